@@ -0,0 +1,78 @@
+#ifndef ALIGNED_ALLOCATOR_HPP_
+#define ALIGNED_ALLOCATOR_HPP_
+
+#include <cstdlib>
+#include <new>
+
+// _aligned_malloc on Windows and aligned_alloc elsewhere, nullptr on failure. free the
+// memory with free_aligned
+inline void* allocate_aligned(std::size_t size_bytes, std::size_t alignment)
+{
+    // aligned_alloc requires the size to be a multiple of the alignment
+    const std::size_t padded_size_bytes = ((size_bytes + alignment - 1) / alignment) * alignment;
+
+#ifdef _WIN32
+    return _aligned_malloc(padded_size_bytes, alignment);
+#else
+    return std::aligned_alloc(alignment, padded_size_bytes);
+#endif
+}
+
+inline void free_aligned(void* memory)
+{
+#ifdef _WIN32
+    _aligned_free(memory);
+#else
+    std::free(memory);
+#endif
+}
+
+template <typename T, std::size_t Alignment>
+class AlignedAllocator
+{
+public:
+    using value_type = T;
+
+    template <typename U>
+    struct rebind
+    {
+        using other = AlignedAllocator<U, Alignment>;
+    };
+
+    AlignedAllocator() = default;
+
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&)
+    {}
+
+    T* allocate(std::size_t count)
+    {
+        void* memory = allocate_aligned(count * sizeof(T), Alignment);
+
+        if (memory == nullptr)
+        {
+            throw std::bad_alloc();
+        }
+
+        return static_cast<T*>(memory);
+    }
+
+    void deallocate(T* memory, std::size_t)
+    {
+        free_aligned(memory);
+    }
+};
+
+template <typename T, typename U, std::size_t Alignment>
+bool operator==(const AlignedAllocator<T, Alignment>&, const AlignedAllocator<U, Alignment>&)
+{
+    return true;
+}
+
+template <typename T, typename U, std::size_t Alignment>
+bool operator!=(const AlignedAllocator<T, Alignment>&, const AlignedAllocator<U, Alignment>&)
+{
+    return false;
+}
+
+#endif // !ALIGNED_ALLOCATOR_HPP_
@@ -0,0 +1,325 @@
+#include "BarnesHutVelocityVerlet.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iostream>
+#include <numeric>
+
+static float square(float val)
+{
+    return val * val;
+}
+
+void BarnesHutVelocityVerlet::set_opening_angle(float opening_angle)
+{
+    m_opening_angle = opening_angle;
+}
+
+void BarnesHutVelocityVerlet::build_tree()
+{
+    m_nodes.clear();
+
+    if (m_num_particles == 0)
+    {
+        return;
+    }
+
+    // bounding cube of all particles
+    sf::Vector3f min_corner(m_particles.x[0], m_particles.y[0], m_particles.z[0]);
+    sf::Vector3f max_corner = min_corner;
+
+    for (std::size_t i = 1; i < m_num_particles; ++i)
+    {
+        min_corner.x = std::min(min_corner.x, m_particles.x[i]);
+        min_corner.y = std::min(min_corner.y, m_particles.y[i]);
+        min_corner.z = std::min(min_corner.z, m_particles.z[i]);
+        max_corner.x = std::max(max_corner.x, m_particles.x[i]);
+        max_corner.y = std::max(max_corner.y, m_particles.y[i]);
+        max_corner.z = std::max(max_corner.z, m_particles.z[i]);
+    }
+
+    const sf::Vector3f center((min_corner.x + max_corner.x) * 0.5f,
+        (min_corner.y + max_corner.y) * 0.5f,
+        (min_corner.z + max_corner.z) * 0.5f);
+
+    float half_size = std::max({ max_corner.x - min_corner.x, max_corner.y - min_corner.y, max_corner.z - min_corner.z }) * 0.5f;
+
+    // grow slightly so that particles on the boundary fall inside
+    half_size = std::max(half_size * 1.0001f, 1e-6f);
+
+    // keep the previous order, it is already almost sorted
+    if (m_tree_order.size() != m_num_particles)
+    {
+        m_tree_order.resize(m_num_particles);
+        std::iota(m_tree_order.begin(), m_tree_order.end(), 0u);
+    }
+
+    m_nodes.resize(1);
+
+    build_node(0, center, half_size, 0u, static_cast<std::uint32_t>(m_num_particles), 0u);
+}
+
+void BarnesHutVelocityVerlet::build_node(std::int32_t index,
+    const sf::Vector3f& center,
+    float half_size,
+    std::uint32_t begin,
+    std::uint32_t end,
+    std::size_t depth)
+{
+    // the pool may grow below, so the node is only accessed by index
+    m_nodes[index] = OctreeNode{ center, half_size, center, 0.f, -1, begin, end };
+
+    if (((end - begin) <= LEAF_SIZE) || (depth >= MAX_DEPTH))
+    {
+        sf::Vector3f weighted(0.f, 0.f, 0.f);
+        float mass = 0.f;
+
+        for (std::uint32_t k = begin; k < end; ++k)
+        {
+            const std::uint32_t i = m_tree_order[k];
+
+            weighted.x += m_particles.mass[i] * m_particles.x[i];
+            weighted.y += m_particles.mass[i] * m_particles.y[i];
+            weighted.z += m_particles.mass[i] * m_particles.z[i];
+            mass += m_particles.mass[i];
+        }
+
+        m_nodes[index].mass = mass;
+
+        if (mass > 0.f)
+        {
+            m_nodes[index].center_of_mass = weighted / mass;
+        }
+
+        return;
+    }
+
+    // counting sort of the range into the 8 octants
+    auto octant_of = [&](std::uint32_t i)
+    {
+        return ((m_particles.x[i] >= center.x) ? 1u : 0u)
+            | ((m_particles.y[i] >= center.y) ? 2u : 0u)
+            | ((m_particles.z[i] >= center.z) ? 4u : 0u);
+    };
+
+    std::array<std::uint32_t, 9> offsets = {};
+
+    for (std::uint32_t k = begin; k < end; ++k)
+    {
+        ++offsets[octant_of(m_tree_order[k]) + 1];
+    }
+
+    offsets[0] = begin;
+
+    for (std::size_t octant = 1; octant < offsets.size(); ++octant)
+    {
+        offsets[octant] += offsets[octant - 1];
+    }
+
+    std::array<std::uint32_t, 8> cursor;
+    std::copy(offsets.begin(), offsets.begin() + 8, cursor.begin());
+
+    for (std::uint32_t k = begin; k < end; ++k)
+    {
+        const std::uint32_t i = m_tree_order[k];
+        m_scratch_order[cursor[octant_of(i)]++] = i;
+    }
+
+    std::copy(m_scratch_order.begin() + begin, m_scratch_order.begin() + end, m_tree_order.begin() + begin);
+
+    // children are allocated consecutively so only the first index is stored
+    const std::int32_t first_child = static_cast<std::int32_t>(m_nodes.size());
+    const float child_half_size = half_size * 0.5f;
+
+    m_nodes.resize(m_nodes.size() + 8);
+    m_nodes[index].first_child = first_child;
+
+    sf::Vector3f weighted(0.f, 0.f, 0.f);
+    float mass = 0.f;
+
+    for (std::uint32_t octant = 0; octant < 8; ++octant)
+    {
+        const sf::Vector3f child_center(center.x + ((octant & 1u) ? child_half_size : -child_half_size),
+            center.y + ((octant & 2u) ? child_half_size : -child_half_size),
+            center.z + ((octant & 4u) ? child_half_size : -child_half_size));
+
+        const std::int32_t child = first_child + static_cast<std::int32_t>(octant);
+
+        build_node(child, child_center, child_half_size, offsets[octant], offsets[octant + 1], depth + 1);
+
+        weighted += m_nodes[child].mass * m_nodes[child].center_of_mass;
+        mass += m_nodes[child].mass;
+    }
+
+    m_nodes[index].mass = mass;
+
+    if (mass > 0.f)
+    {
+        m_nodes[index].center_of_mass = weighted / mass;
+    }
+}
+
+sf::Vector3f BarnesHutVelocityVerlet::walk_tree(std::size_t me) const
+{
+    const float my_x = m_particles.x[me];
+    const float my_y = m_particles.y[me];
+    const float my_z = m_particles.z[me];
+    const float my_mass = m_particles.mass[me];
+
+    const float sqr_opening_angle = square(m_opening_angle);
+
+    sf::Vector3f force(0.f, 0.f, 0.f);
+
+    std::array<std::int32_t, 8 * 64> stack;
+    std::size_t stack_size = 0;
+
+    stack[stack_size++] = 0;
+
+    while (stack_size > 0)
+    {
+        const OctreeNode& node = m_nodes[stack[--stack_size]];
+
+        if (node.mass <= 0.f)
+        {
+            continue;
+        }
+
+        const float diff_x = node.center_of_mass.x - my_x;
+        const float diff_y = node.center_of_mass.y - my_y;
+        const float diff_z = node.center_of_mass.z - my_z;
+
+        const float sqr_distance = square(diff_x) + square(diff_y) + square(diff_z);
+
+        // the node is far enough away to be replaced by its monopole: (2 * half_size) / d < theta
+        if ((node.first_child >= 0) && (4.f * square(node.half_size) < sqr_opening_angle * sqr_distance))
+        {
+            const float gravity = my_mass * node.mass / (std::sqrt(sqr_distance) * sqr_distance);
+
+            force.x += gravity * diff_x;
+            force.y += gravity * diff_y;
+            force.z += gravity * diff_z;
+        }
+        else if (node.first_child >= 0)
+        {
+            for (std::int32_t octant = 0; octant < 8; ++octant)
+            {
+                stack[stack_size++] = node.first_child + octant;
+            }
+        }
+        else
+        {
+            for (std::uint32_t k = node.begin; k < node.end; ++k)
+            {
+                const std::uint32_t other = m_tree_order[k];
+
+                const float other_x = m_particles.x[other] - my_x;
+                const float other_y = m_particles.y[other] - my_y;
+                const float other_z = m_particles.z[other] - my_z;
+
+                const float sqr_other_distance = square(other_x) + square(other_y) + square(other_z);
+
+                // skips this particle and coincident ones
+                if (sqr_other_distance > 0.f)
+                {
+                    const float gravity = my_mass * m_particles.mass[other] / (std::sqrt(sqr_other_distance) * sqr_other_distance);
+
+                    force.x += gravity * other_x;
+                    force.y += gravity * other_y;
+                    force.z += gravity * other_z;
+                }
+            }
+        }
+    }
+
+    return force;
+}
+
+void BarnesHutVelocityVerlet::compute_forces()
+{
+    build_tree();
+
+    // walk in tree order so that consecutive particles visit the same nodes
+    m_thread_pool.parallel_for(0, m_num_particles, GRAIN_SIZE,
+        [this](std::size_t begin, std::size_t end, std::size_t)
+        {
+            for (std::size_t k = begin; k < end; ++k)
+            {
+                const std::uint32_t i = m_tree_order[k];
+                const sf::Vector3f force = walk_tree(i);
+
+                m_new_forces.x[i] = force.x;
+                m_new_forces.y[i] = force.y;
+                m_new_forces.z[i] = force.z;
+            }
+        });
+}
+
+void BarnesHutVelocityVerlet::update_positions()
+{
+    m_thread_pool.parallel_for(0, m_num_particles, GRAIN_SIZE,
+        [this](std::size_t begin, std::size_t end, std::size_t)
+        {
+            for (std::size_t i = begin; i < end; ++i)
+            {
+                float acceleration = m_time_step * 0.5f / m_particles.mass[i];
+
+                m_particles.x[i] += m_time_step * (m_velocities.x[i] + acceleration * m_new_forces.x[i]);
+                m_particles.y[i] += m_time_step * (m_velocities.y[i] + acceleration * m_new_forces.y[i]);
+                m_particles.z[i] += m_time_step * (m_velocities.z[i] + acceleration * m_new_forces.z[i]);
+            }
+        });
+
+    std::swap(m_old_forces, m_new_forces);
+}
+
+void BarnesHutVelocityVerlet::update_velocities()
+{
+    m_thread_pool.parallel_for(0, m_num_particles, GRAIN_SIZE,
+        [this](std::size_t begin, std::size_t end, std::size_t)
+        {
+            for (std::size_t i = begin; i < end; ++i)
+            {
+                float acceleration = m_time_step * 0.5f / m_particles.mass[i];
+
+                m_velocities.x[i] += acceleration * (m_new_forces.x[i] + m_old_forces.x[i]);
+                m_velocities.y[i] += acceleration * (m_new_forces.y[i] + m_old_forces.y[i]);
+                m_velocities.z[i] += acceleration * (m_new_forces.z[i] + m_old_forces.z[i]);
+            }
+        });
+}
+
+void BarnesHutVelocityVerlet::initialize()
+{
+    std::iota(m_tree_order.begin(), m_tree_order.end(), 0u);
+
+    // a balanced octree has about 8 / 7 * N / LEAF_SIZE * 8 nodes, reserve twice that up front
+    m_nodes.reserve(std::max<std::size_t>(64u, 4u * m_num_particles / LEAF_SIZE * 8u));
+
+    std::cout << std::endl << "Barnes-Hut opening angle : " << m_opening_angle << std::endl;
+    std::cout << "CPU threads              : " << m_thread_pool.get_num_threads() << std::endl;
+}
+
+void BarnesHutVelocityVerlet::run(std::vector<sf::Vertex>& vertices)
+{
+    // the forces at the end of a step are the forces at the start of the next one,
+    // so apart from the very first step there is one force evaluation per step
+    if (!m_forces_computed)
+    {
+        compute_forces();
+        m_forces_computed = true;
+    }
+
+    // half kick and drift
+    update_positions();
+    compute_forces();
+    // closing half kick with the new forces
+    update_velocities();
+
+    vertices.resize(m_num_particles);
+
+    for (std::size_t i = 0; i < m_num_particles; ++i)
+    {
+        vertices[i] = sf::Vertex(sf::Vector2f(m_particles.x[i], m_particles.y[i]));
+    }
+}
@@ -0,0 +1,103 @@
+#ifndef BARNES_HUT_VELOCITY_VERLET_HPP_
+#define BARNES_HUT_VELOCITY_VERLET_HPP_
+
+#include "IAlgorithmStrategy.hpp"
+#include "ParticleArrays.hpp"
+#include "ThreadPool.hpp"
+
+#include <cstdint>
+#include <SFML/System/Vector3.hpp>
+#include <thread>
+#include <vector>
+
+class BarnesHutVelocityVerlet : public IAlgorithmStrategy
+{
+private:
+    // maximum number of particles in a leaf before it is split into octants
+    const std::size_t LEAF_SIZE = 16u;
+
+    // coincident particles cannot be separated, stop splitting at this depth
+    const std::size_t MAX_DEPTH = 32u;
+
+    // particles per task for the tree walk and the O(N) loops
+    const std::size_t GRAIN_SIZE = 1024u;
+
+    struct OctreeNode
+    {
+        // geometric center and half the edge length of the cube
+        sf::Vector3f center;
+        float half_size;
+
+        // monopole of all particles below this node
+        sf::Vector3f center_of_mass;
+        float mass;
+
+        // index of the first of 8 consecutive children, or -1 for a leaf
+        std::int32_t first_child;
+
+        // range in m_tree_order covered by this node
+        std::uint32_t begin;
+        std::uint32_t end;
+    };
+
+    void build_tree();
+    void build_node(std::int32_t index, const sf::Vector3f& center, float half_size, std::uint32_t begin, std::uint32_t end, std::size_t depth);
+    sf::Vector3f walk_tree(std::size_t me) const;
+    void compute_forces();
+    void update_positions();
+    void update_velocities();
+
+    ThreadPool m_thread_pool;
+
+    ParticleArrays m_particles;
+    VectorArrays   m_velocities;
+    VectorArrays   m_old_forces;
+    VectorArrays   m_new_forces;
+
+    // m_new_forces holds the forces at the current positions
+    bool m_forces_computed;
+
+    // node pool, cleared but not released every step
+    std::vector<OctreeNode> m_nodes;
+
+    // particle indices grouped by leaf
+    std::vector<std::uint32_t> m_tree_order;
+    std::vector<std::uint32_t> m_scratch_order;
+
+    float m_opening_angle;
+    float m_time_step;
+    std::size_t m_num_particles;
+
+public:
+    BarnesHutVelocityVerlet(std::size_t num_particles,
+        float time_step,
+        std::vector<sf::Vector3f> positions,
+        std::vector<sf::Vector3f> velocities,
+        std::vector<float> masses,
+        float opening_angle = 0.5f,
+        std::size_t num_threads = std::thread::hardware_concurrency())
+        : m_num_particles(num_particles),
+        m_time_step(time_step),
+        m_opening_angle(opening_angle),
+        m_particles(positions, masses),
+        m_velocities(velocities),
+        m_old_forces(num_particles),
+        m_new_forces(num_particles),
+        m_forces_computed(false),
+        m_tree_order(num_particles),
+        m_scratch_order(num_particles),
+        m_thread_pool(num_threads)
+    {}
+
+    ~BarnesHutVelocityVerlet()
+    {}
+
+    // theta in the s / d < theta acceptance criterion, 0 degenerates to direct summation
+    void set_opening_angle(float opening_angle);
+
+    void initialize() override;
+
+    void run(std::vector<sf::Vertex>& vertices) override;
+};
+
+#endif // !BARNES_HUT_VELOCITY_VERLET_HPP_
@@ -0,0 +1,178 @@
+#include "Benchmark.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <numeric>
+
+BenchmarkResult Benchmark::run(const std::string& strategy_name,
+    IAlgorithmStrategy& algorithm,
+    std::size_t num_particles,
+    std::size_t steps_per_run,
+    std::size_t num_systems) const
+{
+    num_systems = std::max<std::size_t>(num_systems, 1u);
+
+    std::vector<sf::Vertex> vertices(num_particles * num_systems);
+
+    for (std::size_t step = 0; step < m_warmup_steps; ++step)
+    {
+        algorithm.run(vertices);
+    }
+
+    std::vector<double> step_seconds;
+    step_seconds.reserve(m_num_steps);
+
+    for (std::size_t step = 0; step < m_num_steps; ++step)
+    {
+        const auto start = std::chrono::steady_clock::now();
+
+        algorithm.run(vertices);
+
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        step_seconds.push_back(seconds / static_cast<double>(std::max<std::size_t>(steps_per_run, 1u)));
+    }
+
+    BenchmarkResult result = {};
+
+    result.strategy_name = strategy_name;
+    result.num_particles = num_particles * num_systems;
+    result.num_steps = m_num_steps * std::max<std::size_t>(steps_per_run, 1u);
+
+    if (step_seconds.empty())
+    {
+        return result;
+    }
+
+    std::sort(step_seconds.begin(), step_seconds.end());
+
+    // nearest rank percentiles
+    auto percentile = [&](double fraction)
+    {
+        const std::size_t rank = static_cast<std::size_t>(std::ceil(fraction * static_cast<double>(step_seconds.size())));
+
+        return step_seconds[std::min(std::max<std::size_t>(rank, 1u), step_seconds.size()) - 1];
+    };
+
+    result.median_step_seconds = percentile(0.5);
+    result.p99_step_seconds = percentile(0.99);
+    result.mean_step_seconds = std::accumulate(step_seconds.begin(), step_seconds.end(), 0.0) / static_cast<double>(step_seconds.size());
+
+    const double interactions = static_cast<double>(num_systems) * static_cast<double>(num_particles) * static_cast<double>(num_particles);
+
+    result.interactions_per_second = interactions / result.median_step_seconds;
+    result.gflops = result.interactions_per_second * FLOPS_PER_INTERACTION * 1e-9;
+
+    return result;
+}
+
+void Benchmark::print_header(std::ostream& output)
+{
+    output << std::endl
+        << std::left << std::setw(10) << "strategy"
+        << std::right << std::setw(12) << "particles"
+        << std::setw(8) << "steps"
+        << std::setw(14) << "median (ms)"
+        << std::setw(12) << "p99 (ms)"
+        << std::setw(16) << "interactions/s"
+        << std::setw(10) << "GFLOP/s" << std::endl;
+}
+
+void Benchmark::print_result(std::ostream& output, const BenchmarkResult& result)
+{
+    output << std::left << std::setw(10) << result.strategy_name
+        << std::right << std::setw(12) << result.num_particles
+        << std::setw(8) << result.num_steps
+        << std::fixed << std::setprecision(3)
+        << std::setw(14) << result.median_step_seconds * 1e3
+        << std::setw(12) << result.p99_step_seconds * 1e3
+        << std::scientific << std::setprecision(3)
+        << std::setw(16) << result.interactions_per_second
+        << std::fixed << std::setprecision(2)
+        << std::setw(10) << result.gflops << std::endl;
+
+    output.unsetf(std::ios::floatfield);
+}
+
+void Benchmark::write_csv(std::ostream& output, const std::vector<BenchmarkResult>& results)
+{
+    output << "strategy,particles,steps,median_s,p99_s,mean_s,interactions_per_s,gflops" << std::endl;
+
+    for (const BenchmarkResult& result : results)
+    {
+        output << result.strategy_name << ','
+            << result.num_particles << ','
+            << result.num_steps << ','
+            << std::setprecision(9)
+            << result.median_step_seconds << ','
+            << result.p99_step_seconds << ','
+            << result.mean_step_seconds << ','
+            << result.interactions_per_second << ','
+            << result.gflops << std::endl;
+    }
+}
+
+void Benchmark::compute_scaling_efficiencies(std::vector<ScalingResult>& results)
+{
+    if (results.empty())
+    {
+        return;
+    }
+
+    const double strong_reference = results.front().strong_step_seconds;
+    const double weak_reference = results.front().weak_step_seconds;
+
+    for (ScalingResult& result : results)
+    {
+        result.strong_efficiency = strong_reference / (static_cast<double>(result.num_ranks) * result.strong_step_seconds);
+        result.weak_efficiency = weak_reference / result.weak_step_seconds;
+    }
+}
+
+void Benchmark::print_scaling(std::ostream& output, const std::vector<ScalingResult>& results)
+{
+    output << std::endl
+        << std::right << std::setw(6) << "ranks"
+        << std::setw(12) << "particles"
+        << std::setw(14) << "strong (ms)"
+        << std::setw(12) << "strong eff"
+        << std::setw(12) << "particles"
+        << std::setw(12) << "weak (ms)"
+        << std::setw(12) << "weak eff" << std::endl;
+
+    for (const ScalingResult& result : results)
+    {
+        output << std::setw(6) << result.num_ranks
+            << std::setw(12) << result.strong_particles
+            << std::fixed << std::setprecision(3)
+            << std::setw(14) << result.strong_step_seconds * 1e3
+            << std::setprecision(2)
+            << std::setw(12) << result.strong_efficiency
+            << std::setw(12) << result.weak_particles
+            << std::setprecision(3)
+            << std::setw(12) << result.weak_step_seconds * 1e3
+            << std::setprecision(2)
+            << std::setw(12) << result.weak_efficiency << std::endl;
+
+        output.unsetf(std::ios::floatfield);
+    }
+}
+
+void Benchmark::write_scaling_csv(std::ostream& output, const std::vector<ScalingResult>& results)
+{
+    output << "ranks,strong_particles,strong_s,strong_efficiency,weak_particles,weak_s,weak_efficiency" << std::endl;
+
+    for (const ScalingResult& result : results)
+    {
+        output << result.num_ranks << ','
+            << result.strong_particles << ','
+            << std::setprecision(9)
+            << result.strong_step_seconds << ','
+            << result.strong_efficiency << ','
+            << result.weak_particles << ','
+            << result.weak_step_seconds << ','
+            << result.weak_efficiency << std::endl;
+    }
+}
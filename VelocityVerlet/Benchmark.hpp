@@ -0,0 +1,81 @@
+#ifndef BENCHMARK_HPP_
+#define BENCHMARK_HPP_
+
+#include "IAlgorithmStrategy.hpp"
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct BenchmarkResult
+{
+    std::string strategy_name;
+    std::size_t num_particles;
+    std::size_t num_steps;
+
+    double median_step_seconds;
+    double p99_step_seconds;
+    double mean_step_seconds;
+
+    // N^2 body-body interactions per step, the usual convention for N-body codes,
+    // so tree and mesh strategies report the direct-sum equivalent rate. an ensemble
+    // counts N^2 per system, num_particles is the total over all systems
+    double interactions_per_second;
+
+    // FLOPS_PER_INTERACTION * interactions_per_second
+    double gflops;
+};
+
+// strong scaling keeps the particle count, weak scaling grows it with sqrt(ranks) so the
+// O(N^2 / ranks) work per rank stays the same. efficiencies are relative to one rank
+struct ScalingResult
+{
+    std::size_t num_ranks;
+
+    std::size_t strong_particles;
+    double strong_step_seconds;
+    double strong_efficiency;
+
+    std::size_t weak_particles;
+    double weak_step_seconds;
+    double weak_efficiency;
+};
+
+// runs an algorithm without a window for a fixed number of steps and reports step time statistics
+class Benchmark
+{
+private:
+    // 3 sub, 3 mul + 2 add (r^2), rsqrt, 2 mul (1/r^3), 2 mul (masses), 3 mul + 3 add (force)
+    const double FLOPS_PER_INTERACTION = 20.0;
+
+    std::size_t m_warmup_steps;
+    std::size_t m_num_steps;
+
+public:
+    Benchmark(std::size_t warmup_steps, std::size_t num_steps)
+        : m_warmup_steps(warmup_steps),
+        m_num_steps(num_steps)
+    {}
+
+    // the algorithm has to be initialized already, steps_per_run is the number of
+    // integration steps a single call to run() advances. an ensemble runs num_systems
+    // independent systems of num_particles each
+    BenchmarkResult run(const std::string& strategy_name,
+        IAlgorithmStrategy& algorithm,
+        std::size_t num_particles,
+        std::size_t steps_per_run = 1u,
+        std::size_t num_systems = 1u) const;
+
+    static void print_header(std::ostream& output);
+    static void print_result(std::ostream& output, const BenchmarkResult& result);
+
+    static void write_csv(std::ostream& output, const std::vector<BenchmarkResult>& results);
+
+    // fills in the efficiencies from the step times, the first result has to be one rank
+    static void compute_scaling_efficiencies(std::vector<ScalingResult>& results);
+
+    static void print_scaling(std::ostream& output, const std::vector<ScalingResult>& results);
+    static void write_scaling_csv(std::ostream& output, const std::vector<ScalingResult>& results);
+};
+
+#endif // !BENCHMARK_HPP_
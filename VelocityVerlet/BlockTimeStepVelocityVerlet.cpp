@@ -0,0 +1,275 @@
+#include "BlockTimeStepVelocityVerlet.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+
+std::uint64_t BlockTimeStepVelocityVerlet::get_period(std::uint32_t level) const
+{
+    // in ticks of time_step / 2^max_level
+    return std::uint64_t(1) << (m_max_level - level);
+}
+
+std::uint32_t BlockTimeStepVelocityVerlet::get_requested_level(std::size_t i) const
+{
+    const float acceleration = std::sqrt(m_accelerations.x[i] * m_accelerations.x[i]
+        + m_accelerations.y[i] * m_accelerations.y[i]
+        + m_accelerations.z[i] * m_accelerations.z[i]);
+
+    const float jerk = std::sqrt(m_jerks.x[i] * m_jerks.x[i]
+        + m_jerks.y[i] * m_jerks.y[i]
+        + m_jerks.z[i] * m_jerks.z[i]);
+
+    if ((acceleration <= 0.f) || (jerk <= 0.f))
+    {
+        return 0u;
+    }
+
+    const float time_step = ETA * acceleration / jerk;
+
+    if (time_step >= m_time_step)
+    {
+        return 0u;
+    }
+
+    // the largest power of two fraction of m_time_step that is not above the requested step
+    const float level = std::ceil(std::log2(m_time_step / time_step));
+
+    return std::min(static_cast<std::uint32_t>(level), m_max_level);
+}
+
+void BlockTimeStepVelocityVerlet::compute_forces(const std::vector<std::uint32_t>& particles)
+{
+    for (const std::uint32_t me : particles)
+    {
+        const float my_x = m_particles.x[me];
+        const float my_y = m_particles.y[me];
+        const float my_z = m_particles.z[me];
+        const float my_vx = m_velocities.x[me];
+        const float my_vy = m_velocities.y[me];
+        const float my_vz = m_velocities.z[me];
+
+        float acceleration_x = 0.f;
+        float acceleration_y = 0.f;
+        float acceleration_z = 0.f;
+        float jerk_x = 0.f;
+        float jerk_y = 0.f;
+        float jerk_z = 0.f;
+
+        // a gather over every other particle, the pair symmetry of the full step kernels
+        // does not help when only a few particles are active
+        for (std::size_t other = 0; other < m_num_particles; ++other)
+        {
+            const float diff_x = m_particles.x[other] - my_x;
+            const float diff_y = m_particles.y[other] - my_y;
+            const float diff_z = m_particles.z[other] - my_z;
+
+            const float sqr_distance = diff_x * diff_x + diff_y * diff_y + diff_z * diff_z;
+
+            // skips me and coincident particles
+            if (sqr_distance <= 0.f)
+            {
+                continue;
+            }
+
+            const float inv_distance = 1.f / std::sqrt(sqr_distance);
+            const float inv_sqr_distance = inv_distance * inv_distance;
+            const float gravity = m_particles.mass[other] * inv_distance * inv_sqr_distance;
+
+            acceleration_x += gravity * diff_x;
+            acceleration_y += gravity * diff_y;
+            acceleration_z += gravity * diff_z;
+
+            // the velocities of inactive particles are half a kick ahead, good enough for picking a step
+            const float diff_vx = m_velocities.x[other] - my_vx;
+            const float diff_vy = m_velocities.y[other] - my_vy;
+            const float diff_vz = m_velocities.z[other] - my_vz;
+
+            const float radial = 3.f * (diff_x * diff_vx + diff_y * diff_vy + diff_z * diff_vz) * inv_sqr_distance;
+
+            jerk_x += gravity * (diff_vx - radial * diff_x);
+            jerk_y += gravity * (diff_vy - radial * diff_y);
+            jerk_z += gravity * (diff_vz - radial * diff_z);
+        }
+
+        m_accelerations.x[me] = acceleration_x;
+        m_accelerations.y[me] = acceleration_y;
+        m_accelerations.z[me] = acceleration_z;
+        m_jerks.x[me] = jerk_x;
+        m_jerks.y[me] = jerk_y;
+        m_jerks.z[me] = jerk_z;
+    }
+
+    m_num_force_evaluations += particles.size();
+}
+
+void BlockTimeStepVelocityVerlet::update_positions()
+{
+    const float time_step = m_time_step / static_cast<float>(m_ticks_per_block);
+
+    // every particle drifts every tick, the opening kick already moved its velocity to mid step
+    for (std::size_t i = 0; i < m_num_particles; ++i)
+    {
+        m_particles.x[i] += time_step * m_velocities.x[i];
+        m_particles.y[i] += time_step * m_velocities.y[i];
+        m_particles.z[i] += time_step * m_velocities.z[i];
+    }
+}
+
+void BlockTimeStepVelocityVerlet::update_velocities(const std::vector<std::uint32_t>& particles)
+{
+    for (const std::uint32_t i : particles)
+    {
+        // the closing kick finishes the step that just ended, the opening kick starts the next one
+        const float half_step = 0.5f * m_time_step / static_cast<float>(std::uint64_t(1) << m_levels[i]);
+
+        m_velocities.x[i] += half_step * m_accelerations.x[i];
+        m_velocities.y[i] += half_step * m_accelerations.y[i];
+        m_velocities.z[i] += half_step * m_accelerations.z[i];
+    }
+}
+
+void BlockTimeStepVelocityVerlet::assign_levels(const std::vector<std::uint32_t>& particles)
+{
+    for (const std::uint32_t i : particles)
+    {
+        const std::uint32_t requested = get_requested_level(i);
+        const std::uint32_t current = m_levels[i];
+
+        if (requested > current)
+        {
+            // a shorter step always fits, the particle is at the end of a longer one
+            m_levels[i] = requested;
+        }
+        else if ((requested < current) && (m_tick % get_period(current - 1) == 0))
+        {
+            // steps only grow one level at a time and only where the longer step starts,
+            // so all particles stay synchronised at block boundaries
+            m_levels[i] = current - 1;
+        }
+    }
+}
+
+void BlockTimeStepVelocityVerlet::collect_active_particles()
+{
+    // a particle is active when the tick is a multiple of its period, that is when its
+    // level is at least max_level minus the number of trailing zero bits of the tick
+    std::uint32_t trailing_zeros = 0;
+
+    while ((trailing_zeros < m_max_level) && (((m_tick >> trailing_zeros) & 1u) == 0))
+    {
+        ++trailing_zeros;
+    }
+
+    const std::uint32_t min_level = m_max_level - trailing_zeros;
+
+    m_active.clear();
+
+    for (std::size_t i = 0; i < m_num_particles; ++i)
+    {
+        if (m_levels[i] >= min_level)
+        {
+            m_active.push_back(static_cast<std::uint32_t>(i));
+        }
+    }
+}
+
+void BlockTimeStepVelocityVerlet::initialize()
+{
+    std::cout << std::endl << "Block time steps : " << m_ticks_per_block << " ticks per step, dt_min "
+        << m_time_step / static_cast<float>(m_ticks_per_block) << std::endl;
+
+    m_all.resize(m_num_particles);
+    std::iota(m_all.begin(), m_all.end(), 0u);
+
+    m_active.reserve(m_num_particles);
+}
+
+void BlockTimeStepVelocityVerlet::run(std::vector<sf::Vertex>& vertices)
+{
+    if (!m_forces_computed)
+    {
+        {
+            ProfileScope scope(m_profiler, ProfilePhase::Force);
+            compute_forces(m_all);
+        }
+
+        ProfileScope scope(m_profiler, ProfilePhase::Kick);
+
+        assign_levels(m_all);
+        update_velocities(m_all);
+
+        m_forces_computed = true;
+    }
+
+    for (m_tick = 1; m_tick <= m_ticks_per_block; ++m_tick)
+    {
+        {
+            ProfileScope scope(m_profiler, ProfilePhase::Drift);
+            update_positions();
+        }
+
+        collect_active_particles();
+
+        {
+            ProfileScope scope(m_profiler, ProfilePhase::Force);
+            compute_forces(m_active);
+        }
+
+        ProfileScope scope(m_profiler, ProfilePhase::Kick);
+
+        update_velocities(m_active);
+
+        // the tick ends the step of every active particle, pick the next one from the new forces
+        assign_levels(m_active);
+
+        update_velocities(m_active);
+    }
+
+    ++m_num_blocks;
+
+    ProfileScope scope(m_profiler, ProfilePhase::VertexConversion);
+
+    vertices.resize(m_num_particles);
+
+    for (std::size_t i = 0; i < m_num_particles; ++i)
+    {
+        vertices[i] = sf::Vertex(sf::Vector2f(m_particles.x[i], m_particles.y[i]));
+    }
+}
+
+void BlockTimeStepVelocityVerlet::set_profiler(Profiler* profiler)
+{
+    m_profiler = profiler;
+}
+
+void BlockTimeStepVelocityVerlet::print_statistics(std::ostream& output) const
+{
+    std::vector<std::size_t> histogram(m_max_level + 1u, 0u);
+
+    for (const std::uint32_t level : m_levels)
+    {
+        ++histogram[level];
+    }
+
+    output << "Block time step levels (dt = " << m_time_step << " / 2^level):" << std::endl;
+
+    for (std::uint32_t level = 0; level <= m_max_level; ++level)
+    {
+        if (histogram[level] > 0)
+        {
+            output << "  level " << std::setw(2) << level << " : " << histogram[level] << std::endl;
+        }
+    }
+
+    // a shared step small enough for the fastest level evaluates every particle every tick
+    const double shared_evaluations = static_cast<double>(m_num_blocks) * static_cast<double>(m_ticks_per_block)
+        * static_cast<double>(m_num_particles);
+
+    output << "Force evaluations : " << m_num_force_evaluations << " over " << m_num_blocks << " steps, "
+        << std::fixed << std::setprecision(1)
+        << ((m_num_force_evaluations > 0) ? shared_evaluations / static_cast<double>(m_num_force_evaluations) : 0.0)
+        << "x fewer than a shared dt_min" << std::defaultfloat << std::endl;
+}
@@ -0,0 +1,93 @@
+#ifndef BLOCK_TIME_STEP_VELOCITY_VERLET_HPP_
+#define BLOCK_TIME_STEP_VELOCITY_VERLET_HPP_
+
+#include "IAlgorithmStrategy.hpp"
+#include "IProfileable.hpp"
+#include "ParticleArrays.hpp"
+
+#include <cstdint>
+#include <ostream>
+#include <SFML/System/Vector3.hpp>
+#include <vector>
+
+// kick-drift-kick leapfrog with hierarchical power-of-two time steps. particle i steps
+// with time_step / 2^level[i], the level is picked from its acceleration and jerk. one
+// call to run() advances a whole block of time_step in 2^max_level ticks: every tick
+// all particles drift, and only the particles whose step ends on that tick get new forces
+// and their closing and opening half kicks
+class BlockTimeStepVelocityVerlet : public IAlgorithmStrategy, public IProfileable
+{
+private:
+    // time step criterion dt = ETA * |a| / |jerk|
+    const float ETA = 0.02f;
+
+    void compute_forces(const std::vector<std::uint32_t>& particles);
+    void update_positions();
+    void update_velocities(const std::vector<std::uint32_t>& particles);
+    void assign_levels(const std::vector<std::uint32_t>& particles);
+    void collect_active_particles();
+
+    std::uint32_t get_requested_level(std::size_t i) const;
+    std::uint64_t get_period(std::uint32_t level) const;
+
+    ParticleArrays m_particles;
+    VectorArrays   m_velocities;
+    VectorArrays   m_accelerations;
+    VectorArrays   m_jerks;
+
+    std::vector<std::uint32_t> m_levels;
+    std::vector<std::uint32_t> m_active;
+    std::vector<std::uint32_t> m_all;
+
+    // m_accelerations holds the accelerations at the start of every particle's current step
+    bool m_forces_computed;
+
+    float m_time_step;
+    std::uint32_t m_max_level;
+    std::uint64_t m_ticks_per_block;
+    std::uint64_t m_tick;
+    std::size_t m_num_particles;
+
+    // single particle force evaluations, each one sums over all other particles
+    std::uint64_t m_num_force_evaluations;
+    std::uint64_t m_num_blocks;
+
+    Profiler* m_profiler;
+
+public:
+    BlockTimeStepVelocityVerlet(std::size_t num_particles,
+        float time_step,
+        std::vector<sf::Vector3f> positions,
+        std::vector<sf::Vector3f> velocities,
+        std::vector<float> masses,
+        std::uint32_t max_level = 8u)
+        : m_particles(positions, masses),
+        m_velocities(velocities),
+        m_accelerations(num_particles),
+        m_jerks(num_particles),
+        m_levels(num_particles, 0u),
+        m_forces_computed(false),
+        m_time_step(time_step),
+        m_max_level(max_level),
+        m_ticks_per_block(std::uint64_t(1) << max_level),
+        m_tick(0u),
+        m_num_particles(num_particles),
+        m_num_force_evaluations(0u),
+        m_num_blocks(0u),
+        m_profiler(nullptr)
+    {}
+
+    ~BlockTimeStepVelocityVerlet()
+    {}
+
+    void initialize() override;
+
+    void run(std::vector<sf::Vertex>& vertices) override;
+
+    void set_profiler(Profiler* profiler) override;
+
+    // level histogram and force evaluations compared to a global step of time_step / 2^max_level
+    void print_statistics(std::ostream& output) const;
+};
+
+#endif // !BLOCK_TIME_STEP_VELOCITY_VERLET_HPP_
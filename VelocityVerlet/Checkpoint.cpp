@@ -0,0 +1,319 @@
+#include "Checkpoint.hpp"
+
+#include "ICheckpointable.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char CHECKPOINT_MAGIC[8] = { 'V', 'V', 'C', 'H', 'K', 'P', 'T', '\0' };
+
+static std::uint64_t align_size(std::uint64_t size)
+{
+    return ((size + CHECKPOINT_ALIGNMENT - 1) / CHECKPOINT_ALIGNMENT) * CHECKPOINT_ALIGNMENT;
+}
+
+void CheckpointState::resize(std::size_t size)
+{
+    num_particles = size;
+
+    for (std::vector<float>& array : arrays)
+    {
+        array.resize(size);
+    }
+}
+
+bool write_checkpoint_file(const std::string& file_name, const CheckpointState& state)
+{
+    CheckpointHeader header = {};
+
+    std::memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version = CHECKPOINT_VERSION;
+    header.header_size = sizeof(CheckpointHeader);
+    header.num_particles = state.num_particles;
+    header.step_count = state.step_count;
+    header.time_step = state.time_step;
+    header.flags = state.has_forces ? CHECKPOINT_HAS_FORCES : 0u;
+    header.array_stride = align_size(state.num_particles * sizeof(float));
+    header.data_offset = align_size(sizeof(CheckpointHeader));
+
+    const std::string temp_file_name = file_name + ".tmp";
+
+    {
+        std::ofstream file(temp_file_name, std::ios::binary | std::ios::trunc);
+
+        if (!file)
+        {
+            return false;
+        }
+
+        const std::vector<char> padding(CHECKPOINT_ALIGNMENT, '\0');
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(padding.data(), header.data_offset - sizeof(header));
+
+        for (const std::vector<float>& array : state.arrays)
+        {
+            const std::uint64_t size_bytes = state.num_particles * sizeof(float);
+
+            if (array.size() != state.num_particles)
+            {
+                return false;
+            }
+
+            file.write(reinterpret_cast<const char*>(array.data()), size_bytes);
+            file.write(padding.data(), header.array_stride - size_bytes);
+        }
+
+        if (!file)
+        {
+            return false;
+        }
+    }
+
+    // a crash during the write leaves the previous checkpoint intact
+    std::error_code error;
+    std::filesystem::rename(temp_file_name, file_name, error);
+
+    if (error)
+    {
+        std::remove(temp_file_name.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+CheckpointFile::CheckpointFile(const std::string& file_name)
+    : m_data(nullptr),
+    m_size(0u),
+#ifdef _WIN32
+    m_file_handle(INVALID_HANDLE_VALUE),
+    m_mapping_handle(NULL)
+#else
+    m_file_descriptor(-1)
+#endif
+{
+#ifdef _WIN32
+    m_file_handle = CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+    LARGE_INTEGER file_size = {};
+
+    if ((m_file_handle == INVALID_HANDLE_VALUE) || !GetFileSizeEx(m_file_handle, &file_size))
+    {
+        close();
+        throw std::string("Failed to open checkpoint ") + file_name;
+    }
+
+    m_size = static_cast<std::size_t>(file_size.QuadPart);
+    m_mapping_handle = CreateFileMappingA(m_file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+
+    if (m_mapping_handle != NULL)
+    {
+        m_data = static_cast<const unsigned char*>(MapViewOfFile(m_mapping_handle, FILE_MAP_READ, 0, 0, 0));
+    }
+#else
+    m_file_descriptor = open(file_name.c_str(), O_RDONLY);
+
+    struct stat file_stat = {};
+
+    if ((m_file_descriptor < 0) || (fstat(m_file_descriptor, &file_stat) != 0))
+    {
+        close();
+        throw std::string("Failed to open checkpoint ") + file_name;
+    }
+
+    m_size = static_cast<std::size_t>(file_stat.st_size);
+
+    void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_file_descriptor, 0);
+
+    if (data != MAP_FAILED)
+    {
+        m_data = static_cast<const unsigned char*>(data);
+
+        // the arrays are read front to back exactly once
+        madvise(data, m_size, MADV_SEQUENTIAL);
+    }
+#endif
+
+    if (m_data == nullptr)
+    {
+        close();
+        throw std::string("Failed to map checkpoint ") + file_name;
+    }
+
+    if (m_size < sizeof(CheckpointHeader))
+    {
+        close();
+        throw std::string("Checkpoint is truncated: ") + file_name;
+    }
+
+    const CheckpointHeader& header = get_header();
+
+    if (std::memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) != 0)
+    {
+        close();
+        throw std::string("Not a checkpoint file: ") + file_name;
+    }
+
+    if ((header.version != CHECKPOINT_VERSION) || (header.header_size != sizeof(CheckpointHeader)))
+    {
+        close();
+        throw std::string("Unsupported checkpoint version ") + std::to_string(header.version) + ": " + file_name;
+    }
+
+    // the sizes come from the file, so every bound is checked by division instead of
+    // multiplying or adding values that could wrap around
+    if ((header.data_offset % CHECKPOINT_ALIGNMENT != 0)
+        || (header.array_stride % CHECKPOINT_ALIGNMENT != 0)
+        || (header.data_offset < sizeof(CheckpointHeader))
+        || (header.data_offset > m_size)
+        || (header.num_particles > header.array_stride / sizeof(float))
+        || (header.array_stride > (m_size - header.data_offset) / CHECKPOINT_ARRAY_COUNT))
+    {
+        close();
+        throw std::string("Checkpoint is truncated: ") + file_name;
+    }
+}
+
+CheckpointFile::~CheckpointFile()
+{
+    close();
+}
+
+void CheckpointFile::close()
+{
+#ifdef _WIN32
+    if (m_data != nullptr)
+    {
+        UnmapViewOfFile(m_data);
+    }
+
+    if (m_mapping_handle != NULL)
+    {
+        CloseHandle(m_mapping_handle);
+        m_mapping_handle = NULL;
+    }
+
+    if (m_file_handle != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(m_file_handle);
+        m_file_handle = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (m_data != nullptr)
+    {
+        munmap(const_cast<unsigned char*>(m_data), m_size);
+    }
+
+    if (m_file_descriptor >= 0)
+    {
+        ::close(m_file_descriptor);
+        m_file_descriptor = -1;
+    }
+#endif
+
+    m_data = nullptr;
+    m_size = 0u;
+}
+
+const CheckpointHeader& CheckpointFile::get_header() const
+{
+    return *reinterpret_cast<const CheckpointHeader*>(m_data);
+}
+
+std::size_t CheckpointFile::get_num_particles() const
+{
+    return static_cast<std::size_t>(get_header().num_particles);
+}
+
+std::uint64_t CheckpointFile::get_step_count() const
+{
+    return get_header().step_count;
+}
+
+float CheckpointFile::get_time_step() const
+{
+    return get_header().time_step;
+}
+
+bool CheckpointFile::has_forces() const
+{
+    return (get_header().flags & CHECKPOINT_HAS_FORCES) != 0;
+}
+
+const float* CheckpointFile::get_array(CheckpointArray array) const
+{
+    const CheckpointHeader& header = get_header();
+
+    return reinterpret_cast<const float*>(m_data + header.data_offset + static_cast<std::size_t>(array) * header.array_stride);
+}
+
+bool CheckpointWriter::save_async(ICheckpointable& source, const std::string& file_name)
+{
+    if (m_busy)
+    {
+        // never stall the integration for a checkpoint, the next one will catch up
+        ++m_num_skipped;
+        return false;
+    }
+
+    if (m_thread.joinable())
+    {
+        m_thread.join();
+    }
+
+    source.save_checkpoint(m_state);
+
+    m_busy = true;
+
+    m_thread = std::thread([this, file_name]()
+        {
+            if (write_checkpoint_file(file_name, m_state))
+            {
+                ++m_num_written;
+            }
+            else
+            {
+                m_failed = true;
+            }
+
+            m_busy = false;
+        });
+
+    return true;
+}
+
+bool CheckpointWriter::wait()
+{
+    if (m_thread.joinable())
+    {
+        m_thread.join();
+    }
+
+    return !m_failed.exchange(false);
+}
+
+std::size_t CheckpointWriter::get_num_written() const
+{
+    return m_num_written;
+}
+
+std::size_t CheckpointWriter::get_num_skipped() const
+{
+    return m_num_skipped;
+}
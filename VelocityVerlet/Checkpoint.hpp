@@ -0,0 +1,149 @@
+#ifndef CHECKPOINT_HPP_
+#define CHECKPOINT_HPP_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+// file layout, native byte order:
+//   CheckpointHeader
+//   CHECKPOINT_ARRAY_COUNT arrays of num_particles floats, each starting on a 64 byte
+//   boundary array_stride bytes apart, in the order of CheckpointArray
+constexpr std::uint32_t CHECKPOINT_VERSION = 1u;
+constexpr std::uint32_t CHECKPOINT_HAS_FORCES = 1u;
+constexpr std::size_t CHECKPOINT_ALIGNMENT = 64u;
+
+enum class CheckpointArray
+{
+    PositionX,
+    PositionY,
+    PositionZ,
+    VelocityX,
+    VelocityY,
+    VelocityZ,
+    Mass,
+    ForceX,
+    ForceY,
+    ForceZ
+};
+
+constexpr std::size_t CHECKPOINT_ARRAY_COUNT = 10u;
+
+struct CheckpointHeader
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t header_size;
+    std::uint64_t num_particles;
+    std::uint64_t step_count;
+    float time_step;
+    std::uint32_t flags;
+    std::uint64_t array_stride;
+    std::uint64_t data_offset;
+};
+
+// an in-memory copy of the state, filled by the strategies when saving
+struct CheckpointState
+{
+    std::uint64_t num_particles = 0;
+    std::uint64_t step_count = 0;
+    float time_step = 0.f;
+
+    // the forces at the saved positions, lets a restored run skip the first force evaluation
+    bool has_forces = false;
+
+    std::array<std::vector<float>, CHECKPOINT_ARRAY_COUNT> arrays;
+
+    void resize(std::size_t size);
+
+    std::vector<float>& get(CheckpointArray array)
+    {
+        return arrays[static_cast<std::size_t>(array)];
+    }
+};
+
+// writes through a temporary file that replaces file_name once complete
+bool write_checkpoint_file(const std::string& file_name, const CheckpointState& state);
+
+// read-only memory mapping of a checkpoint file, the arrays point straight into the mapping
+class CheckpointFile
+{
+private:
+    const unsigned char* m_data;
+    std::size_t m_size;
+
+#ifdef _WIN32
+    void* m_file_handle;
+    void* m_mapping_handle;
+#else
+    int m_file_descriptor;
+#endif
+
+    const CheckpointHeader& get_header() const;
+
+    void close();
+
+public:
+    // throws std::string if the file cannot be mapped or is not a valid checkpoint
+    explicit CheckpointFile(const std::string& file_name);
+
+    ~CheckpointFile();
+
+    CheckpointFile(const CheckpointFile&) = delete;
+    CheckpointFile& operator=(const CheckpointFile&) = delete;
+
+    std::size_t get_num_particles() const;
+    std::uint64_t get_step_count() const;
+    float get_time_step() const;
+    bool has_forces() const;
+
+    const float* get_array(CheckpointArray array) const;
+};
+
+class ICheckpointable;
+
+// saves checkpoints on a background thread. the state is copied on the calling thread into a
+// buffer the writer keeps, so a save only costs a memcpy of the particle arrays
+class CheckpointWriter
+{
+private:
+    CheckpointState m_state;
+    std::thread m_thread;
+    std::atomic<bool> m_busy;
+    std::atomic<bool> m_failed;
+
+    // counted by the writer thread once the file is complete
+    std::atomic<std::size_t> m_num_written;
+    std::size_t m_num_skipped;
+
+public:
+    CheckpointWriter()
+        : m_busy(false),
+        m_failed(false),
+        m_num_written(0u),
+        m_num_skipped(0u)
+    {}
+
+    ~CheckpointWriter()
+    {
+        wait();
+    }
+
+    CheckpointWriter(const CheckpointWriter&) = delete;
+    CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+    // returns false without blocking when the previous checkpoint is still being written
+    bool save_async(ICheckpointable& source, const std::string& file_name);
+
+    // blocks until the pending write is done, returns false if it failed
+    bool wait();
+
+    std::size_t get_num_written() const;
+    std::size_t get_num_skipped() const;
+};
+
+#endif // !CHECKPOINT_HPP_
@@ -0,0 +1,149 @@
+#include "DensitySplatRenderer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+void DensitySplatRenderer::build_palette(Colormap colormap)
+{
+    // a few stops of an inferno-like ramp, black for empty pixels
+    const std::array<sf::Color, 5u> heat_stops =
+    { {
+        sf::Color(0, 0, 4),
+        sf::Color(87, 16, 110),
+        sf::Color(188, 55, 84),
+        sf::Color(249, 142, 9),
+        sf::Color(252, 255, 164)
+    } };
+
+    for (std::size_t i = 0; i < m_palette.size(); ++i)
+    {
+        const float t = static_cast<float>(i) / static_cast<float>(m_palette.size() - 1);
+
+        if (colormap == Colormap::Grayscale)
+        {
+            const sf::Uint8 level = static_cast<sf::Uint8>(i);
+
+            m_palette[i] = sf::Color(level, level, level);
+            continue;
+        }
+
+        const float position = t * static_cast<float>(heat_stops.size() - 1);
+        const std::size_t stop = std::min(static_cast<std::size_t>(position), heat_stops.size() - 2);
+        const float weight = position - static_cast<float>(stop);
+
+        auto blend = [weight](sf::Uint8 from, sf::Uint8 to)
+        {
+            return static_cast<sf::Uint8>(std::lround(from + weight * (static_cast<float>(to) - from)));
+        };
+
+        m_palette[i] = sf::Color(blend(heat_stops[stop].r, heat_stops[stop + 1].r),
+            blend(heat_stops[stop].g, heat_stops[stop + 1].g),
+            blend(heat_stops[stop].b, heat_stops[stop + 1].b));
+    }
+}
+
+void DensitySplatRenderer::bin_particles(const std::vector<sf::Vertex>& vertices)
+{
+    m_thread_pool.parallel_for(0, vertices.size(), GRAIN_SIZE,
+        [this, &vertices](std::size_t begin, std::size_t end, std::size_t worker)
+        {
+            std::uint32_t* counts = m_thread_counts[worker].data();
+
+            const float width = static_cast<float>(m_width);
+            const float height = static_cast<float>(m_height);
+
+            for (std::size_t i = begin; i < end; ++i)
+            {
+                const sf::Vector2f& position = vertices[i].position;
+
+                // also rejects NaN, particles outside the window are not drawn either
+                if ((position.x >= 0.f) && (position.x < width) && (position.y >= 0.f) && (position.y < height))
+                {
+                    ++counts[static_cast<std::size_t>(position.y) * m_width + static_cast<std::size_t>(position.x)];
+                }
+            }
+        });
+}
+
+std::uint32_t DensitySplatRenderer::sum_counts()
+{
+    std::fill(m_thread_max.begin(), m_thread_max.end(), 0u);
+
+    m_thread_pool.parallel_for(0, m_height, ROW_GRAIN_SIZE,
+        [this](std::size_t begin, std::size_t end, std::size_t worker)
+        {
+            std::uint32_t max_count = m_thread_max[worker];
+
+            for (std::size_t pixel = begin * m_width; pixel < end * m_width; ++pixel)
+            {
+                std::uint32_t count = 0;
+
+                for (std::vector<std::uint32_t>& thread_counts : m_thread_counts)
+                {
+                    count += thread_counts[pixel];
+                    thread_counts[pixel] = 0;
+                }
+
+                m_counts[pixel] = count;
+                max_count = std::max(max_count, count);
+            }
+
+            m_thread_max[worker] = max_count;
+        });
+
+    return *std::max_element(m_thread_max.begin(), m_thread_max.end());
+}
+
+void DensitySplatRenderer::color_pixels(std::uint32_t max_count)
+{
+    // the densest pixel takes the last palette entry in either scale
+    const float palette_max = static_cast<float>(m_palette.size() - 1);
+    const float scale = (m_scale == DensityScale::Log)
+        ? palette_max / std::log1p(static_cast<float>(std::max(max_count, 1u)))
+        : palette_max / static_cast<float>(std::max(max_count, 1u));
+
+    m_thread_pool.parallel_for(0, m_height, ROW_GRAIN_SIZE,
+        [this, scale](std::size_t begin, std::size_t end, std::size_t)
+        {
+            for (std::size_t pixel = begin * m_width; pixel < end * m_width; ++pixel)
+            {
+                const float count = static_cast<float>(m_counts[pixel]);
+                const float level = (m_scale == DensityScale::Log) ? std::log1p(count) * scale : count * scale;
+
+                const sf::Color& color = m_palette[std::min(static_cast<std::size_t>(level), m_palette.size() - 1)];
+
+                sf::Uint8* rgba = &m_pixels[pixel * 4u];
+
+                rgba[0] = color.r;
+                rgba[1] = color.g;
+                rgba[2] = color.b;
+                rgba[3] = 255;
+            }
+        });
+}
+
+void DensitySplatRenderer::update(const std::vector<sf::Vertex>& vertices)
+{
+    if (!m_texture_created)
+    {
+        if (!m_texture.create(static_cast<unsigned int>(m_width), static_cast<unsigned int>(m_height)))
+        {
+            throw std::string("Failed to create density texture. Size: ") + std::to_string(m_width) + " x " + std::to_string(m_height);
+        }
+
+        m_sprite.setTexture(m_texture, true);
+        m_texture_created = true;
+    }
+
+    bin_particles(vertices);
+    color_pixels(sum_counts());
+
+    // the only upload of the frame, the same size whatever the particle count
+    m_texture.update(m_pixels.data());
+}
+
+const sf::Drawable& DensitySplatRenderer::get_frame() const
+{
+    return m_sprite;
+}
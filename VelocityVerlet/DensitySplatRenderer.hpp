@@ -0,0 +1,86 @@
+#ifndef DENSITY_SPLAT_RENDERER_HPP_
+#define DENSITY_SPLAT_RENDERER_HPP_
+
+#include "IRenderStrategy.hpp"
+#include "ThreadPool.hpp"
+
+#include <array>
+#include <cstdint>
+#include <SFML/Graphics.hpp>
+#include <thread>
+#include <vector>
+
+enum class DensityScale
+{
+    Linear,
+    Log
+};
+
+enum class Colormap
+{
+    Grayscale,
+    Heat
+};
+
+// counts the particles per pixel of a fixed-size image and uploads it as one texture, so
+// the upload depends on the window size instead of the particle count. the counts are
+// binned in parallel into one image per worker and summed while they are colored
+class DensitySplatRenderer : public IRenderStrategy
+{
+private:
+    // particles per binning task and image rows per coloring task
+    const std::size_t GRAIN_SIZE = 65536u;
+    const std::size_t ROW_GRAIN_SIZE = 16u;
+
+    std::size_t m_width;
+    std::size_t m_height;
+    DensityScale m_scale;
+
+    ThreadPool m_thread_pool;
+
+    // one count image per worker, cleared again when it is summed
+    std::vector<std::vector<std::uint32_t>> m_thread_counts;
+    std::vector<std::uint32_t> m_counts;
+    std::vector<std::uint32_t> m_thread_max;
+
+    // RGBA, row by row
+    std::vector<sf::Uint8> m_pixels;
+    std::array<sf::Color, 256u> m_palette;
+
+    sf::Texture m_texture;
+    sf::Sprite m_sprite;
+    bool m_texture_created;
+
+    void build_palette(Colormap colormap);
+    void bin_particles(const std::vector<sf::Vertex>& vertices);
+    std::uint32_t sum_counts();
+    void color_pixels(std::uint32_t max_count);
+
+public:
+    DensitySplatRenderer(std::size_t width,
+        std::size_t height,
+        DensityScale scale = DensityScale::Log,
+        Colormap colormap = Colormap::Heat,
+        std::size_t num_threads = std::thread::hardware_concurrency())
+        : m_width(width),
+        m_height(height),
+        m_scale(scale),
+        m_thread_pool(num_threads),
+        m_thread_counts(m_thread_pool.get_num_threads(), std::vector<std::uint32_t>(width * height, 0u)),
+        m_counts(width * height, 0u),
+        m_thread_max(m_thread_pool.get_num_threads(), 0u),
+        m_pixels(width * height * 4u, 0u),
+        m_texture_created(false)
+    {
+        build_palette(colormap);
+    }
+
+    ~DensitySplatRenderer()
+    {}
+
+    void update(const std::vector<sf::Vertex>& vertices) override;
+
+    const sf::Drawable& get_frame() const override;
+};
+
+#endif // !DENSITY_SPLAT_RENDERER_HPP_
@@ -0,0 +1,112 @@
+#include "Diagnostics.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+void DiagnosticsLog::record(const StepDiagnostics& diagnostics)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_records.size() < MAX_RECORDS)
+    {
+        m_records.push_back(diagnostics);
+    }
+    else
+    {
+        ++m_num_discarded_records;
+    }
+}
+
+std::vector<StepDiagnostics> DiagnosticsLog::get_records() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return m_records;
+}
+
+void DiagnosticsLog::print_summary(std::ostream& output) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_records.empty())
+    {
+        output << "No diagnostics recorded" << std::endl;
+        return;
+    }
+
+    const StepDiagnostics& first = m_records.front();
+    const StepDiagnostics& last = m_records.back();
+
+    // relative to the first total energy, absolute when that is zero
+    const double reference = (first.get_total_energy() != 0.0) ? std::abs(first.get_total_energy()) : 1.0;
+
+    double max_energy_drift = 0.0;
+    double max_momentum_drift = 0.0;
+
+    for (const StepDiagnostics& diagnostics : m_records)
+    {
+        max_energy_drift = std::max(max_energy_drift,
+            std::abs(diagnostics.get_total_energy() - first.get_total_energy()) / reference);
+
+        const double drift_x = diagnostics.momentum[0] - first.momentum[0];
+        const double drift_y = diagnostics.momentum[1] - first.momentum[1];
+        const double drift_z = diagnostics.momentum[2] - first.momentum[2];
+
+        max_momentum_drift = std::max(max_momentum_drift,
+            std::sqrt(drift_x * drift_x + drift_y * drift_y + drift_z * drift_z));
+    }
+
+    const std::streamsize precision = output.precision();
+
+    output << "Diagnostics steps    : " << first.step << " - " << last.step
+        << " (" << m_records.size() << " records)" << std::endl;
+    output << std::scientific << std::setprecision(6);
+    output << "Total energy         : " << first.get_total_energy() << " -> " << last.get_total_energy() << std::endl;
+    output << "Max energy drift     : " << max_energy_drift << std::endl;
+    output << "Max momentum drift   : " << max_momentum_drift << std::endl;
+    output << std::defaultfloat << std::setprecision(precision);
+}
+
+void DiagnosticsLog::write_csv(std::ostream& output) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    output << "step,kinetic_energy,potential_energy,total_energy,momentum_x,momentum_y,momentum_z" << std::endl;
+    output << std::scientific << std::setprecision(12);
+
+    for (const StepDiagnostics& diagnostics : m_records)
+    {
+        output << diagnostics.step << ','
+            << diagnostics.kinetic_energy << ','
+            << diagnostics.potential_energy << ','
+            << diagnostics.get_total_energy() << ','
+            << diagnostics.momentum[0] << ','
+            << diagnostics.momentum[1] << ','
+            << diagnostics.momentum[2] << std::endl;
+    }
+
+    output << std::defaultfloat;
+}
+
+bool DiagnosticsLog::export_file(const std::string& file_name) const
+{
+    std::ofstream file(file_name);
+
+    if (!file)
+    {
+        return false;
+    }
+
+    write_csv(file);
+
+    if (m_num_discarded_records > 0)
+    {
+        std::cout << "Diagnostics kept the first " << MAX_RECORDS << " steps, "
+            << m_num_discarded_records << " more were dropped" << std::endl;
+    }
+
+    return static_cast<bool>(file);
+}
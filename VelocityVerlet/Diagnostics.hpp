@@ -0,0 +1,56 @@
+#ifndef DIAGNOSTICS_HPP_
+#define DIAGNOSTICS_HPP_
+
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// conserved quantities at the end of one step, summed in double
+struct StepDiagnostics
+{
+    std::uint64_t step;
+    double kinetic_energy;
+    double potential_energy;
+    std::array<double, 3u> momentum;
+
+    double get_total_energy() const
+    {
+        return kinetic_energy + potential_energy;
+    }
+};
+
+// collects the per-step diagnostics of a strategy. the strategies fuse the sums into
+// their force and velocity passes and only do so while a log is set, see IDiagnosable.
+// records may arrive from the simulation thread while the main thread reads them
+class DiagnosticsLog
+{
+private:
+    const std::size_t MAX_RECORDS = 10000000u;
+
+    std::vector<StepDiagnostics> m_records;
+    std::size_t m_num_discarded_records;
+
+    mutable std::mutex m_mutex;
+
+public:
+    DiagnosticsLog()
+        : m_num_discarded_records(0u)
+    {}
+
+    void record(const StepDiagnostics& diagnostics);
+
+    std::vector<StepDiagnostics> get_records() const;
+
+    // relative energy drift and momentum drift against the first record
+    void print_summary(std::ostream& output) const;
+
+    void write_csv(std::ostream& output) const;
+
+    bool export_file(const std::string& file_name) const;
+};
+
+#endif // !DIAGNOSTICS_HPP_
@@ -0,0 +1,391 @@
+#include "DistributedVelocityVerlet.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <utility>
+
+DistributedRank::DistributedRank(IRingCommunicator& communicator,
+    const DistributedSetup& setup,
+    const std::vector<sf::Vector3f>& positions,
+    const std::vector<sf::Vector3f>& velocities,
+    const std::vector<float>& masses)
+    : m_communicator(communicator),
+    m_setup(setup),
+    m_forces_computed(false),
+    m_simd_level(detect_simd_level()),
+    m_force_kernel(select_force_kernel(m_simd_level, setup.force_law.law))
+{
+    const std::size_t num_particles = static_cast<std::size_t>(m_setup.num_particles);
+    const std::size_t num_ranks = m_communicator.get_num_ranks();
+    const std::size_t particles_per_rank = (num_particles + num_ranks - 1) / num_ranks;
+
+    m_block_size = ((particles_per_rank + PARTICLE_LANE_WIDTH - 1) / PARTICLE_LANE_WIDTH) * PARTICLE_LANE_WIDTH;
+    m_first_particle = std::min(m_communicator.get_rank() * particles_per_rank, num_particles);
+    m_num_local_particles = get_num_particles_of(m_communicator.get_rank());
+
+    // the whole initial state from rank 0, position, velocity and mass per particle
+    std::vector<float> state(7u * num_particles);
+
+    if (m_communicator.get_rank() == 0)
+    {
+        for (std::size_t i = 0; i < num_particles; ++i)
+        {
+            state[7u * i + 0u] = positions[i].x;
+            state[7u * i + 1u] = positions[i].y;
+            state[7u * i + 2u] = positions[i].z;
+            state[7u * i + 3u] = velocities[i].x;
+            state[7u * i + 4u] = velocities[i].y;
+            state[7u * i + 5u] = velocities[i].z;
+            state[7u * i + 6u] = masses[i];
+        }
+    }
+
+    m_communicator.broadcast(state.data(), state.size() * sizeof(float));
+
+    m_particles.resize(2u * m_block_size);
+    m_velocities.resize(m_block_size);
+    m_old_forces.resize(2u * m_block_size);
+    m_new_forces.resize(2u * m_block_size);
+
+    for (std::size_t i = 0; i < m_num_local_particles; ++i)
+    {
+        const float* particle = &state[7u * (m_first_particle + i)];
+
+        m_particles.x[i] = particle[0];
+        m_particles.y[i] = particle[1];
+        m_particles.z[i] = particle[2];
+        m_velocities.x[i] = particle[3];
+        m_velocities.y[i] = particle[4];
+        m_velocities.z[i] = particle[5];
+        m_particles.mass[i] = particle[6];
+    }
+
+    for (std::vector<float>& block : m_blocks)
+    {
+        block.resize(4u * m_block_size);
+    }
+}
+
+std::size_t DistributedRank::get_num_particles_of(std::size_t rank) const
+{
+    const std::size_t num_particles = static_cast<std::size_t>(m_setup.num_particles);
+    const std::size_t num_ranks = m_communicator.get_num_ranks();
+    const std::size_t particles_per_rank = (num_particles + num_ranks - 1) / num_ranks;
+    const std::size_t first = std::min(rank * particles_per_rank, num_particles);
+
+    return std::min(particles_per_rank, num_particles - first);
+}
+
+void DistributedRank::pack_block(std::vector<float>& block) const
+{
+    std::copy(m_particles.x.begin(), m_particles.x.begin() + m_block_size, block.begin());
+    std::copy(m_particles.y.begin(), m_particles.y.begin() + m_block_size, block.begin() + m_block_size);
+    std::copy(m_particles.z.begin(), m_particles.z.begin() + m_block_size, block.begin() + 2u * m_block_size);
+    std::copy(m_particles.mass.begin(), m_particles.mass.begin() + m_block_size, block.begin() + 3u * m_block_size);
+}
+
+void DistributedRank::unpack_block(const std::vector<float>& block)
+{
+    std::copy(block.begin(), block.begin() + m_block_size, m_particles.x.begin() + m_block_size);
+    std::copy(block.begin() + m_block_size, block.begin() + 2u * m_block_size, m_particles.y.begin() + m_block_size);
+    std::copy(block.begin() + 2u * m_block_size, block.begin() + 3u * m_block_size, m_particles.z.begin() + m_block_size);
+    std::copy(block.begin() + 3u * m_block_size, block.begin() + 4u * m_block_size, m_particles.mass.begin() + m_block_size);
+}
+
+void DistributedRank::compute_forces()
+{
+    const std::size_t num_ranks = m_communicator.get_num_ranks();
+    const std::size_t rank = m_communicator.get_rank();
+
+    m_new_forces.fill_zero();
+
+    const ForceKernelArgs args =
+    {
+        m_particles.x.data(),
+        m_particles.y.data(),
+        m_particles.z.data(),
+        m_particles.mass.data(),
+        m_new_forces.x.data(),
+        m_new_forces.y.data(),
+        m_new_forces.z.data(),
+        m_setup.force_law
+    };
+
+    std::size_t current = 0;
+
+    pack_block(m_blocks[current]);
+
+    // after hop h the block of rank - h has arrived, num_ranks - 1 shifts in total
+    for (std::size_t hop = 0; hop < num_ranks; ++hop)
+    {
+        const bool forward = (hop + 1 < num_ranks);
+
+        if (forward)
+        {
+            m_communicator.start_shift(m_blocks[current].data(), m_blocks[1 - current].data(), m_blocks[current].size());
+        }
+
+        if (hop == 0)
+        {
+            // the own slice against itself, each pair once
+            m_force_kernel(args, 0, m_num_local_particles, 0, m_num_local_particles);
+        }
+        else
+        {
+            const std::size_t source = (rank + num_ranks - hop) % num_ranks;
+
+            m_force_kernel(args, 0, m_num_local_particles, m_block_size, m_block_size + get_num_particles_of(source));
+        }
+
+        if (forward)
+        {
+            m_communicator.finish_shift();
+
+            current = 1 - current;
+            unpack_block(m_blocks[current]);
+        }
+    }
+}
+
+void DistributedRank::update_positions()
+{
+    const float time_step = m_setup.time_step;
+
+    for (std::size_t i = 0; i < m_num_local_particles; ++i)
+    {
+        float acceleration = time_step * 0.5f / m_particles.mass[i];
+
+        m_particles.x[i] += time_step * (m_velocities.x[i] + acceleration * m_new_forces.x[i]);
+        m_particles.y[i] += time_step * (m_velocities.y[i] + acceleration * m_new_forces.y[i]);
+        m_particles.z[i] += time_step * (m_velocities.z[i] + acceleration * m_new_forces.z[i]);
+    }
+
+    std::swap(m_old_forces, m_new_forces);
+}
+
+void DistributedRank::update_velocities()
+{
+    const float time_step = m_setup.time_step;
+
+    for (std::size_t i = 0; i < m_num_local_particles; ++i)
+    {
+        float acceleration = time_step * 0.5f / m_particles.mass[i];
+
+        m_velocities.x[i] += acceleration * (m_new_forces.x[i] + m_old_forces.x[i]);
+        m_velocities.y[i] += acceleration * (m_new_forces.y[i] + m_old_forces.y[i]);
+        m_velocities.z[i] += acceleration * (m_new_forces.z[i] + m_old_forces.z[i]);
+    }
+}
+
+void DistributedRank::step()
+{
+    // the forces at the end of a step are the forces at the start of the next one
+    if (!m_forces_computed)
+    {
+        compute_forces();
+        m_forces_computed = true;
+    }
+
+    update_positions();
+    compute_forces();
+    update_velocities();
+}
+
+void DistributedRank::gather_positions(std::vector<sf::Vertex>& vertices)
+{
+    const std::size_t num_ranks = m_communicator.get_num_ranks();
+
+    m_gather_send.resize(2u * m_block_size);
+    m_gather_receive.resize(2u * m_block_size * num_ranks);
+
+    std::copy(m_particles.x.begin(), m_particles.x.begin() + m_block_size, m_gather_send.begin());
+    std::copy(m_particles.y.begin(), m_particles.y.begin() + m_block_size, m_gather_send.begin() + m_block_size);
+
+    m_communicator.all_gather(m_gather_send.data(), m_gather_receive.data(), m_gather_send.size());
+
+    if (m_communicator.get_rank() != 0)
+    {
+        return;
+    }
+
+    vertices.resize(static_cast<std::size_t>(m_setup.num_particles));
+
+    std::size_t particle = 0;
+
+    for (std::size_t rank = 0; rank < num_ranks; ++rank)
+    {
+        const float* x = &m_gather_receive[2u * m_block_size * rank];
+        const float* y = x + m_block_size;
+
+        for (std::size_t i = 0; i < get_num_particles_of(rank); ++i)
+        {
+            vertices[particle++] = sf::Vertex(sf::Vector2f(x[i], y[i]));
+        }
+    }
+}
+
+void DistributedRank::send_step()
+{
+    Command command = Command::Step;
+
+    m_communicator.broadcast(&command, sizeof(command));
+}
+
+void DistributedRank::send_stop()
+{
+    Command command = Command::Stop;
+
+    m_communicator.broadcast(&command, sizeof(command));
+}
+
+void DistributedRank::serve()
+{
+    std::vector<sf::Vertex> vertices;
+
+    for (;;)
+    {
+        Command command = Command::Stop;
+
+        m_communicator.broadcast(&command, sizeof(command));
+
+        if (command == Command::Stop)
+        {
+            return;
+        }
+
+        step();
+        gather_positions(vertices);
+    }
+}
+
+void DistributedVelocityVerlet::stop_ranks()
+{
+    if (m_rank != nullptr)
+    {
+        m_rank->send_stop();
+    }
+
+    for (std::thread& thread : m_threads)
+    {
+        thread.join();
+    }
+
+    m_threads.clear();
+    m_rank.reset();
+    m_communicators.clear();
+    m_hub.reset();
+}
+
+void DistributedVelocityVerlet::initialize()
+{
+    if ((m_positions.size() != m_setup.num_particles) || (m_velocities.size() != m_setup.num_particles)
+        || (m_masses.size() != m_setup.num_particles) || (m_setup.num_particles == 0))
+    {
+        throw std::string("Failure due to invalid inputs");
+    }
+
+    stop_ranks();
+
+#ifdef VV_USE_MPI
+    int world_size = 1;
+    MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+
+    if (world_size > 1)
+    {
+        // the other processes wait in MpiSession::serve_workers for this setup
+        MpiRingCommunicator world;
+
+        m_setup.num_ranks = std::min<std::uint64_t>(m_setup.num_ranks, static_cast<std::uint64_t>(world_size));
+        world.broadcast(&m_setup, sizeof(m_setup));
+
+        m_communicators.push_back(world.split(static_cast<std::size_t>(m_setup.num_ranks)));
+        m_rank = std::make_unique<DistributedRank>(*m_communicators.front(), m_setup, m_positions, m_velocities, m_masses);
+
+        std::cout << std::endl << "Distributed ranks : " << m_setup.num_ranks << " MPI processes" << std::endl;
+
+        return;
+    }
+#endif
+
+    const std::size_t num_ranks = static_cast<std::size_t>(m_setup.num_ranks);
+
+    m_hub = std::make_unique<LocalRingHub>(num_ranks);
+
+    for (std::size_t rank = 0; rank < num_ranks; ++rank)
+    {
+        m_communicators.push_back(std::make_unique<LocalRingCommunicator>(*m_hub, rank));
+    }
+
+    for (std::size_t rank = 1; rank < num_ranks; ++rank)
+    {
+        m_threads.emplace_back([this, rank]()
+            {
+                DistributedRank worker(*m_communicators[rank], m_setup, m_positions, m_velocities, m_masses);
+                worker.serve();
+            });
+    }
+
+    // the constructor is collective, the state broadcast waits for all worker threads
+    m_rank = std::make_unique<DistributedRank>(*m_communicators.front(), m_setup, m_positions, m_velocities, m_masses);
+
+    std::cout << std::endl << "Distributed ranks : " << num_ranks << " threads" << std::endl;
+}
+
+void DistributedVelocityVerlet::run(std::vector<sf::Vertex>& vertices)
+{
+    m_rank->send_step();
+    m_rank->step();
+    m_rank->gather_positions(vertices);
+}
+
+#ifdef VV_USE_MPI
+
+DistributedVelocityVerlet::MpiSession::MpiSession(int& argc, char**& argv)
+    : m_rank(0)
+{
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &m_rank);
+}
+
+DistributedVelocityVerlet::MpiSession::~MpiSession()
+{
+    // zero ranks releases the workers from serve_workers
+    if (m_rank == 0)
+    {
+        MpiRingCommunicator world;
+        DistributedSetup setup = {};
+
+        world.broadcast(&setup, sizeof(setup));
+    }
+
+    MPI_Finalize();
+}
+
+void DistributedVelocityVerlet::MpiSession::serve_workers()
+{
+    MpiRingCommunicator world;
+
+    for (;;)
+    {
+        DistributedSetup setup = {};
+
+        world.broadcast(&setup, sizeof(setup));
+
+        if (setup.num_ranks == 0)
+        {
+            return;
+        }
+
+        // ranks beyond the requested count sit this strategy out
+        std::unique_ptr<MpiRingCommunicator> communicator = world.split(static_cast<std::size_t>(setup.num_ranks));
+
+        if (communicator != nullptr)
+        {
+            DistributedRank rank(*communicator, setup, {}, {}, {});
+            rank.serve();
+        }
+    }
+}
+
+#endif // VV_USE_MPI
@@ -0,0 +1,163 @@
+#ifndef DISTRIBUTED_VELOCITY_VERLET_HPP_
+#define DISTRIBUTED_VELOCITY_VERLET_HPP_
+
+#include "ForceKernels.hpp"
+#include "IAlgorithmStrategy.hpp"
+#include "LocalRingCommunicator.hpp"
+#include "MpiRingCommunicator.hpp"
+#include "ParticleArrays.hpp"
+#include "RingCommunicator.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <SFML/System/Vector3.hpp>
+#include <thread>
+#include <vector>
+
+// what rank 0 broadcasts before the initial state
+struct DistributedSetup
+{
+    std::uint64_t num_particles;
+    std::uint64_t num_ranks;
+    float time_step;
+    ForceLawParameters force_law;
+};
+
+// one rank of the distributed strategy, it owns a contiguous slice of the particles.
+// the position blocks of all ranks travel around the ring, while a block is in flight
+// to the next rank the forces of the own slice against it are accumulated
+class DistributedRank
+{
+private:
+    enum class Command : std::uint32_t
+    {
+        Step,
+        Stop
+    };
+
+    IRingCommunicator& m_communicator;
+    DistributedSetup m_setup;
+
+    // every rank holds block_size slots, the last ones may be partly (or fully) padding
+    std::size_t m_block_size;
+    std::size_t m_first_particle;
+    std::size_t m_num_local_particles;
+
+    // the own slice in [0, block_size), the visiting block in [block_size, 2 block_size).
+    // the kernel also scatters into the visiting half of the forces, which is discarded
+    ParticleArrays m_particles;
+    VectorArrays m_velocities;
+    VectorArrays m_old_forces;
+    VectorArrays m_new_forces;
+    bool m_forces_computed;
+
+    SimdLevel m_simd_level;
+    ForceKernel m_force_kernel;
+
+    // x, y, z and mass lanes of a block as one message, one is sent while the other receives
+    std::vector<float> m_blocks[2];
+    std::vector<float> m_gather_send;
+    std::vector<float> m_gather_receive;
+
+    std::size_t get_num_particles_of(std::size_t rank) const;
+    void pack_block(std::vector<float>& block) const;
+    void unpack_block(const std::vector<float>& block);
+
+    void compute_forces();
+    void update_positions();
+    void update_velocities();
+
+public:
+    // the initial state is broadcast by rank 0, the other ranks may pass empty vectors
+    DistributedRank(IRingCommunicator& communicator,
+        const DistributedSetup& setup,
+        const std::vector<sf::Vector3f>& positions,
+        const std::vector<sf::Vector3f>& velocities,
+        const std::vector<float>& masses);
+
+    DistributedRank(const DistributedRank&) = delete;
+    DistributedRank& operator=(const DistributedRank&) = delete;
+
+    void step();
+
+    // collective, fills the vertices on rank 0 in particle order
+    void gather_positions(std::vector<sf::Vertex>& vertices);
+
+    // rank 0 drives the other ranks, which serve() until it sends stop()
+    void send_step();
+    void send_stop();
+    void serve();
+};
+
+// the ring-pass strategy. with VV_USE_MPI and more than one MPI process the ranks are
+// processes, otherwise they are threads of this process. either way this object is rank 0.
+// the MPI processes serve one instance at a time, destroy it before initializing the next
+class DistributedVelocityVerlet : public IAlgorithmStrategy
+{
+private:
+    DistributedSetup m_setup;
+
+    std::vector<sf::Vector3f> m_positions;
+    std::vector<sf::Vector3f> m_velocities;
+    std::vector<float> m_masses;
+
+    std::unique_ptr<LocalRingHub> m_hub;
+    std::vector<std::unique_ptr<IRingCommunicator>> m_communicators;
+    std::vector<std::thread> m_threads;
+
+    std::unique_ptr<DistributedRank> m_rank;
+
+    void stop_ranks();
+
+public:
+    DistributedVelocityVerlet(std::size_t num_particles,
+        float time_step,
+        std::vector<sf::Vector3f> positions,
+        std::vector<sf::Vector3f> velocities,
+        std::vector<float> masses,
+        std::size_t num_ranks,
+        ForceLawParameters force_law = ForceLawParameters())
+        : m_setup{ num_particles, std::max<std::size_t>(num_ranks, 1u), time_step, force_law },
+        m_positions(std::move(positions)),
+        m_velocities(std::move(velocities)),
+        m_masses(std::move(masses))
+    {}
+
+    ~DistributedVelocityVerlet()
+    {
+        stop_ranks();
+    }
+
+    void initialize() override;
+
+    void run(std::vector<sf::Vertex>& vertices) override;
+
+    std::size_t get_num_ranks() const
+    {
+        return static_cast<std::size_t>(m_setup.num_ranks);
+    }
+
+#ifdef VV_USE_MPI
+    // MPI_Init and MPI_Finalize for main. every rank but 0 calls serve_workers(), which
+    // takes part in the distributed strategies rank 0 creates until its session ends
+    class MpiSession
+    {
+    private:
+        int m_rank;
+
+    public:
+        MpiSession(int& argc, char**& argv);
+        ~MpiSession();
+
+        int get_rank() const
+        {
+            return m_rank;
+        }
+
+        void serve_workers();
+    };
+#endif
+};
+
+#endif // !DISTRIBUTED_VELOCITY_VERLET_HPP_
@@ -0,0 +1,72 @@
+#include "Ensemble.hpp"
+
+#include "IEnsemble.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <numeric>
+
+EnsembleLayout::EnsembleLayout(const std::vector<EnsembleSystem>& systems, std::size_t alignment)
+    : m_total_size(0u),
+    m_max_count(0u)
+{
+    alignment = std::max<std::size_t>(alignment, 1u);
+
+    for (const EnsembleSystem& system : systems)
+    {
+        const std::size_t count = system.positions.size();
+
+        m_offsets.push_back(m_total_size);
+        m_counts.push_back(count);
+        m_time_steps.push_back(system.time_step);
+
+        m_total_size += ((count + alignment - 1) / alignment) * alignment;
+        m_max_count = std::max(m_max_count, count);
+    }
+}
+
+bool EnsembleLayout::validate(const std::vector<EnsembleSystem>& systems)
+{
+    if (systems.empty())
+    {
+        return false;
+    }
+
+    for (const EnsembleSystem& system : systems)
+    {
+        const std::size_t count = system.positions.size();
+
+        if ((count == 0) || (system.velocities.size() != count) || (system.masses.size() != count)
+            || !(system.time_step > 0.f))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+std::size_t EnsembleLayout::get_num_particles() const
+{
+    return std::accumulate(m_counts.begin(), m_counts.end(), std::size_t(0));
+}
+
+void write_ensemble_csv(std::ostream& output, IEnsemble& ensemble)
+{
+    output << "system,particle,x,y,z,vx,vy,vz" << std::endl;
+    output << std::setprecision(9);
+
+    EnsembleSystem state;
+
+    for (std::size_t system = 0; system < ensemble.get_num_systems(); ++system)
+    {
+        ensemble.read_system(system, state);
+
+        for (std::size_t i = 0; i < state.positions.size(); ++i)
+        {
+            output << system << ',' << i << ','
+                << state.positions[i].x << ',' << state.positions[i].y << ',' << state.positions[i].z << ','
+                << state.velocities[i].x << ',' << state.velocities[i].y << ',' << state.velocities[i].z << std::endl;
+        }
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef ENSEMBLE_HPP_
+#define ENSEMBLE_HPP_
+
+#include <ostream>
+#include <SFML/System/Vector3.hpp>
+#include <vector>
+
+// one independent system of an ensemble, the masses and time step stay fixed
+struct EnsembleSystem
+{
+    std::vector<sf::Vector3f> positions;
+    std::vector<sf::Vector3f> velocities;
+    std::vector<float> masses;
+    float time_step;
+};
+
+// packs the systems of an ensemble back to back into shared buffers. every system starts
+// at a multiple of the alignment, the slots in between belong to no system
+class EnsembleLayout
+{
+private:
+    std::vector<std::size_t> m_offsets;
+    std::vector<std::size_t> m_counts;
+    std::vector<float> m_time_steps;
+    std::size_t m_total_size;
+    std::size_t m_max_count;
+
+public:
+    EnsembleLayout(const std::vector<EnsembleSystem>& systems, std::size_t alignment = 1u);
+
+    // true when every system has matching, non-empty inputs and a positive time step
+    static bool validate(const std::vector<EnsembleSystem>& systems);
+
+    std::size_t get_num_systems() const
+    {
+        return m_counts.size();
+    }
+
+    std::size_t get_offset(std::size_t system) const
+    {
+        return m_offsets[system];
+    }
+
+    std::size_t get_count(std::size_t system) const
+    {
+        return m_counts[system];
+    }
+
+    float get_time_step(std::size_t system) const
+    {
+        return m_time_steps[system];
+    }
+
+    // slots of the shared buffers, including the alignment gaps
+    std::size_t get_total_size() const
+    {
+        return m_total_size;
+    }
+
+    std::size_t get_num_particles() const;
+
+    std::size_t get_max_count() const
+    {
+        return m_max_count;
+    }
+};
+
+class IEnsemble;
+
+// one line per particle: system, particle, position and velocity
+void write_ensemble_csv(std::ostream& output, IEnsemble& ensemble);
+
+#endif // !ENSEMBLE_HPP_
@@ -0,0 +1,423 @@
+#include "EnsembleGPUVelocityVerlet.hpp"
+
+#include "ProgramBinaryCache.hpp"
+
+#include <chrono>
+#include <iostream>
+
+bool EnsembleGPUVelocityVerlet::validate_inputs() const
+{
+    return EnsembleLayout::validate(m_systems);
+}
+
+bool EnsembleGPUVelocityVerlet::setup_platform()
+{
+    try
+    {
+        if (!select_opencl_platform(m_selected_device, m_platform))
+        {
+            return false;
+        }
+
+        m_platform_name = m_platform.getInfo<CL_PLATFORM_NAME>();
+        m_platform_vendor = m_platform.getInfo<CL_PLATFORM_VENDOR>();
+
+        return true;
+    }
+    catch (const cl::Error& e)
+    {
+        std::cout << "Error: " << e.err() << std::endl;
+        std::cout << "Exception: " << e.what() << std::endl;
+
+        return false;
+    }
+}
+
+bool EnsembleGPUVelocityVerlet::setup_context()
+{
+    try
+    {
+        m_context = create_opencl_context(m_platform, m_selected_device);
+
+        return true;
+    }
+    catch (const cl::Error& e)
+    {
+        std::cout << "Error: " << e.err() << std::endl;
+        std::cout << "Exception: " << e.what() << std::endl;
+
+        return false;
+    }
+}
+
+bool EnsembleGPUVelocityVerlet::setup_device()
+{
+    try
+    {
+        std::vector<cl::Device> devices = m_context.getInfo<CL_CONTEXT_DEVICES>();
+
+        if (devices.empty())
+        {
+            return false;
+        }
+
+        m_device = devices.front();
+        m_device_name = get_opencl_device_name(m_device);
+
+        return true;
+    }
+    catch (const cl::Error& e)
+    {
+        std::cout << "Error: " << e.err() << std::endl;
+        std::cout << "Exception: " << e.what() << std::endl;
+
+        return false;
+    }
+}
+
+bool EnsembleGPUVelocityVerlet::setup_program()
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    try
+    {
+        // the ensemble kernel is appended to the shared force laws
+        std::string kernel_code;
+
+        if (!read_kernel_sources(KERNEL_FILE_NAMES, kernel_code))
+        {
+            return false;
+        }
+
+        m_program = build_cached_program(m_context, m_device, kernel_code, m_build_options,
+            PROGRAM_CACHE_DIRECTORY, &m_program_from_cache);
+        m_program_setup_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        return true;
+    }
+    catch (const cl::Error& e)
+    {
+        std::cout << "Error: " << e.err() << std::endl;
+        std::cout << "Exception: " << e.what() << std::endl;
+
+        return false;
+    }
+    catch (const std::exception& e)
+    {
+        std::cout << "Exception: " << e.what() << std::endl;
+
+        return false;
+    }
+}
+
+bool EnsembleGPUVelocityVerlet::setup_command_queue()
+{
+    try
+    {
+        // the frame is one launch followed by one read, the in-order queue needs no events
+        m_command_queue = cl::CommandQueue(m_context, m_device, 0, NULL);
+
+        return true;
+    }
+    catch (const cl::Error& e)
+    {
+        std::cout << "Error: " << e.err() << std::endl;
+        std::cout << "Exception: " << e.what() << std::endl;
+
+        return false;
+    }
+}
+
+bool EnsembleGPUVelocityVerlet::setup_input_data()
+{
+    m_buffer_size_bytes = m_layout.get_total_size() * sizeof(cl_float4);
+
+    m_positions = static_cast<cl_float4*>(allocate_aligned(m_buffer_size_bytes, 16));
+    m_velocities = static_cast<cl_float4*>(allocate_aligned(m_buffer_size_bytes, 16));
+
+    if ((m_positions == nullptr) || (m_velocities == nullptr))
+    {
+        return false;
+    }
+
+    for (std::size_t system = 0; system < m_systems.size(); ++system)
+    {
+        EnsembleSystem& input = m_systems[system];
+        const std::size_t offset = m_layout.get_offset(system);
+
+        for (std::size_t i = 0; i < input.positions.size(); ++i)
+        {
+            // the 4th component contains the mass for this particle
+            m_positions[offset + i].s0 = input.positions[i].x;
+            m_positions[offset + i].s1 = input.positions[i].y;
+            m_positions[offset + i].s2 = input.positions[i].z;
+            m_positions[offset + i].s3 = input.masses[i];
+
+            m_velocities[offset + i].s0 = input.velocities[i].x;
+            m_velocities[offset + i].s1 = input.velocities[i].y;
+            m_velocities[offset + i].s2 = input.velocities[i].z;
+            m_velocities[offset + i].s3 = input.masses[i];
+        }
+
+        // the device holds the state from now on, only the masses and time step are kept
+        input.positions = std::vector<sf::Vector3f>();
+        input.velocities = std::vector<sf::Vector3f>();
+    }
+
+    return true;
+}
+
+bool EnsembleGPUVelocityVerlet::setup_buffers()
+{
+    try
+    {
+        std::vector<cl_uint2> ranges(m_layout.get_num_systems());
+        std::vector<cl_float> time_steps(m_layout.get_num_systems());
+
+        for (std::size_t system = 0; system < ranges.size(); ++system)
+        {
+            ranges[system] = { { static_cast<cl_uint>(m_layout.get_offset(system)), static_cast<cl_uint>(m_layout.get_count(system)) } };
+            time_steps[system] = m_layout.get_time_step(system);
+        }
+
+        m_positions_buffer = cl::Buffer(m_context,
+            CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,
+            m_buffer_size_bytes,
+            m_positions);
+
+        m_velocities_buffer = cl::Buffer(m_context,
+            CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,
+            m_buffer_size_bytes,
+            m_velocities);
+
+        m_forces_buffer = cl::Buffer(m_context,
+            CL_MEM_READ_WRITE,
+            m_buffer_size_bytes,
+            NULL);
+
+        m_ranges_buffer = cl::Buffer(m_context,
+            CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+            ranges.size() * sizeof(cl_uint2),
+            ranges.data());
+
+        m_time_steps_buffer = cl::Buffer(m_context,
+            CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+            time_steps.size() * sizeof(cl_float),
+            time_steps.data());
+
+        return true;
+    }
+    catch (const cl::Error& e)
+    {
+        std::cout << "Error: " << e.err() << std::endl;
+        std::cout << "Exception: " << e.what() << std::endl;
+
+        return false;
+    }
+}
+
+bool EnsembleGPUVelocityVerlet::setup_kernels()
+{
+    try
+    {
+        m_step_kernel = cl::Kernel(m_program, STEP_KERNEL_NAME.data());
+
+        // a work group per system, more items than the largest system would only idle
+        const std::size_t max_count = ((m_layout.get_max_count() + 31) / 32) * 32;
+
+        m_workgroup_size = std::min({ WORKGROUP_SIZE,
+            max_count,
+            m_device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>(),
+            m_step_kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(m_device) });
+
+        m_step_kernel.setArg(0, m_positions_buffer);
+        m_step_kernel.setArg(1, m_velocities_buffer);
+        m_step_kernel.setArg(2, m_forces_buffer);
+        m_step_kernel.setArg(3, m_ranges_buffer);
+        m_step_kernel.setArg(4, m_time_steps_buffer);
+        m_step_kernel.setArg(5, cl::Local(m_workgroup_size * sizeof(cl_float4)));
+        m_step_kernel.setArg(6, static_cast<cl_uint>(m_steps_per_frame));
+
+        return true;
+    }
+    catch (const cl::Error& e)
+    {
+        std::cout << "Error: " << e.err() << std::endl;
+        std::cout << "Exception: " << e.what() << std::endl;
+
+        return false;
+    }
+}
+
+bool EnsembleGPUVelocityVerlet::queue_steps()
+{
+    try
+    {
+        // the very first launch computes the starting forces before its first step
+        m_step_kernel.setArg(7, static_cast<cl_uint>(m_forces_computed ? 1u : 0u));
+
+        m_command_queue->enqueueNDRangeKernel(m_step_kernel,
+            cl::NullRange,
+            cl::NDRange(m_layout.get_num_systems() * m_workgroup_size),
+            cl::NDRange(m_workgroup_size));
+
+        m_forces_computed = true;
+
+        return true;
+    }
+    catch (const cl::Error& e)
+    {
+        std::cout << "Error: " << e.err() << std::endl;
+        std::cout << "Exception: " << e.what() << std::endl;
+
+        return false;
+    }
+}
+
+bool EnsembleGPUVelocityVerlet::read_positions()
+{
+    try
+    {
+        m_command_queue->enqueueReadBuffer(m_positions_buffer,
+            CL_TRUE,
+            0,
+            m_buffer_size_bytes,
+            m_positions);
+
+        return true;
+    }
+    catch (const cl::Error& e)
+    {
+        std::cout << "Error: " << e.err() << std::endl;
+        std::cout << "Exception: " << e.what() << std::endl;
+
+        return false;
+    }
+}
+
+void EnsembleGPUVelocityVerlet::initialize()
+{
+    if (!validate_inputs())
+    {
+        throw std::string("Failure due to invalid inputs");
+    }
+
+    if (setup_platform())
+    {
+        std::cout << std::endl << "Platform setup is OK" << std::endl;
+        std::cout << "Platform name   : " << m_platform_name << std::endl;
+        std::cout << "Platform vendor : " << m_platform_vendor << std::endl;
+    }
+    else
+    {
+        throw std::string("Failed to setup platform");
+    }
+
+    if (!setup_context())
+    {
+        throw std::string("Failed to setup context");
+    }
+
+    if (setup_device())
+    {
+        std::cout << std::endl << "Device setup is OK" << std::endl;
+        std::cout << "Device name : " << m_device_name.value() << std::endl;
+    }
+    else
+    {
+        throw std::string("Failed to setup device");
+    }
+
+    if (setup_program())
+    {
+        std::cout << std::endl << "Program setup is OK" << std::endl;
+        std::cout << "Program source  : " << (m_program_from_cache ? "cached binary (warm start)" : "built from source (cold start)") << std::endl;
+        std::cout << "Setup time (ms) : " << m_program_setup_seconds * 1e3 << std::endl;
+    }
+    else
+    {
+        throw std::string("Failed to setup program");
+    }
+
+    if (!setup_command_queue())
+    {
+        throw std::string("Failed to setup command queue");
+    }
+
+    if (!setup_input_data())
+    {
+        throw std::string("Failed to setup input data");
+    }
+
+    if (!setup_buffers())
+    {
+        throw std::string("Failed to setup buffers");
+    }
+
+    if (!setup_kernels())
+    {
+        throw std::string("Failed to setup kernels");
+    }
+
+    std::cout << std::endl << "Kernel setup is OK" << std::endl;
+    std::cout << "Ensemble        : " << m_layout.get_num_systems() << " systems, "
+        << m_layout.get_num_particles() << " particles" << std::endl;
+    std::cout << "Work-group size : " << m_workgroup_size << " per system" << std::endl;
+}
+
+void EnsembleGPUVelocityVerlet::run(std::vector<sf::Vertex>& vertices)
+{
+    if (!queue_steps())
+    {
+        throw std::string("Failed to queue commands");
+    }
+
+    m_step_count += m_steps_per_frame;
+
+    if (!read_positions())
+    {
+        throw std::string("Failed to read back positions");
+    }
+
+    // the systems are packed without gaps, so the slots are the vertices
+    vertices.resize(m_layout.get_num_particles());
+
+    for (std::size_t i = 0; i < vertices.size(); ++i)
+    {
+        vertices[i] = sf::Vector2f(m_positions[i].s0, m_positions[i].s1);
+    }
+}
+
+void EnsembleGPUVelocityVerlet::read_system(std::size_t system, EnsembleSystem& state)
+{
+    const std::size_t offset = m_layout.get_offset(system);
+    const std::size_t count = m_layout.get_count(system);
+
+    try
+    {
+        m_command_queue->enqueueReadBuffer(m_velocities_buffer,
+            CL_TRUE,
+            offset * sizeof(cl_float4),
+            count * sizeof(cl_float4),
+            m_velocities + offset);
+    }
+    catch (const cl::Error& e)
+    {
+        std::cout << "Error: " << e.err() << std::endl;
+        std::cout << "Exception: " << e.what() << std::endl;
+
+        throw std::string("Failed to read back velocities");
+    }
+
+    state.positions.resize(count);
+    state.velocities.resize(count);
+    state.masses = m_systems[system].masses;
+    state.time_step = m_layout.get_time_step(system);
+
+    // the positions were read back with the last frame
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        state.positions[i] = sf::Vector3f(m_positions[offset + i].s0, m_positions[offset + i].s1, m_positions[offset + i].s2);
+        state.velocities[i] = sf::Vector3f(m_velocities[offset + i].s0, m_velocities[offset + i].s1, m_velocities[offset + i].s2);
+    }
+}
@@ -0,0 +1,149 @@
+#ifndef ENSEMBLE_GPU_VELOCITY_VERLET_HPP_
+#define ENSEMBLE_GPU_VELOCITY_VERLET_HPP_
+
+#define CL_HPP_ENABLE_EXCEPTIONS
+#define CL_HPP_TARGET_OPENCL_VERSION 220
+
+#include "AlignedAllocator.hpp"
+#include "Ensemble.hpp"
+#include "ForceLaws.hpp"
+#include "IAlgorithmStrategy.hpp"
+#include "IEnsemble.hpp"
+#include "OpenCLDevices.hpp"
+
+#include <algorithm>
+#include <CL/opencl.hpp>
+#include <cstdint>
+#include <cstdlib>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// many small independent systems in shared device buffers. one work group integrates one
+// system for all steps of a frame, so the whole ensemble is a single launch per frame and
+// a single read of the packed positions, however many systems there are
+class EnsembleGPUVelocityVerlet : public IAlgorithmStrategy, public IEnsemble
+{
+private:
+    const std::vector<std::string> KERNEL_FILE_NAMES = { "velocity_verlet.cl", "ensemble.cl" };
+    const std::string STEP_KERNEL_NAME = "step_ensemble";
+    const std::string BUILD_OPTIONS = "-cl-std=CL2.2";
+    const std::string PROGRAM_CACHE_DIRECTORY = "kernel_cache";
+    const std::size_t WORKGROUP_SIZE = 256u;
+
+    // the first GPU of the first platform when not set
+    std::optional<OpenCLDevice> m_selected_device;
+
+    cl::Platform m_platform;
+    std::string m_platform_name;
+    std::string m_platform_vendor;
+    cl::Context m_context;
+    cl::Device m_device;
+    std::optional<std::string> m_device_name;
+
+    cl::Program m_program;
+    ForceLawParameters m_force_law;
+    std::string m_build_options;
+    bool m_program_from_cache;
+    double m_program_setup_seconds;
+
+    std::optional<cl::CommandQueue> m_command_queue;
+
+    // the systems are packed without gaps, system s owns m_layout.get_offset(s) onwards
+    std::vector<EnsembleSystem> m_systems;
+    EnsembleLayout m_layout;
+
+    cl::Buffer m_positions_buffer;
+    cl::Buffer m_velocities_buffer;
+    cl::Buffer m_forces_buffer;
+    cl::Buffer m_ranges_buffer;
+    cl::Buffer m_time_steps_buffer;
+    std::size_t m_buffer_size_bytes;
+
+    // the forces buffer holds the forces at the current positions
+    bool m_forces_computed;
+
+    cl::Kernel m_step_kernel;
+
+    cl_float4* m_positions;
+    cl_float4* m_velocities;
+
+    std::size_t m_steps_per_frame;
+    std::uint64_t m_step_count;
+
+    std::size_t m_workgroup_size;
+
+    bool validate_inputs() const;
+    bool setup_platform();
+    bool setup_context();
+    bool setup_device();
+    bool setup_program();
+    bool setup_command_queue();
+    bool setup_input_data();
+    bool setup_buffers();
+    bool setup_kernels();
+    bool queue_steps();
+    bool read_positions();
+
+public:
+    EnsembleGPUVelocityVerlet(std::vector<EnsembleSystem> systems,
+        std::size_t steps_per_frame = 1u,
+        std::optional<OpenCLDevice> device = std::nullopt,
+        ForceLawParameters force_law = ForceLawParameters())
+        : m_selected_device(device),
+        m_force_law(force_law),
+        m_build_options(BUILD_OPTIONS + get_force_law_build_options(force_law)),
+        m_program_from_cache(false),
+        m_program_setup_seconds(0.0),
+        m_systems(std::move(systems)),
+        m_layout(m_systems),
+        m_buffer_size_bytes(0u),
+        m_forces_computed(false),
+        m_positions(nullptr),
+        m_velocities(nullptr),
+        m_steps_per_frame(std::max<std::size_t>(steps_per_frame, 1u)),
+        m_step_count(0u),
+        m_workgroup_size(WORKGROUP_SIZE)
+    {}
+
+    ~EnsembleGPUVelocityVerlet()
+    {
+        if (m_command_queue.has_value())
+        {
+            try
+            {
+                m_command_queue->finish();
+            }
+            catch (const cl::Error&)
+            {
+            }
+        }
+
+        if (m_positions != nullptr)
+        {
+            free_aligned(m_positions);
+            m_positions = nullptr;
+        }
+
+        if (m_velocities != nullptr)
+        {
+            free_aligned(m_velocities);
+            m_velocities = nullptr;
+        }
+    }
+
+    void initialize() override;
+
+    void run(std::vector<sf::Vertex>& vertices) override;
+
+    std::size_t get_num_systems() const override
+    {
+        return m_layout.get_num_systems();
+    }
+
+    // reads the velocities of just this system back from the device
+    void read_system(std::size_t system, EnsembleSystem& state) override;
+};
+
+#endif // !ENSEMBLE_GPU_VELOCITY_VERLET_HPP_
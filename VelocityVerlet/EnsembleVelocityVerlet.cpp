@@ -0,0 +1,173 @@
+#include "EnsembleVelocityVerlet.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <utility>
+
+void EnsembleVelocityVerlet::step_system(std::size_t system, std::vector<sf::Vertex>& vertices)
+{
+    const std::size_t offset = m_layout.get_offset(system);
+    const std::size_t count = m_layout.get_count(system);
+    const float time_step = m_layout.get_time_step(system);
+
+    float* x = m_particles.x.data() + offset;
+    float* y = m_particles.y.data() + offset;
+    float* z = m_particles.z.data() + offset;
+    const float* mass = m_particles.mass.data() + offset;
+
+    float* velocity_x = m_velocities.x.data() + offset;
+    float* velocity_y = m_velocities.y.data() + offset;
+    float* velocity_z = m_velocities.z.data() + offset;
+
+    // the forces at the current positions, the other set receives the forces at the new ones
+    VectorArrays& current_forces = m_forces_computed ? m_new_forces : m_old_forces;
+    VectorArrays& next_forces = m_forces_computed ? m_old_forces : m_new_forces;
+
+    auto compute_forces = [&](VectorArrays& forces)
+    {
+        std::fill_n(forces.x.data() + offset, count, 0.f);
+        std::fill_n(forces.y.data() + offset, count, 0.f);
+        std::fill_n(forces.z.data() + offset, count, 0.f);
+
+        const ForceKernelArgs args =
+        {
+            x,
+            y,
+            z,
+            mass,
+            forces.x.data() + offset,
+            forces.y.data() + offset,
+            forces.z.data() + offset,
+            m_force_law
+        };
+
+        m_force_kernel(args, 0, count, 0, count);
+    };
+
+    if (!m_forces_computed)
+    {
+        compute_forces(current_forces);
+    }
+
+    // half kick and drift
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        float acceleration = time_step * 0.5f / mass[i];
+
+        x[i] += time_step * (velocity_x[i] + acceleration * current_forces.x[offset + i]);
+        y[i] += time_step * (velocity_y[i] + acceleration * current_forces.y[offset + i]);
+        z[i] += time_step * (velocity_z[i] + acceleration * current_forces.z[offset + i]);
+    }
+
+    compute_forces(next_forces);
+
+    // closing half kick with the new forces
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        float acceleration = time_step * 0.5f / mass[i];
+
+        velocity_x[i] += acceleration * (current_forces.x[offset + i] + next_forces.x[offset + i]);
+        velocity_y[i] += acceleration * (current_forces.y[offset + i] + next_forces.y[offset + i]);
+        velocity_z[i] += acceleration * (current_forces.z[offset + i] + next_forces.z[offset + i]);
+    }
+
+    sf::Vertex* system_vertices = vertices.data() + m_vertex_offsets[system];
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        system_vertices[i] = sf::Vertex(sf::Vector2f(x[i], y[i]));
+    }
+}
+
+void EnsembleVelocityVerlet::initialize()
+{
+    if (!EnsembleLayout::validate(m_systems))
+    {
+        throw std::string("Failure due to invalid inputs");
+    }
+
+    const std::size_t total_size = m_layout.get_total_size();
+
+    m_particles.resize(total_size);
+    m_velocities.resize(total_size);
+    m_old_forces.resize(total_size);
+    m_new_forces.resize(total_size);
+
+    m_vertex_offsets.clear();
+
+    std::size_t num_vertices = 0;
+
+    for (std::size_t system = 0; system < m_systems.size(); ++system)
+    {
+        EnsembleSystem& input = m_systems[system];
+        const std::size_t offset = m_layout.get_offset(system);
+
+        for (std::size_t i = 0; i < input.positions.size(); ++i)
+        {
+            m_particles.x[offset + i] = input.positions[i].x;
+            m_particles.y[offset + i] = input.positions[i].y;
+            m_particles.z[offset + i] = input.positions[i].z;
+            m_particles.mass[offset + i] = input.masses[i];
+
+            m_velocities.x[offset + i] = input.velocities[i].x;
+            m_velocities.y[offset + i] = input.velocities[i].y;
+            m_velocities.z[offset + i] = input.velocities[i].z;
+        }
+
+        // the lanes hold the state from now on, only the masses and time step are kept
+        input.positions = std::vector<sf::Vector3f>();
+        input.velocities = std::vector<sf::Vector3f>();
+
+        m_vertex_offsets.push_back(num_vertices);
+        num_vertices += m_layout.get_count(system);
+    }
+
+    m_forces_computed = false;
+
+    std::cout << std::endl << "CPU threads      : " << m_thread_pool.get_num_threads() << std::endl;
+    std::cout << "CPU force kernel : " << get_simd_level_name(m_simd_level)
+        << ", " << get_force_law_name(m_force_law.law) << std::endl;
+    std::cout << "Ensemble         : " << m_layout.get_num_systems() << " systems, "
+        << m_layout.get_num_particles() << " particles" << std::endl;
+}
+
+void EnsembleVelocityVerlet::run(std::vector<sf::Vertex>& vertices)
+{
+    vertices.resize(m_layout.get_num_particles());
+
+    // systems differ in size, so every task takes a single one
+    m_thread_pool.parallel_for(0, m_layout.get_num_systems(), 1,
+        [this, &vertices](std::size_t begin, std::size_t end, std::size_t)
+        {
+            for (std::size_t system = begin; system < end; ++system)
+            {
+                step_system(system, vertices);
+            }
+        });
+
+    // the forces at the end of a step are the forces at the start of the next one
+    if (m_forces_computed)
+    {
+        std::swap(m_old_forces, m_new_forces);
+    }
+
+    m_forces_computed = true;
+}
+
+void EnsembleVelocityVerlet::read_system(std::size_t system, EnsembleSystem& state)
+{
+    const std::size_t offset = m_layout.get_offset(system);
+    const std::size_t count = m_layout.get_count(system);
+
+    state.positions.resize(count);
+    state.velocities.resize(count);
+    state.masses = m_systems[system].masses;
+    state.time_step = m_layout.get_time_step(system);
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        state.positions[i] = m_particles.get(offset + i);
+        state.velocities[i] = m_velocities.get(offset + i);
+    }
+}
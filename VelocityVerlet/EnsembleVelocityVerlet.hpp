@@ -0,0 +1,73 @@
+#ifndef ENSEMBLE_VELOCITY_VERLET_HPP_
+#define ENSEMBLE_VELOCITY_VERLET_HPP_
+
+#include "Ensemble.hpp"
+#include "ForceKernels.hpp"
+#include "IAlgorithmStrategy.hpp"
+#include "IEnsemble.hpp"
+#include "ParticleArrays.hpp"
+#include "ThreadPool.hpp"
+
+#include <thread>
+#include <utility>
+#include <vector>
+
+// many small independent systems in shared lanes, one system per task. a whole step of
+// every system is a single thread pool dispatch, the systems never wait for each other
+// inside it. the vertices hold the systems one after another
+class EnsembleVelocityVerlet : public IAlgorithmStrategy, public IEnsemble
+{
+private:
+    void step_system(std::size_t system, std::vector<sf::Vertex>& vertices);
+
+    // systems start at multiples of PARTICLE_LANE_WIDTH, so every system is padded
+    // like a ParticleArrays of its own and the force kernels run on it unchanged
+    std::vector<EnsembleSystem> m_systems;
+    EnsembleLayout m_layout;
+
+    ThreadPool m_thread_pool;
+
+    ParticleArrays m_particles;
+    VectorArrays   m_velocities;
+    VectorArrays   m_old_forces;
+    VectorArrays   m_new_forces;
+
+    // m_new_forces holds the forces at the current positions
+    bool m_forces_computed;
+
+    // index of the first vertex of every system
+    std::vector<std::size_t> m_vertex_offsets;
+
+    ForceLawParameters m_force_law;
+    SimdLevel   m_simd_level;
+    ForceKernel m_force_kernel;
+
+public:
+    EnsembleVelocityVerlet(std::vector<EnsembleSystem> systems,
+        ForceLawParameters force_law = ForceLawParameters(),
+        std::size_t num_threads = std::thread::hardware_concurrency())
+        : m_systems(std::move(systems)),
+        m_layout(m_systems, PARTICLE_LANE_WIDTH),
+        m_thread_pool(num_threads),
+        m_forces_computed(false),
+        m_force_law(force_law),
+        m_simd_level(detect_simd_level()),
+        m_force_kernel(select_force_kernel(m_simd_level, force_law.law))
+    {}
+
+    ~EnsembleVelocityVerlet()
+    {}
+
+    void initialize() override;
+
+    void run(std::vector<sf::Vertex>& vertices) override;
+
+    std::size_t get_num_systems() const override
+    {
+        return m_layout.get_num_systems();
+    }
+
+    void read_system(std::size_t system, EnsembleSystem& state) override;
+};
+
+#endif // !ENSEMBLE_VELOCITY_VERLET_HPP_
@@ -0,0 +1,144 @@
+#include "FastFourierTransform.hpp"
+
+#include <cmath>
+#include <string>
+
+FastFourierTransform3D::FastFourierTransform3D(std::size_t size)
+    : m_size(size),
+    m_log_size(0u)
+{
+    if ((size < 2) || ((size & (size - 1)) != 0))
+    {
+        throw std::string("FFT size must be a power of two: ") + std::to_string(size);
+    }
+
+    while ((std::size_t(1) << m_log_size) < size)
+    {
+        ++m_log_size;
+    }
+
+    m_bit_reversal.resize(size);
+
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        std::size_t reversed = 0;
+
+        for (std::size_t bit = 0; bit < m_log_size; ++bit)
+        {
+            reversed |= ((i >> bit) & 1u) << (m_log_size - 1 - bit);
+        }
+
+        m_bit_reversal[i] = reversed;
+    }
+
+    const double pi = std::acos(-1.0);
+
+    m_twiddles.resize(size / 2);
+
+    for (std::size_t i = 0; i < size / 2; ++i)
+    {
+        m_twiddles[i] = std::polar(1.0, -2.0 * pi * static_cast<double>(i) / static_cast<double>(size));
+    }
+}
+
+std::size_t FastFourierTransform3D::get_size() const
+{
+    return m_size;
+}
+
+void FastFourierTransform3D::transform_line(std::complex<double>* line, bool inverse) const
+{
+    for (std::size_t i = 0; i < m_size; ++i)
+    {
+        if (i < m_bit_reversal[i])
+        {
+            std::swap(line[i], line[m_bit_reversal[i]]);
+        }
+    }
+
+    for (std::size_t length = 2; length <= m_size; length <<= 1)
+    {
+        const std::size_t half = length / 2;
+        const std::size_t twiddle_stride = m_size / length;
+
+        for (std::size_t start = 0; start < m_size; start += length)
+        {
+            for (std::size_t k = 0; k < half; ++k)
+            {
+                const std::complex<double> twiddle = inverse ? std::conj(m_twiddles[k * twiddle_stride]) : m_twiddles[k * twiddle_stride];
+                const std::complex<double> odd = twiddle * line[start + k + half];
+
+                line[start + k + half] = line[start + k] - odd;
+                line[start + k] += odd;
+            }
+        }
+    }
+}
+
+void FastFourierTransform3D::transform_axis(std::vector<std::complex<double>>& grid,
+    std::size_t stride,
+    bool inverse,
+    ThreadPool& thread_pool) const
+{
+    const std::size_t num_lines = m_size * m_size;
+
+    thread_pool.parallel_for(0, num_lines, 64u,
+        [this, &grid, stride, inverse](std::size_t begin, std::size_t end, std::size_t)
+        {
+            std::vector<std::complex<double>> line(m_size);
+
+            for (std::size_t line_index = begin; line_index < end; ++line_index)
+            {
+                // first element of the line: the two coordinates other than the transformed one
+                const std::size_t low = line_index % stride;
+                const std::size_t high = line_index / stride;
+                const std::size_t first = high * stride * m_size + low;
+
+                if (stride == 1)
+                {
+                    transform_line(&grid[first], inverse);
+                    continue;
+                }
+
+                for (std::size_t i = 0; i < m_size; ++i)
+                {
+                    line[i] = grid[first + i * stride];
+                }
+
+                transform_line(line.data(), inverse);
+
+                for (std::size_t i = 0; i < m_size; ++i)
+                {
+                    grid[first + i * stride] = line[i];
+                }
+            }
+        });
+}
+
+void FastFourierTransform3D::transform(std::vector<std::complex<double>>& grid, bool inverse, ThreadPool& thread_pool) const
+{
+    transform_axis(grid, 1, inverse, thread_pool);
+    transform_axis(grid, m_size, inverse, thread_pool);
+    transform_axis(grid, m_size * m_size, inverse, thread_pool);
+}
+
+void FastFourierTransform3D::forward(std::vector<std::complex<double>>& grid, ThreadPool& thread_pool) const
+{
+    transform(grid, false, thread_pool);
+}
+
+void FastFourierTransform3D::inverse(std::vector<std::complex<double>>& grid, ThreadPool& thread_pool) const
+{
+    transform(grid, true, thread_pool);
+
+    const double scale = 1.0 / static_cast<double>(m_size * m_size * m_size);
+
+    thread_pool.parallel_for(0, grid.size(), 1u << 16,
+        [&grid, scale](std::size_t begin, std::size_t end, std::size_t)
+        {
+            for (std::size_t i = begin; i < end; ++i)
+            {
+                grid[i] *= scale;
+            }
+        });
+}
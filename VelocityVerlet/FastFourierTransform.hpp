@@ -0,0 +1,34 @@
+#ifndef FAST_FOURIER_TRANSFORM_HPP_
+#define FAST_FOURIER_TRANSFORM_HPP_
+
+#include "ThreadPool.hpp"
+
+#include <complex>
+#include <vector>
+
+// in-place radix-2 complex FFT of a cubic grid with power of two edge length,
+// stored x fastest: index = (z * n + y) * n + x
+class FastFourierTransform3D
+{
+private:
+    std::size_t m_size;
+    std::size_t m_log_size;
+    std::vector<std::size_t> m_bit_reversal;
+    std::vector<std::complex<double>> m_twiddles;
+
+    void transform_line(std::complex<double>* line, bool inverse) const;
+    void transform_axis(std::vector<std::complex<double>>& grid, std::size_t stride, bool inverse, ThreadPool& thread_pool) const;
+    void transform(std::vector<std::complex<double>>& grid, bool inverse, ThreadPool& thread_pool) const;
+
+public:
+    explicit FastFourierTransform3D(std::size_t size);
+
+    std::size_t get_size() const;
+
+    void forward(std::vector<std::complex<double>>& grid, ThreadPool& thread_pool) const;
+
+    // includes the 1 / n^3 normalization
+    void inverse(std::vector<std::complex<double>>& grid, ThreadPool& thread_pool) const;
+};
+
+#endif // !FAST_FOURIER_TRANSFORM_HPP_
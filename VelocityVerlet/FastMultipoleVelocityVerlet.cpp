@@ -0,0 +1,747 @@
+#include "FastMultipoleVelocityVerlet.hpp"
+#include "ForceKernels.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+
+static float square(float val)
+{
+    return val * val;
+}
+
+static std::size_t cube(std::size_t val)
+{
+    return val * val * val;
+}
+
+void FastMultipoleVelocityVerlet::setup_expansions()
+{
+    // a far field needs at least the monopole gradient
+    m_expansion_order = std::max<std::size_t>(m_expansion_order, 1u);
+
+    const std::size_t p = m_expansion_order;
+    const std::size_t dim = p + 1;
+
+    m_multi_indices.clear();
+    m_multi_index_lookup.assign(cube(dim), -1);
+    m_inverse_factorials.clear();
+
+    std::vector<double> factorials(dim, 1.0);
+
+    for (std::size_t i = 1; i < dim; ++i)
+    {
+        factorials[i] = factorials[i - 1] * static_cast<double>(i);
+    }
+
+    // multi-indices ordered by total order
+    for (std::size_t order = 0; order <= p; ++order)
+    {
+        for (std::size_t a = order + 1; a-- > 0;)
+        {
+            for (std::size_t b = order - a + 1; b-- > 0;)
+            {
+                const std::size_t c = order - a - b;
+
+                m_multi_index_lookup[(a * dim + b) * dim + c] = static_cast<std::int32_t>(m_multi_indices.size());
+                m_multi_indices.push_back({ static_cast<std::uint32_t>(a), static_cast<std::uint32_t>(b), static_cast<std::uint32_t>(c) });
+                m_inverse_factorials.push_back(1.0 / (factorials[a] * factorials[b] * factorials[c]));
+            }
+        }
+    }
+
+    m_num_coefficients = m_multi_indices.size();
+
+    auto lookup = [&](std::size_t a, std::size_t b, std::size_t c)
+    {
+        return static_cast<std::uint32_t>(m_multi_index_lookup[(a * dim + b) * dim + c]);
+    };
+
+    m_shift_terms.clear();
+    m_m2l_terms.clear();
+
+    for (auto& terms : m_gradient_terms)
+    {
+        terms.clear();
+    }
+
+    for (std::uint32_t target = 0; target < m_num_coefficients; ++target)
+    {
+        const auto& k = m_multi_indices[target];
+        const std::size_t k_order = k[0] + k[1] + k[2];
+
+        // shifts: every l <= k component-wise
+        for (std::uint32_t a = 0; a <= k[0]; ++a)
+        {
+            for (std::uint32_t b = 0; b <= k[1]; ++b)
+            {
+                for (std::uint32_t c = 0; c <= k[2]; ++c)
+                {
+                    m_shift_terms.push_back({ target, lookup(a, b, c), lookup(k[0] - a, k[1] - b, k[2] - c), 1.0 });
+                }
+            }
+        }
+
+        // conversion: L_n += (-1)^|m| M_m D_(n + m) for |n| + |m| <= p
+        for (std::uint32_t source = 0; source < m_num_coefficients; ++source)
+        {
+            const auto& m = m_multi_indices[source];
+            const std::size_t m_order = m[0] + m[1] + m[2];
+
+            if (k_order + m_order <= p)
+            {
+                m_m2l_terms.push_back({ target, source, lookup(k[0] + m[0], k[1] + m[1], k[2] + m[2]), (m_order % 2 == 0) ? 1.0 : -1.0 });
+            }
+        }
+
+        // gradient of the local expansion: d/dx_axis sum_n L_n e^n / n! = sum_m L_(m + e_axis) e^m / m!
+        if (k_order < p)
+        {
+            m_gradient_terms[0].push_back({ target, lookup(k[0] + 1, k[1], k[2]), 0u, 1.0 });
+            m_gradient_terms[1].push_back({ target, lookup(k[0], k[1] + 1, k[2]), 0u, 1.0 });
+            m_gradient_terms[2].push_back({ target, lookup(k[0], k[1], k[2] + 1), 0u, 1.0 });
+        }
+    }
+}
+
+void FastMultipoleVelocityVerlet::compute_powers(double x, double y, double z, double* powers) const
+{
+    // e^k / k! for every multi-index k
+    for (std::size_t i = 0; i < m_num_coefficients; ++i)
+    {
+        const auto& k = m_multi_indices[i];
+
+        double value = m_inverse_factorials[i];
+
+        for (std::uint32_t a = 0; a < k[0]; ++a)
+        {
+            value *= x;
+        }
+
+        for (std::uint32_t b = 0; b < k[1]; ++b)
+        {
+            value *= y;
+        }
+
+        for (std::uint32_t c = 0; c < k[2]; ++c)
+        {
+            value *= z;
+        }
+
+        powers[i] = value;
+    }
+}
+
+void FastMultipoleVelocityVerlet::compute_derivatives(double x, double y, double z, double* derivatives, std::vector<double>& scratch) const
+{
+    // McMurchie-Davidson recurrence for the derivatives of 1/r:
+    // R(n)_000 = (-1)^n (2n - 1)!! / r^(2n + 1)
+    // R(n)_(t+1)uv = t R(n+1)_(t-1)uv + x R(n+1)_tuv (same for y and z)
+    // and d^(t+u+v) / dx^t dy^u dz^v (1/r) = R(0)_tuv
+    const std::size_t p = m_expansion_order;
+    const std::size_t dim = p + 1;
+
+    scratch.resize(dim * m_num_coefficients);
+
+    auto R = [&](std::size_t n, std::size_t index) -> double& { return scratch[n * m_num_coefficients + index]; };
+
+    auto lookup = [&](std::size_t a, std::size_t b, std::size_t c)
+    {
+        return static_cast<std::size_t>(m_multi_index_lookup[(a * dim + b) * dim + c]);
+    };
+
+    const double inv_sqr_distance = 1.0 / (x * x + y * y + z * z);
+
+    R(0, 0) = std::sqrt(inv_sqr_distance);
+
+    for (std::size_t n = 1; n <= p; ++n)
+    {
+        R(n, 0) = -static_cast<double>(2 * n - 1) * inv_sqr_distance * R(n - 1, 0);
+    }
+
+    for (std::size_t index = 1; index < m_num_coefficients; ++index)
+    {
+        const auto& k = m_multi_indices[index];
+        const std::size_t order = k[0] + k[1] + k[2];
+
+        for (std::size_t n = 0; n + order <= p; ++n)
+        {
+            double value;
+
+            if (k[0] > 0)
+            {
+                value = x * R(n + 1, lookup(k[0] - 1, k[1], k[2]));
+
+                if (k[0] > 1)
+                {
+                    value += static_cast<double>(k[0] - 1) * R(n + 1, lookup(k[0] - 2, k[1], k[2]));
+                }
+            }
+            else if (k[1] > 0)
+            {
+                value = y * R(n + 1, lookup(k[0], k[1] - 1, k[2]));
+
+                if (k[1] > 1)
+                {
+                    value += static_cast<double>(k[1] - 1) * R(n + 1, lookup(k[0], k[1] - 2, k[2]));
+                }
+            }
+            else
+            {
+                value = z * R(n + 1, lookup(k[0], k[1], k[2] - 1));
+
+                if (k[2] > 1)
+                {
+                    value += static_cast<double>(k[2] - 1) * R(n + 1, lookup(k[0], k[1], k[2] - 2));
+                }
+            }
+
+            R(n, index) = value;
+        }
+    }
+
+    for (std::size_t index = 0; index < m_num_coefficients; ++index)
+    {
+        derivatives[index] = R(0, index);
+    }
+}
+
+std::size_t FastMultipoleVelocityVerlet::cell_index(std::size_t level, std::int64_t x, std::int64_t y, std::int64_t z) const
+{
+    const std::int64_t dim = std::int64_t(1) << level;
+
+    return static_cast<std::size_t>((z * dim + y) * dim + x);
+}
+
+void FastMultipoleVelocityVerlet::build_tree()
+{
+    // bounding cube of all particles
+    sf::Vector3f min_corner(m_particles.x[0], m_particles.y[0], m_particles.z[0]);
+    sf::Vector3f max_corner = min_corner;
+
+    for (std::size_t i = 1; i < m_num_particles; ++i)
+    {
+        min_corner.x = std::min(min_corner.x, m_particles.x[i]);
+        min_corner.y = std::min(min_corner.y, m_particles.y[i]);
+        min_corner.z = std::min(min_corner.z, m_particles.z[i]);
+        max_corner.x = std::max(max_corner.x, m_particles.x[i]);
+        max_corner.y = std::max(max_corner.y, m_particles.y[i]);
+        max_corner.z = std::max(max_corner.z, m_particles.z[i]);
+    }
+
+    m_min_corner = min_corner;
+    m_size = std::max({ max_corner.x - min_corner.x, max_corner.y - min_corner.y, max_corner.z - min_corner.z, 1e-6f }) * 1.0001f;
+
+    // deepest level with about LEAF_TARGET particles per leaf that fits the memory budget
+    std::size_t depth = MIN_DEPTH;
+
+    while ((depth < MAX_DEPTH) && (cube(std::size_t(1) << depth) * LEAF_TARGET < m_num_particles))
+    {
+        ++depth;
+    }
+
+    auto expansion_bytes = [&](std::size_t levels)
+    {
+        std::size_t cells = 0;
+
+        for (std::size_t level = 0; level <= levels; ++level)
+        {
+            cells += cube(std::size_t(1) << level);
+        }
+
+        return 2u * cells * m_num_coefficients * sizeof(double);
+    };
+
+    while ((depth > MIN_DEPTH) && (expansion_bytes(depth) > MAX_EXPANSION_BYTES))
+    {
+        --depth;
+    }
+
+    m_depth = depth;
+
+    m_multipoles.resize(m_depth + 1);
+    m_locals.resize(m_depth + 1);
+
+    for (std::size_t level = 0; level <= m_depth; ++level)
+    {
+        m_multipoles[level].assign(cube(std::size_t(1) << level) * m_num_coefficients, 0.0);
+        m_locals[level].assign(cube(std::size_t(1) << level) * m_num_coefficients, 0.0);
+    }
+
+    // counting sort of the particles into the leaves
+    const std::size_t dim = std::size_t(1) << m_depth;
+    const float scale = static_cast<float>(dim) / m_size;
+
+    m_leaf_offsets.assign(cube(dim) + 1, 0u);
+    m_leaf_of_particle.resize(m_num_particles);
+    m_leaf_order.resize(m_num_particles);
+
+    for (std::size_t i = 0; i < m_num_particles; ++i)
+    {
+        const std::int64_t x = std::min<std::int64_t>(static_cast<std::int64_t>((m_particles.x[i] - m_min_corner.x) * scale), dim - 1);
+        const std::int64_t y = std::min<std::int64_t>(static_cast<std::int64_t>((m_particles.y[i] - m_min_corner.y) * scale), dim - 1);
+        const std::int64_t z = std::min<std::int64_t>(static_cast<std::int64_t>((m_particles.z[i] - m_min_corner.z) * scale), dim - 1);
+
+        const std::uint32_t leaf = static_cast<std::uint32_t>(cell_index(m_depth, x, y, z));
+
+        m_leaf_of_particle[i] = leaf;
+        ++m_leaf_offsets[leaf + 1];
+    }
+
+    for (std::size_t leaf = 1; leaf < m_leaf_offsets.size(); ++leaf)
+    {
+        m_leaf_offsets[leaf] += m_leaf_offsets[leaf - 1];
+    }
+
+    std::vector<std::uint32_t> cursor(m_leaf_offsets.begin(), m_leaf_offsets.end() - 1);
+
+    for (std::size_t i = 0; i < m_num_particles; ++i)
+    {
+        m_leaf_order[cursor[m_leaf_of_particle[i]]++] = static_cast<std::uint32_t>(i);
+    }
+}
+
+void FastMultipoleVelocityVerlet::compute_multipoles()
+{
+    const std::size_t leaf_dim = std::size_t(1) << m_depth;
+    const double leaf_size = static_cast<double>(m_size) / static_cast<double>(leaf_dim);
+
+    // P2M: M_k = sum_j m_j d_j^k / k! about the leaf center
+    m_thread_pool.parallel_for(0, cube(leaf_dim), GRAIN_SIZE,
+        [this, leaf_dim, leaf_size](std::size_t begin, std::size_t end, std::size_t)
+        {
+            std::vector<double> powers(m_num_coefficients);
+
+            for (std::size_t leaf = begin; leaf < end; ++leaf)
+            {
+                double* multipole = &m_multipoles[m_depth][leaf * m_num_coefficients];
+
+                const double center_x = m_min_corner.x + (static_cast<double>(leaf % leaf_dim) + 0.5) * leaf_size;
+                const double center_y = m_min_corner.y + (static_cast<double>((leaf / leaf_dim) % leaf_dim) + 0.5) * leaf_size;
+                const double center_z = m_min_corner.z + (static_cast<double>(leaf / (leaf_dim * leaf_dim)) + 0.5) * leaf_size;
+
+                for (std::uint32_t k = m_leaf_offsets[leaf]; k < m_leaf_offsets[leaf + 1]; ++k)
+                {
+                    const std::uint32_t i = m_leaf_order[k];
+
+                    compute_powers(m_particles.x[i] - center_x, m_particles.y[i] - center_y, m_particles.z[i] - center_z, powers.data());
+
+                    for (std::size_t c = 0; c < m_num_coefficients; ++c)
+                    {
+                        multipole[c] += m_particles.mass[i] * powers[c];
+                    }
+                }
+            }
+        });
+
+    // M2M: M_k(parent) += sum_(l <= k) M_l(child) s^(k - l) / (k - l)!, s = child center - parent center
+    for (std::size_t level = m_depth; level-- > MIN_DEPTH;)
+    {
+        const std::size_t dim = std::size_t(1) << level;
+        const double child_half_size = static_cast<double>(m_size) / static_cast<double>(dim) * 0.25;
+
+        m_thread_pool.parallel_for(0, cube(dim), GRAIN_SIZE,
+            [this, level, dim, child_half_size](std::size_t begin, std::size_t end, std::size_t)
+            {
+                std::vector<double> powers(m_num_coefficients);
+
+                for (std::size_t cell = begin; cell < end; ++cell)
+                {
+                    const std::int64_t x = cell % dim;
+                    const std::int64_t y = (cell / dim) % dim;
+                    const std::int64_t z = cell / (dim * dim);
+
+                    double* multipole = &m_multipoles[level][cell * m_num_coefficients];
+
+                    for (std::size_t octant = 0; octant < 8; ++octant)
+                    {
+                        const std::size_t child = cell_index(level + 1,
+                            2 * x + (octant & 1),
+                            2 * y + ((octant >> 1) & 1),
+                            2 * z + ((octant >> 2) & 1));
+
+                        const double* child_multipole = &m_multipoles[level + 1][child * m_num_coefficients];
+
+                        if (child_multipole[0] == 0.0)
+                        {
+                            continue;
+                        }
+
+                        compute_powers((octant & 1) ? child_half_size : -child_half_size,
+                            ((octant >> 1) & 1) ? child_half_size : -child_half_size,
+                            ((octant >> 2) & 1) ? child_half_size : -child_half_size,
+                            powers.data());
+
+                        for (const ShiftTerm& term : m_shift_terms)
+                        {
+                            multipole[term.target] += child_multipole[term.source] * powers[term.offset];
+                        }
+                    }
+                }
+            });
+    }
+}
+
+void FastMultipoleVelocityVerlet::compute_locals()
+{
+    std::vector<double> scratch;
+
+    for (std::size_t level = MIN_DEPTH; level <= m_depth; ++level)
+    {
+        const std::int64_t dim = std::int64_t(1) << level;
+        const double cell_size = static_cast<double>(m_size) / static_cast<double>(dim);
+
+        // all well separated pairs of one level are 2..3 cells apart on some axis
+        m_m2l_derivatives.assign(cube(7) * m_num_coefficients, 0.0);
+
+        for (std::int64_t offset = 0; offset < 343; ++offset)
+        {
+            const std::int64_t x = offset % 7 - 3;
+            const std::int64_t y = (offset / 7) % 7 - 3;
+            const std::int64_t z = offset / 49 - 3;
+
+            if (std::max({ std::abs(x), std::abs(y), std::abs(z) }) > 1)
+            {
+                compute_derivatives(x * cell_size, y * cell_size, z * cell_size,
+                    &m_m2l_derivatives[offset * m_num_coefficients],
+                    scratch);
+            }
+        }
+
+        m_thread_pool.parallel_for(0, cube(dim), GRAIN_SIZE,
+            [this, level, dim, cell_size](std::size_t begin, std::size_t end, std::size_t)
+            {
+                std::vector<double> powers(m_num_coefficients);
+
+                for (std::size_t cell = begin; cell < end; ++cell)
+                {
+                    // the force is proportional to the target mass, empty cells need no expansion
+                    if (m_multipoles[level][cell * m_num_coefficients] == 0.0)
+                    {
+                        continue;
+                    }
+
+                    const std::int64_t x = cell % dim;
+                    const std::int64_t y = (cell / dim) % dim;
+                    const std::int64_t z = cell / (dim * dim);
+
+                    double* local = &m_locals[level][cell * m_num_coefficients];
+
+                    // L2L: L_l(child) += sum_(k >= l) L_k(parent) s^(k - l) / (k - l)!
+                    if (level > MIN_DEPTH)
+                    {
+                        const double* parent_local = &m_locals[level - 1][cell_index(level - 1, x / 2, y / 2, z / 2) * m_num_coefficients];
+                        const double quarter = cell_size * 0.5;
+
+                        compute_powers((x & 1) ? quarter : -quarter,
+                            (y & 1) ? quarter : -quarter,
+                            (z & 1) ? quarter : -quarter,
+                            powers.data());
+
+                        for (const ShiftTerm& term : m_shift_terms)
+                        {
+                            local[term.source] += parent_local[term.target] * powers[term.offset];
+                        }
+                    }
+
+                    // M2L over the children of the parent's neighbours that are not our neighbours
+                    const std::int64_t first_x = std::max<std::int64_t>(2 * (x / 2 - 1), 0);
+                    const std::int64_t first_y = std::max<std::int64_t>(2 * (y / 2 - 1), 0);
+                    const std::int64_t first_z = std::max<std::int64_t>(2 * (z / 2 - 1), 0);
+                    const std::int64_t last_x = std::min<std::int64_t>(2 * (x / 2 + 1) + 1, dim - 1);
+                    const std::int64_t last_y = std::min<std::int64_t>(2 * (y / 2 + 1) + 1, dim - 1);
+                    const std::int64_t last_z = std::min<std::int64_t>(2 * (z / 2 + 1) + 1, dim - 1);
+
+                    for (std::int64_t source_z = first_z; source_z <= last_z; ++source_z)
+                    {
+                        for (std::int64_t source_y = first_y; source_y <= last_y; ++source_y)
+                        {
+                            for (std::int64_t source_x = first_x; source_x <= last_x; ++source_x)
+                            {
+                                if (std::max({ std::abs(source_x - x), std::abs(source_y - y), std::abs(source_z - z) }) <= 1)
+                                {
+                                    continue;
+                                }
+
+                                const double* multipole = &m_multipoles[level][cell_index(level, source_x, source_y, source_z) * m_num_coefficients];
+
+                                if (multipole[0] == 0.0)
+                                {
+                                    continue;
+                                }
+
+                                const std::size_t offset = static_cast<std::size_t>((x - source_x + 3) + 7 * (y - source_y + 3) + 49 * (z - source_z + 3));
+                                const double* derivatives = &m_m2l_derivatives[offset * m_num_coefficients];
+
+                                for (const ShiftTerm& term : m_m2l_terms)
+                                {
+                                    local[term.target] += term.sign * multipole[term.source] * derivatives[term.offset];
+                                }
+                            }
+                        }
+                    }
+                }
+            });
+    }
+}
+
+void FastMultipoleVelocityVerlet::evaluate_forces()
+{
+    const std::int64_t dim = std::int64_t(1) << m_depth;
+    const double leaf_size = static_cast<double>(m_size) / static_cast<double>(dim);
+
+    m_thread_pool.parallel_for(0, cube(dim), GRAIN_SIZE,
+        [this, dim, leaf_size](std::size_t begin, std::size_t end, std::size_t)
+        {
+            std::vector<double> powers(m_num_coefficients);
+
+            for (std::size_t leaf = begin; leaf < end; ++leaf)
+            {
+                if (m_leaf_offsets[leaf] == m_leaf_offsets[leaf + 1])
+                {
+                    continue;
+                }
+
+                const std::int64_t x = leaf % dim;
+                const std::int64_t y = (leaf / dim) % dim;
+                const std::int64_t z = leaf / (dim * dim);
+
+                const double center_x = m_min_corner.x + (static_cast<double>(x) + 0.5) * leaf_size;
+                const double center_y = m_min_corner.y + (static_cast<double>(y) + 0.5) * leaf_size;
+                const double center_z = m_min_corner.z + (static_cast<double>(z) + 0.5) * leaf_size;
+
+                const double* local = &m_locals[m_depth][leaf * m_num_coefficients];
+
+                for (std::uint32_t k = m_leaf_offsets[leaf]; k < m_leaf_offsets[leaf + 1]; ++k)
+                {
+                    const std::uint32_t me = m_leaf_order[k];
+
+                    // L2P: far field from the gradient of the local expansion
+                    compute_powers(m_particles.x[me] - center_x, m_particles.y[me] - center_y, m_particles.z[me] - center_z, powers.data());
+
+                    double gradient[3] = { 0.0, 0.0, 0.0 };
+
+                    for (std::size_t axis = 0; axis < 3; ++axis)
+                    {
+                        for (const ShiftTerm& term : m_gradient_terms[axis])
+                        {
+                            gradient[axis] += local[term.source] * powers[term.target];
+                        }
+                    }
+
+                    float force_x = static_cast<float>(m_particles.mass[me] * gradient[0]);
+                    float force_y = static_cast<float>(m_particles.mass[me] * gradient[1]);
+                    float force_z = static_cast<float>(m_particles.mass[me] * gradient[2]);
+
+                    // P2P: direct sum over the neighbouring leaves
+                    for (std::int64_t other_z = std::max<std::int64_t>(z - 1, 0); other_z <= std::min<std::int64_t>(z + 1, dim - 1); ++other_z)
+                    {
+                        for (std::int64_t other_y = std::max<std::int64_t>(y - 1, 0); other_y <= std::min<std::int64_t>(y + 1, dim - 1); ++other_y)
+                        {
+                            for (std::int64_t other_x = std::max<std::int64_t>(x - 1, 0); other_x <= std::min<std::int64_t>(x + 1, dim - 1); ++other_x)
+                            {
+                                const std::size_t other_leaf = cell_index(m_depth, other_x, other_y, other_z);
+
+                                for (std::uint32_t j = m_leaf_offsets[other_leaf]; j < m_leaf_offsets[other_leaf + 1]; ++j)
+                                {
+                                    const std::uint32_t other = m_leaf_order[j];
+
+                                    const float diff_x = m_particles.x[other] - m_particles.x[me];
+                                    const float diff_y = m_particles.y[other] - m_particles.y[me];
+                                    const float diff_z = m_particles.z[other] - m_particles.z[me];
+
+                                    const float sqr_distance = square(diff_x) + square(diff_y) + square(diff_z);
+
+                                    if (sqr_distance > 0.f)
+                                    {
+                                        const float gravity = m_particles.mass[me] * m_particles.mass[other] / (std::sqrt(sqr_distance) * sqr_distance);
+
+                                        force_x += gravity * diff_x;
+                                        force_y += gravity * diff_y;
+                                        force_z += gravity * diff_z;
+                                    }
+                                }
+                            }
+                        }
+                    }
+
+                    m_new_forces.x[me] = force_x;
+                    m_new_forces.y[me] = force_y;
+                    m_new_forces.z[me] = force_z;
+                }
+            }
+        });
+}
+
+void FastMultipoleVelocityVerlet::compute_forces()
+{
+    if (m_num_particles == 0)
+    {
+        return;
+    }
+
+    build_tree();
+    compute_multipoles();
+    compute_locals();
+    evaluate_forces();
+}
+
+void FastMultipoleVelocityVerlet::update_positions()
+{
+    m_thread_pool.parallel_for(0, m_num_particles, 4096u,
+        [this](std::size_t begin, std::size_t end, std::size_t)
+        {
+            for (std::size_t i = begin; i < end; ++i)
+            {
+                float acceleration = m_time_step * 0.5f / m_particles.mass[i];
+
+                m_particles.x[i] += m_time_step * (m_velocities.x[i] + acceleration * m_new_forces.x[i]);
+                m_particles.y[i] += m_time_step * (m_velocities.y[i] + acceleration * m_new_forces.y[i]);
+                m_particles.z[i] += m_time_step * (m_velocities.z[i] + acceleration * m_new_forces.z[i]);
+            }
+        });
+
+    std::swap(m_old_forces, m_new_forces);
+}
+
+void FastMultipoleVelocityVerlet::update_velocities()
+{
+    m_thread_pool.parallel_for(0, m_num_particles, 4096u,
+        [this](std::size_t begin, std::size_t end, std::size_t)
+        {
+            for (std::size_t i = begin; i < end; ++i)
+            {
+                float acceleration = m_time_step * 0.5f / m_particles.mass[i];
+
+                m_velocities.x[i] += acceleration * (m_new_forces.x[i] + m_old_forces.x[i]);
+                m_velocities.y[i] += acceleration * (m_new_forces.y[i] + m_old_forces.y[i]);
+                m_velocities.z[i] += acceleration * (m_new_forces.z[i] + m_old_forces.z[i]);
+            }
+        });
+}
+
+void FastMultipoleVelocityVerlet::initialize()
+{
+    std::cout << std::endl << "FMM expansion order : " << m_expansion_order << std::endl;
+    std::cout << "FMM coefficients    : " << m_num_coefficients << std::endl;
+    std::cout << "CPU threads         : " << m_thread_pool.get_num_threads() << std::endl;
+}
+
+void FastMultipoleVelocityVerlet::run(std::vector<sf::Vertex>& vertices)
+{
+    // the forces at the end of a step are the forces at the start of the next one,
+    // so apart from the very first step there is one force evaluation per step
+    if (!m_forces_computed)
+    {
+        compute_forces();
+        m_forces_computed = true;
+    }
+
+    // half kick and drift
+    update_positions();
+    compute_forces();
+    // closing half kick with the new forces
+    update_velocities();
+
+    vertices.resize(m_num_particles);
+
+    for (std::size_t i = 0; i < m_num_particles; ++i)
+    {
+        vertices[i] = sf::Vertex(sf::Vector2f(m_particles.x[i], m_particles.y[i]));
+    }
+}
+
+void FastMultipoleVelocityVerlet::report_accuracy(const std::vector<sf::Vector3f>& positions,
+    const std::vector<float>& masses,
+    std::size_t max_order,
+    std::ostream& output)
+{
+    const std::size_t num_particles = positions.size();
+
+    if (num_particles < 2)
+    {
+        return;
+    }
+
+    // reference: the same pair sum as SingleThreadedVelocityVerlet::compute_forces()
+    ParticleArrays particles(positions, masses);
+    VectorArrays direct_forces(num_particles);
+
+    const ForceKernelArgs args =
+    {
+        particles.x.data(),
+        particles.y.data(),
+        particles.z.data(),
+        particles.mass.data(),
+        direct_forces.x.data(),
+        direct_forces.y.data(),
+        direct_forces.z.data()
+    };
+
+    auto start = std::chrono::steady_clock::now();
+
+    select_force_kernel(detect_simd_level())(args, 0, num_particles, 0, num_particles);
+
+    const double direct_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    output << std::endl << "FMM accuracy versus direct summation, " << num_particles << " particles" << std::endl;
+    output << "direct sum : " << std::fixed << std::setprecision(4) << direct_seconds << " s" << std::endl;
+    output << std::setw(6) << "order"
+        << std::setw(8) << "depth"
+        << std::setw(14) << "rms rel err"
+        << std::setw(14) << "max rel err"
+        << std::setw(14) << "global err"
+        << std::setw(12) << "time (s)" << std::endl;
+
+    const std::vector<sf::Vector3f> velocities(num_particles, sf::Vector3f(0.f, 0.f, 0.f));
+
+    for (std::size_t order = 1; order <= max_order; ++order)
+    {
+        FastMultipoleVelocityVerlet fmm(num_particles, 0.f, positions, velocities, masses, order);
+
+        start = std::chrono::steady_clock::now();
+
+        fmm.compute_forces();
+
+        const double fmm_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        double sum_sqr_relative = 0.0;
+        double max_relative = 0.0;
+        double sum_sqr_error = 0.0;
+        double sum_sqr_force = 0.0;
+
+        for (std::size_t i = 0; i < num_particles; ++i)
+        {
+            const double error_x = static_cast<double>(fmm.m_new_forces.x[i]) - direct_forces.x[i];
+            const double error_y = static_cast<double>(fmm.m_new_forces.y[i]) - direct_forces.y[i];
+            const double error_z = static_cast<double>(fmm.m_new_forces.z[i]) - direct_forces.z[i];
+
+            const double sqr_error = error_x * error_x + error_y * error_y + error_z * error_z;
+            const double sqr_force = static_cast<double>(direct_forces.x[i]) * direct_forces.x[i]
+                + static_cast<double>(direct_forces.y[i]) * direct_forces.y[i]
+                + static_cast<double>(direct_forces.z[i]) * direct_forces.z[i];
+
+            if (sqr_force > 0.0)
+            {
+                const double relative = std::sqrt(sqr_error / sqr_force);
+
+                sum_sqr_relative += relative * relative;
+                max_relative = std::max(max_relative, relative);
+            }
+
+            sum_sqr_error += sqr_error;
+            sum_sqr_force += sqr_force;
+        }
+
+        output << std::setw(6) << order
+            << std::setw(8) << fmm.m_depth
+            << std::setw(14) << std::scientific << std::setprecision(3) << std::sqrt(sum_sqr_relative / num_particles)
+            << std::setw(14) << max_relative
+            << std::setw(14) << std::sqrt(sum_sqr_error / sum_sqr_force)
+            << std::setw(12) << std::fixed << std::setprecision(4) << fmm_seconds << std::endl;
+    }
+
+    output.unsetf(std::ios::floatfield);
+}
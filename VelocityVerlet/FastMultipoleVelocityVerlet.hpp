@@ -0,0 +1,138 @@
+#ifndef FAST_MULTIPOLE_VELOCITY_VERLET_HPP_
+#define FAST_MULTIPOLE_VELOCITY_VERLET_HPP_
+
+#include "IAlgorithmStrategy.hpp"
+#include "ParticleArrays.hpp"
+#include "ThreadPool.hpp"
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include <SFML/System/Vector3.hpp>
+#include <thread>
+#include <vector>
+
+// Fast multipole method on a uniform octree with Cartesian Taylor expansions.
+// Multipoles are formed at the leaves, shifted up the tree, converted to local
+// expansions between well separated cells of the same level, shifted down and
+// evaluated at the particles. Neighbouring leaves interact directly.
+class FastMultipoleVelocityVerlet : public IAlgorithmStrategy
+{
+private:
+    // average number of particles per leaf the tree depth is chosen for
+    const std::size_t LEAF_TARGET = 64u;
+
+    // expansions are stored densely per level, cap the depth by memory
+    const std::size_t MIN_DEPTH = 2u;
+    const std::size_t MAX_DEPTH = 6u;
+    const std::size_t MAX_EXPANSION_BYTES = 512u * 1024u * 1024u;
+
+    const std::size_t GRAIN_SIZE = 64u;
+
+    // terms of a shift (M2M, L2L) or conversion (M2L) between multi-indices
+    struct ShiftTerm
+    {
+        std::uint32_t target;
+        std::uint32_t source;
+        std::uint32_t offset;
+        double sign;
+    };
+
+    void setup_expansions();
+    void compute_derivatives(double x, double y, double z, double* derivatives, std::vector<double>& scratch) const;
+    void compute_powers(double x, double y, double z, double* powers) const;
+
+    void build_tree();
+    void compute_multipoles();
+    void compute_locals();
+    void evaluate_forces();
+    void compute_forces();
+    void update_positions();
+    void update_velocities();
+
+    std::size_t cell_index(std::size_t level, std::int64_t x, std::int64_t y, std::int64_t z) const;
+
+    ThreadPool m_thread_pool;
+
+    ParticleArrays m_particles;
+    VectorArrays   m_velocities;
+    VectorArrays   m_old_forces;
+    VectorArrays   m_new_forces;
+
+    // m_new_forces holds the forces at the current positions
+    bool m_forces_computed;
+
+    std::size_t m_expansion_order;
+    std::size_t m_num_coefficients;
+
+    // multi-index tables, m_multi_index_lookup is (p + 1)^3 and -1 for orders above p
+    std::vector<std::array<std::uint32_t, 3>> m_multi_indices;
+    std::vector<std::int32_t> m_multi_index_lookup;
+    std::vector<double> m_inverse_factorials;
+
+    std::vector<ShiftTerm> m_shift_terms;
+    std::vector<ShiftTerm> m_m2l_terms;
+
+    // gradient terms for L2P: coefficient m + e_axis for every |m| < p
+    std::array<std::vector<ShiftTerm>, 3> m_gradient_terms;
+
+    // tree geometry of the current step
+    std::size_t m_depth;
+    sf::Vector3f m_min_corner;
+    float m_size;
+
+    // per level dense expansions, [level][cell * m_num_coefficients + coefficient]
+    std::vector<std::vector<double>> m_multipoles;
+    std::vector<std::vector<double>> m_locals;
+
+    // derivatives of 1/r for the 7^3 relative cell offsets of the current level
+    std::vector<double> m_m2l_derivatives;
+
+    // particles sorted by leaf and the leaf ranges into m_leaf_order
+    std::vector<std::uint32_t> m_leaf_order;
+    std::vector<std::uint32_t> m_leaf_offsets;
+    std::vector<std::uint32_t> m_leaf_of_particle;
+
+    float m_time_step;
+    std::size_t m_num_particles;
+
+public:
+    FastMultipoleVelocityVerlet(std::size_t num_particles,
+        float time_step,
+        std::vector<sf::Vector3f> positions,
+        std::vector<sf::Vector3f> velocities,
+        std::vector<float> masses,
+        std::size_t expansion_order = 4u,
+        std::size_t num_threads = std::thread::hardware_concurrency())
+        : m_num_particles(num_particles),
+        m_time_step(time_step),
+        m_particles(positions, masses),
+        m_velocities(velocities),
+        m_old_forces(num_particles),
+        m_new_forces(num_particles),
+        m_forces_computed(false),
+        m_expansion_order(expansion_order),
+        m_num_coefficients(0u),
+        m_depth(0u),
+        m_size(0.f),
+        m_thread_pool(num_threads)
+    {
+        setup_expansions();
+    }
+
+    ~FastMultipoleVelocityVerlet()
+    {}
+
+    void initialize() override;
+
+    void run(std::vector<sf::Vertex>& vertices) override;
+
+    // compares FMM forces for orders 1..max_order against the direct pair sum
+    // of the CPU strategies and prints the error and run time of every order
+    static void report_accuracy(const std::vector<sf::Vector3f>& positions,
+        const std::vector<float>& masses,
+        std::size_t max_order,
+        std::ostream& output);
+};
+
+#endif // !FAST_MULTIPOLE_VELOCITY_VERLET_HPP_
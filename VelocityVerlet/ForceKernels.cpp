@@ -0,0 +1,128 @@
+#include "ForceKernels.hpp"
+#include "ForceKernelsImpl.hpp"
+
+#include <cmath>
+
+#if defined(_MSC_VER)
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+namespace
+{
+    struct ScalarSimd
+    {
+        using Vec = float;
+        using Mask = bool;
+
+        static constexpr std::size_t WIDTH = 1u;
+
+        static Vec zero() { return 0.f; }
+        static Vec broadcast(float val) { return val; }
+        static Vec load(const float* ptr) { return *ptr; }
+        static void store(float* ptr, Vec val) { *ptr = val; }
+        static Vec add(Vec a, Vec b) { return a + b; }
+        static Vec sub(Vec a, Vec b) { return a - b; }
+        static Vec mul(Vec a, Vec b) { return a * b; }
+        static Vec fmadd(Vec a, Vec b, Vec c) { return a * b + c; }
+        static Vec rsqrt(Vec val) { return 1.f / std::sqrt(val); }
+        static Mask positive(Vec val) { return val > 0.f; }
+        static Mask range_mask(std::size_t base, std::size_t first, std::size_t end) { return (base >= first) && (base < end); }
+        static Mask all() { return true; }
+        static Mask mask_and(Mask a, Mask b) { return a && b; }
+        static Vec select(Vec val, Mask mask) { return mask ? val : 0.f; }
+        static float reduce_add(Vec val) { return val; }
+    };
+}
+
+ForceKernel get_scalar_force_kernel(ForceLaw law, bool energy)
+{
+    return get_force_kernel<ScalarSimd>(law, energy);
+}
+
+SimdLevel detect_simd_level()
+{
+#if defined(_MSC_VER)
+    int info[4];
+
+    __cpuid(info, 0);
+    const int max_leaf = info[0];
+
+    if (max_leaf < 7)
+    {
+        return SimdLevel::Scalar;
+    }
+
+    __cpuid(info, 1);
+    const bool has_fma = (info[2] & (1 << 12)) != 0;
+    const bool has_osxsave = (info[2] & (1 << 27)) != 0;
+
+    if (!has_osxsave)
+    {
+        return SimdLevel::Scalar;
+    }
+
+    // the OS has to save the YMM (and ZMM) state on context switches
+    const unsigned long long xcr0 = _xgetbv(0);
+    const bool os_avx = (xcr0 & 0x6) == 0x6;
+    const bool os_avx512 = (xcr0 & 0xE6) == 0xE6;
+
+    __cpuidex(info, 7, 0);
+    const bool has_avx2 = (info[1] & (1 << 5)) != 0;
+    const bool has_avx512f = (info[1] & (1 << 16)) != 0;
+
+    if (has_avx512f && os_avx512)
+    {
+        return SimdLevel::Avx512;
+    }
+
+    if (has_avx2 && has_fma && os_avx)
+    {
+        return SimdLevel::Avx2;
+    }
+
+    return SimdLevel::Scalar;
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx512f"))
+    {
+        return SimdLevel::Avx512;
+    }
+
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    {
+        return SimdLevel::Avx2;
+    }
+
+    return SimdLevel::Scalar;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+const char* get_simd_level_name(SimdLevel level)
+{
+    switch (level)
+    {
+    case SimdLevel::Avx512:
+        return "AVX-512";
+    case SimdLevel::Avx2:
+        return "AVX2";
+    default:
+        return "Scalar";
+    }
+}
+
+ForceKernel select_force_kernel(SimdLevel level, ForceLaw law, bool energy)
+{
+    switch (level)
+    {
+    case SimdLevel::Avx512:
+        return get_avx512_force_kernel(law, energy);
+    case SimdLevel::Avx2:
+        return get_avx2_force_kernel(law, energy);
+    default:
+        return get_scalar_force_kernel(law, energy);
+    }
+}
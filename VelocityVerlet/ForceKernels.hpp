@@ -0,0 +1,55 @@
+#ifndef FORCE_KERNELS_HPP_
+#define FORCE_KERNELS_HPP_
+
+#include "ForceLaws.hpp"
+
+#include <cstddef>
+
+// raw lanes of a ParticleArrays/VectorArrays pair, see ParticleArrays.hpp
+struct ForceKernelArgs
+{
+    const float* x;
+    const float* y;
+    const float* z;
+    const float* mass;
+
+    float* force_x;
+    float* force_y;
+    float* force_z;
+
+    // constants of the law the kernel was selected for
+    ForceLawParameters law = {};
+
+    // energy kernels add the potential energy of their pairs here
+    double* potential_energy = nullptr;
+};
+
+enum class SimdLevel
+{
+    Scalar,
+    Avx2,
+    Avx512
+};
+
+// accumulates the forces of every pair (me, other) with
+// row_begin <= me < row_end, column_begin <= other < column_end and other > me,
+// applying the opposite force to other. The lanes must be padded as in ParticleArrays.
+using ForceKernel = void (*)(const ForceKernelArgs& args,
+    std::size_t row_begin,
+    std::size_t row_end,
+    std::size_t column_begin,
+    std::size_t column_end);
+
+// the kernels of one instruction set, specialized for each force law
+ForceKernel get_scalar_force_kernel(ForceLaw law, bool energy);
+ForceKernel get_avx2_force_kernel(ForceLaw law, bool energy);
+ForceKernel get_avx512_force_kernel(ForceLaw law, bool energy);
+
+SimdLevel detect_simd_level();
+
+const char* get_simd_level_name(SimdLevel level);
+
+// energy selects the variant that also sums the potential energy, see ForceKernelArgs
+ForceKernel select_force_kernel(SimdLevel level, ForceLaw law = ForceLaw::Newtonian, bool energy = false);
+
+#endif // !FORCE_KERNELS_HPP_
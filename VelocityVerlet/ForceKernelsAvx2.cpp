@@ -0,0 +1,71 @@
+#include "ForceKernels.hpp"
+
+// everything below is compiled for AVX2 + FMA, the project sets /arch:AVX2 for this file
+#if defined(__GNUC__) && !defined(_MSC_VER)
+#pragma GCC target("avx2,fma")
+#endif
+
+#include "ForceKernelsImpl.hpp"
+
+#include <immintrin.h>
+
+namespace
+{
+    struct Avx2Simd
+    {
+        using Vec = __m256;
+        using Mask = __m256;
+
+        static constexpr std::size_t WIDTH = 8u;
+
+        static Vec zero() { return _mm256_setzero_ps(); }
+        static Vec broadcast(float val) { return _mm256_set1_ps(val); }
+        static Vec load(const float* ptr) { return _mm256_load_ps(ptr); }
+        static void store(float* ptr, Vec val) { _mm256_store_ps(ptr, val); }
+        static Vec add(Vec a, Vec b) { return _mm256_add_ps(a, b); }
+        static Vec sub(Vec a, Vec b) { return _mm256_sub_ps(a, b); }
+        static Vec mul(Vec a, Vec b) { return _mm256_mul_ps(a, b); }
+        static Vec fmadd(Vec a, Vec b, Vec c) { return _mm256_fmadd_ps(a, b, c); }
+
+        static Vec rsqrt(Vec val)
+        {
+            // 12 bit estimate plus one Newton-Raphson step: y * (1.5 - 0.5 * x * y * y)
+            const Vec estimate = _mm256_rsqrt_ps(val);
+            const Vec half_val = _mm256_mul_ps(val, _mm256_set1_ps(0.5f));
+            const Vec correction = _mm256_fnmadd_ps(_mm256_mul_ps(half_val, estimate), estimate, _mm256_set1_ps(1.5f));
+
+            return _mm256_mul_ps(estimate, correction);
+        }
+
+        static Mask positive(Vec val) { return _mm256_cmp_ps(val, _mm256_setzero_ps(), _CMP_GT_OQ); }
+
+        static Mask range_mask(std::size_t base, std::size_t first, std::size_t end)
+        {
+            const __m256i index = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(base)),
+                _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+
+            const __m256i after_first = _mm256_cmpgt_epi32(index, _mm256_set1_epi32(static_cast<int>(first) - 1));
+            const __m256i before_end = _mm256_cmpgt_epi32(_mm256_set1_epi32(static_cast<int>(end)), index);
+
+            return _mm256_castsi256_ps(_mm256_and_si256(after_first, before_end));
+        }
+
+        static Mask all() { return _mm256_castsi256_ps(_mm256_set1_epi32(-1)); }
+        static Mask mask_and(Mask a, Mask b) { return _mm256_and_ps(a, b); }
+        static Vec select(Vec val, Mask mask) { return _mm256_and_ps(val, mask); }
+
+        static float reduce_add(Vec val)
+        {
+            __m128 sum = _mm_add_ps(_mm256_castps256_ps128(val), _mm256_extractf128_ps(val, 1));
+            sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+            sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 0x55));
+
+            return _mm_cvtss_f32(sum);
+        }
+    };
+}
+
+ForceKernel get_avx2_force_kernel(ForceLaw law, bool energy)
+{
+    return get_force_kernel<Avx2Simd>(law, energy);
+}
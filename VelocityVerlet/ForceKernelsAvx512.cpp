@@ -0,0 +1,63 @@
+#include "ForceKernels.hpp"
+
+// everything below is compiled for AVX-512F, the project sets /arch:AVX512 for this file
+#if defined(__GNUC__) && !defined(_MSC_VER)
+#pragma GCC target("avx512f")
+#endif
+
+#include "ForceKernelsImpl.hpp"
+
+#include <immintrin.h>
+
+namespace
+{
+    struct Avx512Simd
+    {
+        using Vec = __m512;
+        using Mask = __mmask16;
+
+        static constexpr std::size_t WIDTH = 16u;
+
+        static Vec zero() { return _mm512_setzero_ps(); }
+        static Vec broadcast(float val) { return _mm512_set1_ps(val); }
+        static Vec load(const float* ptr) { return _mm512_load_ps(ptr); }
+        static void store(float* ptr, Vec val) { _mm512_store_ps(ptr, val); }
+        static Vec add(Vec a, Vec b) { return _mm512_add_ps(a, b); }
+        static Vec sub(Vec a, Vec b) { return _mm512_sub_ps(a, b); }
+        static Vec mul(Vec a, Vec b) { return _mm512_mul_ps(a, b); }
+        static Vec fmadd(Vec a, Vec b, Vec c) { return _mm512_fmadd_ps(a, b, c); }
+
+        static Vec rsqrt(Vec val)
+        {
+            // 14 bit estimate plus one Newton-Raphson step: y * (1.5 - 0.5 * x * y * y)
+            const Vec estimate = _mm512_rsqrt14_ps(val);
+            const Vec half_val = _mm512_mul_ps(val, _mm512_set1_ps(0.5f));
+            const Vec correction = _mm512_fnmadd_ps(_mm512_mul_ps(half_val, estimate), estimate, _mm512_set1_ps(1.5f));
+
+            return _mm512_mul_ps(estimate, correction);
+        }
+
+        static Mask positive(Vec val) { return _mm512_cmp_ps_mask(val, _mm512_setzero_ps(), _CMP_GT_OQ); }
+
+        static Mask range_mask(std::size_t base, std::size_t first, std::size_t end)
+        {
+            const __m512i index = _mm512_add_epi32(_mm512_set1_epi32(static_cast<int>(base)),
+                _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+
+            const Mask after_first = _mm512_cmpge_epi32_mask(index, _mm512_set1_epi32(static_cast<int>(first)));
+            const Mask before_end = _mm512_cmplt_epi32_mask(index, _mm512_set1_epi32(static_cast<int>(end)));
+
+            return after_first & before_end;
+        }
+
+        static Mask all() { return static_cast<Mask>(0xFFFF); }
+        static Mask mask_and(Mask a, Mask b) { return a & b; }
+        static Vec select(Vec val, Mask mask) { return _mm512_maskz_mov_ps(mask, val); }
+        static float reduce_add(Vec val) { return _mm512_reduce_add_ps(val); }
+    };
+}
+
+ForceKernel get_avx512_force_kernel(ForceLaw law, bool energy)
+{
+    return get_force_kernel<Avx512Simd>(law, energy);
+}
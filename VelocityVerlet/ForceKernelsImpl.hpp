@@ -0,0 +1,133 @@
+#ifndef FORCE_KERNELS_IMPL_HPP_
+#define FORCE_KERNELS_IMPL_HPP_
+
+#include "ForceKernels.hpp"
+#include "ForceLawPolicies.hpp"
+
+// Generic pair loop shared by all instruction sets. Each translation unit that
+// includes this header provides a Simd wrapper and is compiled for its target,
+// so nothing in here may call into non-inline library code.
+//
+// The wrapper provides: Vec, Mask, WIDTH, zero(), broadcast(), load(), store(),
+// add(), sub(), mul(), fmadd(a, b, c) = a * b + c, rsqrt() (refined),
+// positive(Vec), range_mask(base, first, end), all(), mask_and(), select(Vec, Mask)
+// and reduce_add(). Law is one of the policies in ForceLawPolicies.hpp, it is inlined into
+// the pair loop so every (instruction set, law) pair gets its own specialized kernel.
+// With Energy the same loop also sums the pair potentials into *args.potential_energy,
+// without it the energy code is not instantiated at all.
+
+template <typename Simd, template <typename> class Law, bool Energy>
+inline void accumulate_forces_impl(const ForceKernelArgs& args,
+    std::size_t row_begin,
+    std::size_t row_end,
+    std::size_t column_begin,
+    std::size_t column_end)
+{
+    using Vec = typename Simd::Vec;
+    using Mask = typename Simd::Mask;
+
+    const Law<Simd> law(args.law);
+
+    for (std::size_t me = row_begin; me < row_end; ++me)
+    {
+        const std::size_t first = (column_begin > me) ? column_begin : me + 1;
+
+        if (first >= column_end)
+        {
+            continue;
+        }
+
+        const Vec my_x = Simd::broadcast(args.x[me]);
+        const Vec my_y = Simd::broadcast(args.y[me]);
+        const Vec my_z = Simd::broadcast(args.z[me]);
+        const Vec my_mass = Simd::broadcast(args.mass[me]);
+
+        Vec force_x = Simd::zero();
+        Vec force_y = Simd::zero();
+        Vec force_z = Simd::zero();
+        Vec potential = Simd::zero();
+
+        // whole registers from the aligned block containing first, the partial
+        // blocks at both ends are masked out
+        for (std::size_t block = first - (first % Simd::WIDTH); block < column_end; block += Simd::WIDTH)
+        {
+            const bool edge = (block < first) || (block + Simd::WIDTH > column_end);
+            const Mask in_range = edge ? Simd::range_mask(block, first, column_end) : Simd::all();
+
+            const Vec diff_x = Simd::sub(Simd::load(args.x + block), my_x);
+            const Vec diff_y = Simd::sub(Simd::load(args.y + block), my_y);
+            const Vec diff_z = Simd::sub(Simd::load(args.z + block), my_z);
+
+            Vec sqr_distance = Simd::mul(diff_x, diff_x);
+            sqr_distance = Simd::fmadd(diff_y, diff_y, sqr_distance);
+            sqr_distance = Simd::fmadd(diff_z, diff_z, sqr_distance);
+
+            // coincident particles (and zero padding) would produce inf * 0
+            const Mask valid = Simd::mask_and(in_range, Simd::positive(sqr_distance));
+
+            const Vec other_mass = Simd::load(args.mass + block);
+            const Vec scale = Simd::select(law.get_scale(my_mass, other_mass, sqr_distance), valid);
+
+            if (Energy)
+            {
+                potential = Simd::add(potential, Simd::select(law.get_potential(my_mass, other_mass, sqr_distance), valid));
+            }
+
+            const Vec pair_x = Simd::mul(scale, diff_x);
+            const Vec pair_y = Simd::mul(scale, diff_y);
+            const Vec pair_z = Simd::mul(scale, diff_z);
+
+            force_x = Simd::add(force_x, pair_x);
+            force_y = Simd::add(force_y, pair_y);
+            force_z = Simd::add(force_z, pair_z);
+
+            Simd::store(args.force_x + block, Simd::sub(Simd::load(args.force_x + block), pair_x));
+            Simd::store(args.force_y + block, Simd::sub(Simd::load(args.force_y + block), pair_y));
+            Simd::store(args.force_z + block, Simd::sub(Simd::load(args.force_z + block), pair_z));
+        }
+
+        args.force_x[me] += Simd::reduce_add(force_x);
+        args.force_y[me] += Simd::reduce_add(force_y);
+        args.force_z[me] += Simd::reduce_add(force_z);
+
+        if (Energy)
+        {
+            *args.potential_energy += Simd::reduce_add(potential);
+        }
+    }
+}
+
+template <typename Simd, template <typename> class Law, bool Energy>
+inline void accumulate_forces(const ForceKernelArgs& args,
+    std::size_t row_begin,
+    std::size_t row_end,
+    std::size_t column_begin,
+    std::size_t column_end)
+{
+    accumulate_forces_impl<Simd, Law, Energy>(args, row_begin, row_end, column_begin, column_end);
+}
+
+template <typename Simd, template <typename> class Law>
+inline ForceKernel get_force_kernel(bool energy)
+{
+    return energy ? &accumulate_forces<Simd, Law, true> : &accumulate_forces<Simd, Law, false>;
+}
+
+// the instantiations for one Simd wrapper
+template <typename Simd>
+inline ForceKernel get_force_kernel(ForceLaw law, bool energy)
+{
+    switch (law)
+    {
+    case ForceLaw::Plummer:
+        return get_force_kernel<Simd, PlummerLaw>(energy);
+    case ForceLaw::Coulomb:
+        return get_force_kernel<Simd, CoulombLaw>(energy);
+    case ForceLaw::LennardJones:
+        return get_force_kernel<Simd, LennardJonesLaw>(energy);
+    default:
+        return get_force_kernel<Simd, NewtonianLaw>(energy);
+    }
+}
+
+#endif // !FORCE_KERNELS_IMPL_HPP_
@@ -0,0 +1,139 @@
+#ifndef FORCE_LAW_POLICIES_HPP_
+#define FORCE_LAW_POLICIES_HPP_
+
+#include "ForceLaws.hpp"
+
+// Force law policies for the pair kernels in ForceKernelsImpl.hpp. Each is instantiated
+// for one Simd wrapper, broadcasts its constants once and returns the scale s of a pair
+// such that the force on me is s * (other - me), and get_potential the pair potential
+// energy for the diagnostics. Like ForceKernelsImpl.hpp this header is
+// compiled for the target of the including translation unit, so it must stay inline and
+// may only be included after the target pragmas.
+
+template <typename Simd>
+struct NewtonianLaw
+{
+    using Vec = typename Simd::Vec;
+
+    const Vec negative_one;
+
+    explicit NewtonianLaw(const ForceLawParameters&)
+        : negative_one(Simd::broadcast(-1.f))
+    {}
+
+    Vec get_scale(Vec my_mass, Vec other_mass, Vec sqr_distance) const
+    {
+        const Vec inv_distance = Simd::rsqrt(sqr_distance);
+        const Vec inv_distance_cubed = Simd::mul(inv_distance, Simd::mul(inv_distance, inv_distance));
+
+        return Simd::mul(Simd::mul(my_mass, other_mass), inv_distance_cubed);
+    }
+
+    // U = -m_i m_j / r
+    Vec get_potential(Vec my_mass, Vec other_mass, Vec sqr_distance) const
+    {
+        return Simd::mul(Simd::mul(negative_one, Simd::mul(my_mass, other_mass)), Simd::rsqrt(sqr_distance));
+    }
+};
+
+template <typename Simd>
+struct PlummerLaw
+{
+    using Vec = typename Simd::Vec;
+
+    const Vec sqr_softening;
+    const Vec negative_one;
+
+    explicit PlummerLaw(const ForceLawParameters& parameters)
+        : sqr_softening(Simd::broadcast(parameters.softening * parameters.softening)),
+        negative_one(Simd::broadcast(-1.f))
+    {}
+
+    Vec get_scale(Vec my_mass, Vec other_mass, Vec sqr_distance) const
+    {
+        const Vec inv_distance = Simd::rsqrt(Simd::add(sqr_distance, sqr_softening));
+        const Vec inv_distance_cubed = Simd::mul(inv_distance, Simd::mul(inv_distance, inv_distance));
+
+        return Simd::mul(Simd::mul(my_mass, other_mass), inv_distance_cubed);
+    }
+
+    // U = -m_i m_j / sqrt(r^2 + softening^2)
+    Vec get_potential(Vec my_mass, Vec other_mass, Vec sqr_distance) const
+    {
+        return Simd::mul(Simd::mul(negative_one, Simd::mul(my_mass, other_mass)),
+            Simd::rsqrt(Simd::add(sqr_distance, sqr_softening)));
+    }
+};
+
+template <typename Simd>
+struct CoulombLaw
+{
+    using Vec = typename Simd::Vec;
+
+    const Vec negative_constant;
+    const Vec constant;
+
+    explicit CoulombLaw(const ForceLawParameters& parameters)
+        : negative_constant(Simd::broadcast(-parameters.coulomb_constant)),
+        constant(Simd::broadcast(parameters.coulomb_constant))
+    {}
+
+    Vec get_scale(Vec my_mass, Vec other_mass, Vec sqr_distance) const
+    {
+        const Vec inv_distance = Simd::rsqrt(sqr_distance);
+        const Vec inv_distance_cubed = Simd::mul(inv_distance, Simd::mul(inv_distance, inv_distance));
+
+        return Simd::mul(Simd::mul(negative_constant, Simd::mul(my_mass, other_mass)), inv_distance_cubed);
+    }
+
+    // U = coulomb_constant q_i q_j / r
+    Vec get_potential(Vec my_mass, Vec other_mass, Vec sqr_distance) const
+    {
+        return Simd::mul(Simd::mul(constant, Simd::mul(my_mass, other_mass)), Simd::rsqrt(sqr_distance));
+    }
+};
+
+template <typename Simd>
+struct LennardJonesLaw
+{
+    using Vec = typename Simd::Vec;
+
+    const Vec sqr_sigma;
+    const Vec negative_epsilon_24;
+    const Vec epsilon_4;
+    const Vec two;
+    const Vec one;
+
+    explicit LennardJonesLaw(const ForceLawParameters& parameters)
+        : sqr_sigma(Simd::broadcast(parameters.sigma * parameters.sigma)),
+        negative_epsilon_24(Simd::broadcast(-24.f * parameters.epsilon)),
+        epsilon_4(Simd::broadcast(4.f * parameters.epsilon)),
+        two(Simd::broadcast(2.f)),
+        one(Simd::broadcast(1.f))
+    {}
+
+    // the masses do not enter, the sign makes the short range repulsive
+    Vec get_scale(Vec, Vec, Vec sqr_distance) const
+    {
+        const Vec inv_distance = Simd::rsqrt(sqr_distance);
+        const Vec inv_sqr_distance = Simd::mul(inv_distance, inv_distance);
+
+        const Vec sigma2 = Simd::mul(sqr_sigma, inv_sqr_distance);
+        const Vec sigma6 = Simd::mul(sigma2, Simd::mul(sigma2, sigma2));
+
+        return Simd::mul(Simd::mul(negative_epsilon_24, sigma6),
+            Simd::mul(Simd::sub(Simd::mul(two, sigma6), one), inv_sqr_distance));
+    }
+
+    // U = 4 epsilon (sigma6^2 - sigma6)
+    Vec get_potential(Vec, Vec, Vec sqr_distance) const
+    {
+        const Vec inv_distance = Simd::rsqrt(sqr_distance);
+        const Vec sigma2 = Simd::mul(sqr_sigma, Simd::mul(inv_distance, inv_distance));
+        const Vec sigma6 = Simd::mul(sigma2, Simd::mul(sigma2, sigma2));
+
+        return Simd::mul(epsilon_4, Simd::mul(sigma6, Simd::sub(sigma6, one)));
+    }
+};
+
+#endif // !FORCE_LAW_POLICIES_HPP_
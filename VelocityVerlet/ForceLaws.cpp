@@ -0,0 +1,48 @@
+#include "ForceLaws.hpp"
+
+#include <iomanip>
+#include <sstream>
+
+namespace
+{
+    // exact float literal for an OpenCL define
+    std::string to_float_literal(float value)
+    {
+        std::ostringstream literal;
+
+        literal << std::scientific << std::setprecision(9) << value << "f";
+
+        return literal.str();
+    }
+}
+
+const char* get_force_law_name(ForceLaw law)
+{
+    switch (law)
+    {
+    case ForceLaw::Plummer:
+        return "Plummer";
+    case ForceLaw::Coulomb:
+        return "Coulomb";
+    case ForceLaw::LennardJones:
+        return "Lennard-Jones";
+    default:
+        return "Newtonian";
+    }
+}
+
+std::string get_force_law_build_options(const ForceLawParameters& parameters)
+{
+    switch (parameters.law)
+    {
+    case ForceLaw::Plummer:
+        return " -D FORCE_LAW_PLUMMER -D SQR_SOFTENING=" + to_float_literal(parameters.softening * parameters.softening);
+    case ForceLaw::Coulomb:
+        return " -D FORCE_LAW_COULOMB -D COULOMB_CONSTANT=" + to_float_literal(parameters.coulomb_constant);
+    case ForceLaw::LennardJones:
+        return " -D FORCE_LAW_LENNARD_JONES -D SQR_SIGMA=" + to_float_literal(parameters.sigma * parameters.sigma)
+            + " -D EPSILON=" + to_float_literal(parameters.epsilon);
+    default:
+        return " -D FORCE_LAW_NEWTONIAN";
+    }
+}
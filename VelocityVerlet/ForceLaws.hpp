@@ -0,0 +1,36 @@
+#ifndef FORCE_LAWS_HPP_
+#define FORCE_LAWS_HPP_
+
+#include <string>
+
+enum class ForceLaw
+{
+    Newtonian,
+    Plummer,
+    Coulomb,
+    LennardJones
+};
+
+struct ForceLawParameters
+{
+    ForceLaw law = ForceLaw::Newtonian;
+
+    // Plummer: F = m_i m_j r / (r^2 + softening^2)^(3/2)
+    float softening = 1.f;
+
+    // Coulomb: F = -coulomb_constant q_i q_j r / r^3, the charges are the masses,
+    // so all particles repel like equal sign charges
+    float coulomb_constant = 1.f;
+
+    // Lennard-Jones: U = 4 epsilon ((sigma / r)^12 - (sigma / r)^6)
+    float sigma = 10.f;
+    float epsilon = 1.f;
+};
+
+const char* get_force_law_name(ForceLaw law);
+
+// -D defines that specialize the force kernel in velocity_verlet.cl for the law,
+// so every configuration compiles (and caches) its own branch-free program
+std::string get_force_law_build_options(const ForceLawParameters& parameters);
+
+#endif // !FORCE_LAWS_HPP_
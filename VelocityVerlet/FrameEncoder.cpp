@@ -0,0 +1,237 @@
+#include "FrameEncoder.hpp"
+
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+FrameEncoder::~FrameEncoder()
+{
+    close();
+}
+
+void FrameEncoder::open()
+{
+    if (m_output == CaptureOutput::Pipe)
+    {
+        // binary mode, the frames must reach the encoder unchanged
+#ifdef _WIN32
+        m_pipe = popen(m_target.c_str(), "wb");
+#else
+        // an encoder that exits early should fail the writes, not end the simulation
+        std::signal(SIGPIPE, SIG_IGN);
+
+        m_pipe = popen(m_target.c_str(), "w");
+#endif
+
+        if (m_pipe == nullptr)
+        {
+            throw std::string("Failed to start the encoder ") + m_target;
+        }
+    }
+
+    m_stop = false;
+
+    for (std::size_t thread = 0; thread < m_num_threads; ++thread)
+    {
+        m_threads.emplace_back(&FrameEncoder::encoder_loop, this);
+    }
+}
+
+bool FrameEncoder::push(std::uint64_t frame_index, const sf::Uint8* pixels)
+{
+    sf::Uint8* destination = acquire(frame_index);
+
+    if (destination == nullptr)
+    {
+        return false;
+    }
+
+    std::memcpy(destination, pixels, m_acquired.pixels.size());
+    submit(false);
+
+    return true;
+}
+
+sf::Uint8* FrameEncoder::acquire(std::uint64_t frame_index)
+{
+    if (m_has_acquired)
+    {
+        throw std::string("The acquired capture frame has not been submitted");
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        ++m_frames_pushed;
+
+        if (m_queue.size() >= m_queue_capacity)
+        {
+            ++m_frames_dropped;
+            return nullptr;
+        }
+
+        // recycled frames keep their allocation, after the first few frames nothing is allocated
+        if (!m_free_frames.empty())
+        {
+            m_acquired = std::move(m_free_frames.back());
+            m_free_frames.pop_back();
+        }
+    }
+
+    // the frame is filled outside the lock, the encoders only wait on the queue itself
+    m_acquired.index = frame_index;
+    m_acquired.pixels.resize(static_cast<std::size_t>(m_width) * m_height * 4u);
+    m_has_acquired = true;
+
+    return m_acquired.pixels.data();
+}
+
+void FrameEncoder::submit(bool flipped)
+{
+    if (!m_has_acquired)
+    {
+        return;
+    }
+
+    m_acquired.flipped = flipped;
+    m_has_acquired = false;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.push_back(std::move(m_acquired));
+    }
+
+    m_frame_available.notify_one();
+}
+
+void FrameEncoder::encoder_loop()
+{
+    while (true)
+    {
+        Frame frame;
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+
+            m_frame_available.wait(lock, [this]() { return m_stop || !m_queue.empty(); });
+
+            // the queue is drained before stopping
+            if (m_queue.empty())
+            {
+                return;
+            }
+
+            frame = std::move(m_queue.front());
+            m_queue.pop_front();
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        const bool encoded = encode(frame);
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (encoded)
+        {
+            ++m_frames_encoded;
+        }
+        else
+        {
+            ++m_frames_failed;
+        }
+
+        m_encode_seconds += seconds;
+
+        m_free_frames.push_back(std::move(frame));
+    }
+}
+
+bool FrameEncoder::encode(const Frame& frame)
+{
+    const std::size_t row_size = static_cast<std::size_t>(m_width) * 4u;
+
+    if ((m_output == CaptureOutput::Pipe) && !frame.flipped)
+    {
+        return std::fwrite(frame.pixels.data(), 1, frame.pixels.size(), m_pipe) == frame.pixels.size();
+    }
+
+    // the encoder expects the top row first
+    if (m_output == CaptureOutput::Pipe)
+    {
+        for (std::size_t row = m_height; row > 0; --row)
+        {
+            if (std::fwrite(&frame.pixels[(row - 1) * row_size], 1, row_size, m_pipe) != row_size)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    std::ostringstream file_name;
+
+    file_name << m_target << std::setw(6) << std::setfill('0') << frame.index << ".png";
+
+    sf::Image image;
+
+    image.create(m_width, m_height, frame.pixels.data());
+
+    if (frame.flipped)
+    {
+        image.flipVertically();
+    }
+
+    return image.saveToFile(file_name.str());
+}
+
+void FrameEncoder::close()
+{
+    if (m_threads.empty())
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+
+    m_frame_available.notify_all();
+
+    for (std::thread& thread : m_threads)
+    {
+        thread.join();
+    }
+
+    m_threads.clear();
+
+    // closing the pipe ends the input of the encoder, pclose waits for it to finish the file
+    if (m_pipe != nullptr)
+    {
+        pclose(m_pipe);
+        m_pipe = nullptr;
+    }
+}
+
+void FrameEncoder::print_statistics(std::ostream& out)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    const std::size_t frames_done = m_frames_encoded + m_frames_failed;
+
+    out << "Capture " << m_target << std::endl
+        << "  frames encoded     : " << m_frames_encoded << " of " << m_frames_pushed << std::endl
+        << "  frames dropped     : " << m_frames_dropped << std::endl
+        << "  frames failed      : " << m_frames_failed << std::endl
+        << "  encode time (ms)   : " << std::fixed << std::setprecision(2)
+        << ((frames_done > 0) ? m_encode_seconds * 1e3 / static_cast<double>(frames_done) : 0.0) << " per frame, "
+        << m_num_threads << " threads" << std::defaultfloat << std::endl;
+}
@@ -0,0 +1,127 @@
+#ifndef FRAME_ENCODER_HPP_
+#define FRAME_ENCODER_HPP_
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <SFML/Graphics.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class CaptureOutput
+{
+    // <target>000001.png, <target>000002.png, ... written by all encoder threads
+    PngSequence,
+
+    // raw RGBA frames on the standard input of the command in target, in frame order
+    Pipe
+};
+
+// encodes captured frames on a pool of threads. push() only copies the pixels into a
+// recycled buffer, or acquire() hands out that buffer to be filled in place. when every
+// buffer of the bounded queue is taken the frame is dropped so the simulation never
+// waits for the encoder. the pipe keeps the frame order, so it is fed by a single thread
+// and the encoder process does the parallel work
+class FrameEncoder
+{
+private:
+    struct Frame
+    {
+        std::uint64_t index;
+        std::vector<sf::Uint8> pixels;
+
+        // rows from the bottom to the top, as OpenGL reads them
+        bool flipped;
+    };
+
+    std::string m_target;
+    CaptureOutput m_output;
+    unsigned int m_width;
+    unsigned int m_height;
+    std::size_t m_num_threads;
+    std::size_t m_queue_capacity;
+
+    FILE* m_pipe;
+
+    std::vector<std::thread> m_threads;
+    std::mutex m_mutex;
+    std::condition_variable m_frame_available;
+    std::deque<Frame> m_queue;
+    std::vector<Frame> m_free_frames;
+    bool m_stop;
+
+    // the frame between acquire() and submit(), only touched by the caller
+    Frame m_acquired;
+    bool m_has_acquired;
+
+    // statistics, guarded by m_mutex
+    std::size_t m_frames_pushed;
+    std::size_t m_frames_encoded;
+    std::size_t m_frames_dropped;
+    std::size_t m_frames_failed;
+    double m_encode_seconds;
+
+    void encoder_loop();
+    bool encode(const Frame& frame);
+
+public:
+    FrameEncoder(std::string target,
+        CaptureOutput output,
+        unsigned int width,
+        unsigned int height,
+        std::size_t num_threads = 2u,
+        std::size_t queue_capacity = 8u)
+        : m_target(target),
+        m_output(output),
+        m_width(width),
+        m_height(height),
+        m_num_threads((output == CaptureOutput::Pipe) ? 1u : std::max<std::size_t>(num_threads, 1u)),
+        m_queue_capacity(std::max<std::size_t>(queue_capacity, 1u)),
+        m_pipe(nullptr),
+        m_stop(false),
+        m_has_acquired(false),
+        m_frames_pushed(0u),
+        m_frames_encoded(0u),
+        m_frames_dropped(0u),
+        m_frames_failed(0u),
+        m_encode_seconds(0.0)
+    {}
+
+    ~FrameEncoder();
+
+    FrameEncoder(const FrameEncoder&) = delete;
+    FrameEncoder& operator=(const FrameEncoder&) = delete;
+
+    unsigned int get_width() const
+    {
+        return m_width;
+    }
+
+    unsigned int get_height() const
+    {
+        return m_height;
+    }
+
+    // starts the encoder process and threads, throws std::string on failure
+    void open();
+
+    // pixels holds width * height RGBA texels, returns false if the frame was dropped
+    bool push(std::uint64_t frame_index, const sf::Uint8* pixels);
+
+    // a recycled buffer of width * height RGBA texels to fill, nullptr if the frame was
+    // dropped. the frame is queued by submit(), flipped when its rows go bottom to top
+    sf::Uint8* acquire(std::uint64_t frame_index);
+    void submit(bool flipped);
+
+    // encodes the queued frames, then stops the threads and waits for the encoder process
+    void close();
+
+    void print_statistics(std::ostream& out);
+};
+
+#endif // !FRAME_ENCODER_HPP_
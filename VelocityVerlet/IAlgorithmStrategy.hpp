@@ -12,7 +12,9 @@ public:
 
     virtual void initialize() = 0;
 
-    virtual std::vector<sf::Vertex> run() = 0;
+    // advances one step and writes the particle vertices into the caller owned buffer,
+    // the buffer is only resized when its size does not match the particle count
+    virtual void run(std::vector<sf::Vertex>& vertices) = 0;
 };
 
 #endif // !IALGORITHMSTRATEGY
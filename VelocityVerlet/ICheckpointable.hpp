@@ -0,0 +1,18 @@
+#ifndef ICHECKPOINTABLE_HPP_
+#define ICHECKPOINTABLE_HPP_
+
+#include "Checkpoint.hpp"
+
+class ICheckpointable
+{
+public:
+    virtual ~ICheckpointable() = default;
+
+    // copies positions, velocities, masses and the current forces into the state
+    virtual void save_checkpoint(CheckpointState& state) = 0;
+
+    // called after initialize(), the particle count has to match the checkpoint
+    virtual void restore_checkpoint(const CheckpointFile& checkpoint) = 0;
+};
+
+#endif // !ICHECKPOINTABLE_HPP_
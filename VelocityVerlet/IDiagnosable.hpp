@@ -0,0 +1,16 @@
+#ifndef IDIAGNOSABLE_HPP_
+#define IDIAGNOSABLE_HPP_
+
+#include "Diagnostics.hpp"
+
+class IDiagnosable
+{
+public:
+    virtual ~IDiagnosable() = default;
+
+    // the strategy records energy and momentum of every step into the log, null turns
+    // the diagnostics off and selects the kernels without the extra sums again
+    virtual void set_diagnostics(DiagnosticsLog* diagnostics) = 0;
+};
+
+#endif // !IDIAGNOSABLE_HPP_
@@ -0,0 +1,18 @@
+#ifndef IENSEMBLE_HPP_
+#define IENSEMBLE_HPP_
+
+#include "Ensemble.hpp"
+
+class IEnsemble
+{
+public:
+    virtual ~IEnsemble() = default;
+
+    virtual std::size_t get_num_systems() const = 0;
+
+    // copies the current positions and velocities of one system into state, together
+    // with the masses and time step it was created with
+    virtual void read_system(std::size_t system, EnsembleSystem& state) = 0;
+};
+
+#endif // !IENSEMBLE_HPP_
@@ -0,0 +1,15 @@
+#ifndef IPROFILEABLE_HPP_
+#define IPROFILEABLE_HPP_
+
+#include "Profiler.hpp"
+
+class IProfileable
+{
+public:
+    virtual ~IProfileable() = default;
+
+    // the strategy records its phases into the profiler, null turns profiling off
+    virtual void set_profiler(Profiler* profiler) = 0;
+};
+
+#endif // !IPROFILEABLE_HPP_
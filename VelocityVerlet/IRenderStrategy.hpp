@@ -10,7 +10,7 @@ class IRenderStrategy
 public:
 	virtual ~IRenderStrategy() = default;
 
-	virtual void update(std::vector<sf::Vertex> vertices) = 0;
+	virtual void update(const std::vector<sf::Vertex>& vertices) = 0;
 
 	virtual const sf::Drawable& get_frame() const = 0;
 };
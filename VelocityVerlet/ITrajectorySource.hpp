@@ -0,0 +1,16 @@
+#ifndef ITRAJECTORY_SOURCE_HPP_
+#define ITRAJECTORY_SOURCE_HPP_
+
+#include "TrajectoryWriter.hpp"
+
+class ITrajectorySource
+{
+public:
+    virtual ~ITrajectorySource() = default;
+
+    // resizes and fills the positions, and the velocities when with_velocities is set,
+    // with num_particles * 3 floats in particle order
+    virtual void save_snapshot(TrajectorySnapshot& snapshot, bool with_velocities) = 0;
+};
+
+#endif // !ITRAJECTORY_SOURCE_HPP_
@@ -0,0 +1,170 @@
+#include "LocalRingCommunicator.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+LocalRingHub::LocalRingHub(std::size_t num_ranks)
+    : m_num_ranks(num_ranks),
+    m_mailboxes(num_ranks),
+    m_stop(false),
+    m_num_arrived(0u),
+    m_generation(0u),
+    m_broadcast_data(nullptr)
+{
+    m_copy_thread = std::thread(&LocalRingHub::copy_loop, this);
+}
+
+LocalRingHub::~LocalRingHub()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+
+    m_changed.notify_all();
+    m_copy_thread.join();
+}
+
+void LocalRingHub::wait_for_all(std::unique_lock<std::mutex>& lock)
+{
+    const std::uint64_t generation = m_generation;
+
+    if (++m_num_arrived == m_num_ranks)
+    {
+        m_num_arrived = 0u;
+        ++m_generation;
+        m_changed.notify_all();
+    }
+    else
+    {
+        m_changed.wait(lock, [&]() { return m_generation != generation; });
+    }
+}
+
+void LocalRingHub::copy_loop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (true)
+    {
+        m_changed.wait(lock, [this]() { return m_stop || !m_copies.empty(); });
+
+        if (m_copies.empty())
+        {
+            return;
+        }
+
+        const Copy copy = m_copies.front();
+        m_copies.pop_front();
+
+        Mailbox& mailbox = m_mailboxes[copy.rank];
+        const Mailbox& previous = m_mailboxes[(copy.rank + m_num_ranks - 1) % m_num_ranks];
+
+        // both ranks wait for this copy before touching either buffer again, so it runs unlocked
+        const float* source = previous.send;
+        float* destination = mailbox.receive;
+        const std::size_t count = std::min(previous.count, mailbox.count);
+
+        lock.unlock();
+        std::copy(source, source + count, destination);
+        lock.lock();
+
+        mailbox.arrived = copy.sequence;
+        m_changed.notify_all();
+    }
+}
+
+void LocalRingHub::start_shift(std::size_t rank, std::uint64_t sequence, const float* send, float* receive, std::size_t count)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    Mailbox& mailbox = m_mailboxes[rank];
+
+    mailbox.send = send;
+    mailbox.receive = receive;
+    mailbox.count = count;
+    mailbox.posted = sequence;
+
+    // whichever of two neighbours posts last queues the copy between them
+    const std::size_t previous = (rank + m_num_ranks - 1) % m_num_ranks;
+    const std::size_t next = (rank + 1) % m_num_ranks;
+
+    if (m_mailboxes[previous].posted == sequence)
+    {
+        m_copies.push_back({ rank, sequence });
+    }
+
+    if ((next != rank) && (m_mailboxes[next].posted == sequence))
+    {
+        m_copies.push_back({ next, sequence });
+    }
+
+    m_changed.notify_all();
+}
+
+void LocalRingHub::finish_shift(std::size_t rank, std::uint64_t sequence)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    const Mailbox& mailbox = m_mailboxes[rank];
+    const Mailbox& next = m_mailboxes[(rank + 1) % m_num_ranks];
+
+    // the block of the previous rank has arrived, and the send buffer belongs to the caller
+    // again once the next rank has received it
+    m_changed.wait(lock, [&]() { return (mailbox.arrived == sequence) && (next.arrived == sequence); });
+}
+
+void LocalRingHub::all_gather(std::size_t rank, const float* send, float* receive, std::size_t count)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    m_gather_buffer.resize(m_num_ranks * count);
+    std::copy(send, send + count, m_gather_buffer.begin() + rank * count);
+
+    wait_for_all(lock);
+
+    std::copy(m_gather_buffer.begin(), m_gather_buffer.begin() + m_num_ranks * count, receive);
+
+    // nobody may start the next gather before everyone has copied this one
+    wait_for_all(lock);
+}
+
+void LocalRingHub::broadcast(std::size_t rank, void* data, std::size_t num_bytes)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    if (rank == 0)
+    {
+        m_broadcast_data = data;
+    }
+
+    wait_for_all(lock);
+
+    if (rank != 0)
+    {
+        std::memcpy(data, m_broadcast_data, num_bytes);
+    }
+
+    // rank 0 keeps its buffer alive until everyone has copied it
+    wait_for_all(lock);
+}
+
+void LocalRingCommunicator::start_shift(const float* send, float* receive, std::size_t count)
+{
+    m_hub.start_shift(m_rank, ++m_shift_sequence, send, receive, count);
+}
+
+void LocalRingCommunicator::finish_shift()
+{
+    m_hub.finish_shift(m_rank, m_shift_sequence);
+}
+
+void LocalRingCommunicator::all_gather(const float* send, float* receive, std::size_t count)
+{
+    m_hub.all_gather(m_rank, send, receive, count);
+}
+
+void LocalRingCommunicator::broadcast(void* data, std::size_t num_bytes)
+{
+    m_hub.broadcast(m_rank, data, num_bytes);
+}
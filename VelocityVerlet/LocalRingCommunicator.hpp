@@ -0,0 +1,108 @@
+#ifndef LOCAL_RING_COMMUNICATOR_HPP_
+#define LOCAL_RING_COMMUNICATOR_HPP_
+
+#include "RingCommunicator.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// shared state of a ring of ranks that are threads of one process. starting a shift posts
+// the send and receive buffers, and once two neighbours have both posted, a copy thread
+// moves the block from one to the other while both ranks compute on. finishing a shift
+// only waits for the copies into and out of the rank
+class LocalRingHub
+{
+private:
+    struct Mailbox
+    {
+        const float* send = nullptr;
+        float* receive = nullptr;
+        std::size_t count = 0u;
+        std::uint64_t posted = 0u;
+
+        // the shift whose block has been copied into receive
+        std::uint64_t arrived = 0u;
+    };
+
+    struct Copy
+    {
+        std::size_t rank;
+        std::uint64_t sequence;
+    };
+
+    std::size_t m_num_ranks;
+    std::vector<Mailbox> m_mailboxes;
+
+    // receiving ranks whose block can be copied
+    std::deque<Copy> m_copies;
+    std::thread m_copy_thread;
+    bool m_stop;
+
+    // generation barrier
+    std::size_t m_num_arrived;
+    std::uint64_t m_generation;
+
+    // what rank 0 shares in a broadcast, and the rank order buffer of a gather
+    const void* m_broadcast_data;
+    std::vector<float> m_gather_buffer;
+
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+
+    void wait_for_all(std::unique_lock<std::mutex>& lock);
+    void copy_loop();
+
+public:
+    explicit LocalRingHub(std::size_t num_ranks);
+    ~LocalRingHub();
+
+    LocalRingHub(const LocalRingHub&) = delete;
+    LocalRingHub& operator=(const LocalRingHub&) = delete;
+
+    std::size_t get_num_ranks() const
+    {
+        return m_num_ranks;
+    }
+
+    void start_shift(std::size_t rank, std::uint64_t sequence, const float* send, float* receive, std::size_t count);
+    void finish_shift(std::size_t rank, std::uint64_t sequence);
+    void all_gather(std::size_t rank, const float* send, float* receive, std::size_t count);
+    void broadcast(std::size_t rank, void* data, std::size_t num_bytes);
+};
+
+// the view of one rank on a LocalRingHub
+class LocalRingCommunicator : public IRingCommunicator
+{
+private:
+    LocalRingHub& m_hub;
+    std::size_t m_rank;
+    std::uint64_t m_shift_sequence;
+
+public:
+    LocalRingCommunicator(LocalRingHub& hub, std::size_t rank)
+        : m_hub(hub),
+        m_rank(rank),
+        m_shift_sequence(0u)
+    {}
+
+    std::size_t get_rank() const override
+    {
+        return m_rank;
+    }
+
+    std::size_t get_num_ranks() const override
+    {
+        return m_hub.get_num_ranks();
+    }
+
+    void start_shift(const float* send, float* receive, std::size_t count) override;
+    void finish_shift() override;
+    void all_gather(const float* send, float* receive, std::size_t count) override;
+    void broadcast(void* data, std::size_t num_bytes) override;
+};
+
+#endif // !LOCAL_RING_COMMUNICATOR_HPP_
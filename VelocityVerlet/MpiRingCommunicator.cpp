@@ -0,0 +1,65 @@
+#include "MpiRingCommunicator.hpp"
+
+#ifdef VV_USE_MPI
+
+MpiRingCommunicator::MpiRingCommunicator(MPI_Comm communicator, bool owns_communicator)
+    : m_communicator(communicator),
+    m_owns_communicator(owns_communicator),
+    m_rank(0),
+    m_num_ranks(1),
+    m_requests{ MPI_REQUEST_NULL, MPI_REQUEST_NULL }
+{
+    MPI_Comm_rank(m_communicator, &m_rank);
+    MPI_Comm_size(m_communicator, &m_num_ranks);
+}
+
+MpiRingCommunicator::~MpiRingCommunicator()
+{
+    MPI_Waitall(static_cast<int>(m_requests.size()), m_requests.data(), MPI_STATUSES_IGNORE);
+
+    if (m_owns_communicator)
+    {
+        MPI_Comm_free(&m_communicator);
+    }
+}
+
+void MpiRingCommunicator::start_shift(const float* send, float* receive, std::size_t count)
+{
+    const int next = (m_rank + 1) % m_num_ranks;
+    const int previous = (m_rank + m_num_ranks - 1) % m_num_ranks;
+
+    MPI_Irecv(receive, static_cast<int>(count), MPI_FLOAT, previous, 0, m_communicator, &m_requests[0]);
+    MPI_Isend(send, static_cast<int>(count), MPI_FLOAT, next, 0, m_communicator, &m_requests[1]);
+}
+
+void MpiRingCommunicator::finish_shift()
+{
+    MPI_Waitall(static_cast<int>(m_requests.size()), m_requests.data(), MPI_STATUSES_IGNORE);
+}
+
+void MpiRingCommunicator::all_gather(const float* send, float* receive, std::size_t count)
+{
+    MPI_Allgather(send, static_cast<int>(count), MPI_FLOAT, receive, static_cast<int>(count), MPI_FLOAT, m_communicator);
+}
+
+void MpiRingCommunicator::broadcast(void* data, std::size_t num_bytes)
+{
+    MPI_Bcast(data, static_cast<int>(num_bytes), MPI_BYTE, 0, m_communicator);
+}
+
+std::unique_ptr<MpiRingCommunicator> MpiRingCommunicator::split(std::size_t num_ranks)
+{
+    const bool member = (static_cast<std::size_t>(m_rank) < num_ranks);
+
+    MPI_Comm communicator = MPI_COMM_NULL;
+    MPI_Comm_split(m_communicator, member ? 0 : MPI_UNDEFINED, m_rank, &communicator);
+
+    if (communicator == MPI_COMM_NULL)
+    {
+        return nullptr;
+    }
+
+    return std::make_unique<MpiRingCommunicator>(communicator, true);
+}
+
+#endif // VV_USE_MPI
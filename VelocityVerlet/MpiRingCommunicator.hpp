@@ -0,0 +1,56 @@
+#ifndef MPI_RING_COMMUNICATOR_HPP_
+#define MPI_RING_COMMUNICATOR_HPP_
+
+// only built with -D VV_USE_MPI and an MPI implementation, the Debug-MPI and Release-MPI
+// configurations define it and link MS-MPI
+#ifdef VV_USE_MPI
+
+#include "RingCommunicator.hpp"
+
+#include <array>
+#include <memory>
+#include <mpi.h>
+
+// ranks are MPI processes, shifts are non-blocking point-to-point messages so the
+// transfer overlaps the force computation on the previous block
+class MpiRingCommunicator : public IRingCommunicator
+{
+private:
+    MPI_Comm m_communicator;
+    bool m_owns_communicator;
+    int m_rank;
+    int m_num_ranks;
+
+    std::array<MPI_Request, 2u> m_requests;
+
+public:
+    // wraps MPI_COMM_WORLD or a communicator created by split()
+    explicit MpiRingCommunicator(MPI_Comm communicator = MPI_COMM_WORLD, bool owns_communicator = false);
+
+    ~MpiRingCommunicator();
+
+    MpiRingCommunicator(const MpiRingCommunicator&) = delete;
+    MpiRingCommunicator& operator=(const MpiRingCommunicator&) = delete;
+
+    std::size_t get_rank() const override
+    {
+        return static_cast<std::size_t>(m_rank);
+    }
+
+    std::size_t get_num_ranks() const override
+    {
+        return static_cast<std::size_t>(m_num_ranks);
+    }
+
+    void start_shift(const float* send, float* receive, std::size_t count) override;
+    void finish_shift() override;
+    void all_gather(const float* send, float* receive, std::size_t count) override;
+    void broadcast(void* data, std::size_t num_bytes) override;
+
+    // collective, a communicator over the first num_ranks ranks, null on the others
+    std::unique_ptr<MpiRingCommunicator> split(std::size_t num_ranks);
+};
+
+#endif // VV_USE_MPI
+
+#endif // !MPI_RING_COMMUNICATOR_HPP_
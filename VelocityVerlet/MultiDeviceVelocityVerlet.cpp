@@ -0,0 +1,531 @@
+#include "MultiDeviceVelocityVerlet.hpp"
+
+#include "ProgramBinaryCache.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+
+bool MultiDeviceVelocityVerlet::validate_inputs() const
+{
+    const std::vector<std::size_t> input_sizes =
+    {
+        m_input_positions.size(),
+        m_input_velocities.size(),
+        m_input_masses.size(),
+        m_num_particles
+    };
+
+    if (!std::equal(input_sizes.begin() + 1, input_sizes.end(), input_sizes.begin()))
+    {
+        return false;
+    }
+
+    return (m_num_particles > 0) && !m_selected_devices.empty();
+}
+
+bool MultiDeviceVelocityVerlet::setup_input_data()
+{
+    m_buffer_size_bytes = m_num_particles * sizeof(cl_float4);
+
+    m_positions.resize(m_num_particles);
+    m_velocities.resize(m_num_particles);
+
+    for (std::size_t i = 0; i < m_num_particles; ++i)
+    {
+        // the 4th component contains the mass for this particle
+        m_positions[i].s0 = m_input_positions[i].x;
+        m_positions[i].s1 = m_input_positions[i].y;
+        m_positions[i].s2 = m_input_positions[i].z;
+        m_positions[i].s3 = m_input_masses[i];
+
+        m_velocities[i].s0 = m_input_velocities[i].x;
+        m_velocities[i].s1 = m_input_velocities[i].y;
+        m_velocities[i].s2 = m_input_velocities[i].z;
+        m_velocities[i].s3 = m_input_masses[i];
+    }
+
+    return true;
+}
+
+bool MultiDeviceVelocityVerlet::setup_device(DeviceSlice& slice)
+{
+    try
+    {
+        // one context per device, the devices may come from different platforms
+        slice.context = cl::Context(slice.device.device);
+        slice.command_queue = cl::CommandQueue(slice.context, slice.device.device, CL_QUEUE_PROFILING_ENABLE, NULL);
+
+        slice.all_positions_buffer = cl::Buffer(slice.context,
+            CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+            m_buffer_size_bytes,
+            m_positions.data());
+
+        return true;
+    }
+    catch (const cl::Error& e)
+    {
+        std::cout << "Error: " << e.err() << std::endl;
+        std::cout << "Exception: " << e.what() << std::endl;
+
+        return false;
+    }
+}
+
+bool MultiDeviceVelocityVerlet::setup_program(DeviceSlice& slice)
+{
+    try
+    {
+        std::string kernel_code;
+
+        if (!read_kernel_sources({ KERNEL_FILE_NAME }, kernel_code))
+        {
+            return false;
+        }
+
+        // every slice has its own context, sub-devices of one device share the cached binary
+        slice.program = build_cached_program(slice.context, slice.device.device, kernel_code, m_build_options,
+            PROGRAM_CACHE_DIRECTORY);
+
+        return true;
+    }
+    catch (const cl::Error& e)
+    {
+        std::cout << "Error: " << e.err() << std::endl;
+        std::cout << "Exception: " << e.what() << std::endl;
+
+        return false;
+    }
+}
+
+bool MultiDeviceVelocityVerlet::setup_kernels(DeviceSlice& slice)
+{
+    try
+    {
+        slice.force_kernel = cl::Kernel(slice.program, FORCE_KERNEL_NAME.data());
+        slice.positions_kernel = cl::Kernel(slice.program, POSITIONS_KERNEL_NAME.data());
+        slice.velocities_kernel = cl::Kernel(slice.program, VELOCITY_KERNEL_NAME.data());
+
+        slice.workgroup_size = std::min({ WORKGROUP_SIZE,
+            slice.device.device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>(),
+            slice.force_kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(slice.device.device) });
+
+        // arguments that never change, the rest are bound when queueing
+        slice.force_kernel.setArg(1, slice.all_positions_buffer);
+        slice.force_kernel.setArg(2, slice.workgroup_size * sizeof(cl_float4), NULL);
+        slice.force_kernel.setArg(3, static_cast<cl_uint>(m_num_particles));
+
+        slice.positions_kernel.setArg(1, slice.all_positions_buffer);
+        slice.positions_kernel.setArg(4, m_time_step);
+
+        slice.velocities_kernel.setArg(3, m_time_step);
+
+        return true;
+    }
+    catch (const cl::Error& e)
+    {
+        std::cout << "Error: " << e.err() << std::endl;
+        std::cout << "Exception: " << e.what() << std::endl;
+
+        return false;
+    }
+}
+
+bool MultiDeviceVelocityVerlet::measure_throughput(DeviceSlice& slice)
+{
+    try
+    {
+        const std::size_t num_particles = std::min(m_num_particles, CALIBRATION_PARTICLES);
+        const std::size_t total_workitems = ((num_particles + slice.workgroup_size - 1) / slice.workgroup_size) * slice.workgroup_size;
+
+        cl::Buffer forces_buffer(slice.context, CL_MEM_READ_WRITE, num_particles * sizeof(cl_float4), NULL);
+
+        slice.force_kernel.setArg(0, forces_buffer);
+        slice.force_kernel.setArg(4, cl_uint(0));
+        slice.force_kernel.setArg(5, static_cast<cl_uint>(num_particles));
+
+        double best_seconds = std::numeric_limits<double>::max();
+
+        for (std::size_t run = 0; run < CALIBRATION_RUNS; ++run)
+        {
+            cl::Event event;
+
+            slice.command_queue->enqueueNDRangeKernel(slice.force_kernel,
+                cl::NullRange,
+                cl::NDRange(total_workitems),
+                cl::NDRange(slice.workgroup_size),
+                NULL,
+                &event);
+
+            event.wait();
+
+            const double seconds = 1e-9 * static_cast<double>(event.getProfilingInfo<CL_PROFILING_COMMAND_END>()
+                - event.getProfilingInfo<CL_PROFILING_COMMAND_START>());
+
+            // the first run pays for lazy allocations and code upload
+            if ((run > 0) || (CALIBRATION_RUNS == 1))
+            {
+                best_seconds = std::min(best_seconds, std::max(seconds, 1e-9));
+            }
+        }
+
+        slice.throughput = static_cast<double>(num_particles) * static_cast<double>(m_num_particles) / best_seconds;
+
+        return true;
+    }
+    catch (const cl::Error& e)
+    {
+        std::cout << "Error: " << e.err() << std::endl;
+        std::cout << "Exception: " << e.what() << std::endl;
+
+        return false;
+    }
+}
+
+void MultiDeviceVelocityVerlet::partition_particles()
+{
+    double total_throughput = 0.0;
+
+    for (const DeviceSlice& slice : m_devices)
+    {
+        total_throughput += slice.throughput;
+    }
+
+    // every device gets a contiguous slice proportional to its share of the throughput
+    double cumulative_throughput = 0.0;
+    std::size_t first_particle = 0;
+
+    for (std::size_t d = 0; d < m_devices.size(); ++d)
+    {
+        cumulative_throughput += m_devices[d].throughput;
+
+        const std::size_t end_particle = (d + 1 == m_devices.size())
+            ? m_num_particles
+            : std::min(m_num_particles, static_cast<std::size_t>(std::llround(m_num_particles * cumulative_throughput / total_throughput)));
+
+        m_devices[d].first_particle = first_particle;
+        m_devices[d].num_particles = end_particle - first_particle;
+
+        first_particle = end_particle;
+    }
+
+    // devices too slow to get any particles only add exchange overhead
+    m_devices.erase(std::remove_if(m_devices.begin(), m_devices.end(),
+        [](const DeviceSlice& slice) { return slice.num_particles == 0; }),
+        m_devices.end());
+}
+
+bool MultiDeviceVelocityVerlet::setup_buffers(DeviceSlice& slice)
+{
+    try
+    {
+        const std::size_t slice_size_bytes = slice.num_particles * sizeof(cl_float4);
+
+        slice.new_positions_buffer = cl::Buffer(slice.context, CL_MEM_READ_WRITE, slice_size_bytes, NULL);
+
+        slice.velocities_buffer = cl::Buffer(slice.context,
+            CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,
+            slice_size_bytes,
+            m_velocities.data() + slice.first_particle);
+
+        slice.forces_buffers[0] = cl::Buffer(slice.context, CL_MEM_READ_WRITE, slice_size_bytes, NULL);
+        slice.forces_buffers[1] = cl::Buffer(slice.context, CL_MEM_READ_WRITE, slice_size_bytes, NULL);
+
+        const cl_uint first_particle = static_cast<cl_uint>(slice.first_particle);
+        const cl_uint num_particles = static_cast<cl_uint>(slice.num_particles);
+
+        slice.force_kernel.setArg(4, first_particle);
+        slice.force_kernel.setArg(5, num_particles);
+
+        slice.positions_kernel.setArg(2, slice.new_positions_buffer);
+        slice.positions_kernel.setArg(3, slice.velocities_buffer);
+        slice.positions_kernel.setArg(5, num_particles);
+        slice.positions_kernel.setArg(6, first_particle);
+
+        slice.velocities_kernel.setArg(2, slice.velocities_buffer);
+        slice.velocities_kernel.setArg(4, num_particles);
+
+        return true;
+    }
+    catch (const cl::Error& e)
+    {
+        std::cout << "Error: " << e.err() << std::endl;
+        std::cout << "Exception: " << e.what() << std::endl;
+
+        return false;
+    }
+}
+
+bool MultiDeviceVelocityVerlet::queue_forces(DeviceSlice& slice, std::size_t forces_idx, const std::vector<cl::Event>* wait_events)
+{
+    try
+    {
+        const std::size_t total_workitems = ((slice.num_particles + slice.workgroup_size - 1) / slice.workgroup_size) * slice.workgroup_size;
+
+        slice.force_kernel.setArg(0, slice.forces_buffers[forces_idx]);
+
+        slice.command_queue->enqueueNDRangeKernel(slice.force_kernel,
+            cl::NullRange,
+            cl::NDRange(total_workitems),
+            cl::NDRange(slice.workgroup_size),
+            wait_events,
+            &slice.force_events[0]);
+
+        return true;
+    }
+    catch (const cl::Error& e)
+    {
+        std::cout << "Error: " << e.err() << std::endl;
+        std::cout << "Exception: " << e.what() << std::endl;
+
+        return false;
+    }
+}
+
+bool MultiDeviceVelocityVerlet::queue_positions()
+{
+    try
+    {
+        for (std::size_t d = 0; d < m_devices.size(); ++d)
+        {
+            DeviceSlice& slice = m_devices[d];
+
+            const std::size_t total_workitems = ((slice.num_particles + slice.workgroup_size - 1) / slice.workgroup_size) * slice.workgroup_size;
+
+            // half kick and drift with the forces carried over from the previous step
+            slice.positions_kernel.setArg(0, slice.forces_buffers[m_front_buffer_idx]);
+
+            slice.command_queue->enqueueNDRangeKernel(slice.positions_kernel,
+                cl::NullRange,
+                cl::NDRange(total_workitems),
+                cl::NDRange(slice.workgroup_size),
+                NULL,
+                &slice.positions_events[0]);
+
+            // read the new positions of this slice into the shared host array
+            slice.command_queue->enqueueReadBuffer(slice.new_positions_buffer,
+                CL_FALSE,
+                0,
+                slice.num_particles * sizeof(cl_float4),
+                m_positions.data() + slice.first_particle,
+                &slice.positions_events,
+                &m_read_events[d]);
+
+            slice.command_queue->flush();
+        }
+
+        return true;
+    }
+    catch (const cl::Error& e)
+    {
+        std::cout << "Error: " << e.err() << std::endl;
+        std::cout << "Exception: " << e.what() << std::endl;
+
+        return false;
+    }
+}
+
+bool MultiDeviceVelocityVerlet::exchange_positions()
+{
+    try
+    {
+        // every slice has to be on the host before any device can compute forces
+        cl::Event::waitForEvents(m_read_events);
+
+        for (std::size_t d = 0; d < m_devices.size(); ++d)
+        {
+            DeviceSlice& slice = m_devices[d];
+
+            slice.command_queue->enqueueWriteBuffer(slice.all_positions_buffer,
+                CL_FALSE,
+                0,
+                m_buffer_size_bytes,
+                m_positions.data(),
+                NULL,
+                &slice.write_events[0]);
+
+            m_write_events[d] = slice.write_events[0];
+        }
+
+        return true;
+    }
+    catch (const cl::Error& e)
+    {
+        std::cout << "Error: " << e.err() << std::endl;
+        std::cout << "Exception: " << e.what() << std::endl;
+
+        return false;
+    }
+}
+
+bool MultiDeviceVelocityVerlet::queue_forces_and_velocities()
+{
+    try
+    {
+        for (DeviceSlice& slice : m_devices)
+        {
+            if (!queue_forces(slice, m_back_buffer_idx, &slice.write_events))
+            {
+                return false;
+            }
+
+            const std::size_t total_workitems = ((slice.num_particles + slice.workgroup_size - 1) / slice.workgroup_size) * slice.workgroup_size;
+
+            // closing half kick with the old and the new forces
+            slice.velocities_kernel.setArg(0, slice.forces_buffers[m_front_buffer_idx]);
+            slice.velocities_kernel.setArg(1, slice.forces_buffers[m_back_buffer_idx]);
+
+            slice.command_queue->enqueueNDRangeKernel(slice.velocities_kernel,
+                cl::NullRange,
+                cl::NDRange(total_workitems),
+                cl::NDRange(slice.workgroup_size),
+                &slice.force_events,
+                &slice.velocities_events[0]);
+
+            slice.command_queue->flush();
+        }
+
+        return true;
+    }
+    catch (const cl::Error& e)
+    {
+        std::cout << "Error: " << e.err() << std::endl;
+        std::cout << "Exception: " << e.what() << std::endl;
+
+        return false;
+    }
+}
+
+bool MultiDeviceVelocityVerlet::wait_for_uploads()
+{
+    try
+    {
+        // the next step reads slices back into the array the uploads are sending
+        cl::Event::waitForEvents(m_write_events);
+
+        return true;
+    }
+    catch (const cl::Error& e)
+    {
+        std::cout << "Error: " << e.err() << std::endl;
+        std::cout << "Exception: " << e.what() << std::endl;
+
+        return false;
+    }
+}
+
+void MultiDeviceVelocityVerlet::initialize()
+{
+    if (!validate_inputs())
+    {
+        throw std::string("Failure due to invalid inputs");
+    }
+
+    if (!setup_input_data())
+    {
+        throw std::string("Failed to setup input data");
+    }
+
+    m_devices.clear();
+
+    for (const OpenCLDevice& device : m_selected_devices)
+    {
+        DeviceSlice slice;
+        slice.device = device;
+
+        if (!setup_device(slice))
+        {
+            throw std::string("Failed to setup device ") + device.name;
+        }
+
+        if (!setup_program(slice))
+        {
+            throw std::string("Failed to setup program for ") + device.name;
+        }
+
+        if (!setup_kernels(slice))
+        {
+            throw std::string("Failed to setup kernels for ") + device.name;
+        }
+
+        if (!measure_throughput(slice))
+        {
+            throw std::string("Failed to measure the throughput of ") + device.name;
+        }
+
+        m_devices.push_back(slice);
+    }
+
+    partition_particles();
+
+    for (DeviceSlice& slice : m_devices)
+    {
+        if (!setup_buffers(slice))
+        {
+            throw std::string("Failed to setup buffers for ") + slice.device.name;
+        }
+    }
+
+    m_read_events.resize(m_devices.size());
+    m_write_events.resize(m_devices.size());
+
+    std::cout << std::endl << "Multi-device setup is OK" << std::endl;
+
+    for (const DeviceSlice& slice : m_devices)
+    {
+        std::cout << std::setw(40) << std::left << slice.device.name << std::right
+            << " particles " << std::setw(9) << slice.first_particle
+            << " - " << std::setw(9) << (slice.first_particle + slice.num_particles)
+            << ", " << std::scientific << std::setprecision(3) << slice.throughput << std::defaultfloat
+            << " interactions/s" << std::endl;
+    }
+}
+
+void MultiDeviceVelocityVerlet::run(std::vector<sf::Vertex>& vertices)
+{
+    // the forces are only computed up front for the very first step
+    if (!m_forces_computed)
+    {
+        for (DeviceSlice& slice : m_devices)
+        {
+            if (!queue_forces(slice, m_front_buffer_idx, NULL))
+            {
+                throw std::string("Failed to queue commands");
+            }
+        }
+
+        m_forces_computed = true;
+    }
+
+    if (!queue_positions())
+    {
+        throw std::string("Failed to queue commands");
+    }
+
+    if (!exchange_positions())
+    {
+        throw std::string("Failed to exchange positions");
+    }
+
+    if (!queue_forces_and_velocities())
+    {
+        throw std::string("Failed to queue commands");
+    }
+
+    vertices.resize(m_num_particles);
+
+    for (std::size_t i = 0; i < m_num_particles; ++i)
+    {
+        vertices[i] = sf::Vector2f(m_positions[i].s0, m_positions[i].s1);
+    }
+
+    if (!wait_for_uploads())
+    {
+        throw std::string("Failed to exchange positions");
+    }
+
+    // the new forces become the old forces of the next step
+    std::swap(m_front_buffer_idx, m_back_buffer_idx);
+}
@@ -0,0 +1,163 @@
+#ifndef MULTI_DEVICE_VELOCITY_VERLET_HPP_
+#define MULTI_DEVICE_VELOCITY_VERLET_HPP_
+
+#include "ForceLaws.hpp"
+#include "IAlgorithmStrategy.hpp"
+#include "OpenCLDevices.hpp"
+
+#include <array>
+#include <optional>
+#include <SFML/System/Vector3.hpp>
+#include <string>
+#include <vector>
+
+// one OpenCL device and the slice of particles it integrates
+struct DeviceSlice
+{
+    OpenCLDevice device;
+
+    cl::Context context;
+    std::optional<cl::CommandQueue> command_queue;
+    cl::Program program;
+
+    cl::Kernel force_kernel;
+    cl::Kernel positions_kernel;
+    cl::Kernel velocities_kernel;
+
+    // positions and masses of every particle, refreshed after every step
+    cl::Buffer all_positions_buffer;
+
+    // the buffers below only hold this device's slice
+    cl::Buffer new_positions_buffer;
+    cl::Buffer velocities_buffer;
+    std::array<cl::Buffer, 2u> forces_buffers;
+
+    std::size_t workgroup_size;
+    std::size_t first_particle;
+    std::size_t num_particles;
+
+    // measured pair interactions per second
+    double throughput;
+
+    std::vector<cl::Event> positions_events;
+    std::vector<cl::Event> write_events;
+    std::vector<cl::Event> force_events;
+    std::vector<cl::Event> velocities_events;
+
+    DeviceSlice()
+        : workgroup_size(0u),
+        first_particle(0u),
+        num_particles(0u),
+        throughput(0.0),
+        positions_events(1),
+        write_events(1),
+        force_events(1),
+        velocities_events(1)
+    {}
+};
+
+// splits the i-particles over several OpenCL devices in proportion to their measured
+// throughput. every device keeps a copy of all positions, after the drift each device
+// reads back its slice and the host sends the combined positions to every device
+class MultiDeviceVelocityVerlet : public IAlgorithmStrategy
+{
+private:
+    const std::string KERNEL_FILE_NAME = "velocity_verlet.cl";
+    const std::string FORCE_KERNEL_NAME = "compute_forces";
+    const std::string VELOCITY_KERNEL_NAME = "compute_velocities";
+    const std::string POSITIONS_KERNEL_NAME = "compute_positions";
+    const std::string BUILD_OPTIONS = "-cl-std=CL2.2";
+    const std::string PROGRAM_CACHE_DIRECTORY = "kernel_cache";
+    const std::size_t WORKGROUP_SIZE = 256u;
+
+    // i-particles timed per device to estimate its throughput, the first run is a warm-up
+    const std::size_t CALIBRATION_PARTICLES = 4096u;
+    const std::size_t CALIBRATION_RUNS = 3u;
+
+    std::vector<OpenCLDevice> m_selected_devices;
+
+    // every device builds the program specialized for the force law
+    ForceLawParameters m_force_law;
+    std::string m_build_options;
+
+    std::vector<DeviceSlice> m_devices;
+
+    std::vector<sf::Vector3f>& m_input_positions;
+    std::vector<sf::Vector3f>& m_input_velocities;
+    std::vector<float>& m_input_masses;
+
+    // host copy of every position, the exchange point between the devices
+    std::vector<cl_float4> m_positions;
+    std::vector<cl_float4> m_velocities;
+    std::size_t m_buffer_size_bytes;
+
+    std::vector<cl::Event> m_read_events;
+    std::vector<cl::Event> m_write_events;
+
+    std::size_t m_front_buffer_idx;
+    std::size_t m_back_buffer_idx;
+
+    // the front forces buffers hold the forces at the current positions
+    bool m_forces_computed;
+
+    float m_time_step;
+    std::size_t m_num_particles;
+
+    bool validate_inputs() const;
+    bool setup_input_data();
+    bool setup_device(DeviceSlice& slice);
+    bool setup_program(DeviceSlice& slice);
+    bool measure_throughput(DeviceSlice& slice);
+    void partition_particles();
+    bool setup_buffers(DeviceSlice& slice);
+    bool setup_kernels(DeviceSlice& slice);
+    bool queue_forces(DeviceSlice& slice, std::size_t forces_idx, const std::vector<cl::Event>* wait_events);
+    bool queue_positions();
+    bool exchange_positions();
+    bool queue_forces_and_velocities();
+    bool wait_for_uploads();
+
+public:
+    MultiDeviceVelocityVerlet(std::size_t num_particles,
+        float time_step,
+        std::vector<sf::Vector3f>& positions,
+        std::vector<sf::Vector3f>& velocities,
+        std::vector<float>& masses,
+        std::vector<OpenCLDevice> devices,
+        ForceLawParameters force_law = ForceLawParameters())
+        : m_selected_devices(devices),
+        m_force_law(force_law),
+        m_build_options(BUILD_OPTIONS + get_force_law_build_options(force_law)),
+        m_input_positions(positions),
+        m_input_velocities(velocities),
+        m_input_masses(masses),
+        m_buffer_size_bytes(0u),
+        m_front_buffer_idx(0u),
+        m_back_buffer_idx(1u),
+        m_forces_computed(false),
+        m_time_step(time_step),
+        m_num_particles(num_particles)
+    {}
+
+    ~MultiDeviceVelocityVerlet()
+    {
+        for (DeviceSlice& slice : m_devices)
+        {
+            if (slice.command_queue.has_value())
+            {
+                try
+                {
+                    slice.command_queue->finish();
+                }
+                catch (const cl::Error&)
+                {
+                }
+            }
+        }
+    }
+
+    void initialize() override;
+    void run(std::vector<sf::Vertex>& vertices) override;
+};
+
+#endif // !MULTI_DEVICE_VELOCITY_VERLET_HPP_
@@ -0,0 +1,341 @@
+#include "MultiThreadedVelocityVerlet.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+void MultiThreadedVelocityVerlet::setup_tiles()
+{
+    const std::size_t num_blocks = (m_num_particles + TILE_SIZE - 1) / TILE_SIZE;
+
+    m_tiles.clear();
+
+    for (std::size_t row = 0; row < num_blocks; ++row)
+    {
+        for (std::size_t column = row; column < num_blocks; ++column)
+        {
+            m_tiles.emplace_back(row, column);
+        }
+    }
+
+    // largest tiles first so that the diagonal (half-sized) tiles fill the gaps at the end
+    std::stable_partition(m_tiles.begin(), m_tiles.end(),
+        [](const std::pair<std::size_t, std::size_t>& tile) { return tile.first != tile.second; });
+
+    m_thread_forces.assign(m_thread_pool.get_num_threads(), VectorArrays(m_num_particles));
+    m_thread_sums.assign(m_thread_pool.get_num_threads(), WorkerSums());
+}
+
+void MultiThreadedVelocityVerlet::compute_forces()
+{
+    for (WorkerSums& sums : m_thread_sums)
+    {
+        sums.potential_energy = 0.0;
+    }
+
+    m_thread_pool.parallel_for(0, m_tiles.size(), 1,
+        [this](std::size_t begin, std::size_t end, std::size_t worker)
+        {
+            VectorArrays& forces = m_thread_forces[worker];
+
+            const ForceKernelArgs args =
+            {
+                m_particles.x.data(),
+                m_particles.y.data(),
+                m_particles.z.data(),
+                m_particles.mass.data(),
+                forces.x.data(),
+                forces.y.data(),
+                forces.z.data(),
+                m_force_law,
+                &m_thread_sums[worker].potential_energy
+            };
+
+            for (std::size_t tile = begin; tile < end; ++tile)
+            {
+                const std::size_t row_begin = m_tiles[tile].first * TILE_SIZE;
+                const std::size_t column_begin = m_tiles[tile].second * TILE_SIZE;
+
+                m_force_kernel(args,
+                    row_begin,
+                    std::min(row_begin + TILE_SIZE, m_num_particles),
+                    column_begin,
+                    std::min(column_begin + TILE_SIZE, m_num_particles));
+            }
+        });
+
+    // reduce the per-thread accumulators and clear them for the next pass
+    m_thread_pool.parallel_for(0, m_num_particles, GRAIN_SIZE,
+        [this](std::size_t begin, std::size_t end, std::size_t)
+        {
+            for (std::size_t i = begin; i < end; ++i)
+            {
+                float force_x = 0.f;
+                float force_y = 0.f;
+                float force_z = 0.f;
+
+                for (VectorArrays& thread_forces : m_thread_forces)
+                {
+                    force_x += thread_forces.x[i];
+                    force_y += thread_forces.y[i];
+                    force_z += thread_forces.z[i];
+
+                    thread_forces.x[i] = 0.f;
+                    thread_forces.y[i] = 0.f;
+                    thread_forces.z[i] = 0.f;
+                }
+
+                m_new_forces.x[i] = force_x;
+                m_new_forces.y[i] = force_y;
+                m_new_forces.z[i] = force_z;
+            }
+        });
+}
+
+void MultiThreadedVelocityVerlet::update_positions()
+{
+    m_thread_pool.parallel_for(0, m_num_particles, GRAIN_SIZE,
+        [this](std::size_t begin, std::size_t end, std::size_t)
+        {
+            for (std::size_t i = begin; i < end; ++i)
+            {
+                float acceleration = m_time_step * 0.5f / m_particles.mass[i];
+
+                m_particles.x[i] += m_time_step * (m_velocities.x[i] + acceleration * m_new_forces.x[i]);
+                m_particles.y[i] += m_time_step * (m_velocities.y[i] + acceleration * m_new_forces.y[i]);
+                m_particles.z[i] += m_time_step * (m_velocities.z[i] + acceleration * m_new_forces.z[i]);
+            }
+        });
+
+    std::swap(m_old_forces, m_new_forces);
+}
+
+template <bool Diagnostics>
+void MultiThreadedVelocityVerlet::update_velocities(StepDiagnostics& diagnostics)
+{
+    if (Diagnostics)
+    {
+        for (WorkerSums& sums : m_thread_sums)
+        {
+            sums.kinetic_energy = 0.0;
+            sums.momentum = {};
+        }
+    }
+
+    m_thread_pool.parallel_for(0, m_num_particles, GRAIN_SIZE,
+        [this](std::size_t begin, std::size_t end, std::size_t worker)
+        {
+            double kinetic_energy = 0.0;
+            double momentum_x = 0.0;
+            double momentum_y = 0.0;
+            double momentum_z = 0.0;
+
+            for (std::size_t i = begin; i < end; ++i)
+            {
+                float acceleration = m_time_step * 0.5f / m_particles.mass[i];
+
+                m_velocities.x[i] += acceleration * (m_new_forces.x[i] + m_old_forces.x[i]);
+                m_velocities.y[i] += acceleration * (m_new_forces.y[i] + m_old_forces.y[i]);
+                m_velocities.z[i] += acceleration * (m_new_forces.z[i] + m_old_forces.z[i]);
+
+                if (Diagnostics)
+                {
+                    const double mass = m_particles.mass[i];
+
+                    kinetic_energy += mass * (m_velocities.x[i] * m_velocities.x[i]
+                        + m_velocities.y[i] * m_velocities.y[i]
+                        + m_velocities.z[i] * m_velocities.z[i]);
+
+                    momentum_x += mass * m_velocities.x[i];
+                    momentum_y += mass * m_velocities.y[i];
+                    momentum_z += mass * m_velocities.z[i];
+                }
+            }
+
+            if (Diagnostics)
+            {
+                WorkerSums& sums = m_thread_sums[worker];
+
+                sums.kinetic_energy += kinetic_energy;
+                sums.momentum[0] += momentum_x;
+                sums.momentum[1] += momentum_y;
+                sums.momentum[2] += momentum_z;
+            }
+        });
+
+    if (Diagnostics)
+    {
+        diagnostics.kinetic_energy = 0.0;
+        diagnostics.potential_energy = 0.0;
+        diagnostics.momentum = {};
+
+        for (const WorkerSums& sums : m_thread_sums)
+        {
+            diagnostics.kinetic_energy += 0.5 * sums.kinetic_energy;
+            diagnostics.potential_energy += sums.potential_energy;
+            diagnostics.momentum[0] += sums.momentum[0];
+            diagnostics.momentum[1] += sums.momentum[1];
+            diagnostics.momentum[2] += sums.momentum[2];
+        }
+    }
+}
+
+void MultiThreadedVelocityVerlet::reorder_particles()
+{
+    // the sort itself is serial, it runs once every reorder interval
+    if (!m_reorderer.compute_order(m_particles.x.data(), m_particles.y.data(), m_particles.z.data(), m_step_count))
+    {
+        return;
+    }
+
+    // the old forces are overwritten before they are read again and the per-thread
+    // accumulators are zero between passes
+    float* lanes[] =
+    {
+        m_particles.x.data(),
+        m_particles.y.data(),
+        m_particles.z.data(),
+        m_particles.mass.data(),
+        m_velocities.x.data(),
+        m_velocities.y.data(),
+        m_velocities.z.data(),
+        m_new_forces.x.data(),
+        m_new_forces.y.data(),
+        m_new_forces.z.data()
+    };
+
+    for (float* lane : lanes)
+    {
+        m_reorderer.apply(lane);
+    }
+}
+
+void MultiThreadedVelocityVerlet::initialize()
+{
+    setup_tiles();
+
+    std::cout << std::endl << "CPU threads      : " << m_thread_pool.get_num_threads() << std::endl;
+    std::cout << "CPU force kernel : " << get_simd_level_name(m_simd_level)
+        << ", " << get_force_law_name(m_force_law.law) << std::endl;
+
+    if (m_reorderer.is_enabled())
+    {
+        std::cout << "Particle order   : " << get_space_filling_curve_name(m_reorderer.get_curve()) << " curve" << std::endl;
+    }
+}
+
+void MultiThreadedVelocityVerlet::run(std::vector<sf::Vertex>& vertices)
+{
+    if (m_tiles.empty())
+    {
+        setup_tiles();
+    }
+
+    if (m_reorderer.is_due(m_step_count))
+    {
+        reorder_particles();
+    }
+
+    // the forces at the end of a step are the forces at the start of the next one,
+    // so apart from the very first step there is one force evaluation per step
+    if (!m_forces_computed)
+    {
+        ProfileScope scope(m_profiler, ProfilePhase::Force);
+
+        compute_forces();
+        m_forces_computed = true;
+    }
+
+    // half kick and drift
+    {
+        ProfileScope scope(m_profiler, ProfilePhase::Drift);
+        update_positions();
+    }
+
+    {
+        ProfileScope scope(m_profiler, ProfilePhase::Force);
+        compute_forces();
+    }
+
+    StepDiagnostics diagnostics = {};
+
+    // closing half kick with the new forces
+    {
+        ProfileScope scope(m_profiler, ProfilePhase::Kick);
+
+        if (m_diagnostics != nullptr)
+        {
+            update_velocities<true>(diagnostics);
+        }
+        else
+        {
+            update_velocities<false>(diagnostics);
+        }
+    }
+
+    ++m_step_count;
+
+    if (m_diagnostics != nullptr)
+    {
+        diagnostics.step = m_step_count;
+        m_diagnostics->record(diagnostics);
+    }
+
+    ProfileScope scope(m_profiler, ProfilePhase::VertexConversion);
+
+    vertices.resize(m_num_particles);
+
+    // in particle order, whatever the order of the slots
+    const std::vector<std::uint32_t>& ids = m_reorderer.get_ids();
+
+    m_thread_pool.parallel_for(0, m_num_particles, GRAIN_SIZE,
+        [this, &vertices, &ids](std::size_t begin, std::size_t end, std::size_t)
+        {
+            for (std::size_t i = begin; i < end; ++i)
+            {
+                vertices[ids[i]] = sf::Vertex(sf::Vector2f(m_particles.x[i], m_particles.y[i]));
+            }
+        });
+}
+
+void MultiThreadedVelocityVerlet::save_snapshot(TrajectorySnapshot& snapshot, bool with_velocities)
+{
+    snapshot.positions.resize(m_num_particles * 3u);
+    snapshot.velocities.resize(with_velocities ? m_num_particles * 3u : 0u);
+
+    // snapshots are in particle order
+    const std::vector<std::uint32_t>& ids = m_reorderer.get_ids();
+
+    for (std::size_t i = 0; i < m_num_particles; ++i)
+    {
+        float* position = &snapshot.positions[ids[i] * 3u];
+
+        position[0] = m_particles.x[i];
+        position[1] = m_particles.y[i];
+        position[2] = m_particles.z[i];
+    }
+
+    if (!with_velocities)
+    {
+        return;
+    }
+
+    for (std::size_t i = 0; i < m_num_particles; ++i)
+    {
+        float* velocity = &snapshot.velocities[ids[i] * 3u];
+
+        velocity[0] = m_velocities.x[i];
+        velocity[1] = m_velocities.y[i];
+        velocity[2] = m_velocities.z[i];
+    }
+}
+
+void MultiThreadedVelocityVerlet::set_profiler(Profiler* profiler)
+{
+    m_profiler = profiler;
+}
+
+void MultiThreadedVelocityVerlet::set_diagnostics(DiagnosticsLog* diagnostics)
+{
+    m_diagnostics = diagnostics;
+    m_force_kernel = select_force_kernel(m_simd_level, m_force_law.law, diagnostics != nullptr);
+}
@@ -0,0 +1,118 @@
+#ifndef MULTI_THREADED_VELOCITY_VERLET_HPP_
+#define MULTI_THREADED_VELOCITY_VERLET_HPP_
+
+#include "ForceKernels.hpp"
+#include "IAlgorithmStrategy.hpp"
+#include "IDiagnosable.hpp"
+#include "IProfileable.hpp"
+#include "ITrajectorySource.hpp"
+#include "ParticleArrays.hpp"
+#include "SpatialOrder.hpp"
+#include "ThreadPool.hpp"
+
+#include <array>
+#include <cstdint>
+#include <SFML/System/Vector3.hpp>
+#include <thread>
+#include <utility>
+#include <vector>
+
+class MultiThreadedVelocityVerlet : public IAlgorithmStrategy, public IProfileable, public IDiagnosable,
+    public ITrajectorySource
+{
+private:
+    // particles per side of a tile of the pair matrix, a multiple of PARTICLE_LANE_WIDTH
+    const std::size_t TILE_SIZE = 256u;
+
+    // particles per task for the O(N) loops
+    const std::size_t GRAIN_SIZE = 4096u;
+
+    void setup_tiles();
+    void compute_forces();
+    void update_positions();
+    void reorder_particles();
+
+    // with Diagnostics the kick also sums the kinetic energy and momentum into the record
+    template <bool Diagnostics>
+    void update_velocities(StepDiagnostics& diagnostics);
+
+    // partial diagnostics sums of one worker, on their own cache line
+    struct alignas(64) WorkerSums
+    {
+        double potential_energy;
+        double kinetic_energy;
+        std::array<double, 3u> momentum;
+    };
+
+    ThreadPool m_thread_pool;
+
+    ParticleArrays m_particles;
+    VectorArrays   m_velocities;
+    VectorArrays   m_old_forces;
+    VectorArrays   m_new_forces;
+
+    // m_new_forces holds the forces at the current positions
+    bool m_forces_computed;
+
+    // slot i holds particle get_ids()[i]
+    ParticleReorderer m_reorderer;
+
+    // one force accumulator per worker, reduced into m_new_forces after the pair loop
+    std::vector<VectorArrays> m_thread_forces;
+    std::vector<WorkerSums> m_thread_sums;
+
+    ForceLawParameters m_force_law;
+    SimdLevel   m_simd_level;
+    ForceKernel m_force_kernel;
+
+    // upper triangle of the pair matrix as (row block, column block) tiles
+    std::vector<std::pair<std::size_t, std::size_t>> m_tiles;
+
+    float m_time_step;
+    std::size_t m_num_particles;
+    std::uint64_t m_step_count;
+
+    Profiler* m_profiler;
+    DiagnosticsLog* m_diagnostics;
+
+public:
+    MultiThreadedVelocityVerlet(std::size_t num_particles,
+        float time_step,
+        std::vector<sf::Vector3f> positions,
+        std::vector<sf::Vector3f> velocities,
+        std::vector<float> masses,
+        ForceLawParameters force_law = ForceLawParameters(),
+        ReorderParameters reorder = ReorderParameters(),
+        std::size_t num_threads = std::thread::hardware_concurrency())
+        : m_num_particles(num_particles),
+        m_time_step(time_step),
+        m_step_count(0u),
+        m_particles(positions, masses),
+        m_velocities(velocities),
+        m_old_forces(num_particles),
+        m_new_forces(num_particles),
+        m_forces_computed(false),
+        m_reorderer(num_particles, reorder),
+        m_force_law(force_law),
+        m_simd_level(detect_simd_level()),
+        m_force_kernel(select_force_kernel(m_simd_level, force_law.law)),
+        m_thread_pool(num_threads),
+        m_profiler(nullptr),
+        m_diagnostics(nullptr)
+    {}
+
+    ~MultiThreadedVelocityVerlet()
+    {}
+
+    void initialize() override;
+
+    void run(std::vector<sf::Vertex>& vertices) override;
+
+    void save_snapshot(TrajectorySnapshot& snapshot, bool with_velocities) override;
+
+    void set_profiler(Profiler* profiler) override;
+
+    void set_diagnostics(DiagnosticsLog* diagnostics) override;
+};
+
+#endif // !MULTI_THREADED_VELOCITY_VERLET_HPP_
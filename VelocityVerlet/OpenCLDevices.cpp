@@ -0,0 +1,217 @@
+#include "OpenCLDevices.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+static std::string get_device_type_name(cl_device_type type)
+{
+    if (type & CL_DEVICE_TYPE_GPU)
+    {
+        return "GPU";
+    }
+
+    if (type & CL_DEVICE_TYPE_CPU)
+    {
+        return "CPU";
+    }
+
+    return "other";
+}
+
+std::vector<OpenCLDevice> enumerate_opencl_devices(std::size_t sub_devices_per_device)
+{
+    std::vector<OpenCLDevice> devices;
+
+    try
+    {
+        std::vector<cl::Platform> platforms;
+
+        cl::Platform::get(&platforms);
+
+        for (const cl::Platform& platform : platforms)
+        {
+            std::vector<cl::Device> platform_devices;
+
+            try
+            {
+                platform.getDevices(CL_DEVICE_TYPE_ALL, &platform_devices);
+            }
+            catch (const cl::Error&)
+            {
+                // platforms without devices report CL_DEVICE_NOT_FOUND
+                continue;
+            }
+
+            const std::string platform_name = platform.getInfo<CL_PLATFORM_NAME>();
+
+            for (cl::Device& device : platform_devices)
+            {
+                OpenCLDevice entry;
+
+                entry.platform = platform;
+                entry.device = device;
+                entry.platform_name = platform_name;
+                entry.name = device.getInfo<CL_DEVICE_NAME>();
+                entry.type = get_device_type_name(device.getInfo<CL_DEVICE_TYPE>());
+                entry.compute_units = device.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>();
+                entry.is_sub_device = false;
+                entry.parent_index = devices.size();
+                entry.is_leaf = true;
+
+                devices.push_back(entry);
+
+                const std::size_t parent_index = devices.size() - 1;
+                const cl_uint max_sub_devices = device.getInfo<CL_DEVICE_PARTITION_MAX_SUB_DEVICES>();
+
+                if ((sub_devices_per_device < 2) || (max_sub_devices < 2))
+                {
+                    continue;
+                }
+
+                const std::size_t num_sub_devices = std::min<std::size_t>(sub_devices_per_device, max_sub_devices);
+
+                // partitioning equally by compute_units / n makes more than n sub-devices when
+                // the division has a remainder, so ask for exactly n and spread the remainder
+                if (entry.compute_units < num_sub_devices)
+                {
+                    continue;
+                }
+
+                std::vector<cl_device_partition_property> properties;
+
+                properties.push_back(CL_DEVICE_PARTITION_BY_COUNTS);
+
+                for (std::size_t i = 0; i < num_sub_devices; ++i)
+                {
+                    const std::size_t count = entry.compute_units / num_sub_devices + ((i < entry.compute_units % num_sub_devices) ? 1u : 0u);
+
+                    properties.push_back(static_cast<cl_device_partition_property>(count));
+                }
+
+                properties.push_back(CL_DEVICE_PARTITION_BY_COUNTS_LIST_END);
+                properties.push_back(0);
+
+                std::vector<cl::Device> sub_devices;
+
+                try
+                {
+                    device.createSubDevices(properties.data(), &sub_devices);
+                }
+                catch (const cl::Error& e)
+                {
+                    std::cout << "Failed to partition " << entry.name << ", error: " << e.err() << std::endl;
+                    continue;
+                }
+
+                devices[parent_index].is_leaf = sub_devices.empty();
+
+                for (const cl::Device& sub_device : sub_devices)
+                {
+                    OpenCLDevice sub_entry = devices[parent_index];
+
+                    sub_entry.device = sub_device;
+                    sub_entry.compute_units = sub_device.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>();
+                    sub_entry.is_sub_device = true;
+                    sub_entry.parent_index = parent_index;
+                    sub_entry.is_leaf = true;
+
+                    devices.push_back(sub_entry);
+                }
+            }
+        }
+    }
+    catch (const cl::Error& e)
+    {
+        std::cout << "Error: " << e.err() << std::endl;
+        std::cout << "Exception: " << e.what() << std::endl;
+    }
+
+    return devices;
+}
+
+std::vector<std::size_t> get_leaf_device_indices(const std::vector<OpenCLDevice>& devices)
+{
+    std::vector<std::size_t> indices;
+
+    for (std::size_t i = 0; i < devices.size(); ++i)
+    {
+        if (devices[i].is_leaf)
+        {
+            indices.push_back(i);
+        }
+    }
+
+    return indices;
+}
+
+bool select_opencl_platform(const std::optional<OpenCLDevice>& selected_device, cl::Platform& platform)
+{
+    // an explicitly selected device brings its own platform
+    if (selected_device.has_value())
+    {
+        platform = selected_device->platform;
+
+        return true;
+    }
+
+    std::vector<cl::Platform> platforms;
+
+    cl::Platform::get(&platforms);
+
+    if (platforms.empty())
+    {
+        return false;
+    }
+
+    platform = platforms.front();
+
+    return true;
+}
+
+cl::Context create_opencl_context(const cl::Platform& platform, const std::optional<OpenCLDevice>& selected_device)
+{
+    if (selected_device.has_value())
+    {
+        return cl::Context(selected_device->device);
+    }
+
+    cl_context_properties props[3] =
+    {
+        CL_CONTEXT_PLATFORM,
+        (cl_context_properties)(platform)(),
+        0
+    };
+
+    return cl::Context(CL_DEVICE_TYPE_GPU, props, NULL, NULL);
+}
+
+std::string get_opencl_device_name(const cl::Device& device)
+{
+#ifdef CL_DEVICE_BOARD_NAME_AMD
+    return device.getInfo<CL_DEVICE_BOARD_NAME_AMD>();
+#else
+    return device.getInfo<CL_DEVICE_NAME>();
+#endif
+}
+
+void print_opencl_devices(const std::vector<OpenCLDevice>& devices, std::ostream& output)
+{
+    output << std::endl << "OpenCL devices" << std::endl;
+
+    for (std::size_t i = 0; i < devices.size(); ++i)
+    {
+        const OpenCLDevice& device = devices[i];
+
+        output << std::setw(3) << i << " : "
+            << (device.is_sub_device ? "  sub-device of " + std::to_string(device.parent_index) + ", " : "")
+            << device.type << ", "
+            << device.compute_units << " compute units, "
+            << device.name << " (" << device.platform_name << ")" << std::endl;
+    }
+
+    if (devices.empty())
+    {
+        output << "  none" << std::endl;
+    }
+}
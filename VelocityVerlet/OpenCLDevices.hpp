@@ -0,0 +1,50 @@
+#ifndef OPENCL_DEVICES_HPP_
+#define OPENCL_DEVICES_HPP_
+
+#define CL_HPP_ENABLE_EXCEPTIONS
+#define CL_HPP_TARGET_OPENCL_VERSION 220
+
+#include <CL/opencl.hpp>
+#include <cstdlib>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct OpenCLDevice
+{
+    cl::Platform platform;
+    cl::Device device;
+
+    std::string platform_name;
+    std::string name;
+    std::string type;
+    cl_uint compute_units;
+
+    // sub-devices point at the index of the device they were split from
+    bool is_sub_device;
+    std::size_t parent_index;
+
+    // false for a device that was split into sub-devices, using both would share hardware
+    bool is_leaf;
+};
+
+// every device of every platform, GPUs and CPUs alike. with sub_devices_per_device > 1 every
+// device that supports partitioning is also split into that many equal sub-devices
+std::vector<OpenCLDevice> enumerate_opencl_devices(std::size_t sub_devices_per_device);
+
+// the leaf devices, i.e. sub-devices instead of the device they were split from
+std::vector<std::size_t> get_leaf_device_indices(const std::vector<OpenCLDevice>& devices);
+
+// the platform of the selected device, otherwise the first platform. false without platforms
+bool select_opencl_platform(const std::optional<OpenCLDevice>& selected_device, cl::Platform& platform);
+
+// a context on the selected device, otherwise on the GPUs of platform
+cl::Context create_opencl_context(const cl::Platform& platform, const std::optional<OpenCLDevice>& selected_device);
+
+// the board name where the driver reports one, e.g. AMD, the device name otherwise
+std::string get_opencl_device_name(const cl::Device& device);
+
+void print_opencl_devices(const std::vector<OpenCLDevice>& devices, std::ostream& output);
+
+#endif // !OPENCL_DEVICES_HPP_
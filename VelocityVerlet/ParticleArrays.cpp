@@ -0,0 +1,54 @@
+#include "ParticleArrays.hpp"
+
+#include <algorithm>
+
+static std::size_t padded_count(std::size_t num_particles)
+{
+    return ((num_particles + PARTICLE_LANE_WIDTH - 1) / PARTICLE_LANE_WIDTH) * PARTICLE_LANE_WIDTH;
+}
+
+void VectorArrays::resize(std::size_t num_particles)
+{
+    const std::size_t padded_size = padded_count(num_particles);
+
+    x.resize(padded_size, 0.f);
+    y.resize(padded_size, 0.f);
+    z.resize(padded_size, 0.f);
+
+    m_size = num_particles;
+}
+
+void VectorArrays::assign(const std::vector<sf::Vector3f>& vectors)
+{
+    resize(vectors.size());
+
+    for (std::size_t i = 0; i < vectors.size(); ++i)
+    {
+        x[i] = vectors[i].x;
+        y[i] = vectors[i].y;
+        z[i] = vectors[i].z;
+    }
+}
+
+void VectorArrays::fill_zero()
+{
+    std::fill(x.begin(), x.end(), 0.f);
+    std::fill(y.begin(), y.end(), 0.f);
+    std::fill(z.begin(), z.end(), 0.f);
+}
+
+void ParticleArrays::resize(std::size_t num_particles)
+{
+    VectorArrays::resize(num_particles);
+
+    mass.resize(padded_size(), 0.f);
+}
+
+void ParticleArrays::assign(const std::vector<sf::Vector3f>& positions, const std::vector<float>& masses)
+{
+    VectorArrays::assign(positions);
+
+    mass.assign(padded_size(), 0.f);
+
+    std::copy(masses.begin(), masses.begin() + std::min(masses.size(), size()), mass.begin());
+}
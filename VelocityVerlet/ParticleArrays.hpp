@@ -0,0 +1,80 @@
+#ifndef PARTICLE_ARRAYS_HPP_
+#define PARTICLE_ARRAYS_HPP_
+
+#include "AlignedAllocator.hpp"
+
+#include <SFML/System/Vector3.hpp>
+#include <vector>
+
+// every lane is aligned to a cache line and padded to a multiple of the widest
+// SIMD register (16 floats), so kernels may always read whole registers
+constexpr std::size_t PARTICLE_LANE_ALIGNMENT = 64u;
+constexpr std::size_t PARTICLE_LANE_WIDTH = 16u;
+
+using ParticleLane = std::vector<float, AlignedAllocator<float, PARTICLE_LANE_ALIGNMENT>>;
+
+// structure of arrays storage for per-particle vectors such as velocities and forces
+class VectorArrays
+{
+private:
+    std::size_t m_size;
+
+public:
+    ParticleLane x;
+    ParticleLane y;
+    ParticleLane z;
+
+    VectorArrays()
+        : m_size(0u)
+    {}
+
+    explicit VectorArrays(std::size_t num_particles)
+        : m_size(0u)
+    {
+        resize(num_particles);
+    }
+
+    explicit VectorArrays(const std::vector<sf::Vector3f>& vectors)
+        : m_size(0u)
+    {
+        assign(vectors);
+    }
+
+    void resize(std::size_t num_particles);
+    void assign(const std::vector<sf::Vector3f>& vectors);
+    void fill_zero();
+
+    sf::Vector3f get(std::size_t i) const
+    {
+        return sf::Vector3f(x[i], y[i], z[i]);
+    }
+
+    std::size_t size() const
+    {
+        return m_size;
+    }
+
+    std::size_t padded_size() const
+    {
+        return x.size();
+    }
+};
+
+// positions and masses, the padding lanes have zero mass so they never contribute a force
+class ParticleArrays : public VectorArrays
+{
+public:
+    ParticleLane mass;
+
+    ParticleArrays() = default;
+
+    ParticleArrays(const std::vector<sf::Vector3f>& positions, const std::vector<float>& masses)
+    {
+        assign(positions, masses);
+    }
+
+    void resize(std::size_t num_particles);
+    void assign(const std::vector<sf::Vector3f>& positions, const std::vector<float>& masses);
+};
+
+#endif // !PARTICLE_ARRAYS_HPP_
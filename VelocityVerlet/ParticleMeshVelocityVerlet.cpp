@@ -0,0 +1,547 @@
+#include "ParticleMeshVelocityVerlet.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+
+static float square(float val)
+{
+    return val * val;
+}
+
+static std::size_t wrap(std::int64_t index, std::size_t size)
+{
+    const std::int64_t n = static_cast<std::int64_t>(size);
+
+    return static_cast<std::size_t>(((index % n) + n) % n);
+}
+
+static double sinc(double val)
+{
+    return (std::abs(val) < 1e-12) ? 1.0 : std::sin(val) / val;
+}
+
+// cloud-in-cell: lower cell index and weight of the upper cell along one axis
+static void cic_weights(float grid_coordinate, std::int64_t& lower, float& upper_weight)
+{
+    const float floored = std::floor(grid_coordinate);
+
+    lower = static_cast<std::int64_t>(floored);
+    upper_weight = grid_coordinate - floored;
+}
+
+void ParticleMeshVelocityVerlet::setup_mesh()
+{
+    if (m_boundary == MeshBoundary::Periodic)
+    {
+        m_mesh_origin = m_box_origin;
+        m_cell_size = m_box_size / static_cast<float>(m_grid_size);
+
+        return;
+    }
+
+    // the mesh follows the bounding box of the particles
+    sf::Vector3f min_corner(m_particles.x[0], m_particles.y[0], m_particles.z[0]);
+    sf::Vector3f max_corner = min_corner;
+
+    for (std::size_t i = 1; i < m_num_particles; ++i)
+    {
+        min_corner.x = std::min(min_corner.x, m_particles.x[i]);
+        min_corner.y = std::min(min_corner.y, m_particles.y[i]);
+        min_corner.z = std::min(min_corner.z, m_particles.z[i]);
+        max_corner.x = std::max(max_corner.x, m_particles.x[i]);
+        max_corner.y = std::max(max_corner.y, m_particles.y[i]);
+        max_corner.z = std::max(max_corner.z, m_particles.z[i]);
+    }
+
+    const float extent = std::max({ max_corner.x - min_corner.x, max_corner.y - min_corner.y, max_corner.z - min_corner.z, 1e-6f }) * 1.0001f;
+    const float required_cell_size = extent / static_cast<float>(m_grid_size - 2 * ISOLATED_MARGIN);
+
+    // keep the cell size, and the cached Green's function, while the box still fits with enough resolution
+    if ((required_cell_size > m_cell_size) || (required_cell_size < CELL_SHRINK_THRESHOLD * m_cell_size))
+    {
+        m_cell_size = required_cell_size * CELL_SIZE_HEADROOM;
+    }
+
+    // center the bounding box, the slack leaves at least ISOLATED_MARGIN empty cells on every side
+    const float half_mesh = 0.5f * static_cast<float>(m_grid_size) * m_cell_size;
+
+    m_mesh_origin = sf::Vector3f(0.5f * (min_corner.x + max_corner.x) - half_mesh,
+        0.5f * (min_corner.y + max_corner.y) - half_mesh,
+        0.5f * (min_corner.z + max_corner.z) - half_mesh);
+}
+
+void ParticleMeshVelocityVerlet::compute_green_function()
+{
+    // the kernel only depends on the cell size
+    if (m_cell_size == m_green_cell_size)
+    {
+        return;
+    }
+
+    m_green_cell_size = m_cell_size;
+
+    const double pi = std::acos(-1.0);
+    const double cell_size = m_cell_size;
+    const double split_radius = SPLIT_RADIUS_CELLS * cell_size;
+    const std::size_t n = m_fft_size;
+
+    m_green.assign(n * n * n, std::complex<double>(0.0, 0.0));
+
+    if (m_boundary == MeshBoundary::Isolated)
+    {
+        // long range part of 1/r in real space, evaluated at the minimum image distance
+        // of the zero padded grid: erf(r / 2 r_s) / r, which tends to 1 / (r_s sqrt(pi))
+        m_thread_pool.parallel_for(0, n, 1u,
+            [&](std::size_t begin, std::size_t end, std::size_t)
+            {
+                for (std::size_t z = begin; z < end; ++z)
+                {
+                    for (std::size_t y = 0; y < n; ++y)
+                    {
+                        for (std::size_t x = 0; x < n; ++x)
+                        {
+                            const double dx = static_cast<double>(std::min(x, n - x));
+                            const double dy = static_cast<double>(std::min(y, n - y));
+                            const double dz = static_cast<double>(std::min(z, n - z));
+
+                            const double distance = cell_size * std::sqrt(dx * dx + dy * dy + dz * dz);
+
+                            m_green[(z * n + y) * n + x] = (distance > 0.0)
+                                ? std::erf(distance / (2.0 * split_radius)) / distance
+                                : 1.0 / (split_radius * std::sqrt(pi));
+                        }
+                    }
+                }
+            });
+
+        m_fft.forward(m_green, m_thread_pool);
+    }
+
+    // the mesh holds masses: 4 pi / (h^3 k^2) exp(-k^2 r_s^2) for the periodic
+    // kernel, and for both kernels the cloud-in-cell window of the deposit and
+    // the interpolation is divided out
+    const double k_unit = 2.0 * pi / (static_cast<double>(n) * cell_size);
+
+    m_thread_pool.parallel_for(0, n, 1u,
+        [&](std::size_t begin, std::size_t end, std::size_t)
+        {
+            for (std::size_t z = begin; z < end; ++z)
+            {
+                for (std::size_t y = 0; y < n; ++y)
+                {
+                    for (std::size_t x = 0; x < n; ++x)
+                    {
+                        const double kx = k_unit * ((x <= n / 2) ? static_cast<double>(x) : static_cast<double>(x) - static_cast<double>(n));
+                        const double ky = k_unit * ((y <= n / 2) ? static_cast<double>(y) : static_cast<double>(y) - static_cast<double>(n));
+                        const double kz = k_unit * ((z <= n / 2) ? static_cast<double>(z) : static_cast<double>(z) - static_cast<double>(n));
+
+                        const double window = std::pow(sinc(0.5 * kx * cell_size) * sinc(0.5 * ky * cell_size) * sinc(0.5 * kz * cell_size), 2);
+
+                        std::complex<double>& green = m_green[(z * n + y) * n + x];
+
+                        if (m_boundary == MeshBoundary::Periodic)
+                        {
+                            const double sqr_k = kx * kx + ky * ky + kz * kz;
+
+                            // the k = 0 mode is the uniform background, which exerts no force
+                            green = (sqr_k > 0.0)
+                                ? 4.0 * pi / (cell_size * cell_size * cell_size * sqr_k) * std::exp(-sqr_k * split_radius * split_radius)
+                                : 0.0;
+                        }
+
+                        green /= window * window;
+                    }
+                }
+            }
+        });
+}
+
+void ParticleMeshVelocityVerlet::deposit_masses()
+{
+    const std::size_t n = m_fft_size;
+
+    std::fill(m_density.begin(), m_density.end(), std::complex<double>(0.0, 0.0));
+
+    for (std::size_t i = 0; i < m_num_particles; ++i)
+    {
+        // cell centered coordinates
+        std::int64_t lower[3];
+        float upper[3];
+
+        cic_weights((m_particles.x[i] - m_mesh_origin.x) / m_cell_size - 0.5f, lower[0], upper[0]);
+        cic_weights((m_particles.y[i] - m_mesh_origin.y) / m_cell_size - 0.5f, lower[1], upper[1]);
+        cic_weights((m_particles.z[i] - m_mesh_origin.z) / m_cell_size - 0.5f, lower[2], upper[2]);
+
+        for (std::size_t corner = 0; corner < 8; ++corner)
+        {
+            float weight = m_particles.mass[i];
+            std::size_t cell[3];
+
+            for (std::size_t axis = 0; axis < 3; ++axis)
+            {
+                const std::size_t offset = (corner >> axis) & 1u;
+
+                weight *= offset ? upper[axis] : 1.f - upper[axis];
+
+                // isolated meshes keep a margin so only periodic ones wrap
+                cell[axis] = wrap(lower[axis] + static_cast<std::int64_t>(offset), m_grid_size);
+            }
+
+            m_density[(cell[2] * n + cell[1]) * n + cell[0]] += weight;
+        }
+    }
+}
+
+void ParticleMeshVelocityVerlet::solve_potential()
+{
+    const std::size_t n = m_fft_size;
+
+    m_fft.forward(m_density, m_thread_pool);
+
+    m_thread_pool.parallel_for(0, m_density.size(), 1u << 16,
+        [this](std::size_t begin, std::size_t end, std::size_t)
+        {
+            for (std::size_t i = begin; i < end; ++i)
+            {
+                m_density[i] *= m_green[i];
+            }
+        });
+
+    m_fft.inverse(m_density, m_thread_pool);
+
+    // only the mesh part of a zero padded grid holds the physical potential
+    for (std::size_t z = 0; z < m_grid_size; ++z)
+    {
+        for (std::size_t y = 0; y < m_grid_size; ++y)
+        {
+            for (std::size_t x = 0; x < m_grid_size; ++x)
+            {
+                m_potential[(z * m_grid_size + y) * m_grid_size + x] = static_cast<float>(m_density[(z * n + y) * n + x].real());
+            }
+        }
+    }
+}
+
+void ParticleMeshVelocityVerlet::interpolate_forces()
+{
+    const std::size_t g = m_grid_size;
+
+    auto potential = [this, g](std::int64_t x, std::int64_t y, std::int64_t z)
+    {
+        return m_potential[(wrap(z, g) * g + wrap(y, g)) * g + wrap(x, g)];
+    };
+
+    m_thread_pool.parallel_for(0, m_num_particles, GRAIN_SIZE,
+        [this, &potential](std::size_t begin, std::size_t end, std::size_t)
+        {
+            const float inv_two_cells = 0.5f / m_cell_size;
+
+            for (std::size_t i = begin; i < end; ++i)
+            {
+                std::int64_t lower[3];
+                float upper[3];
+
+                cic_weights((m_particles.x[i] - m_mesh_origin.x) / m_cell_size - 0.5f, lower[0], upper[0]);
+                cic_weights((m_particles.y[i] - m_mesh_origin.y) / m_cell_size - 0.5f, lower[1], upper[1]);
+                cic_weights((m_particles.z[i] - m_mesh_origin.z) / m_cell_size - 0.5f, lower[2], upper[2]);
+
+                float gradient[3] = { 0.f, 0.f, 0.f };
+
+                for (std::size_t corner = 0; corner < 8; ++corner)
+                {
+                    float weight = 1.f;
+                    std::int64_t cell[3];
+
+                    for (std::size_t axis = 0; axis < 3; ++axis)
+                    {
+                        const std::int64_t offset = (corner >> axis) & 1u;
+
+                        weight *= offset ? upper[axis] : 1.f - upper[axis];
+                        cell[axis] = lower[axis] + offset;
+                    }
+
+                    // central differences of the mesh potential
+                    gradient[0] += weight * (potential(cell[0] + 1, cell[1], cell[2]) - potential(cell[0] - 1, cell[1], cell[2]));
+                    gradient[1] += weight * (potential(cell[0], cell[1] + 1, cell[2]) - potential(cell[0], cell[1] - 1, cell[2]));
+                    gradient[2] += weight * (potential(cell[0], cell[1], cell[2] + 1) - potential(cell[0], cell[1], cell[2] - 1));
+                }
+
+                m_new_forces.x[i] = m_particles.mass[i] * gradient[0] * inv_two_cells;
+                m_new_forces.y[i] = m_particles.mass[i] * gradient[1] * inv_two_cells;
+                m_new_forces.z[i] = m_particles.mass[i] * gradient[2] * inv_two_cells;
+            }
+        });
+}
+
+void ParticleMeshVelocityVerlet::compute_short_range_forces()
+{
+    const float split_radius = SPLIT_RADIUS_CELLS * m_cell_size;
+    const float cutoff = SHORT_RANGE_CUTOFF * split_radius;
+    const bool periodic = (m_boundary == MeshBoundary::Periodic);
+
+    // chaining mesh with cells of at least the cutoff
+    if (periodic)
+    {
+        m_chain_origin = m_box_origin;
+        m_chain_size = std::max<std::size_t>(1u, static_cast<std::size_t>(m_box_size / cutoff));
+        m_chain_cell_size = m_box_size / static_cast<float>(m_chain_size);
+    }
+    else
+    {
+        const float extent = static_cast<float>(m_grid_size) * m_cell_size;
+
+        m_chain_origin = m_mesh_origin;
+        m_chain_size = std::max<std::size_t>(1u, static_cast<std::size_t>(extent / cutoff));
+        m_chain_cell_size = extent / static_cast<float>(m_chain_size);
+    }
+
+    const std::size_t c = m_chain_size;
+
+    auto chain_coordinate = [this, c](float position, float origin)
+    {
+        const std::int64_t cell = static_cast<std::int64_t>((position - origin) / m_chain_cell_size);
+
+        return static_cast<std::size_t>(std::min<std::int64_t>(std::max<std::int64_t>(cell, 0), static_cast<std::int64_t>(c) - 1));
+    };
+
+    std::vector<std::uint32_t> cell_of_particle(m_num_particles);
+
+    m_chain_offsets.assign(c * c * c + 1, 0u);
+    m_chain_order.resize(m_num_particles);
+
+    for (std::size_t i = 0; i < m_num_particles; ++i)
+    {
+        const std::size_t cell = (chain_coordinate(m_particles.z[i], m_chain_origin.z) * c
+            + chain_coordinate(m_particles.y[i], m_chain_origin.y)) * c
+            + chain_coordinate(m_particles.x[i], m_chain_origin.x);
+
+        cell_of_particle[i] = static_cast<std::uint32_t>(cell);
+        ++m_chain_offsets[cell + 1];
+    }
+
+    for (std::size_t cell = 1; cell < m_chain_offsets.size(); ++cell)
+    {
+        m_chain_offsets[cell] += m_chain_offsets[cell - 1];
+    }
+
+    std::vector<std::uint32_t> cursor(m_chain_offsets.begin(), m_chain_offsets.end() - 1);
+
+    for (std::size_t i = 0; i < m_num_particles; ++i)
+    {
+        m_chain_order[cursor[cell_of_particle[i]]++] = static_cast<std::uint32_t>(i);
+    }
+
+    const float sqr_cutoff = square(cutoff);
+    const float inv_two_split_radius = 0.5f / split_radius;
+    const float gaussian_factor = 1.f / (split_radius * std::sqrt(std::acos(-1.f)));
+
+    m_thread_pool.parallel_for(0, m_num_particles, GRAIN_SIZE,
+        [&, c, periodic](std::size_t begin, std::size_t end, std::size_t)
+        {
+            std::vector<std::size_t> neighbours;
+
+            for (std::size_t me = begin; me < end; ++me)
+            {
+                const std::int64_t x = static_cast<std::int64_t>(cell_of_particle[me] % c);
+                const std::int64_t y = static_cast<std::int64_t>((cell_of_particle[me] / c) % c);
+                const std::int64_t z = static_cast<std::int64_t>(cell_of_particle[me] / (c * c));
+
+                // neighbouring cells, de-duplicated for chaining meshes of fewer than 3 cells
+                neighbours.clear();
+
+                for (std::int64_t dz = -1; dz <= 1; ++dz)
+                {
+                    for (std::int64_t dy = -1; dy <= 1; ++dy)
+                    {
+                        for (std::int64_t dx = -1; dx <= 1; ++dx)
+                        {
+                            std::int64_t cx = x + dx;
+                            std::int64_t cy = y + dy;
+                            std::int64_t cz = z + dz;
+
+                            if (periodic)
+                            {
+                                cx = static_cast<std::int64_t>(wrap(cx, c));
+                                cy = static_cast<std::int64_t>(wrap(cy, c));
+                                cz = static_cast<std::int64_t>(wrap(cz, c));
+                            }
+                            else if ((cx < 0) || (cy < 0) || (cz < 0) || (cx >= static_cast<std::int64_t>(c)) || (cy >= static_cast<std::int64_t>(c)) || (cz >= static_cast<std::int64_t>(c)))
+                            {
+                                continue;
+                            }
+
+                            neighbours.push_back(static_cast<std::size_t>((cz * static_cast<std::int64_t>(c) + cy) * static_cast<std::int64_t>(c) + cx));
+                        }
+                    }
+                }
+
+                std::sort(neighbours.begin(), neighbours.end());
+                neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+
+                float force_x = 0.f;
+                float force_y = 0.f;
+                float force_z = 0.f;
+
+                for (std::size_t cell : neighbours)
+                {
+                    for (std::uint32_t k = m_chain_offsets[cell]; k < m_chain_offsets[cell + 1]; ++k)
+                    {
+                        const std::uint32_t other = m_chain_order[k];
+
+                        float diff_x = m_particles.x[other] - m_particles.x[me];
+                        float diff_y = m_particles.y[other] - m_particles.y[me];
+                        float diff_z = m_particles.z[other] - m_particles.z[me];
+
+                        if (periodic)
+                        {
+                            // minimum image
+                            diff_x -= m_box_size * std::round(diff_x / m_box_size);
+                            diff_y -= m_box_size * std::round(diff_y / m_box_size);
+                            diff_z -= m_box_size * std::round(diff_z / m_box_size);
+                        }
+
+                        const float sqr_distance = square(diff_x) + square(diff_y) + square(diff_z);
+
+                        if ((sqr_distance > 0.f) && (sqr_distance < sqr_cutoff))
+                        {
+                            // -d/dr of erfc(r / 2 r_s) / r, the part of 1/r the mesh does not resolve
+                            const float distance = std::sqrt(sqr_distance);
+                            const float shape = std::erfc(distance * inv_two_split_radius)
+                                + distance * gaussian_factor * std::exp(-sqr_distance * square(inv_two_split_radius));
+
+                            const float gravity = m_particles.mass[me] * m_particles.mass[other] * shape / (distance * sqr_distance);
+
+                            force_x += gravity * diff_x;
+                            force_y += gravity * diff_y;
+                            force_z += gravity * diff_z;
+                        }
+                    }
+                }
+
+                m_new_forces.x[me] += force_x;
+                m_new_forces.y[me] += force_y;
+                m_new_forces.z[me] += force_z;
+            }
+        });
+}
+
+void ParticleMeshVelocityVerlet::compute_forces()
+{
+    if (m_num_particles == 0)
+    {
+        return;
+    }
+
+    setup_mesh();
+    compute_green_function();
+    deposit_masses();
+    solve_potential();
+    interpolate_forces();
+
+    if (m_short_range_correction)
+    {
+        compute_short_range_forces();
+    }
+}
+
+void ParticleMeshVelocityVerlet::update_positions()
+{
+    const bool periodic = (m_boundary == MeshBoundary::Periodic);
+
+    m_thread_pool.parallel_for(0, m_num_particles, GRAIN_SIZE,
+        [this, periodic](std::size_t begin, std::size_t end, std::size_t)
+        {
+            for (std::size_t i = begin; i < end; ++i)
+            {
+                float acceleration = m_time_step * 0.5f / m_particles.mass[i];
+
+                m_particles.x[i] += m_time_step * (m_velocities.x[i] + acceleration * m_new_forces.x[i]);
+                m_particles.y[i] += m_time_step * (m_velocities.y[i] + acceleration * m_new_forces.y[i]);
+                m_particles.z[i] += m_time_step * (m_velocities.z[i] + acceleration * m_new_forces.z[i]);
+
+                if (periodic)
+                {
+                    m_particles.x[i] -= m_box_size * std::floor((m_particles.x[i] - m_box_origin.x) / m_box_size);
+                    m_particles.y[i] -= m_box_size * std::floor((m_particles.y[i] - m_box_origin.y) / m_box_size);
+                    m_particles.z[i] -= m_box_size * std::floor((m_particles.z[i] - m_box_origin.z) / m_box_size);
+                }
+            }
+        });
+
+    std::swap(m_old_forces, m_new_forces);
+}
+
+void ParticleMeshVelocityVerlet::update_velocities()
+{
+    m_thread_pool.parallel_for(0, m_num_particles, GRAIN_SIZE,
+        [this](std::size_t begin, std::size_t end, std::size_t)
+        {
+            for (std::size_t i = begin; i < end; ++i)
+            {
+                float acceleration = m_time_step * 0.5f / m_particles.mass[i];
+
+                m_velocities.x[i] += acceleration * (m_new_forces.x[i] + m_old_forces.x[i]);
+                m_velocities.y[i] += acceleration * (m_new_forces.y[i] + m_old_forces.y[i]);
+                m_velocities.z[i] += acceleration * (m_new_forces.z[i] + m_old_forces.z[i]);
+            }
+        });
+}
+
+void ParticleMeshVelocityVerlet::initialize()
+{
+    if ((m_boundary == MeshBoundary::Isolated) && (m_grid_size <= 2 * ISOLATED_MARGIN))
+    {
+        throw std::string("Particle mesh is too small for isolated boundaries");
+    }
+
+    if (m_boundary == MeshBoundary::Periodic)
+    {
+        for (std::size_t i = 0; i < m_num_particles; ++i)
+        {
+            m_particles.x[i] -= m_box_size * std::floor((m_particles.x[i] - m_box_origin.x) / m_box_size);
+            m_particles.y[i] -= m_box_size * std::floor((m_particles.y[i] - m_box_origin.y) / m_box_size);
+            m_particles.z[i] -= m_box_size * std::floor((m_particles.z[i] - m_box_origin.z) / m_box_size);
+        }
+    }
+
+    const std::size_t n = m_fft_size;
+
+    m_density.assign(n * n * n, std::complex<double>(0.0, 0.0));
+    m_potential.assign(m_grid_size * m_grid_size * m_grid_size, 0.f);
+
+    std::cout << std::endl << "PM mesh            : " << m_grid_size << "^3" << std::endl;
+    std::cout << "PM FFT grid        : " << m_fft_size << "^3" << std::endl;
+    std::cout << "PM boundaries      : " << ((m_boundary == MeshBoundary::Periodic) ? "periodic" : "isolated") << std::endl;
+    std::cout << "PM short range (P3M): " << (m_short_range_correction ? "on" : "off") << std::endl;
+}
+
+void ParticleMeshVelocityVerlet::run(std::vector<sf::Vertex>& vertices)
+{
+    if (m_density.empty())
+    {
+        initialize();
+    }
+
+    // the forces at the end of a step are the forces at the start of the next one,
+    // so apart from the very first step there is one force evaluation per step
+    if (!m_forces_computed)
+    {
+        compute_forces();
+        m_forces_computed = true;
+    }
+
+    // half kick and drift
+    update_positions();
+    compute_forces();
+    // closing half kick with the new forces
+    update_velocities();
+
+    vertices.resize(m_num_particles);
+
+    for (std::size_t i = 0; i < m_num_particles; ++i)
+    {
+        vertices[i] = sf::Vertex(sf::Vector2f(m_particles.x[i], m_particles.y[i]));
+    }
+}
@@ -0,0 +1,138 @@
+#ifndef PARTICLE_MESH_VELOCITY_VERLET_HPP_
+#define PARTICLE_MESH_VELOCITY_VERLET_HPP_
+
+#include "FastFourierTransform.hpp"
+#include "IAlgorithmStrategy.hpp"
+#include "ParticleArrays.hpp"
+#include "ThreadPool.hpp"
+
+#include <complex>
+#include <cstdint>
+#include <SFML/System/Vector3.hpp>
+#include <thread>
+#include <vector>
+
+enum class MeshBoundary
+{
+    // vacuum boundaries, the mesh follows the bounding box and is zero padded to twice its size
+    Isolated,
+
+    // the box [box_origin, box_origin + box_size)^3 is repeated in every direction
+    Periodic
+};
+
+// Particle-mesh gravity: cloud-in-cell deposit, FFT Poisson solve with a
+// Gaussian split of the 1/r kernel and cloud-in-cell force interpolation.
+// With the short-range correction (P3M) the complementary erfc part of the
+// kernel is summed directly over neighbours found with a chaining mesh.
+class ParticleMeshVelocityVerlet : public IAlgorithmStrategy
+{
+private:
+    // split radius of the long/short range kernels in mesh cells
+    const float SPLIT_RADIUS_CELLS = 1.25f;
+
+    // the short-range force is below 1e-3 of the Newtonian one beyond this many split radii
+    const float SHORT_RANGE_CUTOFF = 5.f;
+
+    // empty cells around the bounding box in isolated mode, keeps the stencils inside the mesh
+    const std::size_t ISOLATED_MARGIN = 2u;
+
+    // isolated meshes are sized with this much slack, so the cell size and with it the
+    // Green's function only change once the bounding box grows past the slack or
+    // shrinks below CELL_SHRINK_THRESHOLD of the cell size
+    const float CELL_SIZE_HEADROOM = 1.25f;
+    const float CELL_SHRINK_THRESHOLD = 0.5f;
+
+    const std::size_t GRAIN_SIZE = 1024u;
+
+    void setup_mesh();
+    void compute_green_function();
+    void deposit_masses();
+    void solve_potential();
+    void interpolate_forces();
+    void compute_short_range_forces();
+    void compute_forces();
+    void update_positions();
+    void update_velocities();
+
+    ThreadPool m_thread_pool;
+
+    ParticleArrays m_particles;
+    VectorArrays   m_velocities;
+    VectorArrays   m_old_forces;
+    VectorArrays   m_new_forces;
+
+    // m_new_forces holds the forces at the current positions
+    bool m_forces_computed;
+
+    MeshBoundary m_boundary;
+    bool m_short_range_correction;
+
+    // mesh of m_grid_size^3 cells, solved on a FFT grid of m_fft_size^3
+    std::size_t m_grid_size;
+    std::size_t m_fft_size;
+    FastFourierTransform3D m_fft;
+
+    sf::Vector3f m_box_origin;
+    float m_box_size;
+
+    sf::Vector3f m_mesh_origin;
+    float m_cell_size;
+    float m_green_cell_size;
+
+    std::vector<std::complex<double>> m_density;
+    std::vector<std::complex<double>> m_green;
+    std::vector<float> m_potential;
+
+    // chaining mesh for the short-range pairs
+    std::size_t m_chain_size;
+    float m_chain_cell_size;
+    sf::Vector3f m_chain_origin;
+    std::vector<std::uint32_t> m_chain_offsets;
+    std::vector<std::uint32_t> m_chain_order;
+
+    float m_time_step;
+    std::size_t m_num_particles;
+
+public:
+    ParticleMeshVelocityVerlet(std::size_t num_particles,
+        float time_step,
+        std::vector<sf::Vector3f> positions,
+        std::vector<sf::Vector3f> velocities,
+        std::vector<float> masses,
+        std::size_t grid_size = 64u,
+        MeshBoundary boundary = MeshBoundary::Isolated,
+        bool short_range_correction = false,
+        sf::Vector3f box_origin = sf::Vector3f(0.f, 0.f, 0.f),
+        float box_size = 1000.f,
+        std::size_t num_threads = std::thread::hardware_concurrency())
+        : m_num_particles(num_particles),
+        m_time_step(time_step),
+        m_particles(positions, masses),
+        m_velocities(velocities),
+        m_old_forces(num_particles),
+        m_new_forces(num_particles),
+        m_forces_computed(false),
+        m_boundary(boundary),
+        m_short_range_correction(short_range_correction),
+        m_grid_size(grid_size),
+        m_fft_size((boundary == MeshBoundary::Isolated) ? 2u * grid_size : grid_size),
+        m_fft(m_fft_size),
+        m_box_origin(box_origin),
+        m_box_size(box_size),
+        m_cell_size(0.f),
+        m_green_cell_size(0.f),
+        m_chain_size(0u),
+        m_chain_cell_size(0.f),
+        m_thread_pool(num_threads)
+    {}
+
+    ~ParticleMeshVelocityVerlet()
+    {}
+
+    void initialize() override;
+
+    void run(std::vector<sf::Vertex>& vertices) override;
+};
+
+#endif // !PARTICLE_MESH_VELOCITY_VERLET_HPP_
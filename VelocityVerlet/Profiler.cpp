@@ -0,0 +1,239 @@
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+Profiler::Profiler()
+    : m_epoch(std::chrono::steady_clock::now()),
+    m_device_offset_seconds(0.0),
+    m_frame(0u),
+    m_frame_totals{},
+    m_history_size(0u),
+    m_history_next(0u),
+    m_num_discarded_events(0u)
+{
+    for (std::vector<double>& history : m_history)
+    {
+        history.resize(ROLLING_WINDOW, 0.0);
+    }
+}
+
+double Profiler::now() const
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_epoch).count();
+}
+
+void Profiler::add_event(ProfilePhase phase, ProfileTrack track, double start_seconds, double duration_seconds)
+{
+    m_frame_totals[static_cast<std::size_t>(phase)] += duration_seconds;
+
+    if (m_events.size() < MAX_EVENTS)
+    {
+        m_events.push_back({ phase, track, m_frame, start_seconds, duration_seconds });
+    }
+    else
+    {
+        ++m_num_discarded_events;
+    }
+}
+
+void Profiler::record(ProfilePhase phase, double start_seconds, double duration_seconds)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    add_event(phase, ProfileTrack::Host, start_seconds, duration_seconds);
+}
+
+void Profiler::record_device(ProfilePhase phase, std::uint64_t start_ns, std::uint64_t end_ns)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    const double start_seconds = 1e-9 * static_cast<double>(start_ns) + m_device_offset_seconds;
+    const double duration_seconds = 1e-9 * static_cast<double>(end_ns - start_ns);
+
+    add_event(phase, ProfileTrack::Device, start_seconds, duration_seconds);
+}
+
+void Profiler::synchronize_device_clock(std::uint64_t device_ns)
+{
+    const double host_seconds = now();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // the event may have finished a little earlier, so the device track can lag slightly
+    m_device_offset_seconds = host_seconds - 1e-9 * static_cast<double>(device_ns);
+}
+
+void Profiler::end_frame()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (std::size_t phase = 0; phase < PROFILE_PHASE_COUNT; ++phase)
+    {
+        m_history[phase][m_history_next] = m_frame_totals[phase];
+        m_frame_totals[phase] = 0.0;
+    }
+
+    m_history_next = (m_history_next + 1) % ROLLING_WINDOW;
+    m_history_size = std::min(m_history_size + 1, ROLLING_WINDOW);
+
+    ++m_frame;
+}
+
+ProfileStatistics Profiler::get_statistics(ProfilePhase phase) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return compute_statistics(phase);
+}
+
+ProfileStatistics Profiler::compute_statistics(ProfilePhase phase) const
+{
+    const std::vector<double>& history = m_history[static_cast<std::size_t>(phase)];
+
+    ProfileStatistics statistics = {};
+
+    statistics.num_frames = m_history_size;
+
+    if (m_history_size == 0)
+    {
+        return statistics;
+    }
+
+    statistics.last_seconds = history[(m_history_next + ROLLING_WINDOW - 1) % ROLLING_WINDOW];
+    statistics.min_seconds = history[0];
+    statistics.max_seconds = history[0];
+
+    double sum = 0.0;
+
+    for (std::size_t i = 0; i < m_history_size; ++i)
+    {
+        sum += history[i];
+        statistics.min_seconds = std::min(statistics.min_seconds, history[i]);
+        statistics.max_seconds = std::max(statistics.max_seconds, history[i]);
+    }
+
+    statistics.mean_seconds = sum / static_cast<double>(m_history_size);
+
+    return statistics;
+}
+
+const char* Profiler::get_phase_name(ProfilePhase phase)
+{
+    switch (phase)
+    {
+    case ProfilePhase::Force:
+        return "force";
+    case ProfilePhase::Drift:
+        return "drift";
+    case ProfilePhase::Kick:
+        return "kick";
+    case ProfilePhase::Transfer:
+        return "transfer";
+    case ProfilePhase::VertexConversion:
+        return "vertex conversion";
+    case ProfilePhase::Upload:
+        return "upload";
+    case ProfilePhase::Draw:
+        return "draw";
+    }
+
+    return "unknown";
+}
+
+void Profiler::print_statistics(std::ostream& output) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    output << std::left << std::setw(20) << "phase"
+        << std::right << std::setw(10) << "last ms"
+        << std::setw(10) << "mean ms"
+        << std::setw(10) << "max ms" << std::endl;
+
+    for (std::size_t i = 0; i < PROFILE_PHASE_COUNT; ++i)
+    {
+        const ProfilePhase phase = static_cast<ProfilePhase>(i);
+        const ProfileStatistics statistics = compute_statistics(phase);
+
+        output << std::left << std::setw(20) << get_phase_name(phase)
+            << std::right << std::fixed << std::setprecision(3)
+            << std::setw(10) << statistics.last_seconds * 1e3
+            << std::setw(10) << statistics.mean_seconds * 1e3
+            << std::setw(10) << statistics.max_seconds * 1e3
+            << std::defaultfloat << std::endl;
+    }
+}
+
+void Profiler::write_csv(std::ostream& output) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    output << "frame,phase,track,start_us,duration_us" << std::endl;
+    output << std::fixed << std::setprecision(3);
+
+    for (const ProfileEvent& event : m_events)
+    {
+        output << event.frame << ','
+            << get_phase_name(event.phase) << ','
+            << ((event.track == ProfileTrack::Host) ? "host" : "device") << ','
+            << event.start_seconds * 1e6 << ','
+            << event.duration_seconds * 1e6 << std::endl;
+    }
+
+    output << std::defaultfloat;
+}
+
+void Profiler::write_chrome_trace(std::ostream& output) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    output << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" << std::endl;
+    output << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"host\"}}," << std::endl;
+    output << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"device\"}}";
+    output << std::fixed << std::setprecision(3);
+
+    for (const ProfileEvent& event : m_events)
+    {
+        // complete events, timestamps in microseconds
+        output << ',' << std::endl
+            << "{\"name\":\"" << get_phase_name(event.phase)
+            << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << ((event.track == ProfileTrack::Host) ? 1 : 2)
+            << ",\"ts\":" << event.start_seconds * 1e6
+            << ",\"dur\":" << event.duration_seconds * 1e6
+            << ",\"args\":{\"frame\":" << event.frame << "}}";
+    }
+
+    output << std::defaultfloat << std::endl << "]}" << std::endl;
+}
+
+bool Profiler::export_file(const std::string& file_name) const
+{
+    std::ofstream file(file_name);
+
+    if (!file)
+    {
+        return false;
+    }
+
+    const std::string extension = ".json";
+
+    if ((file_name.size() >= extension.size())
+        && (file_name.compare(file_name.size() - extension.size(), extension.size(), extension) == 0))
+    {
+        write_chrome_trace(file);
+    }
+    else
+    {
+        write_csv(file);
+    }
+
+    if (m_num_discarded_events > 0)
+    {
+        std::cout << "Profiler kept the first " << m_events.size() << " events, "
+            << m_num_discarded_events << " more were only counted in the statistics" << std::endl;
+    }
+
+    return static_cast<bool>(file);
+}
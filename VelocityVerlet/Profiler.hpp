@@ -0,0 +1,142 @@
+#ifndef PROFILER_HPP_
+#define PROFILER_HPP_
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+enum class ProfilePhase
+{
+    Force,
+    Drift,
+    Kick,
+    Transfer,
+    VertexConversion,
+    Upload,
+    Draw
+};
+
+constexpr std::size_t PROFILE_PHASE_COUNT = 7u;
+
+enum class ProfileTrack
+{
+    Host,
+    Device
+};
+
+struct ProfileEvent
+{
+    ProfilePhase phase;
+    ProfileTrack track;
+    std::uint64_t frame;
+
+    // seconds since the profiler was created, device times are mapped onto the host clock
+    double start_seconds;
+    double duration_seconds;
+};
+
+// statistics of the per-frame totals of a phase over the rolling window
+struct ProfileStatistics
+{
+    std::size_t num_frames;
+    double last_seconds;
+    double mean_seconds;
+    double min_seconds;
+    double max_seconds;
+};
+
+// collects per-phase durations from CPU timers and OpenCL profiling events. the
+// durations of a frame are summed per phase and kept for the last ROLLING_WINDOW frames,
+// every single event is also kept (up to MAX_EVENTS) for the CSV and trace export.
+// phases may be recorded from the simulation and the render thread at the same time
+class Profiler
+{
+private:
+    const std::size_t ROLLING_WINDOW = 120u;
+    const std::size_t MAX_EVENTS = 1000000u;
+
+    std::chrono::steady_clock::time_point m_epoch;
+
+    // host seconds minus device seconds, refreshed whenever the host waits on a device event
+    double m_device_offset_seconds;
+
+    std::uint64_t m_frame;
+    std::array<double, PROFILE_PHASE_COUNT> m_frame_totals;
+    std::array<std::vector<double>, PROFILE_PHASE_COUNT> m_history;
+    std::size_t m_history_size;
+    std::size_t m_history_next;
+
+    std::vector<ProfileEvent> m_events;
+    std::size_t m_num_discarded_events;
+
+    mutable std::mutex m_mutex;
+
+    ProfileStatistics compute_statistics(ProfilePhase phase) const;
+
+    void add_event(ProfilePhase phase, ProfileTrack track, double start_seconds, double duration_seconds);
+
+public:
+    Profiler();
+
+    // seconds since the profiler was created
+    double now() const;
+
+    void record(ProfilePhase phase, double start_seconds, double duration_seconds);
+
+    // start and end are OpenCL profiling timestamps in nanoseconds
+    void record_device(ProfilePhase phase, std::uint64_t start_ns, std::uint64_t end_ns);
+
+    // call right after waiting for a device event, with the event's end timestamp
+    void synchronize_device_clock(std::uint64_t device_ns);
+
+    // moves the totals of the current frame into the rolling window
+    void end_frame();
+
+    ProfileStatistics get_statistics(ProfilePhase phase) const;
+
+    static const char* get_phase_name(ProfilePhase phase);
+
+    void print_statistics(std::ostream& output) const;
+
+    void write_csv(std::ostream& output) const;
+
+    // the Chrome trace event format, loads in chrome://tracing and Perfetto
+    void write_chrome_trace(std::ostream& output) const;
+
+    // writes a Chrome trace for .json files and CSV otherwise
+    bool export_file(const std::string& file_name) const;
+};
+
+// times the enclosing scope, does nothing when the profiler is null
+class ProfileScope
+{
+private:
+    Profiler* m_profiler;
+    ProfilePhase m_phase;
+    double m_start_seconds;
+
+public:
+    ProfileScope(Profiler* profiler, ProfilePhase phase)
+        : m_profiler(profiler),
+        m_phase(phase),
+        m_start_seconds((profiler != nullptr) ? profiler->now() : 0.0)
+    {}
+
+    ~ProfileScope()
+    {
+        if (m_profiler != nullptr)
+        {
+            m_profiler->record(m_phase, m_start_seconds, m_profiler->now() - m_start_seconds);
+        }
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+};
+
+#endif // !PROFILER_HPP_
@@ -0,0 +1,216 @@
+#include "ProgramBinaryCache.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+std::string ProgramBinaryCache::hash(const std::string& text)
+{
+    std::uint64_t value = 14695981039346656037ull;
+
+    for (unsigned char c : text)
+    {
+        value ^= c;
+        value *= 1099511628211ull;
+    }
+
+    std::stringstream stream;
+    stream << std::hex << std::setw(16) << std::setfill('0') << value;
+
+    return stream.str();
+}
+
+std::string ProgramBinaryCache::make_key(const std::string& source,
+    const std::string& build_options,
+    const std::string& device_name,
+    const std::string& driver_version)
+{
+    // one field per line, the full key is stored with the binary and compared on load
+    return "source " + hash(source) + "\n"
+        + "options " + build_options + "\n"
+        + "device " + device_name + "\n"
+        + "driver " + driver_version + "\n";
+}
+
+std::string ProgramBinaryCache::get_file_name(const std::string& key) const
+{
+    return (std::filesystem::path(m_directory) / (hash(key) + ".bin")).string();
+}
+
+bool ProgramBinaryCache::load(const std::string& key, std::vector<unsigned char>& binary) const
+{
+    std::ifstream file(get_file_name(key), std::ios::binary);
+
+    if (!file)
+    {
+        return false;
+    }
+
+    std::string magic(FILE_MAGIC.size(), '\0');
+    std::uint64_t key_size = 0;
+    std::uint64_t binary_size = 0;
+
+    file.read(&magic[0], magic.size());
+    file.read(reinterpret_cast<char*>(&key_size), sizeof(key_size));
+
+    if (!file || (magic != FILE_MAGIC) || (key_size != key.size()))
+    {
+        return false;
+    }
+
+    std::string stored_key(key_size, '\0');
+
+    file.read(&stored_key[0], stored_key.size());
+    file.read(reinterpret_cast<char*>(&binary_size), sizeof(binary_size));
+
+    // stale entry, e.g. a different driver version that happens to share the file name
+    if (!file || (stored_key != key) || (binary_size == 0))
+    {
+        return false;
+    }
+
+    binary.resize(binary_size);
+    file.read(reinterpret_cast<char*>(binary.data()), binary.size());
+
+    return static_cast<bool>(file);
+}
+
+bool ProgramBinaryCache::store(const std::string& key, const std::vector<unsigned char>& binary) const
+{
+    if (binary.empty())
+    {
+        return false;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(m_directory, error);
+
+    if (error)
+    {
+        return false;
+    }
+
+    const std::string file_name = get_file_name(key);
+    const std::string temp_file_name = file_name + ".tmp";
+
+    {
+        std::ofstream file(temp_file_name, std::ios::binary | std::ios::trunc);
+
+        const std::uint64_t key_size = key.size();
+        const std::uint64_t binary_size = binary.size();
+
+        file.write(FILE_MAGIC.data(), FILE_MAGIC.size());
+        file.write(reinterpret_cast<const char*>(&key_size), sizeof(key_size));
+        file.write(key.data(), key.size());
+        file.write(reinterpret_cast<const char*>(&binary_size), sizeof(binary_size));
+        file.write(reinterpret_cast<const char*>(binary.data()), binary.size());
+
+        if (!file)
+        {
+            return false;
+        }
+    }
+
+    // replace the old entry in one step so a concurrent launch never reads a partial file
+    std::filesystem::rename(temp_file_name, file_name, error);
+
+    if (error)
+    {
+        std::remove(temp_file_name.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool read_kernel_sources(const std::vector<std::string>& file_names, std::string& source)
+{
+    std::stringstream buffer;
+
+    for (const std::string& file_name : file_names)
+    {
+        std::ifstream file_stream(file_name);
+
+        if (!file_stream)
+        {
+            std::cout << "Failed to open " << file_name << std::endl;
+            return false;
+        }
+
+        buffer << file_stream.rdbuf() << std::endl;
+    }
+
+    source = buffer.str();
+
+    return true;
+}
+
+cl::Program build_cached_program(const cl::Context& context,
+    const cl::Device& device,
+    const std::string& source,
+    const std::string& build_options,
+    const std::string& cache_directory,
+    bool* from_cache)
+{
+    const ProgramBinaryCache cache(cache_directory);
+    const std::string cache_key = ProgramBinaryCache::make_key(source,
+        build_options,
+        device.getInfo<CL_DEVICE_NAME>(),
+        device.getInfo<CL_DRIVER_VERSION>());
+
+    std::vector<unsigned char> binary;
+
+    if (from_cache != nullptr)
+    {
+        *from_cache = false;
+    }
+
+    if (cache.load(cache_key, binary))
+    {
+        try
+        {
+            cl::Program program(context, { device }, { binary });
+            program.build(device, build_options.data());
+
+            if (from_cache != nullptr)
+            {
+                *from_cache = true;
+            }
+
+            return program;
+        }
+        catch (const cl::Error&)
+        {
+            // the runtime rejected the binary, rebuild from source and replace it
+        }
+    }
+
+    cl::Program program(context, source);
+
+    try
+    {
+        program.build(device, build_options.data());
+    }
+    catch (const cl::Error&)
+    {
+        std::cout << "Build status: " << program.getBuildInfo<CL_PROGRAM_BUILD_STATUS>(device) << std::endl;
+        std::cout << "Build options: " << program.getBuildInfo<CL_PROGRAM_BUILD_OPTIONS>(device) << std::endl;
+        std::cout << "Build log: " << program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(device) << std::endl;
+
+        throw;
+    }
+
+    // the program is built for a single device
+    const cl::Program::Binaries binaries = program.getInfo<CL_PROGRAM_BINARIES>();
+
+    if (binaries.empty() || !cache.store(cache_key, binaries.front()))
+    {
+        std::cout << "Failed to store the program binary in " << cache_directory << std::endl;
+    }
+
+    return program;
+}
@@ -0,0 +1,51 @@
+#ifndef PROGRAM_BINARY_CACHE_HPP_
+#define PROGRAM_BINARY_CACHE_HPP_
+
+#define CL_HPP_ENABLE_EXCEPTIONS
+#define CL_HPP_TARGET_OPENCL_VERSION 220
+
+#include <CL/opencl.hpp>
+#include <string>
+#include <vector>
+
+// stores compiled OpenCL program binaries on disk so later launches can skip the build,
+// an entry is only used when every part of its key matches
+class ProgramBinaryCache
+{
+private:
+    const std::string FILE_MAGIC = "VVCLBIN1";
+
+    std::string m_directory;
+
+    std::string get_file_name(const std::string& key) const;
+
+public:
+    explicit ProgramBinaryCache(std::string directory)
+        : m_directory(directory)
+    {}
+
+    // FNV-1a, only used to name cache files and detect source changes
+    static std::string hash(const std::string& text);
+
+    static std::string make_key(const std::string& source,
+        const std::string& build_options,
+        const std::string& device_name,
+        const std::string& driver_version);
+
+    bool load(const std::string& key, std::vector<unsigned char>& binary) const;
+    bool store(const std::string& key, const std::vector<unsigned char>& binary) const;
+};
+
+// concatenates the kernel files in order, false when one of them cannot be read
+bool read_kernel_sources(const std::vector<std::string>& file_names, std::string& source);
+
+// builds source for a single device, reusing the binary cached in cache_directory when one matches
+// and caching a freshly built one. prints the build log and rethrows when the build fails
+cl::Program build_cached_program(const cl::Context& context,
+    const cl::Device& device,
+    const std::string& source,
+    const std::string& build_options,
+    const std::string& cache_directory,
+    bool* from_cache = nullptr);
+
+#endif // !PROGRAM_BINARY_CACHE_HPP_
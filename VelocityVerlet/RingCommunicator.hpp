@@ -0,0 +1,29 @@
+#ifndef RING_COMMUNICATOR_HPP_
+#define RING_COMMUNICATOR_HPP_
+
+#include <cstdlib>
+
+// the collective operations the distributed strategy needs. ranks are arranged in a ring,
+// a shift passes a block to the next rank and receives the block of the previous one.
+// every rank has to take part in every call, in the same order
+class IRingCommunicator
+{
+public:
+    virtual ~IRingCommunicator() = default;
+
+    virtual std::size_t get_rank() const = 0;
+    virtual std::size_t get_num_ranks() const = 0;
+
+    // starts sending count floats to the next rank and receiving count floats from the
+    // previous rank, neither buffer may be touched until finish_shift returns
+    virtual void start_shift(const float* send, float* receive, std::size_t count) = 0;
+    virtual void finish_shift() = 0;
+
+    // every rank contributes count floats, receive gets num_ranks * count in rank order
+    virtual void all_gather(const float* send, float* receive, std::size_t count) = 0;
+
+    // the bytes of rank 0 on every rank
+    virtual void broadcast(void* data, std::size_t num_bytes) = 0;
+};
+
+#endif // !RING_COMMUNICATOR_HPP_
@@ -0,0 +1,51 @@
+#include "ShortRange.hpp"
+
+#include <algorithm>
+#include <limits>
+
+CellGrid fit_cell_grid(const float* x,
+    const float* y,
+    const float* z,
+    std::size_t num_particles,
+    float min_cell_size,
+    std::uint32_t max_cells_per_axis,
+    std::size_t stride)
+{
+    const float* axes[3] = { x, y, z };
+
+    float min_position[3];
+    float max_position[3];
+
+    for (std::size_t axis = 0; axis < 3; ++axis)
+    {
+        min_position[axis] = std::numeric_limits<float>::max();
+        max_position[axis] = std::numeric_limits<float>::lowest();
+
+        for (std::size_t i = 0; i < num_particles; ++i)
+        {
+            min_position[axis] = std::min(min_position[axis], axes[axis][i * stride]);
+            max_position[axis] = std::max(max_position[axis], axes[axis][i * stride]);
+        }
+    }
+
+    float extent = 0.f;
+
+    for (std::size_t axis = 0; axis < 3; ++axis)
+    {
+        extent = std::max(extent, max_position[axis] - min_position[axis]);
+    }
+
+    CellGrid grid = {};
+
+    grid.cell_size = std::max(min_cell_size, extent / static_cast<float>(max_cells_per_axis));
+
+    for (std::size_t axis = 0; axis < 3; ++axis)
+    {
+        const float axis_extent = std::max(max_position[axis] - min_position[axis], 0.f);
+
+        grid.origin[axis] = min_position[axis];
+        grid.dims[axis] = std::clamp(static_cast<std::uint32_t>(axis_extent / grid.cell_size) + 1u, 1u, max_cells_per_axis);
+    }
+
+    return grid;
+}
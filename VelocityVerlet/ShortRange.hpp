@@ -0,0 +1,120 @@
+#ifndef SHORT_RANGE_HPP_
+#define SHORT_RANGE_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+
+enum class ShortRangeLaw
+{
+    LennardJones,
+    Yukawa
+};
+
+struct ShortRangeParameters
+{
+    ShortRangeLaw law = ShortRangeLaw::LennardJones;
+
+    // pairs further apart than cutoff do not interact
+    float cutoff = 25.f;
+
+    // the neighbor lists hold every pair within cutoff + skin, the pairs of a particle
+    // stay valid until it has moved more than skin / 2
+    float skin = 5.f;
+
+    // U = 4 epsilon ((sigma / r)^12 - (sigma / r)^6)
+    float sigma = 10.f;
+    float epsilon = 1.f;
+
+    // U = strength exp(-r / screening_length) / r
+    float strength = 1000.f;
+    float screening_length = 10.f;
+};
+
+// law policies for the pair loops, get_force_scale returns |F| / r for a pair at squared
+// distance sqr_distance, positive when repulsive. the force on particle i from particle j
+// is -scale * (x_j - x_i)
+struct LennardJonesPotential
+{
+    static float get_force_scale(const ShortRangeParameters& parameters, float sqr_distance)
+    {
+        const float inv_sqr_distance = 1.f / sqr_distance;
+        const float sigma2 = parameters.sigma * parameters.sigma * inv_sqr_distance;
+        const float sigma6 = sigma2 * sigma2 * sigma2;
+
+        return 24.f * parameters.epsilon * sigma6 * (2.f * sigma6 - 1.f) * inv_sqr_distance;
+    }
+};
+
+struct YukawaPotential
+{
+    static float get_force_scale(const ShortRangeParameters& parameters, float sqr_distance)
+    {
+        const float distance = std::sqrt(sqr_distance);
+
+        return parameters.strength * std::exp(-distance / parameters.screening_length)
+            / sqr_distance * (1.f / distance + 1.f / parameters.screening_length);
+    }
+};
+
+// runtime dispatch for code outside the hot loops
+inline float get_short_range_force_scale(const ShortRangeParameters& parameters, float sqr_distance)
+{
+    return (parameters.law == ShortRangeLaw::LennardJones)
+        ? LennardJonesPotential::get_force_scale(parameters, sqr_distance)
+        : YukawaPotential::get_force_scale(parameters, sqr_distance);
+}
+
+// uniform grid over the particle bounding box, cells are at least as wide as the
+// interaction range so all partners of a particle are in its own or the 26 adjacent cells
+struct CellGrid
+{
+    float origin[3];
+    float cell_size;
+    std::uint32_t dims[3];
+
+    std::size_t get_num_cells() const
+    {
+        return static_cast<std::size_t>(dims[0]) * dims[1] * dims[2];
+    }
+
+    // positions outside the grid are clamped into the border cells, which keeps adjacent
+    // particles in adjacent cells
+    std::uint32_t get_cell_coordinate(float position, std::size_t axis) const
+    {
+        const float cell = std::floor((position - origin[axis]) / cell_size);
+
+        if (cell < 0.f)
+        {
+            return 0u;
+        }
+
+        return std::min(static_cast<std::uint32_t>(cell), dims[axis] - 1u);
+    }
+
+    bool contains(float position, std::size_t axis) const
+    {
+        const float offset = position - origin[axis];
+
+        return (offset >= 0.f) && (offset < cell_size * static_cast<float>(dims[axis]));
+    }
+
+    std::size_t get_cell_index(std::uint32_t x, std::uint32_t y, std::uint32_t z) const
+    {
+        return (static_cast<std::size_t>(z) * dims[1] + y) * dims[0] + x;
+    }
+};
+
+// fits a grid to the bounding box of the positions, cells grow beyond min_cell_size
+// when more than max_cells_per_axis would be needed. stride steps over interleaved
+// components, 4 for float4 positions
+CellGrid fit_cell_grid(const float* x,
+    const float* y,
+    const float* z,
+    std::size_t num_particles,
+    float min_cell_size,
+    std::uint32_t max_cells_per_axis,
+    std::size_t stride = 1u);
+
+#endif // !SHORT_RANGE_HPP_
@@ -0,0 +1,802 @@
+#include "ShortRangeGPUVelocityVerlet.hpp"
+
+#include "ProgramBinaryCache.hpp"
+
+#include <chrono>
+#include <iostream>
+
+bool ShortRangeGPUVelocityVerlet::validate_inputs() const
+{
+    const std::vector<std::size_t> input_sizes =
+    {
+        m_input_positions.size(),
+        m_input_velocities.size(),
+        m_input_masses.size(),
+        m_num_particles
+    };
+
+    if (!std::equal(input_sizes.begin() + 1, input_sizes.end(), input_sizes.begin()))
+    {
+        return false;
+    }
+
+    return (m_num_particles > 0) && (m_parameters.cutoff > 0.f) && (m_parameters.skin >= 0.f);
+}
+
+bool ShortRangeGPUVelocityVerlet::setup_platform()
+{
+    try
+    {
+        if (!select_opencl_platform(m_selected_device, m_platform))
+        {
+            return false;
+        }
+
+        m_platform_name = m_platform.getInfo<CL_PLATFORM_NAME>();
+        m_platform_vendor = m_platform.getInfo<CL_PLATFORM_VENDOR>();
+
+        return true;
+    }
+    catch (const cl::Error& e)
+    {
+        std::cout << "Error: " << e.err() << std::endl;
+        std::cout << "Exception: " << e.what() << std::endl;
+
+        return false;
+    }
+}
+
+bool ShortRangeGPUVelocityVerlet::setup_context()
+{
+    try
+    {
+        m_context = create_opencl_context(m_platform, m_selected_device);
+
+        return true;
+    }
+    catch (const cl::Error& e)
+    {
+        std::cout << "Error: " << e.err() << std::endl;
+        std::cout << "Exception: " << e.what() << std::endl;
+
+        return false;
+    }
+}
+
+bool ShortRangeGPUVelocityVerlet::setup_device()
+{
+    try
+    {
+        std::vector<cl::Device> devices = m_context.getInfo<CL_CONTEXT_DEVICES>();
+
+        if (devices.empty())
+        {
+            return false;
+        }
+
+        m_device = devices.front();
+        m_device_name = get_opencl_device_name(m_device);
+
+        return true;
+    }
+    catch (const cl::Error& e)
+    {
+        std::cout << "Error: " << e.err() << std::endl;
+        std::cout << "Exception: " << e.what() << std::endl;
+
+        return false;
+    }
+}
+
+bool ShortRangeGPUVelocityVerlet::setup_program()
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    try
+    {
+        // the short range kernels are appended to the shared integration kernels
+        std::string kernel_code;
+
+        if (!read_kernel_sources(KERNEL_FILE_NAMES, kernel_code))
+        {
+            return false;
+        }
+
+        m_program = build_cached_program(m_context, m_device, kernel_code, m_build_options,
+            PROGRAM_CACHE_DIRECTORY, &m_program_from_cache);
+        m_program_setup_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        return true;
+    }
+    catch (const cl::Error& e)
+    {
+        std::cout << "Error: " << e.err() << std::endl;
+        std::cout << "Exception: " << e.what() << std::endl;
+
+        return false;
+    }
+    catch (const std::exception& e)
+    {
+        std::cout << "Exception: " << e.what() << std::endl;
+
+        return false;
+    }
+}
+
+bool ShortRangeGPUVelocityVerlet::setup_command_queue()
+{
+    try
+    {
+        // in order, so the binning, force and integration kernels need no events between them
+        m_command_queue = cl::CommandQueue(m_context, m_device, CL_QUEUE_PROFILING_ENABLE, NULL);
+
+        return true;
+    }
+    catch (const cl::Error& e)
+    {
+        std::cout << "Error: " << e.err() << std::endl;
+        std::cout << "Exception: " << e.what() << std::endl;
+
+        return false;
+    }
+}
+
+bool ShortRangeGPUVelocityVerlet::setup_input_data()
+{
+    m_buffer_size_bytes = m_num_particles * sizeof(cl_float4);
+
+    m_positions = static_cast<cl_float4*>(allocate_aligned(m_buffer_size_bytes, 16));
+    m_velocities = static_cast<cl_float4*>(allocate_aligned(m_buffer_size_bytes, 16));
+
+    if ((m_positions == nullptr) || (m_velocities == nullptr))
+    {
+        return false;
+    }
+
+    for (std::size_t i = 0; i < m_num_particles; ++i)
+    {
+        // the 4th component contains the mass for this particle
+        m_positions[i].s0 = m_input_positions[i].x;
+        m_positions[i].s1 = m_input_positions[i].y;
+        m_positions[i].s2 = m_input_positions[i].z;
+        m_positions[i].s3 = m_input_masses[i];
+
+        m_velocities[i].s0 = m_input_velocities[i].x;
+        m_velocities[i].s1 = m_input_velocities[i].y;
+        m_velocities[i].s2 = m_input_velocities[i].z;
+        m_velocities[i].s3 = m_input_masses[i];
+    }
+
+    return true;
+}
+
+bool ShortRangeGPUVelocityVerlet::setup_buffers()
+{
+    try
+    {
+        m_positions_buffers[m_front_buffer_idx] = cl::Buffer(m_context,
+            CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,
+            m_buffer_size_bytes,
+            m_positions);
+
+        m_positions_buffers[m_back_buffer_idx] = cl::Buffer(m_context,
+            CL_MEM_READ_WRITE,
+            m_buffer_size_bytes,
+            NULL);
+
+        m_velocities_buffer = cl::Buffer(m_context,
+            CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,
+            m_buffer_size_bytes,
+            m_velocities);
+
+        m_forces_buffers[m_front_buffer_idx] = cl::Buffer(m_context,
+            CL_MEM_READ_WRITE,
+            m_buffer_size_bytes,
+            NULL);
+
+        m_forces_buffers[m_back_buffer_idx] = cl::Buffer(m_context,
+            CL_MEM_READ_WRITE,
+            m_buffer_size_bytes,
+            NULL);
+
+        // sized for the largest grid, so refitting never reallocates the counts
+        const std::size_t max_cells = static_cast<std::size_t>(MAX_CELLS_PER_AXIS) * MAX_CELLS_PER_AXIS * MAX_CELLS_PER_AXIS;
+
+        m_cell_counts_buffer = cl::Buffer(m_context,
+            CL_MEM_READ_WRITE,
+            max_cells * sizeof(cl_uint),
+            NULL);
+
+        m_max_count_buffer = cl::Buffer(m_context,
+            CL_MEM_READ_WRITE,
+            sizeof(cl_uint),
+            NULL);
+
+        m_saved_positions_buffer = cl::Buffer(m_context,
+            CL_MEM_READ_WRITE,
+            m_buffer_size_bytes,
+            NULL);
+
+        m_saved_velocities_buffer = cl::Buffer(m_context,
+            CL_MEM_READ_WRITE,
+            m_buffer_size_bytes,
+            NULL);
+
+        m_saved_forces_buffer = cl::Buffer(m_context,
+            CL_MEM_READ_WRITE,
+            m_buffer_size_bytes,
+            NULL);
+
+        return true;
+    }
+    catch (const cl::Error& e)
+    {
+        std::cout << "Error: " << e.err() << std::endl;
+        std::cout << "Exception: " << e.what() << std::endl;
+
+        return false;
+    }
+}
+
+bool ShortRangeGPUVelocityVerlet::setup_kernels()
+{
+    try
+    {
+        const cl_uint num_particles = static_cast<cl_uint>(m_num_particles);
+
+        m_clear_kernel = cl::Kernel(m_program, CLEAR_KERNEL_NAME.data());
+        m_bin_kernel = cl::Kernel(m_program, BIN_KERNEL_NAME.data());
+        m_force_kernel = cl::Kernel(m_program, FORCE_KERNEL_NAME.data());
+        m_positions_kernel = cl::Kernel(m_program, POSITIONS_KERNEL_NAME.data());
+        m_velocities_kernel = cl::Kernel(m_program, VELOCITY_KERNEL_NAME.data());
+
+        // the gather reads cells through global memory, the limit is what the compiled kernels allow
+        m_workgroup_size = std::min({ WORKGROUP_SIZE,
+            m_device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>(),
+            m_force_kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(m_device),
+            m_bin_kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(m_device) });
+
+        // pad the global size to whole work-groups, the kernels skip the padding items
+        m_total_workitems = ((m_num_particles + m_workgroup_size - 1) / m_workgroup_size) * m_workgroup_size;
+
+        m_clear_kernel.setArg(0, m_cell_counts_buffer);
+
+        m_bin_kernel.setArg(1, m_cell_counts_buffer);
+        m_bin_kernel.setArg(3, m_max_count_buffer);
+        m_bin_kernel.setArg(6, num_particles);
+
+        // the squared cutoff leads the law parameters, the kernel compares against it first
+        const bool lennard_jones = (m_parameters.law == ShortRangeLaw::LennardJones);
+
+        const cl_float4 law_parameters = { {
+            m_parameters.cutoff * m_parameters.cutoff,
+            lennard_jones ? m_parameters.sigma * m_parameters.sigma : m_parameters.strength,
+            lennard_jones ? m_parameters.epsilon : m_parameters.screening_length,
+            0.f } };
+
+        m_force_kernel.setArg(2, m_cell_counts_buffer);
+        m_force_kernel.setArg(6, num_particles);
+        m_force_kernel.setArg(7, law_parameters);
+
+        m_positions_kernel.setArg(3, m_velocities_buffer);
+        m_positions_kernel.setArg(4, m_time_step);
+        m_positions_kernel.setArg(5, num_particles);
+        m_positions_kernel.setArg(6, cl_uint(0));
+
+        m_velocities_kernel.setArg(2, m_velocities_buffer);
+        m_velocities_kernel.setArg(3, m_time_step);
+        m_velocities_kernel.setArg(4, num_particles);
+
+        return true;
+    }
+    catch (const cl::Error& e)
+    {
+        std::cout << "Error: " << e.err() << std::endl;
+        std::cout << "Exception: " << e.what() << std::endl;
+
+        return false;
+    }
+}
+
+bool ShortRangeGPUVelocityVerlet::setup_cell_buffer()
+{
+    try
+    {
+        const std::size_t required = m_grid.get_num_cells() * m_cell_capacity;
+
+        if (required > m_cell_buffer_size)
+        {
+            m_cell_particles_buffer = cl::Buffer(m_context,
+                CL_MEM_READ_WRITE,
+                required * sizeof(cl_uint),
+                NULL);
+
+            m_cell_buffer_size = required;
+
+            m_bin_kernel.setArg(2, m_cell_particles_buffer);
+            m_force_kernel.setArg(3, m_cell_particles_buffer);
+        }
+
+        return true;
+    }
+    catch (const cl::Error& e)
+    {
+        std::cout << "Error: " << e.err() << std::endl;
+        std::cout << "Exception: " << e.what() << std::endl;
+
+        return false;
+    }
+}
+
+bool ShortRangeGPUVelocityVerlet::update_grid_arguments()
+{
+    // cells of at least the cutoff keep every partner within the 27 surrounding cells. the
+    // skin only pads the grid, particles drifting out of it during a frame land in the border
+    // cells, which costs time but not correctness
+    const float padding = m_parameters.skin;
+
+    m_grid = fit_cell_grid(&m_positions[0].s[0],
+        &m_positions[0].s[1],
+        &m_positions[0].s[2],
+        m_num_particles,
+        m_parameters.cutoff,
+        MAX_CELLS_PER_AXIS,
+        4u);
+
+    for (std::size_t axis = 0; axis < 3; ++axis)
+    {
+        m_grid.origin[axis] -= padding;
+        m_grid.dims[axis] = std::min(m_grid.dims[axis] + 1u, MAX_CELLS_PER_AXIS);
+    }
+
+    return set_grid_arguments();
+}
+
+bool ShortRangeGPUVelocityVerlet::set_grid_arguments()
+{
+    if (!setup_cell_buffer())
+    {
+        return false;
+    }
+
+    try
+    {
+        const cl_float4 origin = { { m_grid.origin[0], m_grid.origin[1], m_grid.origin[2], 1.f / m_grid.cell_size } };
+        const cl_uint4 dims = { { m_grid.dims[0], m_grid.dims[1], m_grid.dims[2], m_cell_capacity } };
+
+        m_clear_kernel.setArg(1, static_cast<cl_uint>(m_grid.get_num_cells()));
+
+        m_bin_kernel.setArg(4, origin);
+        m_bin_kernel.setArg(5, dims);
+
+        m_force_kernel.setArg(4, origin);
+        m_force_kernel.setArg(5, dims);
+
+        return true;
+    }
+    catch (const cl::Error& e)
+    {
+        std::cout << "Error: " << e.err() << std::endl;
+        std::cout << "Exception: " << e.what() << std::endl;
+
+        return false;
+    }
+}
+
+bool ShortRangeGPUVelocityVerlet::bin_particles(const cl::Buffer& positions)
+{
+    try
+    {
+        m_bin_kernel.setArg(0, positions);
+
+        const std::size_t num_cells = m_grid.get_num_cells();
+        const std::size_t cell_workitems = ((num_cells + m_workgroup_size - 1) / m_workgroup_size) * m_workgroup_size;
+
+        cl::Event clear_event;
+        cl::Event bin_event;
+
+        m_command_queue->enqueueNDRangeKernel(m_clear_kernel,
+            cl::NullRange,
+            cl::NDRange(cell_workitems),
+            cl::NDRange(m_workgroup_size),
+            NULL,
+            &clear_event);
+
+        // no read back here, an overflow is seen at the end of the frame
+        m_command_queue->enqueueNDRangeKernel(m_bin_kernel,
+            cl::NullRange,
+            cl::NDRange(m_total_workitems),
+            cl::NDRange(m_workgroup_size),
+            NULL,
+            &bin_event);
+
+        profile_command(ProfilePhase::Force, clear_event);
+        profile_command(ProfilePhase::Force, bin_event);
+
+        return true;
+    }
+    catch (const cl::Error& e)
+    {
+        std::cout << "Error: " << e.err() << std::endl;
+        std::cout << "Exception: " << e.what() << std::endl;
+
+        return false;
+    }
+}
+
+bool ShortRangeGPUVelocityVerlet::queue_forces(const cl::Buffer& forces, const cl::Buffer& positions)
+{
+    if (!bin_particles(positions))
+    {
+        return false;
+    }
+
+    try
+    {
+        cl::Event force_event;
+
+        m_force_kernel.setArg(0, forces);
+        m_force_kernel.setArg(1, positions);
+
+        m_command_queue->enqueueNDRangeKernel(m_force_kernel,
+            cl::NullRange,
+            cl::NDRange(m_total_workitems),
+            cl::NDRange(m_workgroup_size),
+            NULL,
+            &force_event);
+
+        profile_command(ProfilePhase::Force, force_event);
+
+        return true;
+    }
+    catch (const cl::Error& e)
+    {
+        std::cout << "Error: " << e.err() << std::endl;
+        std::cout << "Exception: " << e.what() << std::endl;
+
+        return false;
+    }
+}
+
+bool ShortRangeGPUVelocityVerlet::save_frame_state()
+{
+    try
+    {
+        m_command_queue->enqueueFillBuffer(m_max_count_buffer, cl_uint(0), 0, sizeof(cl_uint));
+
+        m_command_queue->enqueueCopyBuffer(m_positions_buffers[m_front_buffer_idx], m_saved_positions_buffer, 0, 0, m_buffer_size_bytes);
+        m_command_queue->enqueueCopyBuffer(m_velocities_buffer, m_saved_velocities_buffer, 0, 0, m_buffer_size_bytes);
+
+        if (m_forces_computed)
+        {
+            m_command_queue->enqueueCopyBuffer(m_forces_buffers[m_front_buffer_idx], m_saved_forces_buffer, 0, 0, m_buffer_size_bytes);
+        }
+
+        return true;
+    }
+    catch (const cl::Error& e)
+    {
+        std::cout << "Error: " << e.err() << std::endl;
+        std::cout << "Exception: " << e.what() << std::endl;
+
+        return false;
+    }
+}
+
+bool ShortRangeGPUVelocityVerlet::restore_frame_state()
+{
+    try
+    {
+        m_command_queue->enqueueCopyBuffer(m_saved_positions_buffer, m_positions_buffers[m_front_buffer_idx], 0, 0, m_buffer_size_bytes);
+        m_command_queue->enqueueCopyBuffer(m_saved_velocities_buffer, m_velocities_buffer, 0, 0, m_buffer_size_bytes);
+
+        if (m_forces_computed)
+        {
+            m_command_queue->enqueueCopyBuffer(m_saved_forces_buffer, m_forces_buffers[m_front_buffer_idx], 0, 0, m_buffer_size_bytes);
+        }
+
+        return true;
+    }
+    catch (const cl::Error& e)
+    {
+        std::cout << "Error: " << e.err() << std::endl;
+        std::cout << "Exception: " << e.what() << std::endl;
+
+        return false;
+    }
+}
+
+bool ShortRangeGPUVelocityVerlet::run_step()
+{
+    // the forces at the front positions are only computed for the very first step,
+    // after that they are the forces computed at the end of the previous step
+    if (!m_forces_computed)
+    {
+        if (!queue_forces(m_forces_buffers[m_front_buffer_idx], m_positions_buffers[m_front_buffer_idx]))
+        {
+            return false;
+        }
+
+        m_forces_computed = true;
+    }
+
+    try
+    {
+        cl::Event positions_event;
+
+        m_positions_kernel.setArg(0, m_forces_buffers[m_front_buffer_idx]);
+        m_positions_kernel.setArg(1, m_positions_buffers[m_front_buffer_idx]);
+        m_positions_kernel.setArg(2, m_positions_buffers[m_back_buffer_idx]);
+
+        m_command_queue->enqueueNDRangeKernel(m_positions_kernel,
+            cl::NullRange,
+            cl::NDRange(m_total_workitems),
+            cl::NDRange(m_workgroup_size),
+            NULL,
+            &positions_event);
+
+        profile_command(ProfilePhase::Drift, positions_event);
+    }
+    catch (const cl::Error& e)
+    {
+        std::cout << "Error: " << e.err() << std::endl;
+        std::cout << "Exception: " << e.what() << std::endl;
+
+        return false;
+    }
+
+    // forces at the new positions, the only force evaluation of the step
+    if (!queue_forces(m_forces_buffers[m_back_buffer_idx], m_positions_buffers[m_back_buffer_idx]))
+    {
+        return false;
+    }
+
+    try
+    {
+        cl::Event velocities_event;
+
+        m_velocities_kernel.setArg(0, m_forces_buffers[m_front_buffer_idx]);
+        m_velocities_kernel.setArg(1, m_forces_buffers[m_back_buffer_idx]);
+
+        m_command_queue->enqueueNDRangeKernel(m_velocities_kernel,
+            cl::NullRange,
+            cl::NDRange(m_total_workitems),
+            cl::NDRange(m_workgroup_size),
+            NULL,
+            &velocities_event);
+
+        profile_command(ProfilePhase::Kick, velocities_event);
+
+        // the new positions and forces become the input of the next step
+        std::swap(m_front_buffer_idx, m_back_buffer_idx);
+
+        return true;
+    }
+    catch (const cl::Error& e)
+    {
+        std::cout << "Error: " << e.err() << std::endl;
+        std::cout << "Exception: " << e.what() << std::endl;
+
+        return false;
+    }
+}
+
+bool ShortRangeGPUVelocityVerlet::read_positions()
+{
+    try
+    {
+        cl::Event read_event;
+
+        // the queue is in order, the blocking read below also completes this one
+        m_command_queue->enqueueReadBuffer(m_max_count_buffer, CL_FALSE, 0, sizeof(cl_uint), &m_max_count);
+
+        m_command_queue->enqueueReadBuffer(m_positions_buffers[m_front_buffer_idx],
+            CL_TRUE,
+            0,
+            m_buffer_size_bytes,
+            m_positions,
+            NULL,
+            &read_event);
+
+        profile_command(ProfilePhase::Transfer, read_event);
+
+        return true;
+    }
+    catch (const cl::Error& e)
+    {
+        std::cout << "Error: " << e.err() << std::endl;
+        std::cout << "Exception: " << e.what() << std::endl;
+
+        return false;
+    }
+}
+
+void ShortRangeGPUVelocityVerlet::initialize()
+{
+    if (!validate_inputs())
+    {
+        throw std::string("Failure due to invalid inputs");
+    }
+
+    if (setup_platform())
+    {
+        std::cout << std::endl << "Platform setup is OK" << std::endl;
+        std::cout << "Platform name   : " << m_platform_name << std::endl;
+        std::cout << "Platform vendor : " << m_platform_vendor << std::endl;
+    }
+    else
+    {
+        throw std::string("Failed to setup platform");
+    }
+
+    if (!setup_context())
+    {
+        throw std::string("Failed to setup context");
+    }
+
+    if (setup_device())
+    {
+        std::cout << std::endl << "Device setup is OK" << std::endl;
+        std::cout << "Device name : " << m_device_name.value() << std::endl;
+    }
+    else
+    {
+        throw std::string("Failed to setup device");
+    }
+
+    if (setup_program())
+    {
+        std::cout << std::endl << "Program setup is OK" << std::endl;
+        std::cout << "Program source  : " << (m_program_from_cache ? "cached binary (warm start)" : "built from source (cold start)") << std::endl;
+        std::cout << "Setup time (ms) : " << m_program_setup_seconds * 1e3 << std::endl;
+    }
+    else
+    {
+        throw std::string("Failed to setup program");
+    }
+
+    if (!setup_command_queue())
+    {
+        throw std::string("Failed to setup command queue");
+    }
+
+    if (!setup_input_data())
+    {
+        throw std::string("Failed to setup input data");
+    }
+
+    if (!setup_buffers())
+    {
+        throw std::string("Failed to setup buffers");
+    }
+
+    if (!setup_kernels() || !update_grid_arguments())
+    {
+        throw std::string("Failed to setup kernels");
+    }
+
+    std::cout << std::endl << "Kernel setup is OK" << std::endl;
+    std::cout << "Short range law : "
+        << ((m_parameters.law == ShortRangeLaw::LennardJones) ? "Lennard-Jones" : "Yukawa")
+        << ", cutoff " << m_parameters.cutoff << std::endl;
+    std::cout << "Cell grid       : " << m_grid.dims[0] << " x " << m_grid.dims[1] << " x " << m_grid.dims[2]
+        << ", " << m_cell_capacity << " slots per cell" << std::endl;
+    std::cout << "Work-group size : " << m_workgroup_size << std::endl;
+}
+
+void ShortRangeGPUVelocityVerlet::profile_command(ProfilePhase phase, const cl::Event& event)
+{
+    if (m_profiler != nullptr)
+    {
+        m_profiled_commands.emplace_back(phase, event);
+    }
+}
+
+bool ShortRangeGPUVelocityVerlet::read_profiled_commands()
+{
+    if ((m_profiler == nullptr) || m_profiled_commands.empty())
+    {
+        return true;
+    }
+
+    try
+    {
+        // the frame ends with the blocking read of the positions, everything before it has finished
+        m_profiler->synchronize_device_clock(m_profiled_commands.back().second.getProfilingInfo<CL_PROFILING_COMMAND_END>());
+
+        for (const std::pair<ProfilePhase, cl::Event>& command : m_profiled_commands)
+        {
+            m_profiler->record_device(command.first,
+                command.second.getProfilingInfo<CL_PROFILING_COMMAND_START>(),
+                command.second.getProfilingInfo<CL_PROFILING_COMMAND_END>());
+        }
+    }
+    catch (const cl::Error& e)
+    {
+        std::cout << "Error: " << e.err() << std::endl;
+        std::cout << "Exception: " << e.what() << std::endl;
+
+        return false;
+    }
+
+    m_profiled_commands.clear();
+
+    return true;
+}
+
+void ShortRangeGPUVelocityVerlet::run(std::vector<sf::Vertex>& vertices)
+{
+    const std::size_t front_buffer_idx = m_front_buffer_idx;
+    const bool forces_computed = m_forces_computed;
+
+    // the first attempt fits unless a cell got denser than the spare slots allow
+    while (true)
+    {
+        if (!save_frame_state())
+        {
+            throw std::string("Failed to save the frame state");
+        }
+
+        for (std::size_t step = 0; step < m_steps_per_frame; ++step)
+        {
+            if (!run_step())
+            {
+                throw std::string("Failed to queue commands");
+            }
+        }
+
+        if (!read_positions())
+        {
+            throw std::string("Failed to read back positions");
+        }
+
+        if (!read_profiled_commands())
+        {
+            throw std::string("Failed to read profiling info");
+        }
+
+        if (m_max_count <= m_cell_capacity)
+        {
+            break;
+        }
+
+        // dropped particles made the forces of this frame wrong, repeat it with more slots
+        while (m_cell_capacity < m_max_count + m_max_count * CELL_CAPACITY_HEADROOM / 100u)
+        {
+            m_cell_capacity *= 2u;
+        }
+
+        ++m_num_regrows;
+
+        m_front_buffer_idx = front_buffer_idx;
+        m_back_buffer_idx = 1u - front_buffer_idx;
+        m_forces_computed = forces_computed;
+
+        if (!restore_frame_state() || !set_grid_arguments())
+        {
+            throw std::string("Failed to grow the cell slots");
+        }
+    }
+
+    m_step_count += m_steps_per_frame;
+
+    // the grid for the next frame follows the particles
+    if (!update_grid_arguments())
+    {
+        throw std::string("Failed to refit the cell grid");
+    }
+
+    ProfileScope scope(m_profiler, ProfilePhase::VertexConversion);
+
+    vertices.resize(m_num_particles);
+
+    for (std::size_t i = 0; i < m_num_particles; ++i)
+    {
+        vertices[i] = sf::Vector2f(m_positions[i].s0, m_positions[i].s1);
+    }
+}
+
+void ShortRangeGPUVelocityVerlet::set_profiler(Profiler* profiler)
+{
+    m_profiler = profiler;
+}
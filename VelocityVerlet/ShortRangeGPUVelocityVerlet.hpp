@@ -0,0 +1,210 @@
+#ifndef SHORT_RANGE_GPU_VELOCITY_VERLET_HPP_
+#define SHORT_RANGE_GPU_VELOCITY_VERLET_HPP_
+
+#define CL_HPP_ENABLE_EXCEPTIONS
+#define CL_HPP_TARGET_OPENCL_VERSION 220
+
+#include "AlignedAllocator.hpp"
+#include "IAlgorithmStrategy.hpp"
+#include "IProfileable.hpp"
+#include "OpenCLDevices.hpp"
+#include "ShortRange.hpp"
+
+#include <algorithm>
+#include <array>
+#include <CL/opencl.hpp>
+#include <cstdint>
+#include <cstdlib>
+#include <optional>
+#include <SFML/System/Vector3.hpp>
+#include <string>
+#include <utility>
+#include <vector>
+
+// cutoff force laws on the device. the particles are binned into a uniform cell grid
+// every step and each work item gathers its force from the 27 surrounding cells, the
+// grid itself is refitted on the host from the positions read back for each frame. the
+// cells keep spare slots and the fullest cell is only read back with the positions, a
+// frame in which a cell overflowed is repeated from a device copy of its starting state
+class ShortRangeGPUVelocityVerlet : public IAlgorithmStrategy, public IProfileable
+{
+private:
+    const std::vector<std::string> KERNEL_FILE_NAMES = { "velocity_verlet.cl", "short_range.cl" };
+    const std::string CLEAR_KERNEL_NAME = "clear_cells";
+    const std::string BIN_KERNEL_NAME = "bin_particles";
+    const std::string FORCE_KERNEL_NAME = "compute_short_range_forces";
+    const std::string VELOCITY_KERNEL_NAME = "compute_velocities";
+    const std::string POSITIONS_KERNEL_NAME = "compute_positions";
+    const std::string BUILD_OPTIONS = "-cl-std=CL2.2";
+    const std::string PROGRAM_CACHE_DIRECTORY = "kernel_cache";
+    const std::size_t WORKGROUP_SIZE = 256u;
+    const std::uint32_t MAX_CELLS_PER_AXIS = 64u;
+    const std::uint32_t INITIAL_CELL_CAPACITY = 16u;
+
+    // slots per cell are at least this much above the fullest cell seen, in percent
+    const std::uint32_t CELL_CAPACITY_HEADROOM = 25u;
+
+    // the first GPU of the first platform when not set
+    std::optional<OpenCLDevice> m_selected_device;
+
+    cl::Platform m_platform;
+    std::string m_platform_name;
+    std::string m_platform_vendor;
+    cl::Context m_context;
+    cl::Device m_device;
+    std::optional<std::string> m_device_name;
+
+    // the law is compiled in, see short_range.cl
+    cl::Program m_program;
+    std::string m_build_options;
+    bool m_program_from_cache;
+    double m_program_setup_seconds;
+
+    std::optional<cl::CommandQueue> m_command_queue;
+
+    std::array<cl::Buffer, 2u> m_positions_buffers;
+    std::array<cl::Buffer, 2u> m_forces_buffers;
+    cl::Buffer m_velocities_buffer;
+    cl::Buffer m_cell_counts_buffer;
+    cl::Buffer m_cell_particles_buffer;
+    cl::Buffer m_max_count_buffer;
+
+    // the state at the start of the frame, restored when binning overflowed
+    cl::Buffer m_saved_positions_buffer;
+    cl::Buffer m_saved_velocities_buffer;
+    cl::Buffer m_saved_forces_buffer;
+    std::size_t m_buffer_size_bytes;
+    std::size_t m_front_buffer_idx;
+    std::size_t m_back_buffer_idx;
+
+    // the front forces buffer holds the forces at the front positions
+    bool m_forces_computed;
+
+    cl::Kernel m_clear_kernel;
+    cl::Kernel m_bin_kernel;
+    cl::Kernel m_force_kernel;
+    cl::Kernel m_velocities_kernel;
+    cl::Kernel m_positions_kernel;
+
+    ShortRangeParameters m_parameters;
+
+    // every cell has m_cell_capacity slots, the slots grow whenever binning overflows
+    // them and the slot buffer only grows when a refitted grid needs more
+    CellGrid m_grid;
+    std::uint32_t m_cell_capacity;
+    std::size_t m_cell_buffer_size;
+    std::uint64_t m_num_regrows;
+
+    // the fullest cell of the frame, read without blocking along with the positions
+    cl_uint m_max_count;
+
+    std::vector<sf::Vector3f>& m_input_positions;
+    std::vector<sf::Vector3f>& m_input_velocities;
+    std::vector<float>& m_input_masses;
+
+    cl_float4* m_positions;
+    cl_float4* m_velocities;
+
+    float m_time_step;
+    std::size_t m_num_particles;
+    std::size_t m_steps_per_frame;
+    std::uint64_t m_step_count;
+
+    std::size_t m_workgroup_size;
+    std::size_t m_total_workitems;
+
+    Profiler* m_profiler;
+    std::vector<std::pair<ProfilePhase, cl::Event>> m_profiled_commands;
+
+    bool validate_inputs() const;
+    bool setup_platform();
+    bool setup_context();
+    bool setup_device();
+    bool setup_program();
+    bool setup_command_queue();
+    bool setup_input_data();
+    bool setup_buffers();
+    bool setup_kernels();
+    bool setup_cell_buffer();
+    bool update_grid_arguments();
+    bool set_grid_arguments();
+    bool bin_particles(const cl::Buffer& positions);
+    bool queue_forces(const cl::Buffer& forces, const cl::Buffer& positions);
+    bool save_frame_state();
+    bool restore_frame_state();
+    bool run_step();
+    bool read_positions();
+    void profile_command(ProfilePhase phase, const cl::Event& event);
+    bool read_profiled_commands();
+
+public:
+    ShortRangeGPUVelocityVerlet(std::size_t num_particles,
+        float time_step,
+        std::vector<sf::Vector3f>& positions,
+        std::vector<sf::Vector3f>& velocities,
+        std::vector<float>& masses,
+        ShortRangeParameters parameters = ShortRangeParameters(),
+        std::size_t steps_per_frame = 1u,
+        std::optional<OpenCLDevice> device = std::nullopt)
+        : m_selected_device(device),
+        m_build_options(BUILD_OPTIONS + ((parameters.law == ShortRangeLaw::Yukawa) ? " -D SHORT_RANGE_YUKAWA" : " -D SHORT_RANGE_LENNARD_JONES")),
+        m_program_from_cache(false),
+        m_program_setup_seconds(0.0),
+        m_buffer_size_bytes(0u),
+        m_front_buffer_idx(0u),
+        m_back_buffer_idx(1u),
+        m_forces_computed(false),
+        m_parameters(parameters),
+        m_grid(),
+        m_cell_capacity(INITIAL_CELL_CAPACITY),
+        m_cell_buffer_size(0u),
+        m_num_regrows(0u),
+        m_max_count(0u),
+        m_input_positions(positions),
+        m_input_velocities(velocities),
+        m_input_masses(masses),
+        m_positions(nullptr),
+        m_velocities(nullptr),
+        m_time_step(time_step),
+        m_num_particles(num_particles),
+        m_steps_per_frame(std::max<std::size_t>(steps_per_frame, 1u)),
+        m_step_count(0u),
+        m_workgroup_size(WORKGROUP_SIZE),
+        m_total_workitems(num_particles),
+        m_profiler(nullptr)
+    {}
+
+    ~ShortRangeGPUVelocityVerlet()
+    {
+        if (m_command_queue.has_value())
+        {
+            try
+            {
+                m_command_queue->finish();
+            }
+            catch (const cl::Error&)
+            {
+            }
+        }
+
+        if (m_positions != nullptr)
+        {
+            free_aligned(m_positions);
+            m_positions = nullptr;
+        }
+
+        if (m_velocities != nullptr)
+        {
+            free_aligned(m_velocities);
+            m_velocities = nullptr;
+        }
+    }
+
+    void initialize() override;
+
+    void run(std::vector<sf::Vertex>& vertices) override;
+
+    void set_profiler(Profiler* profiler) override;
+};
+
+#endif // !SHORT_RANGE_GPU_VELOCITY_VERLET_HPP_
@@ -0,0 +1,414 @@
+#include "ShortRangeVelocityVerlet.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <utility>
+
+void ShortRangeVelocityVerlet::build_cell_list()
+{
+    const float range = m_parameters.cutoff + m_parameters.skin;
+
+    m_grid = fit_cell_grid(m_reference_positions.x.data(),
+        m_reference_positions.y.data(),
+        m_reference_positions.z.data(),
+        m_num_particles,
+        range,
+        MAX_CELLS_PER_AXIS);
+
+    // an empty border cell on every side lets the particles drift a cell outwards before
+    // the grid has to be fitted again
+    for (std::size_t axis = 0; axis < 3; ++axis)
+    {
+        m_grid.origin[axis] -= m_grid.cell_size;
+        m_grid.dims[axis] += 2u;
+    }
+
+    sort_cells();
+}
+
+void ShortRangeVelocityVerlet::sort_cells()
+{
+    const std::size_t num_cells = m_grid.get_num_cells();
+
+    // counting sort of the particles by cell, the arrays keep their capacity between builds
+    m_particle_cells.resize(m_num_particles);
+    m_cell_starts.assign(num_cells + 1u, 0u);
+    m_cell_particles.resize(m_num_particles);
+
+    for (std::size_t i = 0; i < m_num_particles; ++i)
+    {
+        const std::size_t cell = m_grid.get_cell_index(m_grid.get_cell_coordinate(m_reference_positions.x[i], 0),
+            m_grid.get_cell_coordinate(m_reference_positions.y[i], 1),
+            m_grid.get_cell_coordinate(m_reference_positions.z[i], 2));
+
+        m_particle_cells[i] = static_cast<std::uint32_t>(cell);
+        ++m_cell_starts[cell + 1u];
+    }
+
+    for (std::size_t cell = 0; cell < num_cells; ++cell)
+    {
+        m_cell_starts[cell + 1u] += m_cell_starts[cell];
+    }
+
+    std::vector<std::uint32_t> fill(m_cell_starts.begin(), m_cell_starts.end() - 1);
+
+    for (std::size_t i = 0; i < m_num_particles; ++i)
+    {
+        m_cell_particles[fill[m_particle_cells[i]]++] = static_cast<std::uint32_t>(i);
+    }
+}
+
+template <typename Accept>
+void ShortRangeVelocityVerlet::append_neighbors(std::uint32_t i, Accept accept, std::vector<std::uint32_t>& neighbors) const
+{
+    const float range = m_parameters.cutoff + m_parameters.skin;
+    const float sqr_range = range * range;
+
+    const std::uint32_t cell_x = m_grid.get_cell_coordinate(m_reference_positions.x[i], 0);
+    const std::uint32_t cell_y = m_grid.get_cell_coordinate(m_reference_positions.y[i], 1);
+    const std::uint32_t cell_z = m_grid.get_cell_coordinate(m_reference_positions.z[i], 2);
+
+    for (std::uint32_t z = (cell_z > 0) ? cell_z - 1 : 0; z <= std::min(cell_z + 1, m_grid.dims[2] - 1); ++z)
+    {
+        for (std::uint32_t y = (cell_y > 0) ? cell_y - 1 : 0; y <= std::min(cell_y + 1, m_grid.dims[1] - 1); ++y)
+        {
+            for (std::uint32_t x = (cell_x > 0) ? cell_x - 1 : 0; x <= std::min(cell_x + 1, m_grid.dims[0] - 1); ++x)
+            {
+                const std::size_t cell = m_grid.get_cell_index(x, y, z);
+
+                for (std::uint32_t k = m_cell_starts[cell]; k < m_cell_starts[cell + 1u]; ++k)
+                {
+                    const std::uint32_t j = m_cell_particles[k];
+
+                    if ((j == i) || !accept(j))
+                    {
+                        continue;
+                    }
+
+                    const float diff_x = m_reference_positions.x[j] - m_reference_positions.x[i];
+                    const float diff_y = m_reference_positions.y[j] - m_reference_positions.y[i];
+                    const float diff_z = m_reference_positions.z[j] - m_reference_positions.z[i];
+
+                    if (diff_x * diff_x + diff_y * diff_y + diff_z * diff_z < sqr_range)
+                    {
+                        neighbors.push_back(j);
+                    }
+                }
+            }
+        }
+    }
+}
+
+void ShortRangeVelocityVerlet::build_neighbor_list()
+{
+    std::copy(m_particles.x.begin(), m_particles.x.end(), m_reference_positions.x.begin());
+    std::copy(m_particles.y.begin(), m_particles.y.end(), m_reference_positions.y.begin());
+    std::copy(m_particles.z.begin(), m_particles.z.end(), m_reference_positions.z.begin());
+
+    build_cell_list();
+
+    m_neighbor_starts.resize(m_num_particles + 1u);
+    m_neighbors.clear();
+
+    for (std::uint32_t i = 0; i < m_num_particles; ++i)
+    {
+        m_neighbor_starts[i] = static_cast<std::uint32_t>(m_neighbors.size());
+
+        append_neighbors(i, [i](std::uint32_t j) { return j > i; }, m_neighbors);
+    }
+
+    m_neighbor_starts[m_num_particles] = static_cast<std::uint32_t>(m_neighbors.size());
+
+    m_has_neighbor_list = true;
+    ++m_num_rebuilds;
+}
+
+void ShortRangeVelocityVerlet::rebuild_moved_neighbors()
+{
+    // the moved particles start over from their current positions, the grid is kept
+    bool changed_cell = false;
+
+    for (std::uint32_t i : m_moved_particles)
+    {
+        m_reference_positions.x[i] = m_particles.x[i];
+        m_reference_positions.y[i] = m_particles.y[i];
+        m_reference_positions.z[i] = m_particles.z[i];
+
+        const std::size_t cell = m_grid.get_cell_index(m_grid.get_cell_coordinate(m_reference_positions.x[i], 0),
+            m_grid.get_cell_coordinate(m_reference_positions.y[i], 1),
+            m_grid.get_cell_coordinate(m_reference_positions.z[i], 2));
+
+        changed_cell = changed_cell || (cell != m_particle_cells[i]);
+    }
+
+    if (changed_cell)
+    {
+        sort_cells();
+    }
+
+    // the other particles keep their pairs with particles that did not move, a moved particle
+    // lists all of its pairs except those with a moved particle of lower index
+    m_spare_neighbor_starts.resize(m_num_particles + 1u);
+    m_spare_neighbors.clear();
+
+    for (std::uint32_t i = 0; i < m_num_particles; ++i)
+    {
+        m_spare_neighbor_starts[i] = static_cast<std::uint32_t>(m_spare_neighbors.size());
+
+        if (m_moved_flags[i])
+        {
+            append_neighbors(i, [this, i](std::uint32_t j) { return !m_moved_flags[j] || (j > i); }, m_spare_neighbors);
+        }
+        else
+        {
+            for (std::uint32_t k = m_neighbor_starts[i]; k < m_neighbor_starts[i + 1u]; ++k)
+            {
+                if (!m_moved_flags[m_neighbors[k]])
+                {
+                    m_spare_neighbors.push_back(m_neighbors[k]);
+                }
+            }
+        }
+    }
+
+    m_spare_neighbor_starts[m_num_particles] = static_cast<std::uint32_t>(m_spare_neighbors.size());
+
+    m_neighbor_starts.swap(m_spare_neighbor_starts);
+    m_neighbors.swap(m_spare_neighbors);
+
+    ++m_num_partial_rebuilds;
+}
+
+void ShortRangeVelocityVerlet::find_moved_particles()
+{
+    // a pair is listed when its reference positions are within cutoff + skin, two particles
+    // closing in on each other by skin / 2 each may just have entered the cutoff
+    const float half_skin = 0.5f * m_parameters.skin;
+    const float sqr_half_skin = half_skin * half_skin;
+
+    m_moved_particles.clear();
+
+    for (std::uint32_t i = 0; i < m_num_particles; ++i)
+    {
+        const float diff_x = m_particles.x[i] - m_reference_positions.x[i];
+        const float diff_y = m_particles.y[i] - m_reference_positions.y[i];
+        const float diff_z = m_particles.z[i] - m_reference_positions.z[i];
+
+        const bool moved = (diff_x * diff_x + diff_y * diff_y + diff_z * diff_z > sqr_half_skin);
+
+        m_moved_flags[i] = moved ? 1u : 0u;
+
+        if (moved)
+        {
+            m_moved_particles.push_back(i);
+        }
+    }
+}
+
+void ShortRangeVelocityVerlet::update_neighbor_list()
+{
+    if (!m_has_neighbor_list)
+    {
+        build_neighbor_list();
+        return;
+    }
+
+    find_moved_particles();
+
+    if (m_moved_particles.empty())
+    {
+        return;
+    }
+
+    // the grid only fits the reference positions, particles that left it would crowd its border cells
+    const bool left_grid = std::any_of(m_moved_particles.begin(), m_moved_particles.end(),
+        [this](std::uint32_t i)
+        {
+            return !m_grid.contains(m_particles.x[i], 0) || !m_grid.contains(m_particles.y[i], 1) || !m_grid.contains(m_particles.z[i], 2);
+        });
+
+    if (left_grid || (static_cast<float>(m_moved_particles.size()) > PARTIAL_REBUILD_FRACTION * static_cast<float>(m_num_particles)))
+    {
+        build_neighbor_list();
+    }
+    else
+    {
+        rebuild_moved_neighbors();
+    }
+}
+
+template <typename Potential>
+void ShortRangeVelocityVerlet::accumulate_forces()
+{
+    const float sqr_cutoff = m_parameters.cutoff * m_parameters.cutoff;
+
+    for (std::size_t i = 0; i < m_num_particles; ++i)
+    {
+        float force_x = 0.f;
+        float force_y = 0.f;
+        float force_z = 0.f;
+
+        for (std::uint32_t k = m_neighbor_starts[i]; k < m_neighbor_starts[i + 1u]; ++k)
+        {
+            const std::uint32_t j = m_neighbors[k];
+
+            const float diff_x = m_particles.x[j] - m_particles.x[i];
+            const float diff_y = m_particles.y[j] - m_particles.y[i];
+            const float diff_z = m_particles.z[j] - m_particles.z[i];
+
+            const float sqr_distance = diff_x * diff_x + diff_y * diff_y + diff_z * diff_z;
+
+            // the list includes the skin, coincident particles have no direction
+            if ((sqr_distance >= sqr_cutoff) || (sqr_distance <= 0.f))
+            {
+                continue;
+            }
+
+            const float scale = Potential::get_force_scale(m_parameters, sqr_distance);
+
+            force_x -= scale * diff_x;
+            force_y -= scale * diff_y;
+            force_z -= scale * diff_z;
+
+            m_new_forces.x[j] += scale * diff_x;
+            m_new_forces.y[j] += scale * diff_y;
+            m_new_forces.z[j] += scale * diff_z;
+        }
+
+        m_new_forces.x[i] += force_x;
+        m_new_forces.y[i] += force_y;
+        m_new_forces.z[i] += force_z;
+    }
+}
+
+void ShortRangeVelocityVerlet::compute_forces()
+{
+    update_neighbor_list();
+
+    m_new_forces.fill_zero();
+
+    // the law is resolved once per pass, the pair loop is specialized for it
+    if (m_parameters.law == ShortRangeLaw::LennardJones)
+    {
+        accumulate_forces<LennardJonesPotential>();
+    }
+    else
+    {
+        accumulate_forces<YukawaPotential>();
+    }
+}
+
+void ShortRangeVelocityVerlet::update_positions()
+{
+    for (std::size_t i = 0; i < m_num_particles; ++i)
+    {
+        float acceleration = m_time_step * 0.5f / m_particles.mass[i];
+
+        m_particles.x[i] += m_time_step * (m_velocities.x[i] + acceleration * m_new_forces.x[i]);
+        m_particles.y[i] += m_time_step * (m_velocities.y[i] + acceleration * m_new_forces.y[i]);
+        m_particles.z[i] += m_time_step * (m_velocities.z[i] + acceleration * m_new_forces.z[i]);
+    }
+
+    std::swap(m_old_forces, m_new_forces);
+}
+
+void ShortRangeVelocityVerlet::update_velocities()
+{
+    for (std::size_t i = 0; i < m_num_particles; ++i)
+    {
+        float acceleration = m_time_step * 0.5f / m_particles.mass[i];
+
+        m_velocities.x[i] += acceleration * (m_new_forces.x[i] + m_old_forces.x[i]);
+        m_velocities.y[i] += acceleration * (m_new_forces.y[i] + m_old_forces.y[i]);
+        m_velocities.z[i] += acceleration * (m_new_forces.z[i] + m_old_forces.z[i]);
+    }
+}
+
+void ShortRangeVelocityVerlet::initialize()
+{
+    if ((m_parameters.cutoff <= 0.f) || (m_parameters.skin < 0.f))
+    {
+        throw std::string("Short range cutoff and skin have to be positive");
+    }
+
+    std::cout << std::endl << "Short range law  : "
+        << ((m_parameters.law == ShortRangeLaw::LennardJones) ? "Lennard-Jones" : "Yukawa")
+        << ", cutoff " << m_parameters.cutoff << ", skin " << m_parameters.skin << std::endl;
+}
+
+void ShortRangeVelocityVerlet::run(std::vector<sf::Vertex>& vertices)
+{
+    // the forces at the end of a step are the forces at the start of the next one,
+    // so apart from the very first step there is one force evaluation per step
+    if (!m_forces_computed)
+    {
+        ProfileScope scope(m_profiler, ProfilePhase::Force);
+
+        compute_forces();
+        m_forces_computed = true;
+    }
+
+    // half kick and drift
+    {
+        ProfileScope scope(m_profiler, ProfilePhase::Drift);
+        update_positions();
+    }
+
+    {
+        ProfileScope scope(m_profiler, ProfilePhase::Force);
+        compute_forces();
+    }
+
+    // closing half kick with the new forces
+    {
+        ProfileScope scope(m_profiler, ProfilePhase::Kick);
+        update_velocities();
+    }
+
+    ++m_num_steps;
+
+    ProfileScope scope(m_profiler, ProfilePhase::VertexConversion);
+
+    vertices.resize(m_num_particles);
+
+    for (std::size_t i = 0; i < m_num_particles; ++i)
+    {
+        vertices[i] = sf::Vertex(sf::Vector2f(m_particles.x[i], m_particles.y[i]));
+    }
+}
+
+void ShortRangeVelocityVerlet::set_profiler(Profiler* profiler)
+{
+    m_profiler = profiler;
+}
+
+std::uint64_t ShortRangeVelocityVerlet::get_num_rebuilds() const
+{
+    return m_num_rebuilds;
+}
+
+std::size_t ShortRangeVelocityVerlet::get_num_neighbor_pairs() const
+{
+    return m_neighbors.size();
+}
+
+void ShortRangeVelocityVerlet::print_statistics(std::ostream& output) const
+{
+    const std::uint64_t num_updates = m_num_rebuilds + m_num_partial_rebuilds;
+
+    output << "Neighbor list : " << m_neighbors.size() << " pairs within " << m_parameters.cutoff + m_parameters.skin
+        << ", " << m_num_rebuilds << " full and " << m_num_partial_rebuilds << " partial builds over " << m_num_steps << " steps";
+
+    if (num_updates > 0)
+    {
+        const std::streamsize precision = output.precision();
+
+        output << " (" << std::fixed << std::setprecision(1)
+            << static_cast<double>(m_num_steps) / static_cast<double>(num_updates)
+            << " steps per build)" << std::defaultfloat << std::setprecision(precision);
+    }
+
+    output << std::endl;
+}
@@ -0,0 +1,122 @@
+#ifndef SHORT_RANGE_VELOCITY_VERLET_HPP_
+#define SHORT_RANGE_VELOCITY_VERLET_HPP_
+
+#include "IAlgorithmStrategy.hpp"
+#include "IProfileable.hpp"
+#include "ParticleArrays.hpp"
+#include "ShortRange.hpp"
+
+#include <cstdint>
+#include <ostream>
+#include <SFML/System/Vector3.hpp>
+#include <vector>
+
+// cutoff force laws with a Verlet neighbor list. the list holds every pair whose reference
+// positions are within cutoff + skin. only the pairs of particles that moved more than
+// skin / 2 from their reference position are searched again, through a cell list, so a
+// step costs O(N) instead of O(N^2)
+class ShortRangeVelocityVerlet : public IAlgorithmStrategy, public IProfileable
+{
+private:
+    const std::uint32_t MAX_CELLS_PER_AXIS = 128u;
+
+    // the lists are rebuilt from scratch once more than this fraction of the particles moved
+    const float PARTIAL_REBUILD_FRACTION = 0.05f;
+
+    void build_cell_list();
+    void sort_cells();
+    template <typename Accept>
+    void append_neighbors(std::uint32_t i, Accept accept, std::vector<std::uint32_t>& neighbors) const;
+    void build_neighbor_list();
+    void rebuild_moved_neighbors();
+    void find_moved_particles();
+    void update_neighbor_list();
+    void compute_forces();
+    template <typename Potential>
+    void accumulate_forces();
+    void update_positions();
+    void update_velocities();
+
+    ShortRangeParameters m_parameters;
+
+    ParticleArrays m_particles;
+    VectorArrays   m_velocities;
+    VectorArrays   m_old_forces;
+    VectorArrays   m_new_forces;
+
+    // m_new_forces holds the forces at the current positions
+    bool m_forces_computed;
+
+    // particles sorted by cell, m_cell_starts[c] .. m_cell_starts[c + 1] index m_cell_particles
+    CellGrid m_grid;
+    std::vector<std::uint32_t> m_particle_cells;
+    std::vector<std::uint32_t> m_cell_starts;
+    std::vector<std::uint32_t> m_cell_particles;
+
+    // half list, every pair is listed once under one of its particles. the partners of
+    // particle i are m_neighbors[m_neighbor_starts[i] .. m_neighbor_starts[i + 1]]
+    std::vector<std::uint32_t> m_neighbor_starts;
+    std::vector<std::uint32_t> m_neighbors;
+
+    // the list being merged by a partial rebuild, swapped with the current one
+    std::vector<std::uint32_t> m_spare_neighbor_starts;
+    std::vector<std::uint32_t> m_spare_neighbors;
+
+    // positions the pairs of every particle were last searched from, the cell list sorts these
+    VectorArrays m_reference_positions;
+    bool m_has_neighbor_list;
+
+    // particles more than skin / 2 away from their reference position
+    std::vector<std::uint32_t> m_moved_particles;
+    std::vector<std::uint8_t> m_moved_flags;
+
+    float m_time_step;
+    std::size_t m_num_particles;
+
+    std::uint64_t m_num_steps;
+    std::uint64_t m_num_rebuilds;
+    std::uint64_t m_num_partial_rebuilds;
+
+    Profiler* m_profiler;
+
+public:
+    ShortRangeVelocityVerlet(std::size_t num_particles,
+        float time_step,
+        std::vector<sf::Vector3f> positions,
+        std::vector<sf::Vector3f> velocities,
+        std::vector<float> masses,
+        ShortRangeParameters parameters = ShortRangeParameters())
+        : m_parameters(parameters),
+        m_particles(positions, masses),
+        m_velocities(velocities),
+        m_old_forces(num_particles),
+        m_new_forces(num_particles),
+        m_forces_computed(false),
+        m_grid(),
+        m_reference_positions(num_particles),
+        m_has_neighbor_list(false),
+        m_moved_flags(num_particles, 0u),
+        m_time_step(time_step),
+        m_num_particles(num_particles),
+        m_num_steps(0u),
+        m_num_rebuilds(0u),
+        m_num_partial_rebuilds(0u),
+        m_profiler(nullptr)
+    {}
+
+    ~ShortRangeVelocityVerlet()
+    {}
+
+    void initialize() override;
+
+    void run(std::vector<sf::Vertex>& vertices) override;
+
+    void set_profiler(Profiler* profiler) override;
+
+    std::uint64_t get_num_rebuilds() const;
+    std::size_t get_num_neighbor_pairs() const;
+
+    void print_statistics(std::ostream& output) const;
+};
+
+#endif // !SHORT_RANGE_VELOCITY_VERLET_HPP_
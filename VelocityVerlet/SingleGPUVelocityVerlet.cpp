@@ -1,9 +1,10 @@
 #include "SingleGPUVelocityVerlet.hpp"
 
+#include "ProgramBinaryCache.hpp"
+
 #include <algorithm>
+#include <chrono>
 #include <iostream>
-#include <fstream>
-#include <sstream>
 
 bool SingleGPUVelocityVerlet::validate_inputs() const
 {
@@ -27,16 +28,11 @@ bool SingleGPUVelocityVerlet::setup_platform()
 {
     try
     {
-        std::vector<cl::Platform> platforms;
-
-        cl::Platform::get(&platforms);
-
-        if (platforms.empty())
+        if (!select_opencl_platform(m_selected_device, m_platform))
         {
             return false;
         }
 
-        m_platform = platforms.front();
         m_platform_name = m_platform.getInfo<CL_PLATFORM_NAME>();
         m_platform_vendor = m_platform.getInfo<CL_PLATFORM_VENDOR>();
 
@@ -55,14 +51,7 @@ bool SingleGPUVelocityVerlet::setup_context()
 {
     try
     {
-        cl_context_properties props[3] =
-        {
-            CL_CONTEXT_PLATFORM,
-            (cl_context_properties)(m_platform)(),
-            0
-        };
-
-        m_context = cl::Context(CL_DEVICE_TYPE_GPU, props, NULL, NULL);
+        m_context = create_opencl_context(m_platform, m_selected_device);
 
         return true;
     }
@@ -87,12 +76,7 @@ bool SingleGPUVelocityVerlet::setup_device()
         }
 
         m_device = devices.front();
-
-#ifdef CL_DEVICE_BOARD_NAME_AMD
-        m_device_name = m_device.getInfo<CL_DEVICE_BOARD_NAME_AMD>();
-#else
-        m_device_name = m_device.getInfo<CL_DEVICE_NAME>();
-#endif
+        m_device_name = get_opencl_device_name(m_device);
 
         return true;
     }
@@ -107,18 +91,20 @@ bool SingleGPUVelocityVerlet::setup_device()
 
 bool SingleGPUVelocityVerlet::setup_program()
 {
+    const auto start = std::chrono::steady_clock::now();
+
     try
     {
-        std::ifstream file_stream(KERNEL_FILE_NAME);
-        std::stringstream buffer;
-        buffer << file_stream.rdbuf();
-
-        std::string kernel_code(buffer.str());
+        std::string kernel_code;
 
-        cl::Program::Sources sources{ kernel_code };
+        if (!read_kernel_sources({ KERNEL_FILE_NAME }, kernel_code))
+        {
+            return false;
+        }
 
-        m_program = cl::Program(m_context, kernel_code);
-        m_program.build(m_device, BUILD_OPTIONS.data());
+        m_program = build_cached_program(m_context, m_device, kernel_code, m_build_options,
+            PROGRAM_CACHE_DIRECTORY, &m_program_from_cache);
+        m_program_setup_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 
         return true;
     }
@@ -127,10 +113,6 @@ bool SingleGPUVelocityVerlet::setup_program()
         std::cout << "Error: " << e.err() << std::endl;
         std::cout << "Exception: " << e.what() << std::endl;
 
-        std::cout << "Build status: " << m_program.getBuildInfo<CL_PROGRAM_BUILD_STATUS>(m_device) << std::endl;
-        std::cout << "Build options: " << m_program.getBuildInfo<CL_PROGRAM_BUILD_OPTIONS>(m_device) << std::endl;
-        std::cout << "Build log: " << m_program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(m_device) << std::endl;
-
         return false;
     }
     catch (const std::exception& e)
@@ -162,8 +144,8 @@ bool SingleGPUVelocityVerlet::setup_input_data()
 {
     m_buffer_size_bytes = m_num_particles * sizeof(cl_float4);
 
-    m_positions = (cl_float4*)_aligned_malloc(m_buffer_size_bytes, 16);
-    m_velocities = (cl_float4*)_aligned_malloc(m_buffer_size_bytes, 16);
+    m_positions = static_cast<cl_float4*>(allocate_aligned(m_buffer_size_bytes, 16));
+    m_velocities = static_cast<cl_float4*>(allocate_aligned(m_buffer_size_bytes, 16));
 
     if ((m_positions == nullptr) || (m_velocities == nullptr))
     {
@@ -224,8 +206,38 @@ bool SingleGPUVelocityVerlet::setup_buffers()
             m_buffer_size_bytes,
             NULL);
 
-        // output buffer for copying results from device (this should be a pinned buffer)
-        m_output_buffer = cl::Buffer(m_context, CL_MEM_USE_HOST_PTR, m_buffer_size_bytes, m_positions);
+        if (m_reorderer.is_enabled())
+        {
+            m_order_buffer = cl::Buffer(m_context,
+                CL_MEM_READ_ONLY,
+                m_num_particles * sizeof(cl_uint),
+                NULL);
+
+            m_velocities_scratch_buffer = cl::Buffer(m_context,
+                CL_MEM_READ_WRITE,
+                m_buffer_size_bytes,
+                NULL);
+        }
+
+        // ring of pinned output buffers, mapped once so reads from the device land directly
+        // in host memory the renderer can consume while the next frame is computed
+        m_output_buffers.resize(OUTPUT_RING_SIZE);
+        m_output_positions.resize(OUTPUT_RING_SIZE, nullptr);
+        m_output_events.resize(OUTPUT_RING_SIZE);
+
+        for (std::size_t slot = 0; slot < OUTPUT_RING_SIZE; ++slot)
+        {
+            m_output_buffers[slot] = cl::Buffer(m_context,
+                CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR,
+                m_buffer_size_bytes,
+                NULL);
+
+            m_output_positions[slot] = static_cast<cl_float4*>(m_command_queue->enqueueMapBuffer(m_output_buffers[slot],
+                CL_TRUE,
+                CL_MAP_READ | CL_MAP_WRITE,
+                0,
+                m_buffer_size_bytes));
+        }
 
         return true;
     }
@@ -242,11 +254,25 @@ bool SingleGPUVelocityVerlet::setup_kernels()
 {
     try
     {
+        const cl_uint num_particles = static_cast<cl_uint>(m_num_particles);
+
         m_force_kernel = cl::Kernel(m_program, FORCE_KERNEL_NAME.data());
 
+        // the work-group size has to fit the device and the compiled kernel, CPU runtimes
+        // allow less than GPUs
+        m_workgroup_size = std::min({ WORKGROUP_SIZE,
+            m_device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>(),
+            m_force_kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(m_device) });
+
+        // pad the global size to whole work-groups, the kernels skip the padding items
+        m_total_workitems = ((m_num_particles + m_workgroup_size - 1) / m_workgroup_size) * m_workgroup_size;
+
         m_force_kernel.setArg(0, m_forces_buffers[m_front_buffer_idx]);
         m_force_kernel.setArg(1, m_positions_buffers[m_front_buffer_idx]);
-        m_force_kernel.setArg(2, WORKGROUP_SIZE * sizeof(cl_float4), NULL);
+        m_force_kernel.setArg(2, m_workgroup_size * sizeof(cl_float4), NULL);
+        m_force_kernel.setArg(3, num_particles);
+        m_force_kernel.setArg(4, cl_uint(0));
+        m_force_kernel.setArg(5, num_particles);
 
         m_positions_kernel = cl::Kernel(m_program, POSITIONS_KERNEL_NAME.data());
 
@@ -255,6 +281,8 @@ bool SingleGPUVelocityVerlet::setup_kernels()
         m_positions_kernel.setArg(2, m_positions_buffers[m_back_buffer_idx]);
         m_positions_kernel.setArg(3, m_velocities_buffer);
         m_positions_kernel.setArg(4, m_time_step);
+        m_positions_kernel.setArg(5, num_particles);
+        m_positions_kernel.setArg(6, cl_uint(0));
 
         m_velocities_kernel = cl::Kernel(m_program, VELOCITY_KERNEL_NAME.data());
 
@@ -262,6 +290,36 @@ bool SingleGPUVelocityVerlet::setup_kernels()
         m_velocities_kernel.setArg(1, m_forces_buffers[1]);
         m_velocities_kernel.setArg(2, m_velocities_buffer);
         m_velocities_kernel.setArg(3, m_time_step);
+        m_velocities_kernel.setArg(4, num_particles);
+
+        if (m_reorderer.is_enabled())
+        {
+            m_permute_kernel = cl::Kernel(m_program, PERMUTE_KERNEL_NAME.data());
+
+            m_permute_kernel.setArg(2, m_order_buffer);
+            m_permute_kernel.setArg(3, num_particles);
+        }
+
+        // the diagnostics kernels take the partial sums buffers as extra arguments
+        if (m_diagnostics != nullptr)
+        {
+            m_num_workgroups = m_total_workitems / m_workgroup_size;
+
+            const std::size_t num_partials = OUTPUT_RING_SIZE * m_steps_per_frame * m_num_workgroups;
+
+            m_potential_partials_buffer = cl::Buffer(m_context, CL_MEM_READ_WRITE, num_partials * sizeof(cl_float), NULL);
+            m_kinetic_partials_buffer = cl::Buffer(m_context, CL_MEM_READ_WRITE, num_partials * sizeof(cl_float4), NULL);
+
+            m_potential_partials.resize(num_partials);
+            m_kinetic_partials.resize(num_partials);
+
+            m_force_kernel.setArg(6, m_potential_partials_buffer);
+            m_force_kernel.setArg(7, cl_uint(0));
+
+            m_velocities_kernel.setArg(5, m_workgroup_size * sizeof(cl_float4), NULL);
+            m_velocities_kernel.setArg(6, m_kinetic_partials_buffer);
+            m_velocities_kernel.setArg(7, cl_uint(0));
+        }
 
         return true;
     }
@@ -278,13 +336,26 @@ bool SingleGPUVelocityVerlet::update_kernel_arguments()
 {
     try
     {
-        std::swap(m_front_buffer_idx, m_back_buffer_idx);
-
-        m_force_kernel.setArg(0, m_forces_buffers[m_front_buffer_idx]);
-
+        // drift from the front positions into the back positions using the front forces
+        m_positions_kernel.setArg(0, m_forces_buffers[m_front_buffer_idx]);
         m_positions_kernel.setArg(1, m_positions_buffers[m_front_buffer_idx]);
         m_positions_kernel.setArg(2, m_positions_buffers[m_back_buffer_idx]);
 
+        // forces at the back positions, these are carried over to the next step
+        m_force_kernel.setArg(0, m_forces_buffers[m_back_buffer_idx]);
+        m_force_kernel.setArg(1, m_positions_buffers[m_back_buffer_idx]);
+
+        // kick with the front (old) and back (new) forces
+        m_velocities_kernel.setArg(0, m_forces_buffers[m_front_buffer_idx]);
+        m_velocities_kernel.setArg(1, m_forces_buffers[m_back_buffer_idx]);
+
+        // partial sums of this step, the extra first force pass writes the same range first
+        if (m_diagnostics != nullptr)
+        {
+            m_force_kernel.setArg(7, m_partial_offset);
+            m_velocities_kernel.setArg(7, m_partial_offset);
+        }
+
         return true;
     }
     catch (const cl::Error& e)
@@ -296,72 +367,217 @@ bool SingleGPUVelocityVerlet::update_kernel_arguments()
     }
 }
 
-bool SingleGPUVelocityVerlet::queue_commands()
+bool SingleGPUVelocityVerlet::reorder_particles()
 {
     try
     {
-        std::vector<cl::Event> pos_event(1);
-        std::vector<cl::Event> force_event(1);
-        std::vector<cl::Event> vel_event(1);
-        std::vector<cl::Event> read_event(1);
+        // the sort needs the current positions on the host, so the device is drained
+        // once per reorder interval
+        m_command_queue->finish();
+        m_command_queue->enqueueReadBuffer(m_positions_buffers[m_front_buffer_idx], CL_TRUE, 0, m_buffer_size_bytes, m_positions);
 
-        if (m_command_queue.has_value())
+        if (!m_reorderer.compute_order(&m_positions[0].s[0], &m_positions[0].s[1], &m_positions[0].s[2], m_step_count, 4u))
         {
-            // computes forces
-            m_command_queue->enqueueNDRangeKernel(m_force_kernel,
-                cl::NullRange,
-                cl::NDRange(m_total_workitems),
-                cl::NDRange(WORKGROUP_SIZE),
-                NULL,
-                &force_event[0]);
+            return true;
+        }
 
-            // compute positions
-            m_command_queue->enqueueNDRangeKernel(m_positions_kernel,
+        const std::vector<std::uint32_t>& order = m_reorderer.get_order();
+
+        m_command_queue->enqueueWriteBuffer(m_order_buffer, CL_TRUE, 0, order.size() * sizeof(cl_uint), order.data());
+
+        // front positions and forces are gathered into the back buffers, which the next
+        // step overwrites anyway
+        const std::pair<cl::Buffer*, cl::Buffer*> permutations[] =
+        {
+            { &m_positions_buffers[m_front_buffer_idx], &m_positions_buffers[m_back_buffer_idx] },
+            { &m_forces_buffers[m_front_buffer_idx], &m_forces_buffers[m_back_buffer_idx] },
+            { &m_velocities_buffer, &m_velocities_scratch_buffer }
+        };
+
+        for (const auto& permutation : permutations)
+        {
+            m_permute_kernel.setArg(0, *permutation.first);
+            m_permute_kernel.setArg(1, *permutation.second);
+
+            m_command_queue->enqueueNDRangeKernel(m_permute_kernel,
                 cl::NullRange,
                 cl::NDRange(m_total_workitems),
-                cl::NDRange(WORKGROUP_SIZE),
-                NULL,
-                &pos_event[0]);
+                cl::NDRange(m_workgroup_size));
+        }
 
-            // we don't wanna override the newly computed forces so we switch buffers
-            m_force_kernel.setArg(0, m_forces_buffers[m_back_buffer_idx]);
+        std::swap(m_front_buffer_idx, m_back_buffer_idx);
+        std::swap(m_velocities_buffer, m_velocities_scratch_buffer);
 
-            // set the buffer that contains the newly updated positions
-            m_force_kernel.setArg(1, m_positions_buffers[m_back_buffer_idx]);
+        m_positions_kernel.setArg(3, m_velocities_buffer);
+        m_velocities_kernel.setArg(2, m_velocities_buffer);
+
+        // the pending frame is shown next and was read in the old order
+        if (m_has_pending_frame)
+        {
+            m_reorderer.apply(m_output_positions[m_pending_slot], m_positions);
+        }
+
+        return true;
+    }
+    catch (const cl::Error& e)
+    {
+        std::cout << "Error: " << e.err() << std::endl;
+        std::cout << "Exception: " << e.what() << std::endl;
+
+        return false;
+    }
+}
+
+bool SingleGPUVelocityVerlet::queue_step()
+{
+    try
+    {
+        m_step_wait_events.clear();
+
+        // the forces at the front positions are only computed for the very first step,
+        // after that they are the forces computed at the end of the previous step
+        if (!m_forces_computed)
+        {
+            m_force_kernel.setArg(0, m_forces_buffers[m_front_buffer_idx]);
+            m_force_kernel.setArg(1, m_positions_buffers[m_front_buffer_idx]);
 
-            // re-compute forces after updating positions
             m_command_queue->enqueueNDRangeKernel(m_force_kernel,
                 cl::NullRange,
                 cl::NDRange(m_total_workitems),
-                cl::NDRange(WORKGROUP_SIZE),
-                &pos_event,
-                &force_event[0]);
+                cl::NDRange(m_workgroup_size),
+                NULL,
+                &m_force_events[0]);
 
-            // compute velocities
-            m_command_queue->enqueueNDRangeKernel(m_velocities_kernel,
-                cl::NullRange,
-                cl::NDRange(m_total_workitems),
-                cl::NDRange(WORKGROUP_SIZE),
-                &force_event,
-                &vel_event[0]);
-
-            // copy positions from device
-            m_command_queue->enqueueCopyBuffer(m_positions_buffers[m_back_buffer_idx],
-                m_output_buffer,
-                0, // source offset
-                0, // destination offset
-                m_buffer_size_bytes,
-                &force_event,
-                &read_event[0]);
+            profile_command(ProfilePhase::Force, m_force_events[0], OUTPUT_RING_SIZE);
 
-            // sync
-            m_command_queue->finish();
+            m_step_wait_events.push_back(m_force_events[0]);
+            m_forces_computed = true;
+        }
+        else
+        {
+            // the previous step ends with the velocity update
+            m_step_wait_events.push_back(m_velocities_events[0]);
+        }
 
-            // swap buffers and update kernel arguments
-            if (!update_kernel_arguments())
+        // the positions kernel overwrites a buffer an earlier output read may still use
+        if (m_has_output_event)
+        {
+            m_step_wait_events.push_back(m_last_output_event);
+        }
+
+        if (!update_kernel_arguments())
+        {
+            return false;
+        }
+
+        // compute positions
+        m_command_queue->enqueueNDRangeKernel(m_positions_kernel,
+            cl::NullRange,
+            cl::NDRange(m_total_workitems),
+            cl::NDRange(m_workgroup_size),
+            &m_step_wait_events,
+            &m_positions_events[0]);
+
+        profile_command(ProfilePhase::Drift, m_positions_events[0], OUTPUT_RING_SIZE);
+
+        // compute forces at the new positions, the only force evaluation of the step
+        m_command_queue->enqueueNDRangeKernel(m_force_kernel,
+            cl::NullRange,
+            cl::NDRange(m_total_workitems),
+            cl::NDRange(m_workgroup_size),
+            &m_positions_events,
+            &m_force_events[0]);
+
+        profile_command(ProfilePhase::Force, m_force_events[0], OUTPUT_RING_SIZE);
+
+        // compute velocities
+        m_command_queue->enqueueNDRangeKernel(m_velocities_kernel,
+            cl::NullRange,
+            cl::NDRange(m_total_workitems),
+            cl::NDRange(m_workgroup_size),
+            &m_force_events,
+            &m_velocities_events[0]);
+
+        profile_command(ProfilePhase::Kick, m_velocities_events[0], OUTPUT_RING_SIZE);
+
+        // the new positions and forces become the input of the next step
+        std::swap(m_front_buffer_idx, m_back_buffer_idx);
+
+        return true;
+    }
+    catch (const cl::Error& e)
+    {
+        std::cout << "Error: " << e.err() << std::endl;
+        std::cout << "Exception: " << e.what() << std::endl;
+
+        return false;
+    }
+}
+
+bool SingleGPUVelocityVerlet::queue_commands(std::size_t output_slot)
+{
+    try
+    {
+        if (m_command_queue.has_value())
+        {
+            if (m_reorderer.is_due(m_step_count) && !reorder_particles())
             {
                 return false;
             }
+
+            m_slot_first_steps[output_slot] = m_step_count + 1;
+            m_slot_has_diagnostics[output_slot] = (m_diagnostics != nullptr);
+
+            // the steps of a frame are only chained by events, the host does not wait in between
+            for (std::size_t step = 0; step < m_steps_per_frame; ++step)
+            {
+                m_partial_offset = static_cast<cl_uint>((output_slot * m_steps_per_frame + step) * m_num_workgroups);
+
+                if (!queue_step())
+                {
+                    return false;
+                }
+
+                ++m_step_count;
+            }
+
+            // the queue is in order, so these have finished once the positions read has
+            if (m_diagnostics != nullptr)
+            {
+                const std::size_t first = output_slot * m_steps_per_frame * m_num_workgroups;
+                const std::size_t count = m_steps_per_frame * m_num_workgroups;
+
+                m_command_queue->enqueueReadBuffer(m_potential_partials_buffer,
+                    CL_FALSE,
+                    first * sizeof(cl_float),
+                    count * sizeof(cl_float),
+                    m_potential_partials.data() + first,
+                    &m_velocities_events);
+
+                m_command_queue->enqueueReadBuffer(m_kinetic_partials_buffer,
+                    CL_FALSE,
+                    first * sizeof(cl_float4),
+                    count * sizeof(cl_float4),
+                    m_kinetic_partials.data() + first,
+                    &m_velocities_events);
+            }
+
+            // non-blocking read of the latest positions into the pinned output slot
+            m_command_queue->enqueueReadBuffer(m_positions_buffers[m_front_buffer_idx],
+                CL_FALSE,
+                0,
+                m_buffer_size_bytes,
+                m_output_positions[output_slot],
+                &m_positions_events,
+                &m_output_events[output_slot]);
+
+            profile_command(ProfilePhase::Transfer, m_output_events[output_slot], output_slot);
+
+            m_last_output_event = m_output_events[output_slot];
+            m_has_output_event = true;
+
+            // submit the frame to the device without waiting for it
+            m_command_queue->flush();
         }
 
         return true;
@@ -375,6 +591,23 @@ bool SingleGPUVelocityVerlet::queue_commands()
     }
 }
 
+bool SingleGPUVelocityVerlet::wait_for_output(std::size_t output_slot)
+{
+    try
+    {
+        m_output_events[output_slot].wait();
+
+        return true;
+    }
+    catch (const cl::Error& e)
+    {
+        std::cout << "Error: " << e.err() << std::endl;
+        std::cout << "Exception: " << e.what() << std::endl;
+
+        return false;
+    }
+}
+
 void SingleGPUVelocityVerlet::initialize()
 {
     if (!validate_inputs())
@@ -408,7 +641,14 @@ void SingleGPUVelocityVerlet::initialize()
         throw std::string("Failed to setup context");
     }
 
-    if (!setup_program())
+    if (setup_program())
+    {
+        // cold start builds from source, warm start loads the cached binary
+        std::cout << std::endl << "Program setup is OK" << std::endl;
+        std::cout << "Program source  : " << (m_program_from_cache ? "cached binary (warm start)" : "built from source (cold start)") << std::endl;
+        std::cout << "Setup time (ms) : " << m_program_setup_seconds * 1e3 << std::endl;
+    }
+    else
     {
         throw std::string("Failed to setup program");
     }
@@ -434,31 +674,360 @@ void SingleGPUVelocityVerlet::initialize()
         throw std::string("Failed to setup buffers");
     }
 
-    if (!setup_kernels())
+    if (setup_kernels())
+    {
+        std::cout << std::endl << "Kernel setup is OK" << std::endl;
+        std::cout << "Work-group size : " << m_workgroup_size << std::endl;
+        std::cout << "Work items      : " << m_total_workitems << std::endl;
+
+        if (m_reorderer.is_enabled())
+        {
+            std::cout << "Particle order  : " << get_space_filling_curve_name(m_reorderer.get_curve()) << " curve" << std::endl;
+        }
+    }
+    else
     {
         throw std::string("Failed to setup kernels");
     }
 }
 
-std::vector<sf::Vertex> SingleGPUVelocityVerlet::run()
+void SingleGPUVelocityVerlet::profile_command(ProfilePhase phase, const cl::Event& event, std::size_t output_slot)
+{
+    if (m_profiler != nullptr)
+    {
+        m_profiled_commands.push_back({ phase, event, output_slot });
+    }
+}
+
+bool SingleGPUVelocityVerlet::read_profiled_commands(std::size_t output_slot)
+{
+    if ((m_profiler == nullptr) || m_profiled_commands.empty())
+    {
+        return true;
+    }
+
+    // the queue is in order, everything up to the output read of this slot has finished
+    std::size_t num_finished = 0;
+
+    while ((num_finished < m_profiled_commands.size()) && (m_profiled_commands[num_finished].output_slot != output_slot))
+    {
+        ++num_finished;
+    }
+
+    if (num_finished == m_profiled_commands.size())
+    {
+        return true;
+    }
+
+    ++num_finished;
+
+    try
+    {
+        m_profiler->synchronize_device_clock(m_output_events[output_slot].getProfilingInfo<CL_PROFILING_COMMAND_END>());
+
+        for (std::size_t i = 0; i < num_finished; ++i)
+        {
+            const cl::Event& event = m_profiled_commands[i].event;
+
+            m_profiler->record_device(m_profiled_commands[i].phase,
+                event.getProfilingInfo<CL_PROFILING_COMMAND_START>(),
+                event.getProfilingInfo<CL_PROFILING_COMMAND_END>());
+        }
+    }
+    catch (const cl::Error& e)
+    {
+        std::cout << "Error: " << e.err() << std::endl;
+        std::cout << "Exception: " << e.what() << std::endl;
+
+        return false;
+    }
+
+    m_profiled_commands.erase(m_profiled_commands.begin(), m_profiled_commands.begin() + num_finished);
+
+    return true;
+}
+
+void SingleGPUVelocityVerlet::record_diagnostics(std::size_t output_slot)
 {
-    if (!queue_commands())
+    if ((m_diagnostics == nullptr) || !m_slot_has_diagnostics[output_slot])
+    {
+        return;
+    }
+
+    for (std::size_t step = 0; step < m_steps_per_frame; ++step)
+    {
+        const std::size_t first = (output_slot * m_steps_per_frame + step) * m_num_workgroups;
+
+        StepDiagnostics diagnostics = {};
+        diagnostics.step = m_slot_first_steps[output_slot] + step;
+
+        for (std::size_t group = first; group < first + m_num_workgroups; ++group)
+        {
+            diagnostics.potential_energy += m_potential_partials[group];
+            diagnostics.kinetic_energy += m_kinetic_partials[group].s0;
+            diagnostics.momentum[0] += m_kinetic_partials[group].s1;
+            diagnostics.momentum[1] += m_kinetic_partials[group].s2;
+            diagnostics.momentum[2] += m_kinetic_partials[group].s3;
+        }
+
+        m_diagnostics->record(diagnostics);
+    }
+
+    m_slot_has_diagnostics[output_slot] = false;
+}
+
+void SingleGPUVelocityVerlet::run(std::vector<sf::Vertex>& vertices)
+{
+    const std::size_t output_slot = m_next_output_slot;
+
+    m_next_output_slot = (m_next_output_slot + 1) % OUTPUT_RING_SIZE;
+
+    if (!queue_commands(output_slot))
     {
         throw std::string("Failed to queue commands");
     }
 
-    if (!update_kernel_arguments())
+    std::size_t ready_slot = output_slot;
+
+    // in pipelined mode the frame queued now is shown on the next call,
+    // so the host converts and renders frame n while the device runs frame n + 1
+    if (m_pipelined)
     {
-        throw std::string("Failed to update kernel arguments");
+        if (m_has_pending_frame)
+        {
+            ready_slot = m_pending_slot;
+        }
+
+        m_pending_slot = output_slot;
+        m_has_pending_frame = true;
     }
 
-    std::vector<sf::Vertex> vertices(m_num_particles);
+    if (!wait_for_output(ready_slot))
+    {
+        throw std::string("Failed to read back positions");
+    }
+
+    if (!read_profiled_commands(ready_slot))
+    {
+        throw std::string("Failed to read profiling info");
+    }
+
+    record_diagnostics(ready_slot);
+
+    ProfileScope scope(m_profiler, ProfilePhase::VertexConversion);
+
+    const cl_float4* positions = m_output_positions[ready_slot];
+    const std::vector<std::uint32_t>& ids = m_reorderer.get_ids();
+
+    vertices.resize(m_num_particles);
 
     for (std::size_t i = 0; i < m_num_particles; ++i)
     {
-        // copy position values
-        vertices[i] = sf::Vector2f(m_positions[i].s0, m_positions[i].s1);
+        // copy position values, in particle order whatever the order of the slots
+        vertices[ids[i]] = sf::Vector2f(positions[i].s0, positions[i].s1);
     }
+}
+
+void SingleGPUVelocityVerlet::save_checkpoint(CheckpointState& state)
+{
+    state.resize(m_num_particles);
+    state.step_count = m_step_count;
+    state.time_step = m_time_step;
+    state.has_forces = m_forces_computed;
 
-    return vertices;
+    try
+    {
+        // the host input arrays are only needed at setup, reuse them as staging buffers
+        m_command_queue->finish();
+        m_command_queue->enqueueReadBuffer(m_positions_buffers[m_front_buffer_idx], CL_TRUE, 0, m_buffer_size_bytes, m_positions);
+        m_command_queue->enqueueReadBuffer(m_velocities_buffer, CL_TRUE, 0, m_buffer_size_bytes, m_velocities);
+
+        // checkpoints are in particle order
+        const std::vector<std::uint32_t>& ids = m_reorderer.get_ids();
+
+        for (std::size_t i = 0; i < m_num_particles; ++i)
+        {
+            state.get(CheckpointArray::PositionX)[ids[i]] = m_positions[i].s0;
+            state.get(CheckpointArray::PositionY)[ids[i]] = m_positions[i].s1;
+            state.get(CheckpointArray::PositionZ)[ids[i]] = m_positions[i].s2;
+            state.get(CheckpointArray::Mass)[ids[i]] = m_positions[i].s3;
+            state.get(CheckpointArray::VelocityX)[ids[i]] = m_velocities[i].s0;
+            state.get(CheckpointArray::VelocityY)[ids[i]] = m_velocities[i].s1;
+            state.get(CheckpointArray::VelocityZ)[ids[i]] = m_velocities[i].s2;
+        }
+
+        if (m_forces_computed)
+        {
+            m_command_queue->enqueueReadBuffer(m_forces_buffers[m_front_buffer_idx], CL_TRUE, 0, m_buffer_size_bytes, m_velocities);
+
+            for (std::size_t i = 0; i < m_num_particles; ++i)
+            {
+                state.get(CheckpointArray::ForceX)[ids[i]] = m_velocities[i].s0;
+                state.get(CheckpointArray::ForceY)[ids[i]] = m_velocities[i].s1;
+                state.get(CheckpointArray::ForceZ)[ids[i]] = m_velocities[i].s2;
+            }
+        }
+    }
+    catch (const cl::Error& e)
+    {
+        std::cout << "Error: " << e.err() << std::endl;
+        std::cout << "Exception: " << e.what() << std::endl;
+
+        throw std::string("Failed to save checkpoint");
+    }
+}
+
+void SingleGPUVelocityVerlet::save_snapshot(TrajectorySnapshot& snapshot, bool with_velocities)
+{
+    snapshot.positions.resize(m_num_particles * 3u);
+    snapshot.velocities.resize(with_velocities ? m_num_particles * 3u : 0u);
+
+    try
+    {
+        // the same staging buffers as the checkpoints, the velocities are only read when asked for
+        m_command_queue->finish();
+        m_command_queue->enqueueReadBuffer(m_positions_buffers[m_front_buffer_idx], CL_TRUE, 0, m_buffer_size_bytes, m_positions);
+
+        if (with_velocities)
+        {
+            m_command_queue->enqueueReadBuffer(m_velocities_buffer, CL_TRUE, 0, m_buffer_size_bytes, m_velocities);
+        }
+    }
+    catch (const cl::Error& e)
+    {
+        std::cout << "Error: " << e.err() << std::endl;
+        std::cout << "Exception: " << e.what() << std::endl;
+
+        throw std::string("Failed to read trajectory snapshot");
+    }
+
+    // snapshots are in particle order
+    const std::vector<std::uint32_t>& ids = m_reorderer.get_ids();
+
+    for (std::size_t i = 0; i < m_num_particles; ++i)
+    {
+        float* position = &snapshot.positions[ids[i] * 3u];
+
+        position[0] = m_positions[i].s0;
+        position[1] = m_positions[i].s1;
+        position[2] = m_positions[i].s2;
+
+        if (with_velocities)
+        {
+            float* velocity = &snapshot.velocities[ids[i] * 3u];
+
+            velocity[0] = m_velocities[i].s0;
+            velocity[1] = m_velocities[i].s1;
+            velocity[2] = m_velocities[i].s2;
+        }
+    }
+}
+
+void SingleGPUVelocityVerlet::restore_checkpoint(const CheckpointFile& checkpoint)
+{
+    if (checkpoint.get_num_particles() != m_num_particles)
+    {
+        throw std::string("Checkpoint particle count does not match: ") + std::to_string(checkpoint.get_num_particles());
+    }
+
+    const float* position_x = checkpoint.get_array(CheckpointArray::PositionX);
+    const float* position_y = checkpoint.get_array(CheckpointArray::PositionY);
+    const float* position_z = checkpoint.get_array(CheckpointArray::PositionZ);
+    const float* velocity_x = checkpoint.get_array(CheckpointArray::VelocityX);
+    const float* velocity_y = checkpoint.get_array(CheckpointArray::VelocityY);
+    const float* velocity_z = checkpoint.get_array(CheckpointArray::VelocityZ);
+    const float* masses = checkpoint.get_array(CheckpointArray::Mass);
+
+    for (std::size_t i = 0; i < m_num_particles; ++i)
+    {
+        m_positions[i] = { { position_x[i], position_y[i], position_z[i], masses[i] } };
+        m_velocities[i] = { { velocity_x[i], velocity_y[i], velocity_z[i], masses[i] } };
+    }
+
+    try
+    {
+        m_command_queue->finish();
+        m_command_queue->enqueueWriteBuffer(m_positions_buffers[m_front_buffer_idx], CL_TRUE, 0, m_buffer_size_bytes, m_positions);
+        m_command_queue->enqueueWriteBuffer(m_velocities_buffer, CL_TRUE, 0, m_buffer_size_bytes, m_velocities);
+
+        if (checkpoint.has_forces())
+        {
+            const float* force_x = checkpoint.get_array(CheckpointArray::ForceX);
+            const float* force_y = checkpoint.get_array(CheckpointArray::ForceY);
+            const float* force_z = checkpoint.get_array(CheckpointArray::ForceZ);
+
+            for (std::size_t i = 0; i < m_num_particles; ++i)
+            {
+                m_velocities[i] = { { force_x[i], force_y[i], force_z[i], 0.f } };
+            }
+
+            m_command_queue->enqueueWriteBuffer(m_forces_buffers[m_front_buffer_idx], CL_TRUE, 0, m_buffer_size_bytes, m_velocities);
+        }
+    }
+    catch (const cl::Error& e)
+    {
+        std::cout << "Error: " << e.err() << std::endl;
+        std::cout << "Exception: " << e.what() << std::endl;
+
+        throw std::string("Failed to restore checkpoint");
+    }
+
+    m_time_step = checkpoint.get_time_step();
+    m_step_count = checkpoint.get_step_count();
+    m_forces_computed = checkpoint.has_forces();
+
+    m_reorderer.reset(m_step_count);
+
+    m_positions_kernel.setArg(4, m_time_step);
+    m_velocities_kernel.setArg(3, m_time_step);
+
+    // frames queued before the restore are stale
+    m_has_pending_frame = false;
+}
+
+void SingleGPUVelocityVerlet::set_profiler(Profiler* profiler)
+{
+    m_profiler = profiler;
+    m_profiled_commands.clear();
+}
+
+void SingleGPUVelocityVerlet::set_diagnostics(DiagnosticsLog* diagnostics)
+{
+    const bool was_enabled = (m_diagnostics != nullptr);
+
+    m_diagnostics = diagnostics;
+
+    if (was_enabled == (diagnostics != nullptr))
+    {
+        return;
+    }
+
+    // the sums are compiled in or out, so the program is rebuilt with or without them
+    m_build_options = BUILD_OPTIONS + get_force_law_build_options(m_force_law)
+        + ((diagnostics != nullptr) ? DIAGNOSTICS_BUILD_OPTIONS : std::string());
+
+    std::fill(m_slot_has_diagnostics.begin(), m_slot_has_diagnostics.end(), false);
+
+    // before initialize the program is built with these options anyway
+    if (!m_command_queue.has_value())
+    {
+        return;
+    }
+
+    try
+    {
+        m_command_queue->finish();
+    }
+    catch (const cl::Error& e)
+    {
+        std::cout << "Error: " << e.err() << std::endl;
+        std::cout << "Exception: " << e.what() << std::endl;
+
+        throw std::string("Failed to finish queued commands");
+    }
+
+    if (!setup_program() || !setup_kernels())
+    {
+        throw std::string("Failed to setup the diagnostics kernels");
+    }
 }
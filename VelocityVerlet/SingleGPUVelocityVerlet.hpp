@@ -4,25 +4,43 @@
 #define CL_HPP_ENABLE_EXCEPTIONS
 #define CL_HPP_TARGET_OPENCL_VERSION 220
 
+#include "AlignedAllocator.hpp"
+#include "ForceLaws.hpp"
 #include "IAlgorithmStrategy.hpp"
+#include "ICheckpointable.hpp"
+#include "IDiagnosable.hpp"
+#include "IProfileable.hpp"
+#include "ITrajectorySource.hpp"
+#include "OpenCLDevices.hpp"
+#include "SpatialOrder.hpp"
 
+#include <algorithm>
 #include <array>
 #include <CL/opencl.hpp>
+#include <cstdint>
 #include <cstdlib>
 #include <optional>
 #include <SFML/System/Vector3.hpp>
 #include <string>
 #include <vector>
 
-class SingleGPUVelocityVerlet : public IAlgorithmStrategy
+class SingleGPUVelocityVerlet : public IAlgorithmStrategy, public ICheckpointable, public IProfileable,
+    public IDiagnosable, public ITrajectorySource
 {
 private:
     const std::string KERNEL_FILE_NAME = "velocity_verlet.cl";
     const std::string FORCE_KERNEL_NAME = "compute_forces";
     const std::string VELOCITY_KERNEL_NAME = "compute_velocities";
     const std::string POSITIONS_KERNEL_NAME = "compute_positions";
+    const std::string PERMUTE_KERNEL_NAME = "permute_particles";
     const std::string BUILD_OPTIONS = "-cl-std=CL2.2";
+    const std::string DIAGNOSTICS_BUILD_OPTIONS = " -D COMPUTE_DIAGNOSTICS";
+    const std::string PROGRAM_CACHE_DIRECTORY = "kernel_cache";
     const std::size_t WORKGROUP_SIZE = 256u;
+    const std::size_t OUTPUT_RING_SIZE = 3u;
+
+    // the first GPU of the first platform when not set
+    std::optional<OpenCLDevice> m_selected_device;
 
     cl::Platform m_platform;
     std::string m_platform_name;
@@ -33,21 +51,54 @@ private:
 
     cl::Program::Sources m_source;
     cl::Program m_program;
+    ForceLawParameters m_force_law;
+    std::string m_build_options;
     std::string m_source_file;
+    bool m_program_from_cache;
+    double m_program_setup_seconds;
 
     std::optional<cl::CommandQueue> m_command_queue;
 
     std::array<cl::Buffer, 2u> m_positions_buffers;
     std::array<cl::Buffer, 2u> m_forces_buffers;
     cl::Buffer m_velocities_buffer;
-    cl::Buffer m_output_buffer;
+    std::vector<cl::Buffer> m_output_buffers;
+    std::vector<cl_float4*> m_output_positions;
     std::size_t m_buffer_size_bytes;
     std::size_t m_front_buffer_idx;
     std::size_t m_back_buffer_idx;
 
+    // the front forces buffer holds the forces at the front positions
+    bool m_forces_computed;
+
     cl::Kernel m_force_kernel;
     cl::Kernel m_velocities_kernel;
     cl::Kernel m_positions_kernel;
+    cl::Kernel m_permute_kernel;
+
+    // slot i of the device buffers holds particle get_ids()[i], the velocities are
+    // gathered through the scratch buffer
+    ParticleReorderer m_reorderer;
+    cl::Buffer m_order_buffer;
+    cl::Buffer m_velocities_scratch_buffer;
+
+    // kept across frames so queueing a step does not allocate
+    std::vector<cl::Event> m_force_events;
+    std::vector<cl::Event> m_positions_events;
+    std::vector<cl::Event> m_velocities_events;
+    std::vector<cl::Event> m_step_wait_events;
+    std::vector<cl::Event> m_output_events;
+    cl::Event m_last_output_event;
+    bool m_has_output_event;
+
+    // steps chained on the device per rendered frame
+    std::size_t m_steps_per_frame;
+
+    // show the previous frame while the device computes the next one
+    bool m_pipelined;
+    std::size_t m_next_output_slot;
+    std::size_t m_pending_slot;
+    bool m_has_pending_frame;
 
     std::vector<sf::Vector3f>& m_input_positions;
     std::vector<sf::Vector3f>& m_input_velocities;
@@ -58,9 +109,37 @@ private:
 
     float m_time_step;
     std::size_t m_num_particles;
+    std::uint64_t m_step_count;
 
+    std::size_t m_workgroup_size;
     std::size_t m_total_workitems;
 
+    // commands of the queued frames, their profiling info is read once the frame's output is ready.
+    // only the output reads carry a slot, kernels use OUTPUT_RING_SIZE
+    struct ProfiledCommand
+    {
+        ProfilePhase phase;
+        cl::Event event;
+        std::size_t output_slot;
+    };
+
+    Profiler* m_profiler;
+    std::vector<ProfiledCommand> m_profiled_commands;
+
+    // per work group sums of every step, OUTPUT_RING_SIZE * steps per frame * work groups,
+    // read back together with the positions of the frame
+    DiagnosticsLog* m_diagnostics;
+    cl::Buffer m_potential_partials_buffer;
+    cl::Buffer m_kinetic_partials_buffer;
+    std::vector<cl_float> m_potential_partials;
+    std::vector<cl_float4> m_kinetic_partials;
+    std::size_t m_num_workgroups;
+    cl_uint m_partial_offset;
+
+    // first step of the frame in each output slot and whether it was queued with diagnostics
+    std::vector<std::uint64_t> m_slot_first_steps;
+    std::vector<bool> m_slot_has_diagnostics;
+
     bool validate_inputs() const;
     bool setup_platform();
     bool setup_context();
@@ -71,49 +150,109 @@ private:
     bool setup_buffers();
     bool setup_kernels();
     bool update_kernel_arguments();
-    bool queue_commands();
+    bool reorder_particles();
+    bool queue_step();
+    bool queue_commands(std::size_t output_slot);
+    bool wait_for_output(std::size_t output_slot);
+    void profile_command(ProfilePhase phase, const cl::Event& event, std::size_t output_slot);
+    bool read_profiled_commands(std::size_t output_slot);
+    void record_diagnostics(std::size_t output_slot);
 
 public:
     SingleGPUVelocityVerlet(std::size_t num_particles,
         float time_step,
         std::vector<sf::Vector3f>& positions,
         std::vector<sf::Vector3f>& velocities,
-        std::vector<float>& masses)
-        : m_num_particles(num_particles),
+        std::vector<float>& masses,
+        std::size_t steps_per_frame = 1u,
+        bool pipelined = false,
+        std::optional<OpenCLDevice> device = std::nullopt,
+        ForceLawParameters force_law = ForceLawParameters(),
+        ReorderParameters reorder = ReorderParameters())
+        : m_selected_device(device),
+        m_reorderer(num_particles, reorder),
+        m_force_law(force_law),
+        m_build_options(BUILD_OPTIONS + get_force_law_build_options(force_law)),
+        m_num_particles(num_particles),
         m_time_step(time_step),
+        m_step_count(0u),
         m_input_positions(positions),
         m_input_velocities(velocities),
         m_input_masses(masses),
+        m_program_from_cache(false),
+        m_program_setup_seconds(0.0),
         m_positions(nullptr),
         m_velocities(nullptr),
         m_front_buffer_idx(0u),
         m_back_buffer_idx(1u),
+        m_forces_computed(false),
         m_buffer_size_bytes(0u),
-        m_total_workitems(num_particles)
-    {}
+        m_force_events(1),
+        m_positions_events(1),
+        m_velocities_events(1),
+        m_has_output_event(false),
+        m_steps_per_frame(std::max<std::size_t>(steps_per_frame, 1u)),
+        m_pipelined(pipelined),
+        m_next_output_slot(0u),
+        m_pending_slot(0u),
+        m_has_pending_frame(false),
+        m_workgroup_size(WORKGROUP_SIZE),
+        m_total_workitems(num_particles),
+        m_profiler(nullptr),
+        m_diagnostics(nullptr),
+        m_num_workgroups(0u),
+        m_partial_offset(0u),
+        m_slot_first_steps(OUTPUT_RING_SIZE, 0u),
+        m_slot_has_diagnostics(OUTPUT_RING_SIZE, false)
+    {
+        m_step_wait_events.reserve(2u);
+    }
 
     ~SingleGPUVelocityVerlet()
     {
         if (m_command_queue.has_value())
         {
-            m_command_queue->finish();
+            try
+            {
+                for (std::size_t slot = 0; slot < m_output_positions.size(); ++slot)
+                {
+                    if (m_output_positions[slot] != nullptr)
+                    {
+                        m_command_queue->enqueueUnmapMemObject(m_output_buffers[slot], m_output_positions[slot]);
+                    }
+                }
+
+                m_command_queue->finish();
+            }
+            catch (const cl::Error&)
+            {
+            }
         }
 
         if (m_positions != nullptr)
         {
-            _aligned_free(m_positions);
+            free_aligned(m_positions);
             m_positions = nullptr;
         }
 
         if (m_velocities != nullptr)
         {
-            _aligned_free(m_velocities);
+            free_aligned(m_velocities);
             m_velocities = nullptr;
         }
     }
 
     void initialize() override;
-    std::vector<sf::Vertex> run() override;
+    void run(std::vector<sf::Vertex>& vertices) override;
+
+    void save_checkpoint(CheckpointState& state) override;
+    void restore_checkpoint(const CheckpointFile& checkpoint) override;
+
+    void save_snapshot(TrajectorySnapshot& snapshot, bool with_velocities) override;
+
+    void set_profiler(Profiler* profiler) override;
+
+    void set_diagnostics(DiagnosticsLog* diagnostics) override;
 };
 
 #endif // !SINGLE_GPU_VELOCITY_VERLET_HPP_
@@ -1,89 +1,298 @@
 #include "SingleThreadedVelocityVerlet.hpp"
 
-#include <cmath>
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <utility>
 
-static float square(float val)
+void SingleThreadedVelocityVerlet::compute_forces()
 {
-    return val * val;
+    m_new_forces.fill_zero();
+    m_potential_energy = 0.0;
+
+    const ForceKernelArgs args =
+    {
+        m_particles.x.data(),
+        m_particles.y.data(),
+        m_particles.z.data(),
+        m_particles.mass.data(),
+        m_new_forces.x.data(),
+        m_new_forces.y.data(),
+        m_new_forces.z.data(),
+        m_force_law,
+        &m_potential_energy
+    };
+
+    m_force_kernel(args, 0, m_num_particles, 0, m_num_particles);
 }
 
-void SingleThreadedVelocityVerlet::compute_forces()
+void SingleThreadedVelocityVerlet::update_positions()
+{
+    for (size_t i = 0; i < m_num_particles; ++i)
+    {
+        float acceleration = m_time_step * 0.5f / m_particles.mass[i];
+
+        m_particles.x[i] += m_time_step * (m_velocities.x[i] + acceleration * m_new_forces.x[i]);
+        m_particles.y[i] += m_time_step * (m_velocities.y[i] + acceleration * m_new_forces.y[i]);
+        m_particles.z[i] += m_time_step * (m_velocities.z[i] + acceleration * m_new_forces.z[i]);
+    }
+
+    std::swap(m_old_forces, m_new_forces);
+}
+
+template <bool Diagnostics>
+void SingleThreadedVelocityVerlet::update_velocities(StepDiagnostics& diagnostics)
 {
-    std::fill(m_new_forces.begin(), m_new_forces.end(), sf::Vector3f(0.f, 0.f, 0.f));
+    double kinetic_energy = 0.0;
+    double momentum_x = 0.0;
+    double momentum_y = 0.0;
+    double momentum_z = 0.0;
 
-    for (size_t me = 0; me < m_num_particles - 1; ++me)
+    for (size_t i = 0; i < m_num_particles; ++i)
     {
-        for (size_t other = me + 1; other < m_num_particles; ++other)
-        {
-            float sqr_distance = square(m_positions[other].x - m_positions[me].x);
-            sqr_distance += square(m_positions[other].y - m_positions[me].y);
-            sqr_distance += square(m_positions[other].z - m_positions[me].z);
+        float acceleration = m_time_step * 0.5f / m_particles.mass[i];
 
-            float gravity = m_masses[me] * m_masses[other] / (std::sqrt(sqr_distance) * sqr_distance);
+        m_velocities.x[i] += acceleration * (m_new_forces.x[i] + m_old_forces.x[i]);
+        m_velocities.y[i] += acceleration * (m_new_forces.y[i] + m_old_forces.y[i]);
+        m_velocities.z[i] += acceleration * (m_new_forces.z[i] + m_old_forces.z[i]);
 
-            sf::Vector3f force;
-            force.x = gravity * (m_positions[other].x - m_positions[me].x);
-            force.y = gravity * (m_positions[other].y - m_positions[me].y);
-            force.z = gravity * (m_positions[other].z - m_positions[me].z);
+        if (Diagnostics)
+        {
+            const double mass = m_particles.mass[i];
 
-            m_new_forces[me] += force;
+            kinetic_energy += mass * (m_velocities.x[i] * m_velocities.x[i]
+                + m_velocities.y[i] * m_velocities.y[i]
+                + m_velocities.z[i] * m_velocities.z[i]);
 
-            m_new_forces[other] -= force;
+            momentum_x += mass * m_velocities.x[i];
+            momentum_y += mass * m_velocities.y[i];
+            momentum_z += mass * m_velocities.z[i];
         }
     }
+
+    if (Diagnostics)
+    {
+        diagnostics.kinetic_energy = 0.5 * kinetic_energy;
+        diagnostics.momentum = { momentum_x, momentum_y, momentum_z };
+    }
 }
 
-void SingleThreadedVelocityVerlet::update_positions()
+void SingleThreadedVelocityVerlet::reorder_particles()
 {
-    for (size_t i = 0; i < m_num_particles; ++i)
+    if (!m_reorderer.compute_order(m_particles.x.data(), m_particles.y.data(), m_particles.z.data(), m_step_count))
     {
-        float acceleration = m_time_step * 0.5f / m_masses[i];
+        return;
+    }
 
-        sf::Vector3f move;
+    // the old forces are overwritten before they are read again
+    float* lanes[] =
+    {
+        m_particles.x.data(),
+        m_particles.y.data(),
+        m_particles.z.data(),
+        m_particles.mass.data(),
+        m_velocities.x.data(),
+        m_velocities.y.data(),
+        m_velocities.z.data(),
+        m_new_forces.x.data(),
+        m_new_forces.y.data(),
+        m_new_forces.z.data()
+    };
 
-        move.x = m_time_step * (m_velocities[i].x + acceleration * m_new_forces[i].x);
-        move.y = m_time_step * (m_velocities[i].y + acceleration * m_new_forces[i].y);
-        move.z = m_time_step * (m_velocities[i].z + acceleration * m_new_forces[i].z);
+    for (float* lane : lanes)
+    {
+        m_reorderer.apply(lane);
+    }
+}
 
-        m_positions[i] += move;
+void SingleThreadedVelocityVerlet::initialize()
+{
+    std::cout << std::endl << "CPU force kernel : " << get_simd_level_name(m_simd_level)
+        << ", " << get_force_law_name(m_force_law.law) << std::endl;
 
-        m_old_forces[i] = m_new_forces[i];
+    if (m_reorderer.is_enabled())
+    {
+        std::cout << "Particle order   : " << get_space_filling_curve_name(m_reorderer.get_curve()) << " curve" << std::endl;
     }
 }
 
-void SingleThreadedVelocityVerlet::update_velocities()
+void SingleThreadedVelocityVerlet::run(std::vector<sf::Vertex>& vertices)
 {
+    if (m_reorderer.is_due(m_step_count))
+    {
+        reorder_particles();
+    }
+
+    // the forces at the end of a step are the forces at the start of the next one,
+    // so apart from the very first step there is one force evaluation per step
+    if (!m_forces_computed)
+    {
+        ProfileScope scope(m_profiler, ProfilePhase::Force);
+
+        compute_forces();
+        m_forces_computed = true;
+    }
+
+    // half kick and drift
+    {
+        ProfileScope scope(m_profiler, ProfilePhase::Drift);
+        update_positions();
+    }
+
+    {
+        ProfileScope scope(m_profiler, ProfilePhase::Force);
+        compute_forces();
+    }
+
+    StepDiagnostics diagnostics = {};
+
+    // closing half kick with the new forces
+    {
+        ProfileScope scope(m_profiler, ProfilePhase::Kick);
+
+        if (m_diagnostics != nullptr)
+        {
+            update_velocities<true>(diagnostics);
+        }
+        else
+        {
+            update_velocities<false>(diagnostics);
+        }
+    }
+
+    ++m_step_count;
+
+    if (m_diagnostics != nullptr)
+    {
+        diagnostics.step = m_step_count;
+        diagnostics.potential_energy = m_potential_energy;
+
+        m_diagnostics->record(diagnostics);
+    }
+
+    ProfileScope scope(m_profiler, ProfilePhase::VertexConversion);
+
+    vertices.resize(m_num_particles);
+
+    // in particle order, whatever the order of the slots
+    const std::vector<std::uint32_t>& ids = m_reorderer.get_ids();
+
     for (size_t i = 0; i < m_num_particles; ++i)
     {
-        float acceleration = m_time_step * 0.5f / m_masses[i];
+        vertices[ids[i]] = sf::Vertex(sf::Vector2f(m_particles.x[i], m_particles.y[i]));
+    }
+}
+
+void SingleThreadedVelocityVerlet::save_checkpoint(CheckpointState& state)
+{
+    state.resize(m_num_particles);
+    state.step_count = m_step_count;
+    state.time_step = m_time_step;
+    state.has_forces = m_forces_computed;
+
+    const std::pair<CheckpointArray, const ParticleLane*> lanes[] =
+    {
+        { CheckpointArray::PositionX, &m_particles.x },
+        { CheckpointArray::PositionY, &m_particles.y },
+        { CheckpointArray::PositionZ, &m_particles.z },
+        { CheckpointArray::VelocityX, &m_velocities.x },
+        { CheckpointArray::VelocityY, &m_velocities.y },
+        { CheckpointArray::VelocityZ, &m_velocities.z },
+        { CheckpointArray::Mass, &m_particles.mass },
+        { CheckpointArray::ForceX, &m_new_forces.x },
+        { CheckpointArray::ForceY, &m_new_forces.y },
+        { CheckpointArray::ForceZ, &m_new_forces.z }
+    };
 
-        sf::Vector3f delta;
+    // checkpoints are in particle order
+    const std::vector<std::uint32_t>& ids = m_reorderer.get_ids();
 
-        delta.x = acceleration * (m_new_forces[i].x + m_old_forces[i].x);
-        delta.y = acceleration * (m_new_forces[i].y + m_old_forces[i].y);
-        delta.z = acceleration * (m_new_forces[i].z + m_old_forces[i].z);
+    for (const auto& lane : lanes)
+    {
+        auto destination = state.get(lane.first).begin();
 
-        m_velocities[i] += delta;
+        for (std::size_t i = 0; i < m_num_particles; ++i)
+        {
+            destination[ids[i]] = (*lane.second)[i];
+        }
     }
 }
 
-void SingleThreadedVelocityVerlet::initialize()
+void SingleThreadedVelocityVerlet::restore_checkpoint(const CheckpointFile& checkpoint)
 {
+    if (checkpoint.get_num_particles() != m_num_particles)
+    {
+        throw std::string("Checkpoint particle count does not match: ") + std::to_string(checkpoint.get_num_particles());
+    }
+
+    const std::pair<CheckpointArray, ParticleLane*> lanes[] =
+    {
+        { CheckpointArray::PositionX, &m_particles.x },
+        { CheckpointArray::PositionY, &m_particles.y },
+        { CheckpointArray::PositionZ, &m_particles.z },
+        { CheckpointArray::VelocityX, &m_velocities.x },
+        { CheckpointArray::VelocityY, &m_velocities.y },
+        { CheckpointArray::VelocityZ, &m_velocities.z },
+        { CheckpointArray::Mass, &m_particles.mass },
+        { CheckpointArray::ForceX, &m_new_forces.x },
+        { CheckpointArray::ForceY, &m_new_forces.y },
+        { CheckpointArray::ForceZ, &m_new_forces.z }
+    };
+
+    // straight from the mapping into the lanes, the padding lanes keep their zero mass
+    for (const auto& lane : lanes)
+    {
+        const float* source = checkpoint.get_array(lane.first);
+
+        std::copy(source, source + m_num_particles, lane.second->begin());
+    }
+
+    m_time_step = checkpoint.get_time_step();
+    m_step_count = checkpoint.get_step_count();
+    m_forces_computed = checkpoint.has_forces();
+
+    m_reorderer.reset(m_step_count);
 }
 
-std::vector<sf::Vertex> SingleThreadedVelocityVerlet::run()
+void SingleThreadedVelocityVerlet::save_snapshot(TrajectorySnapshot& snapshot, bool with_velocities)
 {
-    compute_forces();
-    update_positions();
-    compute_forces();
-    update_velocities();
+    snapshot.positions.resize(m_num_particles * 3u);
+    snapshot.velocities.resize(with_velocities ? m_num_particles * 3u : 0u);
 
-    std::vector<sf::Vertex> vertices(m_num_particles);
+    // snapshots are in particle order
+    const std::vector<std::uint32_t>& ids = m_reorderer.get_ids();
 
-    for (size_t i = 0; i < m_num_particles; ++i)
+    for (std::size_t i = 0; i < m_num_particles; ++i)
     {
-        vertices[i] = sf::Vertex(sf::Vector2f(m_positions[i].x, m_positions[i].y));
+        float* position = &snapshot.positions[ids[i] * 3u];
+
+        position[0] = m_particles.x[i];
+        position[1] = m_particles.y[i];
+        position[2] = m_particles.z[i];
     }
 
-    return vertices;
+    if (!with_velocities)
+    {
+        return;
+    }
+
+    for (std::size_t i = 0; i < m_num_particles; ++i)
+    {
+        float* velocity = &snapshot.velocities[ids[i] * 3u];
+
+        velocity[0] = m_velocities.x[i];
+        velocity[1] = m_velocities.y[i];
+        velocity[2] = m_velocities.z[i];
+    }
+}
+
+void SingleThreadedVelocityVerlet::set_profiler(Profiler* profiler)
+{
+    m_profiler = profiler;
+}
+
+void SingleThreadedVelocityVerlet::set_diagnostics(DiagnosticsLog* diagnostics)
+{
+    m_diagnostics = diagnostics;
+    m_force_kernel = select_force_kernel(m_simd_level, m_force_law.law, diagnostics != nullptr);
 }
@@ -1,40 +1,79 @@
 #ifndef SINGLE_THREADED_VELOCITY_VERLET_HPP_
 #define SINGLE_THREADED_VELOCITY_VERLET_HPP_
 
+#include "ForceKernels.hpp"
 #include "IAlgorithmStrategy.hpp"
+#include "ICheckpointable.hpp"
+#include "IDiagnosable.hpp"
+#include "IProfileable.hpp"
+#include "ITrajectorySource.hpp"
+#include "ParticleArrays.hpp"
+#include "SpatialOrder.hpp"
 
+#include <cstdint>
 #include <SFML/System/Vector3.hpp>
 #include <vector>
 
-class SingleThreadedVelocityVerlet : public IAlgorithmStrategy
+class SingleThreadedVelocityVerlet : public IAlgorithmStrategy, public ICheckpointable, public IProfileable,
+    public IDiagnosable, public ITrajectorySource
 {
 private:
     void compute_forces();
     void update_positions();
-    void update_velocities();
+    void reorder_particles();
 
-    std::vector<sf::Vector3f> m_positions;
-    std::vector<sf::Vector3f> m_velocities;
-    std::vector<sf::Vector3f> m_old_forces;
-    std::vector<sf::Vector3f> m_new_forces;
-    std::vector<float>        m_masses;
+    // with Diagnostics the kick also sums the kinetic energy and momentum into the record
+    template <bool Diagnostics>
+    void update_velocities(StepDiagnostics& diagnostics);
+
+    ParticleArrays m_particles;
+    VectorArrays   m_velocities;
+    VectorArrays   m_old_forces;
+    VectorArrays   m_new_forces;
+
+    // m_new_forces holds the forces at the current positions
+    bool m_forces_computed;
+
+    // slot i holds particle get_ids()[i]
+    ParticleReorderer m_reorderer;
+
+    ForceLawParameters m_force_law;
+    SimdLevel   m_simd_level;
+    ForceKernel m_force_kernel;
 
     float m_time_step;
     std::size_t m_num_particles;
+    std::uint64_t m_step_count;
+
+    Profiler* m_profiler;
+
+    // set by the energy kernel during compute_forces
+    double m_potential_energy;
+    DiagnosticsLog* m_diagnostics;
 
 public:
     SingleThreadedVelocityVerlet(std::size_t num_particles,
         float time_step,
         std::vector<sf::Vector3f> positions,
         std::vector<sf::Vector3f> velocities,
-        std::vector<float> masses)
+        std::vector<float> masses,
+        ForceLawParameters force_law = ForceLawParameters(),
+        ReorderParameters reorder = ReorderParameters())
         : m_num_particles(num_particles),
         m_time_step(time_step),
-        m_positions(positions),
+        m_step_count(0u),
+        m_particles(positions, masses),
         m_velocities(velocities),
-        m_masses(masses),
-        m_old_forces(num_particles, sf::Vector3f(0.f, 0.f, 0.f)),
-        m_new_forces(num_particles, sf::Vector3f(0.f, 0.f, 0.f))
+        m_old_forces(num_particles),
+        m_new_forces(num_particles),
+        m_forces_computed(false),
+        m_reorderer(num_particles, reorder),
+        m_force_law(force_law),
+        m_simd_level(detect_simd_level()),
+        m_force_kernel(select_force_kernel(m_simd_level, force_law.law)),
+        m_profiler(nullptr),
+        m_potential_energy(0.0),
+        m_diagnostics(nullptr)
     {}
 
     ~SingleThreadedVelocityVerlet()
@@ -42,7 +81,16 @@ public:
 
     void initialize() override;
 
-    std::vector<sf::Vertex> run() override;
+    void run(std::vector<sf::Vertex>& vertices) override;
+
+    void save_checkpoint(CheckpointState& state) override;
+    void restore_checkpoint(const CheckpointFile& checkpoint) override;
+
+    void save_snapshot(TrajectorySnapshot& snapshot, bool with_velocities) override;
+
+    void set_profiler(Profiler* profiler) override;
+
+    void set_diagnostics(DiagnosticsLog* diagnostics) override;
 };
 
 #endif // !SINGLE_THREADED_VELOCITY_VERLET_HPP_
@@ -0,0 +1,156 @@
+#include "SpatialOrder.hpp"
+
+#include <limits>
+#include <numeric>
+
+const char* get_space_filling_curve_name(SpaceFillingCurve curve)
+{
+    return (curve == SpaceFillingCurve::Morton) ? "Morton" : "Hilbert";
+}
+
+// inserts two zero bits above each of the lower 10 bits
+static std::uint32_t spread_bits(std::uint32_t value)
+{
+    value &= 0x000003ffu;
+    value = (value | (value << 16)) & 0x030000ffu;
+    value = (value | (value << 8)) & 0x0300f00fu;
+    value = (value | (value << 4)) & 0x030c30c3u;
+    value = (value | (value << 2)) & 0x09249249u;
+
+    return value;
+}
+
+std::uint32_t get_morton_key(std::uint32_t x, std::uint32_t y, std::uint32_t z)
+{
+    return (spread_bits(x) << 2) | (spread_bits(y) << 1) | spread_bits(z);
+}
+
+std::uint32_t get_hilbert_key(std::uint32_t x, std::uint32_t y, std::uint32_t z)
+{
+    // Skilling's transform of the coordinates into the transposed Hilbert index,
+    // interleaving the transposed bits then gives the index itself
+    std::uint32_t axes[3] = { x, y, z };
+
+    for (std::uint32_t q = 1u << (SPACE_FILLING_CURVE_BITS - 1u); q > 1u; q >>= 1)
+    {
+        const std::uint32_t p = q - 1u;
+
+        for (std::size_t i = 0; i < 3; ++i)
+        {
+            if ((axes[i] & q) != 0u)
+            {
+                axes[0] ^= p;
+            }
+            else
+            {
+                const std::uint32_t t = (axes[0] ^ axes[i]) & p;
+
+                axes[0] ^= t;
+                axes[i] ^= t;
+            }
+        }
+    }
+
+    // gray encode
+    axes[1] ^= axes[0];
+    axes[2] ^= axes[1];
+
+    std::uint32_t t = 0u;
+
+    for (std::uint32_t q = 1u << (SPACE_FILLING_CURVE_BITS - 1u); q > 1u; q >>= 1)
+    {
+        if ((axes[2] & q) != 0u)
+        {
+            t ^= q - 1u;
+        }
+    }
+
+    return get_morton_key(axes[0] ^ t, axes[1] ^ t, axes[2] ^ t);
+}
+
+void ParticleReorderer::reset(std::uint64_t step)
+{
+    m_ids.resize(m_num_particles);
+    m_order.resize(m_num_particles);
+
+    std::iota(m_ids.begin(), m_ids.end(), 0u);
+    std::iota(m_order.begin(), m_order.end(), 0u);
+
+    m_last_step = step;
+}
+
+bool ParticleReorderer::compute_order(const float* x, const float* y, const float* z, std::uint64_t step, std::size_t stride)
+{
+    m_last_step = step;
+
+    const float* axes[3] = { x, y, z };
+
+    float min_position[3];
+    float max_position[3];
+
+    for (std::size_t axis = 0; axis < 3; ++axis)
+    {
+        min_position[axis] = std::numeric_limits<float>::max();
+        max_position[axis] = std::numeric_limits<float>::lowest();
+
+        for (std::size_t i = 0; i < m_num_particles; ++i)
+        {
+            min_position[axis] = std::min(min_position[axis], axes[axis][i * stride]);
+            max_position[axis] = std::max(max_position[axis], axes[axis][i * stride]);
+        }
+    }
+
+    // one cubic grid over the bounding box keeps the curve's locality in every direction
+    float extent = 0.f;
+
+    for (std::size_t axis = 0; axis < 3; ++axis)
+    {
+        extent = std::max(extent, max_position[axis] - min_position[axis]);
+    }
+
+    const std::uint32_t max_cell = (1u << SPACE_FILLING_CURVE_BITS) - 1u;
+    const float scale = (extent > 0.f) ? static_cast<float>(max_cell) / extent : 0.f;
+
+    m_sort_keys.resize(m_num_particles);
+
+    for (std::size_t i = 0; i < m_num_particles; ++i)
+    {
+        std::uint32_t cell[3];
+
+        for (std::size_t axis = 0; axis < 3; ++axis)
+        {
+            const float position = (axes[axis][i * stride] - min_position[axis]) * scale;
+
+            cell[axis] = std::min(static_cast<std::uint32_t>(std::max(position, 0.f)), max_cell);
+        }
+
+        const std::uint32_t key = (m_parameters.curve == SpaceFillingCurve::Morton)
+            ? get_morton_key(cell[0], cell[1], cell[2])
+            : get_hilbert_key(cell[0], cell[1], cell[2]);
+
+        m_sort_keys[i] = (static_cast<std::uint64_t>(key) << 32) | i;
+    }
+
+    std::sort(m_sort_keys.begin(), m_sort_keys.end());
+
+    bool changed = false;
+
+    m_new_ids.resize(m_num_particles);
+
+    for (std::size_t i = 0; i < m_num_particles; ++i)
+    {
+        m_order[i] = static_cast<std::uint32_t>(m_sort_keys[i] & 0xffffffffu);
+        m_new_ids[i] = m_ids[m_order[i]];
+
+        changed = changed || (m_order[i] != i);
+    }
+
+    m_ids.swap(m_new_ids);
+
+    if (changed)
+    {
+        ++m_num_reorders;
+    }
+
+    return changed;
+}
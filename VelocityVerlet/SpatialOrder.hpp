@@ -0,0 +1,121 @@
+#ifndef SPATIAL_ORDER_HPP_
+#define SPATIAL_ORDER_HPP_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+enum class SpaceFillingCurve
+{
+    Morton,
+    Hilbert
+};
+
+struct ReorderParameters
+{
+    SpaceFillingCurve curve = SpaceFillingCurve::Hilbert;
+
+    // steps between two sorts, zero keeps the initial order
+    std::size_t interval = 0u;
+};
+
+const char* get_space_filling_curve_name(SpaceFillingCurve curve);
+
+// keys of a cell on the 2^SPACE_FILLING_CURVE_BITS grid per axis
+constexpr std::uint32_t SPACE_FILLING_CURVE_BITS = 10u;
+
+std::uint32_t get_morton_key(std::uint32_t x, std::uint32_t y, std::uint32_t z);
+std::uint32_t get_hilbert_key(std::uint32_t x, std::uint32_t y, std::uint32_t z);
+
+// sorts the particles along a space-filling curve so that particles close in space are
+// close in memory. the strategies permute all their per-particle arrays with the order,
+// the ids map every slot back to the particle's original index for output and rendering
+class ParticleReorderer
+{
+private:
+    ReorderParameters m_parameters;
+    std::size_t m_num_particles;
+    std::uint64_t m_last_step;
+    std::size_t m_num_reorders;
+
+    // curve key in the upper, old slot in the lower half, so equal keys keep their order
+    std::vector<std::uint64_t> m_sort_keys;
+
+    // m_order[new slot] = old slot
+    std::vector<std::uint32_t> m_order;
+
+    // original index of the particle in each slot
+    std::vector<std::uint32_t> m_ids;
+    std::vector<std::uint32_t> m_new_ids;
+
+    std::vector<float> m_scratch;
+
+public:
+    ParticleReorderer(std::size_t num_particles, const ReorderParameters& parameters)
+        : m_parameters(parameters),
+        m_num_particles(num_particles),
+        m_last_step(0u),
+        m_num_reorders(0u)
+    {
+        reset(0u);
+    }
+
+    bool is_enabled() const
+    {
+        return (m_parameters.interval > 0);
+    }
+
+    bool is_due(std::uint64_t step) const
+    {
+        return is_enabled() && (step >= m_last_step + m_parameters.interval);
+    }
+
+    // back to the original order, for example after restoring a checkpoint at step
+    void reset(std::uint64_t step);
+
+    // sorts the slots by the curve key of their positions. stride steps over interleaved
+    // components, 4 for float4 positions. returns false when the order did not change
+    bool compute_order(const float* x, const float* y, const float* z, std::uint64_t step, std::size_t stride = 1u);
+
+    // gathers values[0, num_particles) into the order of the last compute_order,
+    // scratch has room for num_particles values
+    template <typename T>
+    void apply(T* values, T* scratch) const
+    {
+        for (std::size_t i = 0; i < m_num_particles; ++i)
+        {
+            scratch[i] = values[m_order[i]];
+        }
+
+        std::copy(scratch, scratch + m_num_particles, values);
+    }
+
+    void apply(float* values)
+    {
+        m_scratch.resize(m_num_particles);
+        apply(values, m_scratch.data());
+    }
+
+    const std::vector<std::uint32_t>& get_order() const
+    {
+        return m_order;
+    }
+
+    const std::vector<std::uint32_t>& get_ids() const
+    {
+        return m_ids;
+    }
+
+    SpaceFillingCurve get_curve() const
+    {
+        return m_parameters.curve;
+    }
+
+    std::size_t get_num_reorders() const
+    {
+        return m_num_reorders;
+    }
+};
+
+#endif // !SPATIAL_ORDER_HPP_
@@ -0,0 +1,156 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(std::size_t num_threads)
+    : m_queued_tasks(0u),
+    m_pending_tasks(0u),
+    m_next_queue(0u),
+    m_stop(false)
+{
+    num_threads = std::max<std::size_t>(num_threads, 1u);
+
+    for (std::size_t i = 0; i < num_threads; ++i)
+    {
+        m_queues.push_back(std::make_unique<WorkerQueue>());
+    }
+
+    for (std::size_t i = 0; i < num_threads; ++i)
+    {
+        m_threads.emplace_back(&ThreadPool::worker_loop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+
+    m_work_available.notify_all();
+
+    for (std::thread& thread : m_threads)
+    {
+        thread.join();
+    }
+}
+
+std::size_t ThreadPool::get_num_threads() const
+{
+    return m_threads.size();
+}
+
+bool ThreadPool::pop_task(std::size_t worker, Task& task)
+{
+    // newest task from our own queue first, it is most likely still in cache
+    {
+        WorkerQueue& queue = *m_queues[worker];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+
+        if (!queue.tasks.empty())
+        {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+            --m_queued_tasks;
+
+            return true;
+        }
+    }
+
+    // otherwise steal the oldest task of another worker
+    for (std::size_t offset = 1; offset < m_queues.size(); ++offset)
+    {
+        WorkerQueue& victim = *m_queues[(worker + offset) % m_queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+
+        if (!victim.tasks.empty())
+        {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            --m_queued_tasks;
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ThreadPool::worker_loop(std::size_t worker)
+{
+    while (true)
+    {
+        Task task;
+
+        if (pop_task(worker, task))
+        {
+            task(worker);
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            if (--m_pending_tasks == 0)
+            {
+                m_work_finished.notify_all();
+            }
+
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        m_work_available.wait(lock, [this] { return m_stop || (m_queued_tasks > 0); });
+
+        if (m_stop && (m_queued_tasks == 0))
+        {
+            return;
+        }
+    }
+}
+
+void ThreadPool::submit(Task task)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    WorkerQueue& queue = *m_queues[m_next_queue];
+    m_next_queue = (m_next_queue + 1) % m_queues.size();
+
+    {
+        std::lock_guard<std::mutex> queue_lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+
+    ++m_queued_tasks;
+    ++m_pending_tasks;
+
+    m_work_available.notify_one();
+}
+
+void ThreadPool::wait()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    m_work_finished.wait(lock, [this] { return m_pending_tasks == 0; });
+}
+
+void ThreadPool::parallel_for(std::size_t begin, std::size_t end, std::size_t grain_size, const RangeTask& body)
+{
+    if (begin >= end)
+    {
+        return;
+    }
+
+    grain_size = std::max<std::size_t>(grain_size, 1u);
+
+    for (std::size_t chunk = begin; chunk < end; chunk += grain_size)
+    {
+        const std::size_t chunk_end = std::min(chunk + grain_size, end);
+
+        submit([&body, chunk, chunk_end](std::size_t worker)
+        {
+            body(chunk, chunk_end, worker);
+        });
+    }
+
+    wait();
+}
@@ -0,0 +1,64 @@
+#ifndef THREAD_POOL_HPP_
+#define THREAD_POOL_HPP_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+public:
+    // the argument is the index of the worker executing the task, which
+    // can be used to address per-thread scratch buffers
+    using Task = std::function<void(std::size_t)>;
+
+    // [begin, end) range and worker index
+    using RangeTask = std::function<void(std::size_t, std::size_t, std::size_t)>;
+
+private:
+    struct WorkerQueue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::thread> m_threads;
+    std::vector<std::unique_ptr<WorkerQueue>> m_queues;
+
+    std::mutex m_mutex;
+    std::condition_variable m_work_available;
+    std::condition_variable m_work_finished;
+
+    std::atomic<std::size_t> m_queued_tasks;
+    std::size_t m_pending_tasks;
+    std::size_t m_next_queue;
+    bool m_stop;
+
+    bool pop_task(std::size_t worker, Task& task);
+    void worker_loop(std::size_t worker);
+
+public:
+    explicit ThreadPool(std::size_t num_threads = std::thread::hardware_concurrency());
+
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    std::size_t get_num_threads() const;
+
+    void submit(Task task);
+
+    void wait();
+
+    // splits [begin, end) into chunks of grain_size and blocks until all of them are done
+    void parallel_for(std::size_t begin, std::size_t end, std::size_t grain_size, const RangeTask& body);
+};
+
+#endif // !THREAD_POOL_HPP_
@@ -0,0 +1,405 @@
+#include "TrajectoryWriter.hpp"
+
+#include "ITrajectorySource.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <limits>
+
+static const char TRAJECTORY_MAGIC[8] = { 'V', 'V', 'T', 'R', 'A', 'J', '\0', '\0' };
+
+static std::uint16_t quantize(float value, float min_value, float scale)
+{
+    return static_cast<std::uint16_t>(std::lround(std::clamp((value - min_value) * scale, 0.f, 65535.f)));
+}
+
+static void write_varint(std::vector<unsigned char>& payload, std::uint32_t value)
+{
+    while (value >= 0x80u)
+    {
+        payload.push_back(static_cast<unsigned char>(value | 0x80u));
+        value >>= 7;
+    }
+
+    payload.push_back(static_cast<unsigned char>(value));
+}
+
+TrajectoryWriter::~TrajectoryWriter()
+{
+    close();
+}
+
+std::size_t TrajectoryWriter::get_frame_interval() const
+{
+    return m_frame_interval;
+}
+
+TrajectoryContent TrajectoryWriter::get_content() const
+{
+    return m_content;
+}
+
+std::size_t TrajectoryWriter::get_position_components() const
+{
+    return (m_content == TrajectoryContent::RenderedXY) ? 2u : 3u;
+}
+
+std::size_t TrajectoryWriter::get_num_components() const
+{
+    return get_position_components() + ((m_content == TrajectoryContent::PositionsVelocitiesXYZ) ? 3u : 0u);
+}
+
+void TrajectoryWriter::open(std::size_t num_particles, TrajectoryContent content)
+{
+    m_num_particles = num_particles;
+    m_content = content;
+    m_file.open(m_file_name, std::ios::binary | std::ios::trunc);
+
+    if (!m_file || !write_header())
+    {
+        throw std::string("Failed to open trajectory file ") + m_file_name;
+    }
+
+    m_chunk_frames.reserve(m_frames_per_chunk);
+    m_thread = std::thread(&TrajectoryWriter::writer_loop, this);
+}
+
+bool TrajectoryWriter::write_header()
+{
+    TrajectoryHeader header = {};
+
+    std::memcpy(header.magic, TRAJECTORY_MAGIC, sizeof(header.magic));
+    header.version = TRAJECTORY_VERSION;
+    header.header_size = sizeof(TrajectoryHeader);
+    header.num_particles = m_num_particles;
+    header.frame_interval = static_cast<std::uint32_t>(m_frame_interval);
+    header.encoding = m_encoding;
+    header.content = m_content;
+    header.num_components = static_cast<std::uint32_t>(get_num_components());
+
+    m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    return static_cast<bool>(m_file);
+}
+
+bool TrajectoryWriter::acquire_frame(Frame& frame)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    ++m_frames_pushed;
+
+    if (m_queue.size() >= m_queue_capacity)
+    {
+        if (!m_block_when_full)
+        {
+            ++m_frames_dropped;
+            return false;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+
+        m_slot_available.wait(lock, [this]() { return m_queue.size() < m_queue_capacity; });
+
+        ++m_frames_blocked;
+        m_blocked_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // recycled frames keep their allocation, after the first chunk nothing is allocated
+    if (!m_free_frames.empty())
+    {
+        frame = std::move(m_free_frames.back());
+        m_free_frames.pop_back();
+    }
+
+    return true;
+}
+
+void TrajectoryWriter::queue_frame(Frame&& frame)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.push_back(std::move(frame));
+    }
+
+    m_frame_available.notify_one();
+}
+
+bool TrajectoryWriter::push(std::uint64_t frame_index, const std::vector<sf::Vertex>& vertices)
+{
+    if (m_content != TrajectoryContent::RenderedXY)
+    {
+        throw std::string("Trajectory frames of this content come from a trajectory source");
+    }
+
+    if (vertices.size() != m_num_particles)
+    {
+        throw std::string("Trajectory frame has the wrong number of particles");
+    }
+
+    Frame frame;
+
+    if (!acquire_frame(frame))
+    {
+        return false;
+    }
+
+    // the copy happens outside the lock, the writer thread only waits on the queue itself
+    frame.index = frame_index;
+    frame.snapshot.positions.resize(m_num_particles * 2u);
+    frame.snapshot.velocities.clear();
+
+    for (std::size_t i = 0; i < m_num_particles; ++i)
+    {
+        frame.snapshot.positions[i * 2u] = vertices[i].position.x;
+        frame.snapshot.positions[i * 2u + 1u] = vertices[i].position.y;
+    }
+
+    queue_frame(std::move(frame));
+
+    return true;
+}
+
+bool TrajectoryWriter::push(std::uint64_t frame_index, ITrajectorySource& source)
+{
+    if (m_content == TrajectoryContent::RenderedXY)
+    {
+        throw std::string("Rendered trajectory frames come from the vertices");
+    }
+
+    Frame frame;
+
+    if (!acquire_frame(frame))
+    {
+        return false;
+    }
+
+    const bool with_velocities = (m_content == TrajectoryContent::PositionsVelocitiesXYZ);
+
+    frame.index = frame_index;
+    source.save_snapshot(frame.snapshot, with_velocities);
+
+    if ((frame.snapshot.positions.size() != m_num_particles * 3u)
+        || (with_velocities && (frame.snapshot.velocities.size() != m_num_particles * 3u)))
+    {
+        throw std::string("Trajectory frame has the wrong number of particles");
+    }
+
+    if (!with_velocities)
+    {
+        frame.snapshot.velocities.clear();
+    }
+
+    queue_frame(std::move(frame));
+
+    return true;
+}
+
+void TrajectoryWriter::writer_loop()
+{
+    while (true)
+    {
+        Frame frame;
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+
+            m_frame_available.wait(lock, [this]() { return m_stop || !m_queue.empty(); });
+
+            if (m_queue.empty())
+            {
+                break;
+            }
+
+            frame = std::move(m_queue.front());
+            m_queue.pop_front();
+        }
+
+        m_slot_available.notify_one();
+        m_chunk_frames.push_back(std::move(frame));
+
+        if (m_chunk_frames.size() == m_frames_per_chunk)
+        {
+            write_chunk();
+        }
+    }
+
+    if (!m_chunk_frames.empty())
+    {
+        write_chunk();
+    }
+
+    m_file.flush();
+}
+
+void TrajectoryWriter::write_chunk()
+{
+    TrajectoryChunkHeader chunk = {};
+
+    chunk.num_frames = static_cast<std::uint32_t>(m_chunk_frames.size());
+
+    const std::size_t position_components = get_position_components();
+
+    for (std::size_t component = 0; component < TRAJECTORY_MAX_COMPONENTS; ++component)
+    {
+        chunk.min_values[component] = (component < get_num_components()) ? std::numeric_limits<float>::max() : 0.f;
+        chunk.max_values[component] = (component < get_num_components()) ? std::numeric_limits<float>::lowest() : 0.f;
+    }
+
+    // velocity components follow the position components
+    auto update_bounds = [&chunk](const std::vector<float>& values, std::size_t stride, std::size_t first_component)
+    {
+        for (std::size_t i = 0; i < values.size(); ++i)
+        {
+            const std::size_t component = first_component + i % stride;
+
+            chunk.min_values[component] = std::min(chunk.min_values[component], values[i]);
+            chunk.max_values[component] = std::max(chunk.max_values[component], values[i]);
+        }
+    };
+
+    for (const Frame& frame : m_chunk_frames)
+    {
+        update_bounds(frame.snapshot.positions, position_components, 0u);
+        update_bounds(frame.snapshot.velocities, 3u, position_components);
+    }
+
+    m_payload.clear();
+
+    for (const Frame& frame : m_chunk_frames)
+    {
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&frame.index);
+        m_payload.insert(m_payload.end(), bytes, bytes + sizeof(frame.index));
+    }
+
+    switch (m_encoding)
+    {
+    case TrajectoryEncoding::Float32:
+        encode_float32();
+        break;
+    case TrajectoryEncoding::Quantized16:
+        encode_quantized(chunk, false);
+        break;
+    case TrajectoryEncoding::QuantizedDelta:
+        encode_quantized(chunk, true);
+        break;
+    }
+
+    chunk.stored_size = m_payload.size();
+
+    const auto start = std::chrono::steady_clock::now();
+
+    m_file.write(reinterpret_cast<const char*>(&chunk), sizeof(chunk));
+    m_file.write(reinterpret_cast<const char*>(m_payload.data()), m_payload.size());
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_failed = m_failed || !m_file;
+    m_frames_written += m_chunk_frames.size();
+    m_raw_bytes += m_chunk_frames.size() * m_num_particles * get_num_components() * sizeof(float);
+    m_bytes_written += sizeof(chunk) + m_payload.size();
+    m_write_seconds += seconds;
+
+    for (Frame& frame : m_chunk_frames)
+    {
+        m_free_frames.push_back(std::move(frame));
+    }
+
+    m_chunk_frames.clear();
+}
+
+void TrajectoryWriter::encode_float32()
+{
+    for (const Frame& frame : m_chunk_frames)
+    {
+        for (const std::vector<float>* values : { &frame.snapshot.positions, &frame.snapshot.velocities })
+        {
+            const unsigned char* bytes = reinterpret_cast<const unsigned char*>(values->data());
+            m_payload.insert(m_payload.end(), bytes, bytes + values->size() * sizeof(float));
+        }
+    }
+}
+
+void TrajectoryWriter::encode_quantized(const TrajectoryChunkHeader& chunk, bool delta)
+{
+    std::array<float, TRAJECTORY_MAX_COMPONENTS> scales = {};
+
+    for (std::size_t component = 0; component < get_num_components(); ++component)
+    {
+        const float range = chunk.max_values[component] - chunk.min_values[component];
+        scales[component] = (range > 0.f) ? 65535.f / range : 0.f;
+    }
+
+    const std::size_t position_components = get_position_components();
+    const std::size_t num_position_values = m_num_particles * position_components;
+
+    // every chunk starts from zero so it can be decoded on its own
+    m_previous.assign(delta ? m_num_particles * get_num_components() : 0u, 0u);
+
+    for (const Frame& frame : m_chunk_frames)
+    {
+        const std::size_t num_values = frame.snapshot.positions.size() + frame.snapshot.velocities.size();
+
+        for (std::size_t i = 0; i < num_values; ++i)
+        {
+            // the velocities continue after the positions
+            const bool is_position = (i < num_position_values);
+            const std::size_t component = is_position ? i % position_components : position_components + (i - num_position_values) % 3u;
+            const float original = is_position ? frame.snapshot.positions[i] : frame.snapshot.velocities[i - num_position_values];
+
+            const std::uint16_t value = quantize(original, chunk.min_values[component], scales[component]);
+
+            if (!delta)
+            {
+                m_payload.push_back(static_cast<unsigned char>(value & 0xFFu));
+                m_payload.push_back(static_cast<unsigned char>(value >> 8));
+                continue;
+            }
+
+            // zigzag maps small negative differences to small unsigned values
+            const std::int32_t difference = static_cast<std::int32_t>(value) - static_cast<std::int32_t>(m_previous[i]);
+            const std::uint32_t zigzag = (static_cast<std::uint32_t>(difference) << 1) ^ static_cast<std::uint32_t>(difference >> 31);
+
+            write_varint(m_payload, zigzag);
+            m_previous[i] = value;
+        }
+    }
+}
+
+void TrajectoryWriter::close()
+{
+    if (!m_thread.joinable())
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+
+    m_frame_available.notify_one();
+    m_thread.join();
+    m_file.close();
+}
+
+void TrajectoryWriter::print_statistics(std::ostream& out)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    const double megabytes = static_cast<double>(m_bytes_written) / (1024.0 * 1024.0);
+
+    out << "Trajectory " << m_file_name << (m_failed ? " (write failed)" : "") << std::endl
+        << "  frames written     : " << m_frames_written << " of " << m_frames_pushed << std::endl
+        << "  frames dropped     : " << m_frames_dropped << std::endl
+        << "  frames blocked     : " << m_frames_blocked << " (" << m_blocked_seconds << " s)" << std::endl
+        << "  stored / raw       : " << std::fixed << std::setprecision(2) << megabytes << " MB / "
+        << static_cast<double>(m_raw_bytes) / (1024.0 * 1024.0) << " MB" << std::endl
+        << "  write bandwidth    : " << ((m_write_seconds > 0.0) ? megabytes / m_write_seconds : 0.0) << " MB/s"
+        << std::defaultfloat << std::endl;
+}
@@ -0,0 +1,188 @@
+#ifndef TRAJECTORY_WRITER_HPP_
+#define TRAJECTORY_WRITER_HPP_
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <ostream>
+#include <SFML/Graphics.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+// file layout, native byte order:
+//   TrajectoryHeader
+//   chunks, each a TrajectoryChunkHeader followed by stored_size bytes of payload
+//
+// a chunk holds up to frames_per_chunk frames. the payload starts with the num_frames uint64
+// integration steps of the frames, frames may have been dropped in between. every frame then
+// holds the num_particles positions, x, y and z interleaved (only x and y for RenderedXY),
+// followed by the velocities when the content has them. how the values are stored depends
+// on the encoding:
+//   Float32        the floats as they are
+//   Quantized16    16 bit integers spread over the chunk bounds of their component
+//   QuantizedDelta the 16 bit values minus those of the previous frame of the chunk,
+//                  zigzag encoded varints. slowly moving particles take one byte per value
+constexpr std::uint32_t TRAJECTORY_VERSION = 2u;
+
+// positions and velocities
+constexpr std::size_t TRAJECTORY_MAX_COMPONENTS = 6u;
+
+enum class TrajectoryEncoding : std::uint32_t
+{
+    Float32,
+    Quantized16,
+    QuantizedDelta
+};
+
+enum class TrajectoryContent : std::uint32_t
+{
+    // the x and y of the rendered vertices, for strategies that are not trajectory sources
+    RenderedXY,
+    PositionsXYZ,
+    PositionsVelocitiesXYZ
+};
+
+struct TrajectoryHeader
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t header_size;
+    std::uint64_t num_particles;
+    std::uint32_t frame_interval;
+    TrajectoryEncoding encoding;
+    TrajectoryContent content;
+    std::uint32_t num_components;
+};
+
+// the bounds of the first num_components components are used
+struct TrajectoryChunkHeader
+{
+    std::uint32_t num_frames;
+    std::uint32_t reserved;
+    float min_values[TRAJECTORY_MAX_COMPONENTS];
+    float max_values[TRAJECTORY_MAX_COMPONENTS];
+    std::uint64_t stored_size;
+};
+
+// one frame of particle state in particle order, x, y and z interleaved
+struct TrajectorySnapshot
+{
+    std::vector<float> positions;
+    std::vector<float> velocities;
+};
+
+class ITrajectorySource;
+
+// streams frames to disk on a dedicated thread. push() only copies the particle state into a
+// recycled frame buffer and hands it over through a bounded queue, when the queue is full
+// the frame is dropped or, with block_when_full, the caller waits for the writer
+class TrajectoryWriter
+{
+private:
+    struct Frame
+    {
+        std::uint64_t index;
+        TrajectorySnapshot snapshot;
+    };
+
+    std::string m_file_name;
+    std::ofstream m_file;
+    TrajectoryEncoding m_encoding;
+    std::size_t m_frame_interval;
+    std::size_t m_frames_per_chunk;
+    std::size_t m_queue_capacity;
+    bool m_block_when_full;
+    std::size_t m_num_particles;
+    TrajectoryContent m_content;
+
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_frame_available;
+    std::condition_variable m_slot_available;
+    std::deque<Frame> m_queue;
+    std::vector<Frame> m_free_frames;
+    bool m_stop;
+
+    // only touched by the writer thread
+    std::vector<Frame> m_chunk_frames;
+    std::vector<unsigned char> m_payload;
+    std::vector<std::uint16_t> m_previous;
+
+    // statistics, guarded by m_mutex
+    std::size_t m_frames_pushed;
+    std::size_t m_frames_written;
+    std::size_t m_frames_dropped;
+    std::size_t m_frames_blocked;
+    double m_blocked_seconds;
+    std::uint64_t m_raw_bytes;
+    std::uint64_t m_bytes_written;
+    double m_write_seconds;
+    bool m_failed;
+
+    bool write_header();
+    std::size_t get_position_components() const;
+    std::size_t get_num_components() const;
+    bool acquire_frame(Frame& frame);
+    void queue_frame(Frame&& frame);
+    void writer_loop();
+    void write_chunk();
+    void encode_float32();
+    void encode_quantized(const TrajectoryChunkHeader& chunk, bool delta);
+
+public:
+    TrajectoryWriter(std::string file_name,
+        TrajectoryEncoding encoding,
+        std::size_t frame_interval,
+        std::size_t frames_per_chunk = 32u,
+        std::size_t queue_capacity = 8u,
+        bool block_when_full = false)
+        : m_file_name(file_name),
+        m_encoding(encoding),
+        m_frame_interval(frame_interval),
+        m_frames_per_chunk(frames_per_chunk),
+        m_queue_capacity(queue_capacity),
+        m_block_when_full(block_when_full),
+        m_num_particles(0u),
+        m_content(TrajectoryContent::RenderedXY),
+        m_stop(false),
+        m_frames_pushed(0u),
+        m_frames_written(0u),
+        m_frames_dropped(0u),
+        m_frames_blocked(0u),
+        m_blocked_seconds(0.0),
+        m_raw_bytes(0u),
+        m_bytes_written(0u),
+        m_write_seconds(0.0),
+        m_failed(false)
+    {}
+
+    ~TrajectoryWriter();
+
+    TrajectoryWriter(const TrajectoryWriter&) = delete;
+    TrajectoryWriter& operator=(const TrajectoryWriter&) = delete;
+
+    std::size_t get_frame_interval() const;
+
+    TrajectoryContent get_content() const;
+
+    // opens the file and starts the writer thread, throws std::string on failure
+    void open(std::size_t num_particles, TrajectoryContent content);
+
+    // for RenderedXY, returns false if the frame was dropped
+    bool push(std::uint64_t frame_index, const std::vector<sf::Vertex>& vertices);
+
+    // for the other contents, the source fills a recycled frame. returns false if the frame
+    // was dropped, the source is not asked for a snapshot then
+    bool push(std::uint64_t frame_index, ITrajectorySource& source);
+
+    // writes the queued frames and the last partial chunk, then stops the writer thread
+    void close();
+
+    void print_statistics(std::ostream& out);
+};
+
+#endif // !TRAJECTORY_WRITER_HPP_
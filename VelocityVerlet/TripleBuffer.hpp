@@ -0,0 +1,70 @@
+#ifndef TRIPLE_BUFFER_HPP_
+#define TRIPLE_BUFFER_HPP_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// single producer, single consumer hand-over of the latest value without locks. the
+// producer writes into get_back() and publishes it, the consumer takes the most recently
+// published value with consume(). neither side ever waits for the other, values the
+// consumer did not pick up in time are overwritten
+template <typename T>
+class TripleBuffer
+{
+private:
+    static constexpr std::uint8_t INDEX_MASK = 0x3u;
+    static constexpr std::uint8_t FRESH_BIT = 0x4u;
+
+    std::array<T, 3u> m_buffers;
+
+    // index of the buffer between the two sides, FRESH_BIT is set when it holds a value
+    // the consumer has not seen yet
+    std::atomic<std::uint8_t> m_middle;
+
+    // owned by the producer and the consumer respectively
+    std::uint8_t m_back;
+    std::uint8_t m_front;
+
+public:
+    TripleBuffer()
+        : m_middle(1u),
+        m_back(0u),
+        m_front(2u)
+    {}
+
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    // producer side
+    T& get_back()
+    {
+        return m_buffers[m_back];
+    }
+
+    void publish()
+    {
+        // release the written buffer, acquire the one the consumer gave back
+        m_back = m_middle.exchange(static_cast<std::uint8_t>(m_back | FRESH_BIT), std::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    // consumer side, returns false and keeps the current front when nothing new was published
+    bool consume()
+    {
+        if ((m_middle.load(std::memory_order_relaxed) & FRESH_BIT) == 0)
+        {
+            return false;
+        }
+
+        m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & INDEX_MASK;
+
+        return true;
+    }
+
+    const T& get_front() const
+    {
+        return m_buffers[m_front];
+    }
+};
+
+#endif // !TRIPLE_BUFFER_HPP_
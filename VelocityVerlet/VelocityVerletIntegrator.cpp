@@ -1,10 +1,15 @@
 #include "VelocityVerletIntegrator.hpp"
 
+#include <algorithm>
 #include <cstdlib>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
 #include <string>
+#include <thread>
 
 #include <SFML/Graphics.hpp>
+#include <SFML/OpenGL.hpp>
 #include <SFML/System.hpp>
 #include <SFML/Window.hpp>
 
@@ -31,6 +36,119 @@ void VelocityVerletIntegrator::set_renderer(IRenderStrategy& renderer)
 	m_renderer = renderer;
 }
 
+void VelocityVerletIntegrator::set_checkpoint(ICheckpointable& source, std::string file_name, std::size_t interval)
+{
+	m_checkpoint_source = &source;
+	m_checkpoint_file = file_name;
+	m_checkpoint_interval = interval;
+}
+
+void VelocityVerletIntegrator::set_trajectory_writer(TrajectoryWriter& writer, ITrajectorySource* source)
+{
+	m_trajectory_writer = &writer;
+	m_trajectory_source = source;
+}
+
+void VelocityVerletIntegrator::set_steps_per_run(std::size_t steps_per_run)
+{
+	m_steps_per_run = std::max<std::size_t>(steps_per_run, 1u);
+}
+
+void VelocityVerletIntegrator::set_profiler(Profiler& profiler)
+{
+	m_profiler = &profiler;
+}
+
+void VelocityVerletIntegrator::set_decoupled(bool decoupled)
+{
+	m_decoupled = decoupled;
+}
+
+// true when one of the integration steps (last_step - steps_per_run, last_step] is a multiple of interval
+static bool crosses_interval(std::uint64_t last_step, std::size_t steps_per_run, std::size_t interval)
+{
+	return (interval > 0) && ((last_step / interval) != ((last_step - steps_per_run) / interval));
+}
+
+void VelocityVerletIntegrator::after_step(std::uint64_t step, const std::vector<sf::Vertex>& vertices)
+{
+	// step counts run() calls, the intervals count integration steps
+	const std::uint64_t last_step = step * m_steps_per_run;
+
+	if ((m_checkpoint_source != nullptr) && crosses_interval(last_step, m_steps_per_run, m_checkpoint_interval))
+	{
+		m_checkpoint_writer.save_async(*m_checkpoint_source, m_checkpoint_file);
+	}
+
+	// only copies the state, a full queue drops the frame instead of stalling the loop. a run
+	// of several steps records at most one frame, the state after its last step
+	if ((m_trajectory_writer != nullptr) && crosses_interval(last_step, m_steps_per_run, m_trajectory_writer->get_frame_interval()))
+	{
+		if (m_trajectory_source != nullptr)
+		{
+			m_trajectory_writer->push(last_step, *m_trajectory_source);
+		}
+		else
+		{
+			m_trajectory_writer->push(last_step, vertices);
+		}
+	}
+}
+
+void VelocityVerletIntegrator::simulation_loop()
+{
+	try
+	{
+		std::uint64_t step = 0;
+
+		while (!m_stop_simulation.load(std::memory_order_relaxed))
+		{
+			// the back buffer keeps its allocation, run() only resizes it on the first steps
+			SimulationSnapshot& snapshot = m_snapshots.get_back();
+
+			sf::Clock timer;
+
+			m_algorithm.run(snapshot.vertices);
+
+			snapshot.step = ++step;
+			snapshot.step_seconds = timer.getElapsedTime().asSeconds();
+
+			after_step(step, snapshot.vertices);
+
+			m_snapshots.publish();
+		}
+	}
+	catch (...)
+	{
+		m_simulation_error = std::current_exception();
+		m_stop_simulation = true;
+	}
+}
+
+void VelocityVerletIntegrator::finish_outputs()
+{
+	if ((m_checkpoint_source != nullptr) && !m_checkpoint_writer.wait())
+	{
+		std::cout << "Failed to write checkpoint " << m_checkpoint_file << std::endl;
+	}
+
+	if (m_checkpoint_writer.get_num_written() > 0)
+	{
+		std::cout << "Wrote " << m_checkpoint_writer.get_num_written() << " checkpoints to " << m_checkpoint_file << std::endl;
+	}
+
+	if (m_trajectory_writer != nullptr)
+	{
+		m_trajectory_writer->close();
+		m_trajectory_writer->print_statistics(std::cout);
+	}
+
+	if (m_checkpoint_writer.get_num_skipped() > 0)
+	{
+		std::cout << "Skipped " << m_checkpoint_writer.get_num_skipped() << " checkpoints while a write was in progress" << std::endl;
+	}
+}
+
 void VelocityVerletIntegrator::execute()
 {
 	validate_inputs();
@@ -43,7 +161,31 @@ void VelocityVerletIntegrator::execute()
 	frame_time.setCharacterSize(24);
 	frame_time.setFillColor(sf::Color::Red);
 
-	sf::Clock clock;
+	sf::Text profile_overlay;
+
+	profile_overlay.setFont(m_render_font);
+	profile_overlay.setCharacterSize(14);
+	profile_overlay.setFillColor(sf::Color::Yellow);
+	profile_overlay.setPosition(0.f, 32.f);
+
+	// owned here and reused every frame, the algorithm only resizes it on the first run
+	std::vector<sf::Vertex> vertices;
+
+	std::uint64_t step = 0;
+	std::size_t frame_count = 0;
+	bool has_frame = false;
+
+	std::thread simulation_thread;
+
+	if (m_decoupled)
+	{
+		// the simulation runs as fast as it can, the window only needs to keep up with the display
+		window.setVerticalSyncEnabled(true);
+
+		m_stop_simulation = false;
+		m_simulation_error = nullptr;
+		simulation_thread = std::thread(&VelocityVerletIntegrator::simulation_loop, this);
+	}
 
 	while (window.isOpen())
 	{
@@ -57,25 +199,159 @@ void VelocityVerletIntegrator::execute()
 			}
 		}
 
+		if (m_decoupled && m_stop_simulation)
+		{
+			// the simulation thread failed, the error is rethrown below
+			window.close();
+			break;
+		}
+
 		window.clear();
 
-		sf::Time elapsed = clock.restart();
+		if (m_decoupled)
+		{
+			// the latest completed step, older ones the render loop missed are skipped
+			if (m_snapshots.consume())
+			{
+				const SimulationSnapshot& snapshot = m_snapshots.get_front();
 
-		sf::Clock timer;
+				{
+					ProfileScope scope(m_profiler, ProfilePhase::Upload);
+					m_renderer.update(snapshot.vertices);
+				}
 
-		// run the Velocity Verlet implementation to create the vertices
-		std::vector<sf::Vertex> vertices = m_algorithm.run();
+				frame_time.setString(std::to_string(snapshot.step_seconds));
+				has_frame = true;
+			}
+		}
+		else
+		{
+			sf::Clock timer;
 
-		// update the renderer with the vertices
-		m_renderer.update(vertices);
+			// run the Velocity Verlet implementation to fill the vertices
+			m_algorithm.run(vertices);
 
-		// render the vertices
-		window.draw(m_renderer.get_frame());
+			after_step(++step, vertices);
 
-		sf::Time duration = timer.restart();
+			// update the renderer with the vertices
+			{
+				ProfileScope scope(m_profiler, ProfilePhase::Upload);
+				m_renderer.update(vertices);
+			}
+
+			frame_time.setString(std::to_string(timer.getElapsedTime().asSeconds()));
+			has_frame = true;
+		}
+
+		++frame_count;
+
+		// render the vertices
+		if (has_frame)
+		{
+			ProfileScope scope(m_profiler, ProfilePhase::Draw);
+			window.draw(m_renderer.get_frame());
+		}
 
-		frame_time.setString(std::to_string(duration.asSeconds()));
 		window.draw(frame_time);
+
+		if (m_profiler != nullptr)
+		{
+			m_profiler->end_frame();
+
+			// refreshed a few times per second so the numbers stay readable
+			if (frame_count % 15 == 1)
+			{
+				std::ostringstream overlay;
+				m_profiler->print_statistics(overlay);
+				profile_overlay.setString(overlay.str());
+			}
+
+			window.draw(profile_overlay);
+		}
+
 		window.display();
 	}
+
+	if (simulation_thread.joinable())
+	{
+		m_stop_simulation = true;
+		simulation_thread.join();
+	}
+
+	finish_outputs();
+
+	if (m_simulation_error)
+	{
+		std::rethrow_exception(m_simulation_error);
+	}
+}
+
+void VelocityVerletIntegrator::execute_offscreen(FrameEncoder& encoder, std::size_t num_frames, std::size_t frame_interval)
+{
+	validate_inputs();
+
+	sf::RenderTexture target;
+
+	if (!target.create(encoder.get_width(), encoder.get_height()))
+	{
+		throw std::string("Failed to create the capture texture");
+	}
+
+	// the scene keeps the window coordinates whatever the capture resolution
+	target.setView(sf::View(sf::FloatRect(0.f, 0.f, static_cast<float>(m_window_width), static_cast<float>(m_window_height))));
+
+	std::vector<sf::Vertex> vertices;
+	std::uint64_t step = 0;
+
+	frame_interval = std::max<std::size_t>(frame_interval, 1u);
+
+	for (std::size_t frame = 0; frame < num_frames; ++frame)
+	{
+		for (std::size_t substep = 0; substep < frame_interval; ++substep)
+		{
+			m_algorithm.run(vertices);
+			after_step(++step, vertices);
+		}
+
+		{
+			ProfileScope scope(m_profiler, ProfilePhase::Upload);
+			m_renderer.update(vertices);
+		}
+
+		{
+			ProfileScope scope(m_profiler, ProfilePhase::Draw);
+
+			target.clear();
+			target.draw(m_renderer.get_frame());
+			target.display();
+		}
+
+		// the read back waits for the GPU and goes straight into a recycled encoder frame, a
+		// frame the encoder has no room for is not read back at all
+		if (sf::Uint8* pixels = encoder.acquire(frame + 1))
+		{
+			ProfileScope scope(m_profiler, ProfilePhase::Transfer);
+
+			if (!target.setActive(true))
+			{
+				throw std::string("Failed to activate the capture texture");
+			}
+
+			glPixelStorei(GL_PACK_ALIGNMENT, 1);
+			glReadPixels(0, 0, static_cast<GLsizei>(encoder.get_width()), static_cast<GLsizei>(encoder.get_height()),
+				GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+
+			encoder.submit(true);
+		}
+
+		if (m_profiler != nullptr)
+		{
+			m_profiler->end_frame();
+		}
+	}
+
+	encoder.close();
+	encoder.print_statistics(std::cout);
+
+	finish_outputs();
 }
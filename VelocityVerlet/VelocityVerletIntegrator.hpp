@@ -2,7 +2,26 @@
 #define VELOCITY_VERLET_INTEGRATOR_HPP_
 
 #include "IAlgorithmStrategy.hpp"
+#include "ICheckpointable.hpp"
+#include "FrameEncoder.hpp"
 #include "IRenderStrategy.hpp"
+#include "ITrajectorySource.hpp"
+#include "Profiler.hpp"
+#include "TrajectoryWriter.hpp"
+#include "TripleBuffer.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <vector>
+
+// the vertices of one completed step, handed from the simulation to the render thread
+struct SimulationSnapshot
+{
+	std::vector<sf::Vertex> vertices;
+	std::uint64_t step = 0;
+	double step_seconds = 0.0;
+};
 
 class VelocityVerletIntegrator
 {
@@ -14,7 +33,35 @@ private:
 	std::string m_window_title;
 	sf::Font m_render_font;
 
+	// optional periodic checkpoints, written in the background every m_checkpoint_interval
+	// integration steps
+	ICheckpointable* m_checkpoint_source;
+	std::string m_checkpoint_file;
+	std::size_t m_checkpoint_interval;
+	CheckpointWriter m_checkpoint_writer;
+
+	// optional trajectory output, every get_frame_interval() integration steps. the state
+	// comes from the source when there is one and from the rendered vertices otherwise
+	TrajectoryWriter* m_trajectory_writer;
+	ITrajectorySource* m_trajectory_source;
+
+	// integration steps the algorithm advances per run()
+	std::size_t m_steps_per_run;
+
+	// optional per-phase timings, shown as an overlay
+	Profiler* m_profiler;
+
+	// run the algorithm on its own thread instead of once per rendered frame
+	bool m_decoupled;
+
+	TripleBuffer<SimulationSnapshot> m_snapshots;
+	std::atomic<bool> m_stop_simulation;
+	std::exception_ptr m_simulation_error;
+
 	void validate_inputs();
+	void simulation_loop();
+	void after_step(std::uint64_t step, const std::vector<sf::Vertex>& vertices);
+	void finish_outputs();
 
 public:
 	explicit VelocityVerletIntegrator(IAlgorithmStrategy& algorithm,
@@ -28,12 +75,29 @@ public:
 		m_window_width(window_width),
 		m_window_height(window_height),
 		m_window_title(window_title),
-		m_render_font(render_font)
+		m_render_font(render_font),
+		m_checkpoint_source(nullptr),
+		m_checkpoint_interval(0u),
+		m_trajectory_writer(nullptr),
+		m_trajectory_source(nullptr),
+		m_steps_per_run(1u),
+		m_profiler(nullptr),
+		m_decoupled(true),
+		m_stop_simulation(false)
 	{ }
 
 	void set_algorithm(IAlgorithmStrategy& algorithm);
 	void set_renderer(IRenderStrategy& renderer);
+	void set_checkpoint(ICheckpointable& source, std::string file_name, std::size_t interval);
+	void set_trajectory_writer(TrajectoryWriter& writer, ITrajectorySource* source = nullptr);
+	void set_steps_per_run(std::size_t steps_per_run);
+	void set_profiler(Profiler& profiler);
+	void set_decoupled(bool decoupled);
 	void execute();
+
+	// runs without a window, every frame_interval steps the renderer draws into an offscreen
+	// texture of the encoder's size that is handed to the encoder. stops after num_frames
+	void execute_offscreen(FrameEncoder& encoder, std::size_t num_frames, std::size_t frame_interval);
 };
 
 #endif // !VELOCITY_VERLET_INTEGRATOR_HPP_
@@ -8,7 +8,7 @@
 #include <SFML/System.hpp>
 #include <SFML/Window.hpp>
 
-void VertexBufferRenderer::update(std::vector<sf::Vertex> vertices)
+void VertexBufferRenderer::update(const std::vector<sf::Vertex>& vertices)
 {
 	if (m_vertex_buffer.getVertexCount() == vertices.size())
 	{
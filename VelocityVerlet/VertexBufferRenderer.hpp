@@ -26,7 +26,7 @@ public:
         m_vertex_buffer.create(0);
     }
 
-    void update(std::vector<sf::Vertex> vertices) override;
+    void update(const std::vector<sf::Vertex>& vertices) override;
 
     const sf::Drawable& get_frame() const override;
 };
@@ -0,0 +1,121 @@
+//independent systems packed back to back, appended to velocity_verlet.cl so the force
+//laws are shared. one work group integrates one system, so the steps of a frame need no
+//global synchronization and the whole ensemble advances in a single launch.
+
+//system_ranges holds the offset and count of every system. forces are kept across
+//launches, they hold the forces at the current positions once forces_valid is set.
+
+//every work item gathers the force on particles lid, lid + local_size, ... of its system,
+//all items run the same number of tiles so they all reach the barriers.
+void compute_system_forces(__global float4* forces,
+    __global const float4* positions,
+    __local float4* positions_cache,
+    uint count)
+{
+    uint lid = get_local_id(0);
+    uint local_size = get_local_size(0);
+
+    for (uint base = 0; base < count; base += local_size)
+    {
+        uint me = base + lid;
+        bool active = (me < count);
+
+        float4 my_pos = active ? positions[me] : (float4)0.0f;
+        float3 force = (float3)0.0f;
+
+        for (uint tile = 0; tile < count; tile += local_size)
+        {
+            uint other = tile + lid;
+
+            //out of range entries get zero mass and add no force.
+            positions_cache[lid] = (other < count) ? positions[other] : (float4)0.0f;
+
+            barrier(CLK_LOCAL_MEM_FENCE);
+
+            for (uint j = 0; j < local_size; ++j)
+            {
+                float4 other_position = positions_cache[j];
+
+                float3 diff = other_position.s012 - my_pos.s012;
+                float dist2 = dot(diff, diff);
+
+                force += get_pair_scale(other_position.s3, dist2) * diff;
+            }
+
+            barrier(CLK_LOCAL_MEM_FENCE);
+        }
+
+        if (active)
+        {
+            forces[me] = (float4)(get_force_factor(my_pos.s3) * force, 0.f);
+        }
+    }
+}
+
+__kernel void step_ensemble(__global float4* positions,
+    __global float4* velocities,
+    __global float4* forces,
+    __global const uint2* system_ranges,
+    __global const float* time_steps,
+    __local float4* positions_cache,
+    uint num_steps,
+    uint forces_valid)
+{
+    uint system = get_group_id(0);
+    uint lid = get_local_id(0);
+    uint local_size = get_local_size(0);
+
+    uint2 range = system_ranges[system];
+    float time_step = time_steps[system];
+
+    __global float4* my_positions = positions + range.s0;
+    __global float4* my_velocities = velocities + range.s0;
+    __global float4* my_forces = forces + range.s0;
+
+    if (forces_valid == 0)
+    {
+        compute_system_forces(my_forces, my_positions, positions_cache, range.s1);
+
+        barrier(CLK_GLOBAL_MEM_FENCE);
+    }
+
+    for (uint step = 0; step < num_steps; ++step)
+    {
+        //half kick and drift, the velocities keep the half kick so the old forces are
+        //not needed after the force pass. the same update as compute_positions and
+        //compute_velocities, split differently.
+        for (uint i = lid; i < range.s1; i += local_size)
+        {
+            float4 my_pos = my_positions[i];
+            float4 my_velocity = my_velocities[i];
+
+            float acc = time_step * 0.5f / my_pos.s3;
+
+            my_velocity.s012 += acc * my_forces[i].s012;
+            my_pos.s012 += time_step * my_velocity.s012;
+
+            my_positions[i] = my_pos;
+            my_velocities[i] = my_velocity;
+        }
+
+        barrier(CLK_GLOBAL_MEM_FENCE);
+
+        compute_system_forces(my_forces, my_positions, positions_cache, range.s1);
+
+        barrier(CLK_GLOBAL_MEM_FENCE);
+
+        //closing half kick with the new forces.
+        for (uint i = lid; i < range.s1; i += local_size)
+        {
+            float4 my_velocity = my_velocities[i];
+
+            float acc = time_step * 0.5f / my_positions[i].s3;
+
+            my_velocity.s012 += acc * my_forces[i].s012;
+
+            my_velocities[i] = my_velocity;
+        }
+
+        barrier(CLK_GLOBAL_MEM_FENCE);
+    }
+}
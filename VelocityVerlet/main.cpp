@@ -1,22 +1,55 @@
+#include "BarnesHutVelocityVerlet.hpp"
+#include "Benchmark.hpp"
+#include "BlockTimeStepVelocityVerlet.hpp"
+#include "Checkpoint.hpp"
+#include "DensitySplatRenderer.hpp"
+#include "DistributedVelocityVerlet.hpp"
+#include "EnsembleGPUVelocityVerlet.hpp"
+#include "EnsembleVelocityVerlet.hpp"
+#include "FastMultipoleVelocityVerlet.hpp"
+#include "FrameEncoder.hpp"
+#include "ICheckpointable.hpp"
+#include "IDiagnosable.hpp"
+#include "IEnsemble.hpp"
+#include "IProfileable.hpp"
+#include "ITrajectorySource.hpp"
+#include "MultiDeviceVelocityVerlet.hpp"
+#include "MultiThreadedVelocityVerlet.hpp"
+#include "OpenCLDevices.hpp"
+#include "ParticleMeshVelocityVerlet.hpp"
+#include "ShortRangeGPUVelocityVerlet.hpp"
+#include "ShortRangeVelocityVerlet.hpp"
 #include "SingleGPUVelocityVerlet.hpp"
 #include "SingleThreadedVelocityVerlet.hpp"
+#include "TrajectoryWriter.hpp"
 #include "VelocityVerletIntegrator.hpp"
 #include "VertexBufferRenderer.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <locale>
+#include <memory>
+#include <optional>
 #include <random>
+#include <sstream>
+#include <string>
 #include <SFML/Graphics.hpp>
 #include <SFML/System.hpp>
 #include <SFML/Window.hpp>
 #include <vector>
 
+#ifdef _MSC_VER
 #pragma comment(lib, "sfml-graphics-d.lib")
 #pragma comment(lib, "sfml-window-d.lib")
 #pragma comment(lib, "sfml-system-d.lib")
 #pragma comment(lib, "freetype.lib")
 #pragma comment(lib, "gdi32.lib")
+#pragma comment(lib, "opengl32.lib")
 #pragma comment(lib, "OpenCL.lib")
+#endif
 
 static std::random_device g_random_device;
 static std::mt19937 g_random_engine(g_random_device());
@@ -88,21 +121,1042 @@ static std::vector<float> generate_masses(const std::size_t num_particles,
     return masses;
 }
 
-int main()
+struct Options
 {
+    std::string strategy = "gpu";
+    std::size_t num_particles = 50000;
+    std::vector<std::size_t> sweep_sizes;
+    std::size_t num_steps = 20;
+    std::size_t warmup_steps = 2;
+    std::size_t steps_per_frame = 1;
+    bool pipelined = false;
+    std::vector<std::size_t> device_indices;
+    std::size_t sub_devices = 0;
+    bool list_devices = false;
+    std::string csv_file;
+    bool benchmark = false;
+    bool validate = false;
+    bool fmm_accuracy = false;
+    std::size_t block_levels = 8;
+    std::size_t mesh_size = 64;
+    MeshBoundary mesh_boundary = MeshBoundary::Isolated;
+    sf::Vector3f box_origin = sf::Vector3f(0.f, 0.f, 0.f);
+    float box_size = 1000.f;
+    std::size_t num_ranks = 4;
+    bool scaling = false;
+    std::size_t num_systems = 64;
+    float time_step_spread = 0.f;
+    std::string ensemble_file;
+    std::string renderer = "points";
+    DensityScale density_scale = DensityScale::Log;
+    Colormap colormap = Colormap::Heat;
+    std::string capture_target;
+    CaptureOutput capture_output = CaptureOutput::PngSequence;
+    unsigned int capture_width = 0;
+    unsigned int capture_height = 0;
+    std::size_t capture_frames = 300;
+    std::size_t capture_interval = 1;
+    std::size_t capture_threads = 2;
+    ShortRangeParameters short_range;
+    ForceLawParameters force_law;
+    ReorderParameters reorder;
+    std::string checkpoint_file;
+    std::size_t checkpoint_interval = 100;
+    std::string restore_file;
+    std::string trajectory_file;
+    std::size_t trajectory_interval = 10;
+    TrajectoryEncoding trajectory_encoding = TrajectoryEncoding::QuantizedDelta;
+    bool trajectory_blocking = false;
+    bool trajectory_velocities = false;
+    std::string profile_file;
+    std::string diagnostics_file;
+    bool serial = false;
+};
+
+static void print_usage()
+{
+    std::cout << "Usage: VelocityVerlet [options]" << std::endl
+        << "  --strategy <name>    cpu, mt, gpu, multi, dist, ensemble, ensemble-gpu, bh, fmm, pm, p3m," << std::endl
+        << "                       block, sr or sr-gpu (default gpu)" << std::endl
+        << "  --particles <n>      number of particles (default 50000)" << std::endl
+        << "  --benchmark          run headless for a fixed number of steps and report timings" << std::endl
+        << "  --sizes <n,n,...>    particle counts to sweep in benchmark mode" << std::endl
+        << "  --steps <n>          measured steps per benchmark (default 20)" << std::endl
+        << "  --warmup <n>         unmeasured steps before every benchmark (default 2)" << std::endl
+        << "  --steps-per-frame <n> gpu, sr-gpu and ensemble-gpu integration steps per rendered frame (default 1)" << std::endl
+        << "  --pipelined          GPU shows frame n while computing frame n + 1" << std::endl
+        << "  --serial             step the simulation once per rendered frame on the UI thread" << std::endl
+        << "  --list-devices       list the OpenCL devices and exit" << std::endl
+        << "  --devices <i,j,...>  OpenCL devices by list index, gpu uses the first (default first GPU)," << std::endl
+        << "                       multi uses all of them (default every leaf device)" << std::endl
+        << "  --sub-devices <n>    split every partitionable OpenCL device into n sub-devices" << std::endl
+        << "  --csv <file>         also write the benchmark results as CSV" << std::endl
+        << "  --validate           compare the strategy against the single-threaded CPU strategy" << std::endl
+        << "  --fmm-accuracy       compare FMM expansion orders against direct summation" << std::endl
+        << "  --block-levels <n>   block strategy splits a step into at most 2^n sub-steps (default 8)" << std::endl
+        << "  --mesh <n>           pm and p3m mesh cells per axis (default 64)" << std::endl
+        << "  --boundary <name>    pm and p3m boundaries, isolated or periodic (default isolated)" << std::endl
+        << "  --box-origin <x,y,z> periodic box corner (default 0,0,0)" << std::endl
+        << "  --box-size <s>       periodic box edge length (default 1000)" << std::endl
+        << "  --ranks <n>          dist strategy ranks, MPI processes when run under mpiexec and threads" << std::endl
+        << "                       otherwise (default 4)" << std::endl
+        << "  --scaling            report the strong and weak scaling of the dist strategy up to --ranks" << std::endl
+        << "  --systems <n>        ensemble strategies integrate n independent systems of --particles each (default 64)" << std::endl
+        << "  --time-step-spread <f> ensemble system s of n steps with (1 + f * s / (n - 1)) times the time step (default 0)" << std::endl
+        << "  --ensemble-output <file> write the final state of every ensemble system as CSV" << std::endl
+        << "  --renderer <name>    points draws every particle, density uploads one per-pixel count image (default points)" << std::endl
+        << "  --density-scale <s>  density renderer scale, linear or log (default log)" << std::endl
+        << "  --colormap <name>    density renderer colors, gray or heat (default heat)" << std::endl
+        << "  --force-law <name>   cpu, mt, gpu, multi, dist and ensemble pair law, newton, plummer, coulomb or lj (default newton)" << std::endl
+        << "  --softening <eps>    plummer softening length (default 1)" << std::endl
+        << "  --reorder-every <n>  cpu, mt and gpu sort the particles along a space-filling curve every n steps" << std::endl
+        << "                       for memory locality (default 0, never)" << std::endl
+        << "  --curve <name>       reorder curve, morton or hilbert (default hilbert)" << std::endl
+        << "  --law <name>         sr and sr-gpu force law, lj or yukawa (default lj)" << std::endl
+        << "  --cutoff <r>         sr and sr-gpu interaction cutoff (default 25)" << std::endl
+        << "  --skin <r>           sr neighbor list skin beyond the cutoff (default 5)" << std::endl
+        << "  --checkpoint <file>  periodically save the state to file (cpu and gpu only)" << std::endl
+        << "  --checkpoint-every <n> integration steps between checkpoints (default 100)" << std::endl
+        << "  --restore <file>     continue from a checkpoint, overrides --particles" << std::endl
+        << "  --trajectory <file>  stream the x/y/z positions to a chunked trajectory file, strategies other than" << std::endl
+        << "                       cpu, mt and gpu stream the rendered x/y positions" << std::endl
+        << "  --trajectory-every <n> integration steps between trajectory frames (default 10)" << std::endl
+        << "  --trajectory-velocities also record the velocities (cpu, mt and gpu)" << std::endl
+        << "  --trajectory-encoding <e> float, quantized or delta (default delta)" << std::endl
+        << "  --trajectory-blocking wait for the writer instead of dropping frames when it falls behind" << std::endl
+        << "  --profile <file>     time every phase, show an overlay and export the events on exit," << std::endl
+        << "                       as a Chrome trace for .json files and CSV otherwise" << std::endl
+        << "  --diagnostics <file> record energy and momentum every step (cpu, mt and gpu) and write them as CSV" << std::endl
+        << "  --capture <prefix>   render offscreen without a window and write <prefix>000001.png, ..." << std::endl
+        << "  --capture-pipe <cmd> render offscreen and pipe raw RGBA frames to the standard input of cmd" << std::endl
+        << "  --capture-size <w>x<h> capture resolution (default the window size)" << std::endl
+        << "  --capture-frames <n> frames to capture before exiting (default 300)" << std::endl
+        << "  --capture-every <n>  steps between captured frames (default 1)" << std::endl
+        << "  --capture-threads <n> PNG encoder threads, frames are dropped while all are busy (default 2)" << std::endl;
+}
+
+static void parse_list(const std::string& text, std::vector<std::size_t>& values)
+{
+    std::stringstream stream(text);
+    std::string value;
+
+    while (std::getline(stream, value, ','))
+    {
+        values.push_back(std::stoul(value));
+    }
+}
+
+static bool parse_options(int argc, char* argv[], Options& options)
+{
+    try
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::string arg = argv[i];
+            const bool has_value = (i + 1 < argc);
+
+            if (arg == "--benchmark")
+            {
+                options.benchmark = true;
+            }
+            else if (arg == "--pipelined")
+            {
+                options.pipelined = true;
+            }
+            else if (arg == "--serial")
+            {
+                options.serial = true;
+            }
+            else if (arg == "--list-devices")
+            {
+                options.list_devices = true;
+            }
+            else if ((arg == "--devices") && has_value)
+            {
+                parse_list(argv[++i], options.device_indices);
+            }
+            else if ((arg == "--sub-devices") && has_value)
+            {
+                options.sub_devices = std::stoul(argv[++i]);
+            }
+            else if (arg == "--validate")
+            {
+                options.validate = true;
+            }
+            else if (arg == "--fmm-accuracy")
+            {
+                options.fmm_accuracy = true;
+            }
+            else if ((arg == "--block-levels") && has_value)
+            {
+                options.block_levels = std::stoul(argv[++i]);
+            }
+            else if ((arg == "--mesh") && has_value)
+            {
+                options.mesh_size = std::stoul(argv[++i]);
+            }
+            else if ((arg == "--boundary") && has_value)
+            {
+                const std::string boundary = argv[++i];
+
+                if (boundary == "isolated")
+                {
+                    options.mesh_boundary = MeshBoundary::Isolated;
+                }
+                else if (boundary == "periodic")
+                {
+                    options.mesh_boundary = MeshBoundary::Periodic;
+                }
+                else
+                {
+                    return false;
+                }
+            }
+            else if ((arg == "--box-origin") && has_value)
+            {
+                std::stringstream stream(argv[++i]);
+                std::string value;
+                float* coordinates[3] = { &options.box_origin.x, &options.box_origin.y, &options.box_origin.z };
+
+                for (float* coordinate : coordinates)
+                {
+                    if (!std::getline(stream, value, ','))
+                    {
+                        return false;
+                    }
+
+                    *coordinate = std::stof(value);
+                }
+            }
+            else if ((arg == "--box-size") && has_value)
+            {
+                options.box_size = std::stof(argv[++i]);
+            }
+            else if ((arg == "--ranks") && has_value)
+            {
+                options.num_ranks = std::stoul(argv[++i]);
+            }
+            else if (arg == "--scaling")
+            {
+                options.scaling = true;
+            }
+            else if ((arg == "--force-law") && has_value)
+            {
+                const std::string law = argv[++i];
+
+                if (law == "newton")
+                {
+                    options.force_law.law = ForceLaw::Newtonian;
+                }
+                else if (law == "plummer")
+                {
+                    options.force_law.law = ForceLaw::Plummer;
+                }
+                else if (law == "coulomb")
+                {
+                    options.force_law.law = ForceLaw::Coulomb;
+                }
+                else if (law == "lj")
+                {
+                    options.force_law.law = ForceLaw::LennardJones;
+                }
+                else
+                {
+                    return false;
+                }
+            }
+            else if ((arg == "--softening") && has_value)
+            {
+                options.force_law.softening = std::stof(argv[++i]);
+            }
+            else if ((arg == "--reorder-every") && has_value)
+            {
+                options.reorder.interval = std::stoul(argv[++i]);
+            }
+            else if ((arg == "--curve") && has_value)
+            {
+                const std::string curve = argv[++i];
+
+                if (curve == "morton")
+                {
+                    options.reorder.curve = SpaceFillingCurve::Morton;
+                }
+                else if (curve == "hilbert")
+                {
+                    options.reorder.curve = SpaceFillingCurve::Hilbert;
+                }
+                else
+                {
+                    return false;
+                }
+            }
+            else if ((arg == "--renderer") && has_value)
+            {
+                options.renderer = argv[++i];
+
+                if ((options.renderer != "points") && (options.renderer != "density"))
+                {
+                    return false;
+                }
+            }
+            else if ((arg == "--density-scale") && has_value)
+            {
+                const std::string scale = argv[++i];
+
+                if (scale == "linear")
+                {
+                    options.density_scale = DensityScale::Linear;
+                }
+                else if (scale == "log")
+                {
+                    options.density_scale = DensityScale::Log;
+                }
+                else
+                {
+                    return false;
+                }
+            }
+            else if ((arg == "--colormap") && has_value)
+            {
+                const std::string colormap = argv[++i];
+
+                if (colormap == "gray")
+                {
+                    options.colormap = Colormap::Grayscale;
+                }
+                else if (colormap == "heat")
+                {
+                    options.colormap = Colormap::Heat;
+                }
+                else
+                {
+                    return false;
+                }
+            }
+            else if ((arg == "--law") && has_value)
+            {
+                const std::string law = argv[++i];
+
+                if (law == "lj")
+                {
+                    options.short_range.law = ShortRangeLaw::LennardJones;
+                }
+                else if (law == "yukawa")
+                {
+                    options.short_range.law = ShortRangeLaw::Yukawa;
+                }
+                else
+                {
+                    return false;
+                }
+            }
+            else if ((arg == "--cutoff") && has_value)
+            {
+                options.short_range.cutoff = std::stof(argv[++i]);
+            }
+            else if ((arg == "--skin") && has_value)
+            {
+                options.short_range.skin = std::stof(argv[++i]);
+            }
+            else if ((arg == "--strategy") && has_value)
+            {
+                options.strategy = argv[++i];
+            }
+            else if ((arg == "--particles") && has_value)
+            {
+                options.num_particles = std::stoul(argv[++i]);
+            }
+            else if ((arg == "--steps") && has_value)
+            {
+                options.num_steps = std::stoul(argv[++i]);
+            }
+            else if ((arg == "--warmup") && has_value)
+            {
+                options.warmup_steps = std::stoul(argv[++i]);
+            }
+            else if ((arg == "--steps-per-frame") && has_value)
+            {
+                options.steps_per_frame = std::stoul(argv[++i]);
+            }
+            else if ((arg == "--csv") && has_value)
+            {
+                options.csv_file = argv[++i];
+            }
+            else if ((arg == "--sizes") && has_value)
+            {
+                parse_list(argv[++i], options.sweep_sizes);
+            }
+            else if ((arg == "--checkpoint") && has_value)
+            {
+                options.checkpoint_file = argv[++i];
+            }
+            else if ((arg == "--checkpoint-every") && has_value)
+            {
+                options.checkpoint_interval = std::stoul(argv[++i]);
+            }
+            else if ((arg == "--restore") && has_value)
+            {
+                options.restore_file = argv[++i];
+            }
+            else if ((arg == "--trajectory") && has_value)
+            {
+                options.trajectory_file = argv[++i];
+            }
+            else if ((arg == "--trajectory-every") && has_value)
+            {
+                options.trajectory_interval = std::stoul(argv[++i]);
+            }
+            else if ((arg == "--trajectory-encoding") && has_value)
+            {
+                const std::string encoding = argv[++i];
+
+                if (encoding == "float")
+                {
+                    options.trajectory_encoding = TrajectoryEncoding::Float32;
+                }
+                else if (encoding == "quantized")
+                {
+                    options.trajectory_encoding = TrajectoryEncoding::Quantized16;
+                }
+                else if (encoding == "delta")
+                {
+                    options.trajectory_encoding = TrajectoryEncoding::QuantizedDelta;
+                }
+                else
+                {
+                    return false;
+                }
+            }
+            else if (arg == "--trajectory-blocking")
+            {
+                options.trajectory_blocking = true;
+            }
+            else if (arg == "--trajectory-velocities")
+            {
+                options.trajectory_velocities = true;
+            }
+            else if ((arg == "--profile") && has_value)
+            {
+                options.profile_file = argv[++i];
+            }
+            else if ((arg == "--diagnostics") && has_value)
+            {
+                options.diagnostics_file = argv[++i];
+            }
+            else if (((arg == "--capture") || (arg == "--capture-pipe")) && has_value)
+            {
+                options.capture_target = argv[++i];
+                options.capture_output = (arg == "--capture") ? CaptureOutput::PngSequence : CaptureOutput::Pipe;
+            }
+            else if ((arg == "--capture-size") && has_value)
+            {
+                const std::string size = argv[++i];
+                const std::size_t separator = size.find('x');
+
+                if (separator == std::string::npos)
+                {
+                    return false;
+                }
+
+                options.capture_width = static_cast<unsigned int>(std::stoul(size.substr(0, separator)));
+                options.capture_height = static_cast<unsigned int>(std::stoul(size.substr(separator + 1)));
+            }
+            else if ((arg == "--capture-frames") && has_value)
+            {
+                options.capture_frames = std::stoul(argv[++i]);
+            }
+            else if ((arg == "--capture-every") && has_value)
+            {
+                options.capture_interval = std::stoul(argv[++i]);
+            }
+            else if ((arg == "--capture-threads") && has_value)
+            {
+                options.capture_threads = std::stoul(argv[++i]);
+            }
+            else if ((arg == "--systems") && has_value)
+            {
+                options.num_systems = std::stoul(argv[++i]);
+            }
+            else if ((arg == "--time-step-spread") && has_value)
+            {
+                options.time_step_spread = std::stof(argv[++i]);
+            }
+            else if ((arg == "--ensemble-output") && has_value)
+            {
+                options.ensemble_file = argv[++i];
+            }
+            else
+            {
+                return false;
+            }
+        }
+    }
+    catch (const std::exception&)
+    {
+        return false;
+    }
+
+    return (options.num_particles > 0) && (options.steps_per_frame > 0) && (options.block_levels < 32) && (options.checkpoint_interval > 0)
+        && (options.trajectory_interval > 0) && (options.short_range.cutoff > 0.f) && (options.short_range.skin >= 0.f)
+        && (options.mesh_size > 0) && (options.box_size > 0.f);
+}
+
+// the devices picked with --devices, or every leaf device when none are given
+static std::vector<OpenCLDevice> select_opencl_devices(const Options& options)
+{
+    const std::vector<OpenCLDevice> devices = enumerate_opencl_devices(options.sub_devices);
+
+    std::vector<std::size_t> indices = options.device_indices;
+
+    if (indices.empty())
+    {
+        indices = get_leaf_device_indices(devices);
+    }
+
+    std::vector<OpenCLDevice> selected;
+
+    for (std::size_t index : indices)
+    {
+        if (index >= devices.size())
+        {
+            throw std::string("Invalid OpenCL device index: ") + std::to_string(index);
+        }
+
+        selected.push_back(devices[index]);
+    }
+
+    if (selected.empty())
+    {
+        throw std::string("No OpenCL devices found");
+    }
+
+    return selected;
+}
+
+static bool is_ensemble_strategy(const std::string& name)
+{
+    return (name == "ensemble") || (name == "ensemble-gpu");
+}
+
+// the GPU strategies chain --steps-per-frame steps per run
+static bool chains_steps(const std::string& name)
+{
+    return (name == "gpu") || (name == "sr-gpu") || (name == "ensemble-gpu");
+}
+
+// writes --ensemble-output once the ensemble has stopped
+static bool write_ensemble_output(const Options& options, IAlgorithmStrategy& algorithm)
+{
+    IEnsemble* ensemble = dynamic_cast<IEnsemble*>(&algorithm);
+
+    if (ensemble == nullptr)
+    {
+        std::cout << "Ensemble output is only supported by the ensemble strategies" << std::endl;
+        return false;
+    }
+
+    std::ofstream output(options.ensemble_file);
+
+    if (!output)
+    {
+        std::cout << "Failed to open " << options.ensemble_file << std::endl;
+        return false;
+    }
+
+    write_ensemble_csv(output, *ensemble);
+
+    return true;
+}
+
+// system 0 is the given state so it can be validated, the other systems are generated the
+// same way with their time steps spread out by --time-step-spread
+static std::vector<EnsembleSystem> generate_ensemble(const Options& options,
+    float time_step,
+    const std::vector<sf::Vector3f>& positions,
+    const std::vector<sf::Vector3f>& velocities,
+    const std::vector<float>& masses)
+{
+    const std::size_t num_systems = std::max<std::size_t>(options.num_systems, 1u);
+    const std::size_t num_particles = positions.size();
+
+    std::vector<EnsembleSystem> systems(num_systems);
+
+    for (std::size_t system = 0; system < num_systems; ++system)
+    {
+        EnsembleSystem& state = systems[system];
+
+        if (system == 0)
+        {
+            state.positions = positions;
+            state.velocities = velocities;
+            state.masses = masses;
+        }
+        else
+        {
+            state.positions = generate_starting_positions(num_particles, 100.f, 900.f);
+            state.velocities = generate_starting_velocities(num_particles, 1.f, 10.f);
+            state.masses = generate_masses(num_particles, 1000.f, 5000.f);
+        }
+
+        const float fraction = (num_systems > 1) ? static_cast<float>(system) / static_cast<float>(num_systems - 1) : 0.f;
+
+        state.time_step = time_step * (1.f + options.time_step_spread * fraction);
+    }
+
+    return systems;
+}
+
+// the GPU strategy keeps references to the input vectors, they must outlive the algorithm
+static std::unique_ptr<IAlgorithmStrategy> create_algorithm(const std::string& name,
+    const Options& options,
+    std::size_t num_particles,
+    float time_step,
+    std::vector<sf::Vector3f>& positions,
+    std::vector<sf::Vector3f>& velocities,
+    std::vector<float>& masses)
+{
+    // the tree, mesh and block time step strategies are written for Newtonian gravity
+    const bool pair_law = (name == "cpu") || (name == "mt") || (name == "gpu") || (name == "multi") || (name == "dist")
+        || is_ensemble_strategy(name);
+
+    if ((options.force_law.law != ForceLaw::Newtonian) && !pair_law)
+    {
+        throw std::string("The ") + name + " strategy only supports --force-law newton";
+    }
+
+    if ((options.reorder.interval > 0) && (name != "cpu") && (name != "mt") && (name != "gpu"))
+    {
+        throw std::string("The ") + name + " strategy does not support --reorder-every";
+    }
+
+    if (name == "cpu")
+    {
+        return std::make_unique<SingleThreadedVelocityVerlet>(num_particles, time_step, positions, velocities, masses,
+            options.force_law, options.reorder);
+    }
+
+    if (name == "mt")
+    {
+        return std::make_unique<MultiThreadedVelocityVerlet>(num_particles, time_step, positions, velocities, masses,
+            options.force_law, options.reorder);
+    }
+
+    if (name == "gpu")
+    {
+        std::optional<OpenCLDevice> device;
+
+        if (!options.device_indices.empty())
+        {
+            device = select_opencl_devices(options).front();
+        }
+
+        return std::make_unique<SingleGPUVelocityVerlet>(num_particles, time_step, positions, velocities, masses,
+            options.steps_per_frame, options.pipelined, device, options.force_law, options.reorder);
+    }
+
+    if (name == "multi")
+    {
+        return std::make_unique<MultiDeviceVelocityVerlet>(num_particles, time_step, positions, velocities, masses,
+            select_opencl_devices(options), options.force_law);
+    }
+
+    if (name == "dist")
+    {
+        return std::make_unique<DistributedVelocityVerlet>(num_particles, time_step, positions, velocities, masses,
+            options.num_ranks, options.force_law);
+    }
+
+    if (is_ensemble_strategy(name))
+    {
+        std::vector<EnsembleSystem> systems = generate_ensemble(options, time_step, positions, velocities, masses);
+
+        if (name == "ensemble")
+        {
+            return std::make_unique<EnsembleVelocityVerlet>(std::move(systems), options.force_law);
+        }
+
+        std::optional<OpenCLDevice> device;
+
+        if (!options.device_indices.empty())
+        {
+            device = select_opencl_devices(options).front();
+        }
+
+        return std::make_unique<EnsembleGPUVelocityVerlet>(std::move(systems), options.steps_per_frame, device,
+            options.force_law);
+    }
+
+    if (name == "bh")
+    {
+        return std::make_unique<BarnesHutVelocityVerlet>(num_particles, time_step, positions, velocities, masses);
+    }
+
+    if (name == "fmm")
+    {
+        return std::make_unique<FastMultipoleVelocityVerlet>(num_particles, time_step, positions, velocities, masses);
+    }
+
+    if (name == "pm")
+    {
+        return std::make_unique<ParticleMeshVelocityVerlet>(num_particles, time_step, positions, velocities, masses,
+            options.mesh_size, options.mesh_boundary, false, options.box_origin, options.box_size);
+    }
+
+    if (name == "p3m")
+    {
+        return std::make_unique<ParticleMeshVelocityVerlet>(num_particles, time_step, positions, velocities, masses,
+            options.mesh_size, options.mesh_boundary, true, options.box_origin, options.box_size);
+    }
+
+    if (name == "block")
+    {
+        return std::make_unique<BlockTimeStepVelocityVerlet>(num_particles, time_step, positions, velocities, masses,
+            static_cast<std::uint32_t>(options.block_levels));
+    }
+
+    if (name == "sr")
+    {
+        return std::make_unique<ShortRangeVelocityVerlet>(num_particles, time_step, positions, velocities, masses,
+            options.short_range);
+    }
+
+    if (name == "sr-gpu")
+    {
+        std::optional<OpenCLDevice> device;
+
+        if (!options.device_indices.empty())
+        {
+            device = select_opencl_devices(options).front();
+        }
+
+        return std::make_unique<ShortRangeGPUVelocityVerlet>(num_particles, time_step, positions, velocities, masses,
+            options.short_range, options.steps_per_frame, device);
+    }
+
+    throw std::string("Unknown strategy: ") + name;
+}
+
+static int run_benchmark(const Options& options, float time_step)
+{
+    std::vector<std::size_t> sizes = options.sweep_sizes;
+
+    if (sizes.empty())
+    {
+        sizes.push_back(options.num_particles);
+    }
+
+    const Benchmark benchmark(options.warmup_steps, options.num_steps);
+    std::vector<BenchmarkResult> results;
+
+    Benchmark::print_header(std::cout);
+
+    for (std::size_t num_particles : sizes)
+    {
+        std::vector<sf::Vector3f> positions = generate_starting_positions(num_particles, 100.f, 900.f);
+        std::vector<sf::Vector3f> velocities = generate_starting_velocities(num_particles, 1.f, 10.f);
+        std::vector<float> masses = generate_masses(num_particles, 1000.f, 5000.f);
+
+        try
+        {
+            std::unique_ptr<IAlgorithmStrategy> algorithm = create_algorithm(options.strategy,
+                options,
+                num_particles,
+                time_step,
+                positions,
+                velocities,
+                masses);
+
+            // keep the table readable, the strategies report their setup on stdout
+            std::cout.setstate(std::ios::badbit);
+            algorithm->initialize();
+            std::cout.clear();
+
+            const std::size_t steps_per_run = chains_steps(options.strategy) ? options.steps_per_frame : 1u;
+            const std::size_t num_systems = is_ensemble_strategy(options.strategy) ? std::max<std::size_t>(options.num_systems, 1u) : 1u;
+
+            results.push_back(benchmark.run(options.strategy, *algorithm, num_particles, steps_per_run, num_systems));
+            Benchmark::print_result(std::cout, results.back());
+
+            if (!options.ensemble_file.empty())
+            {
+                write_ensemble_output(options, *algorithm);
+            }
+
+            if (const BlockTimeStepVelocityVerlet* block = dynamic_cast<const BlockTimeStepVelocityVerlet*>(algorithm.get()))
+            {
+                block->print_statistics(std::cout);
+            }
+
+            if (const ShortRangeVelocityVerlet* short_range = dynamic_cast<const ShortRangeVelocityVerlet*>(algorithm.get()))
+            {
+                short_range->print_statistics(std::cout);
+            }
+        }
+        catch (const std::string& e)
+        {
+            std::cout.clear();
+            std::cout << "Skipping " << num_particles << " particles: " << e << std::endl;
+        }
+    }
+
+    if (!options.csv_file.empty())
+    {
+        std::ofstream csv(options.csv_file);
+
+        if (!csv)
+        {
+            std::cout << "Failed to open " << options.csv_file << std::endl;
+            return 1;
+        }
+
+        Benchmark::write_csv(csv, results);
+    }
+
+    return 0;
+}
+
+// times the dist strategy for 1, 2, 4, ... up to --ranks ranks, once with a fixed particle
+// count (strong scaling) and once with the count growing like sqrt(ranks) (weak scaling)
+static int run_scaling_study(const Options& options, float time_step)
+{
+    std::vector<std::size_t> rank_counts;
+
+    for (std::size_t num_ranks = 1; num_ranks < options.num_ranks; num_ranks *= 2)
+    {
+        rank_counts.push_back(num_ranks);
+    }
+
+    rank_counts.push_back(std::max<std::size_t>(options.num_ranks, 1u));
+
+    const Benchmark benchmark(options.warmup_steps, options.num_steps);
+    std::vector<ScalingResult> results;
+
+    auto time_step_seconds = [&](std::size_t num_particles, std::size_t num_ranks)
+    {
+        std::vector<sf::Vector3f> positions = generate_starting_positions(num_particles, 100.f, 900.f);
+        std::vector<sf::Vector3f> velocities = generate_starting_velocities(num_particles, 1.f, 10.f);
+        std::vector<float> masses = generate_masses(num_particles, 1000.f, 5000.f);
+
+        DistributedVelocityVerlet algorithm(num_particles, time_step, positions, velocities, masses,
+            num_ranks, options.force_law);
+
+        std::cout.setstate(std::ios::badbit);
+        algorithm.initialize();
+        std::cout.clear();
+
+        // under MPI the world may have fewer processes than requested
+        if (algorithm.get_num_ranks() != num_ranks)
+        {
+            throw std::string("Only ") + std::to_string(algorithm.get_num_ranks()) + " ranks are available";
+        }
+
+        return benchmark.run("dist", algorithm, num_particles).median_step_seconds;
+    };
+
+    try
+    {
+        for (std::size_t num_ranks : rank_counts)
+        {
+            ScalingResult result = {};
+
+            result.num_ranks = num_ranks;
+            result.strong_particles = options.num_particles;
+            result.strong_step_seconds = time_step_seconds(result.strong_particles, num_ranks);
+            result.weak_particles = static_cast<std::size_t>(std::lround(options.num_particles * std::sqrt(static_cast<double>(num_ranks))));
+            result.weak_step_seconds = time_step_seconds(result.weak_particles, num_ranks);
+
+            results.push_back(result);
+        }
+    }
+    catch (const std::string& e)
+    {
+        std::cout.clear();
+        std::cout << e << std::endl;
+    }
+
+    Benchmark::compute_scaling_efficiencies(results);
+    Benchmark::print_scaling(std::cout, results);
+
+    if (!options.csv_file.empty())
+    {
+        std::ofstream csv(options.csv_file);
+
+        if (!csv)
+        {
+            std::cout << "Failed to open " << options.csv_file << std::endl;
+            return 1;
+        }
+
+        Benchmark::write_scaling_csv(csv, results);
+    }
+
+    return 0;
+}
+
+// runs the selected strategy and the single-threaded reference from the same initial state
+// and reports how far the rendered positions drift apart
+static int run_validation(const Options& options, float time_step)
+{
+    const std::size_t num_particles = options.num_particles;
+
+    // a pipelined strategy returns the previous frame, compare matching steps instead
+    Options validate_options = options;
+    validate_options.pipelined = false;
+
+    std::vector<sf::Vector3f> positions = generate_starting_positions(num_particles, 100.f, 900.f);
+    std::vector<sf::Vector3f> velocities = generate_starting_velocities(num_particles, 1.f, 10.f);
+    std::vector<float> masses = generate_masses(num_particles, 1000.f, 5000.f);
+
+    std::vector<sf::Vector3f> reference_positions = positions;
+    std::vector<sf::Vector3f> reference_velocities = velocities;
+    std::vector<float> reference_masses = masses;
+
+    try
+    {
+        std::unique_ptr<IAlgorithmStrategy> algorithm = create_algorithm(options.strategy,
+            validate_options,
+            num_particles,
+            time_step,
+            positions,
+            velocities,
+            masses);
+
+        std::unique_ptr<IAlgorithmStrategy> reference = create_algorithm("cpu",
+            validate_options,
+            num_particles,
+            time_step,
+            reference_positions,
+            reference_velocities,
+            reference_masses);
+
+        algorithm->initialize();
+        reference->initialize();
+
+        std::vector<sf::Vertex> vertices;
+        std::vector<sf::Vertex> reference_vertices;
+
+        // only the GPU strategies chain several steps per run
+        const std::size_t steps_per_run = chains_steps(options.strategy) ? options.steps_per_frame : 1u;
+
+        std::cout << std::endl << "step   max |dx|      rms |dx|" << std::endl;
+
+        for (std::size_t step = 1; step <= options.num_steps; ++step)
+        {
+            algorithm->run(vertices);
+
+            for (std::size_t substep = 0; substep < steps_per_run; ++substep)
+            {
+                reference->run(reference_vertices);
+            }
+
+            double max_error = 0.0;
+            double sum_error = 0.0;
+
+            for (std::size_t i = 0; i < num_particles; ++i)
+            {
+                const sf::Vector2f diff = vertices[i].position - reference_vertices[i].position;
+                const double error = std::sqrt(static_cast<double>(diff.x) * diff.x + static_cast<double>(diff.y) * diff.y);
+
+                max_error = std::max(max_error, error);
+                sum_error += error * error;
+            }
+
+            std::cout << std::setw(4) << step
+                << std::scientific << std::setprecision(3)
+                << std::setw(13) << max_error
+                << std::setw(14) << std::sqrt(sum_error / static_cast<double>(num_particles))
+                << std::defaultfloat << std::endl;
+        }
+    }
+    catch (const std::string& e)
+    {
+        std::cout << e << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+#ifdef VV_USE_MPI
+    // only rank 0 runs the program, the others serve the distributed strategy
+    DistributedVelocityVerlet::MpiSession mpi_session(argc, argv);
+
+    if (mpi_session.get_rank() != 0)
+    {
+        mpi_session.serve_workers();
+        return 0;
+    }
+#endif
+
     std::cout.imbue(std::locale(std::cout.getloc(), new space_out));
 
+    Options options;
+
+    if (!parse_options(argc, argv, options))
+    {
+        print_usage();
+        return 1;
+    }
+
     const std::size_t window_width = 1000;
     const std::size_t window_height = 1000;
     const std::string window_title = "Velocity Verlet";
 
-    const std::size_t num_particles = 50000;
-    const float time_step = .1f;
+    std::size_t num_particles = options.num_particles;
+    float time_step = .1f;
+
+    if (options.list_devices)
+    {
+        print_opencl_devices(enumerate_opencl_devices(options.sub_devices), std::cout);
+        return 0;
+    }
+
+    if (options.scaling)
+    {
+        return run_scaling_study(options, time_step);
+    }
+
+    if (options.benchmark)
+    {
+        return run_benchmark(options, time_step);
+    }
+
+    if (options.validate)
+    {
+        return run_validation(options, time_step);
+    }
+
+    // the checkpoint decides the particle count and time step, the generated state is overwritten
+    std::unique_ptr<CheckpointFile> checkpoint;
+
+    if (!options.restore_file.empty())
+    {
+        try
+        {
+            checkpoint = std::make_unique<CheckpointFile>(options.restore_file);
+        }
+        catch (const std::string& e)
+        {
+            std::cout << e << std::endl;
+            return 1;
+        }
+
+        num_particles = checkpoint->get_num_particles();
+        time_step = checkpoint->get_time_step();
+    }
 
     std::vector<sf::Vector3f> positions = generate_starting_positions(num_particles, 100.f, 900.f);
     std::vector<sf::Vector3f> velocities = generate_starting_velocities(num_particles, 1.f, 10.f);
     std::vector<float> masses = generate_masses(num_particles, 1000.f, 5000.f);
 
+    if (options.fmm_accuracy)
+    {
+        FastMultipoleVelocityVerlet::report_accuracy(positions, masses, 8, std::cout);
+        return 0;
+    }
+
     sf::Font font;
 
     if (!font.loadFromFile("saxmono.ttf"))
@@ -110,45 +1164,179 @@ int main()
         throw std::string("Failed to load font file");
     }
 
-    if (num_particles <= 1000)
+    std::unique_ptr<IAlgorithmStrategy> algorithm;
+
+    try
     {
-        SingleThreadedVelocityVerlet cpu_algorithm(num_particles,
-            time_step,
-            positions,
-            velocities,
-            masses);
+        algorithm = create_algorithm(options.strategy, options, num_particles, time_step, positions, velocities, masses);
+        algorithm->initialize();
+    }
+    catch (const std::string& e)
+    {
+        std::cout << e << std::endl;
 
-        VertexBufferRenderer cpu_renderer(sf::VertexBuffer::Stream, sf::Points);
+        if ((options.strategy != "gpu") && (options.strategy != "sr-gpu"))
+        {
+            return 1;
+        }
 
-        VelocityVerletIntegrator cpu_integrator(cpu_algorithm,
-            cpu_renderer,
-            window_width,
-            window_height,
-            window_title,
-            font);
+        // the short range laws have their own CPU implementation
+        const std::string fallback = (options.strategy == "sr-gpu") ? "sr" : "mt";
+
+        std::cout << "Falling back to the " << ((fallback == "sr") ? "short range" : "multithreaded") << " CPU implementation" << std::endl;
 
-        cpu_integrator.execute();
+        algorithm = create_algorithm(fallback, options, num_particles, time_step, positions, velocities, masses);
+        algorithm->initialize();
     }
 
-    SingleGPUVelocityVerlet gpu_algorithm(num_particles,
-        time_step,
-        positions,
-        velocities,
-        masses);
+    ICheckpointable* checkpointable = dynamic_cast<ICheckpointable*>(algorithm.get());
+
+    if ((checkpoint || !options.checkpoint_file.empty()) && (checkpointable == nullptr))
+    {
+        std::cout << "Checkpoints are not supported by this strategy" << std::endl;
+        return 1;
+    }
 
     try
     {
-        VertexBufferRenderer gpu_renderer(sf::VertexBuffer::Stream, sf::Points);
+        if (checkpoint)
+        {
+            checkpointable->restore_checkpoint(*checkpoint);
+            checkpoint.reset();
+        }
+
+        // the density image is the size of the window, its upload does not grow with the particles
+        std::unique_ptr<IRenderStrategy> renderer;
 
-        VelocityVerletIntegrator gpu_integrator(gpu_algorithm,
-            gpu_renderer,
+        if (options.renderer == "density")
+        {
+            renderer = std::make_unique<DensitySplatRenderer>(window_width, window_height, options.density_scale, options.colormap);
+        }
+        else
+        {
+            renderer = std::make_unique<VertexBufferRenderer>(sf::VertexBuffer::Stream, sf::Points);
+        }
+
+        VelocityVerletIntegrator integrator(*algorithm,
+            *renderer,
             window_width,
             window_height,
             window_title,
             font);
 
-        gpu_algorithm.initialize();
-        gpu_integrator.execute();
+        integrator.set_decoupled(!options.serial);
+        integrator.set_steps_per_run(chains_steps(options.strategy) ? options.steps_per_frame : 1u);
+
+        if (!options.checkpoint_file.empty())
+        {
+            integrator.set_checkpoint(*checkpointable, options.checkpoint_file, options.checkpoint_interval);
+        }
+
+        std::unique_ptr<TrajectoryWriter> trajectory;
+
+        if (!options.trajectory_file.empty())
+        {
+            trajectory = std::make_unique<TrajectoryWriter>(options.trajectory_file,
+                options.trajectory_encoding,
+                options.trajectory_interval,
+                32u,
+                8u,
+                options.trajectory_blocking);
+
+            ITrajectorySource* trajectory_source = dynamic_cast<ITrajectorySource*>(algorithm.get());
+            TrajectoryContent content = TrajectoryContent::RenderedXY;
+
+            if (trajectory_source != nullptr)
+            {
+                content = options.trajectory_velocities ? TrajectoryContent::PositionsVelocitiesXYZ : TrajectoryContent::PositionsXYZ;
+            }
+            else
+            {
+                std::cout << "This strategy only provides the rendered x/y positions for the trajectory" << std::endl;
+            }
+
+            trajectory->open(is_ensemble_strategy(options.strategy) ? num_particles * std::max<std::size_t>(options.num_systems, 1u) : num_particles, content);
+            integrator.set_trajectory_writer(*trajectory, trajectory_source);
+        }
+
+        Profiler profiler;
+        IProfileable* profileable = dynamic_cast<IProfileable*>(algorithm.get());
+
+        if (!options.profile_file.empty())
+        {
+            // strategies without instrumentation still get the upload and draw phases
+            if (profileable != nullptr)
+            {
+                profileable->set_profiler(&profiler);
+            }
+
+            integrator.set_profiler(profiler);
+        }
+
+        DiagnosticsLog diagnostics;
+        IDiagnosable* diagnosable = dynamic_cast<IDiagnosable*>(algorithm.get());
+
+        if (!options.diagnostics_file.empty())
+        {
+            if (diagnosable != nullptr)
+            {
+                diagnosable->set_diagnostics(&diagnostics);
+            }
+            else
+            {
+                std::cout << "Diagnostics are not supported by this strategy" << std::endl;
+            }
+        }
+
+        if (!options.capture_target.empty())
+        {
+            const unsigned int capture_width = (options.capture_width > 0) ? options.capture_width : static_cast<unsigned int>(window_width);
+            const unsigned int capture_height = (options.capture_height > 0) ? options.capture_height : static_cast<unsigned int>(window_height);
+
+            FrameEncoder encoder(options.capture_target,
+                options.capture_output,
+                capture_width,
+                capture_height,
+                options.capture_threads);
+
+            encoder.open();
+            integrator.execute_offscreen(encoder, options.capture_frames, options.capture_interval);
+        }
+        else
+        {
+            integrator.execute();
+        }
+
+        if (!options.profile_file.empty())
+        {
+            if (profileable != nullptr)
+            {
+                profileable->set_profiler(nullptr);
+            }
+
+            profiler.print_statistics(std::cout);
+
+            if (!profiler.export_file(options.profile_file))
+            {
+                std::cout << "Failed to write " << options.profile_file << std::endl;
+            }
+        }
+
+        // the simulation has stopped, the strategy does not record anymore
+        if (!options.diagnostics_file.empty() && (diagnosable != nullptr))
+        {
+            diagnostics.print_summary(std::cout);
+
+            if (!diagnostics.export_file(options.diagnostics_file))
+            {
+                std::cout << "Failed to write " << options.diagnostics_file << std::endl;
+            }
+        }
+
+        if (!options.ensemble_file.empty() && !write_ensemble_output(options, *algorithm))
+        {
+            return 1;
+        }
     }
     catch (const std::string& e)
     {
@@ -157,4 +1345,4 @@ int main()
     }
 
     return 0;
-}
\ No newline at end of file
+}
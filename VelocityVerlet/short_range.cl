@@ -0,0 +1,143 @@
+//cutoff force laws on a uniform cell grid, appended to velocity_verlet.cl so the
+//positions and velocities kernels are shared. the law is picked at build time with
+//-D SHORT_RANGE_YUKAWA, Lennard-Jones otherwise.
+
+//grid_origin.s3 is the inverse cell size, grid_dims.s3 the number of slots per cell.
+uint get_cell_coordinate(float position, float origin, float inv_cell_size, uint dim)
+{
+    int cell = (int)floor((position - origin) * inv_cell_size);
+
+    //positions outside the grid land in the border cells, adjacent particles stay in adjacent cells.
+    return (uint)clamp(cell, 0, (int)dim - 1);
+}
+
+uint get_cell_index(uint x, uint y, uint z, uint4 grid_dims)
+{
+    return (z * grid_dims.s1 + y) * grid_dims.s0 + x;
+}
+
+__kernel void clear_cells(__global uint* cell_counts,
+    uint num_cells)
+{
+    uint gid = get_global_id(0);
+
+    if (gid < num_cells)
+    {
+        cell_counts[gid] = 0;
+    }
+}
+
+__kernel void bin_particles(__global const float4* positions,
+    __global uint* cell_counts,
+    __global uint* cell_particles,
+    __global uint* max_count,
+    float4 grid_origin,
+    uint4 grid_dims,
+    uint num_particles)
+{
+    uint gid = get_global_id(0);
+
+    if (gid >= num_particles)
+    {
+        return;
+    }
+
+    float4 my_pos = positions[gid];
+
+    uint cell = get_cell_index(get_cell_coordinate(my_pos.s0, grid_origin.s0, grid_origin.s3, grid_dims.s0),
+        get_cell_coordinate(my_pos.s1, grid_origin.s1, grid_origin.s3, grid_dims.s1),
+        get_cell_coordinate(my_pos.s2, grid_origin.s2, grid_origin.s3, grid_dims.s2),
+        grid_dims);
+
+    uint slot = atomic_inc(&cell_counts[cell]);
+
+    //a full cell drops the particle. max_count is only cleared once per frame, the host reads
+    //it with the positions and repeats the frame with more slots when any step overflowed.
+    if (slot < grid_dims.s3)
+    {
+        cell_particles[cell * grid_dims.s3 + slot] = gid;
+    }
+
+    atomic_max(max_count, slot + 1);
+}
+
+//|F| / r for a pair, positive when repulsive. law_parameters holds the squared cutoff
+//followed by sigma^2 and epsilon (Lennard-Jones) or strength and screening length (Yukawa).
+#if defined(SHORT_RANGE_YUKAWA)
+
+float get_force_scale(float4 law_parameters, float dist2)
+{
+    float inv_dist2 = 1.0f / dist2;
+    float dist = sqrt(dist2);
+
+    return law_parameters.s1 * exp(-dist / law_parameters.s2) * inv_dist2 * (1.0f / dist + 1.0f / law_parameters.s2);
+}
+
+#else
+
+float get_force_scale(float4 law_parameters, float dist2)
+{
+    float inv_dist2 = 1.0f / dist2;
+    float sigma2 = law_parameters.s1 * inv_dist2;
+    float sigma6 = sigma2 * sigma2 * sigma2;
+
+    return 24.0f * law_parameters.s2 * sigma6 * (2.0f * sigma6 - 1.0f) * inv_dist2;
+}
+
+#endif
+
+__kernel void compute_short_range_forces(__global float4* forces,
+    __global const float4* curr_positions,
+    __global const uint* cell_counts,
+    __global const uint* cell_particles,
+    float4 grid_origin,
+    uint4 grid_dims,
+    uint num_particles,
+    float4 law_parameters)
+{
+    //every work item gathers its own force from the 27 surrounding cells, the symmetric
+    //half is recomputed instead of scattered since there are no float atomics.
+
+    uint gid = get_global_id(0);
+
+    if (gid >= num_particles)
+    {
+        return;
+    }
+
+    float4 my_pos = curr_positions[gid];
+    float3 force = (float3)0.0f;
+
+    uint cell_x = get_cell_coordinate(my_pos.s0, grid_origin.s0, grid_origin.s3, grid_dims.s0);
+    uint cell_y = get_cell_coordinate(my_pos.s1, grid_origin.s1, grid_origin.s3, grid_dims.s1);
+    uint cell_z = get_cell_coordinate(my_pos.s2, grid_origin.s2, grid_origin.s3, grid_dims.s2);
+
+    for (uint z = max(cell_z, 1u) - 1; z <= min(cell_z + 1, grid_dims.s2 - 1); ++z)
+    {
+        for (uint y = max(cell_y, 1u) - 1; y <= min(cell_y + 1, grid_dims.s1 - 1); ++y)
+        {
+            for (uint x = max(cell_x, 1u) - 1; x <= min(cell_x + 1, grid_dims.s0 - 1); ++x)
+            {
+                uint cell = get_cell_index(x, y, z, grid_dims);
+                uint count = min(cell_counts[cell], grid_dims.s3);
+
+                for (uint slot = 0; slot < count; ++slot)
+                {
+                    float4 other_position = curr_positions[cell_particles[cell * grid_dims.s3 + slot]];
+
+                    float3 diff = other_position.s012 - my_pos.s012;
+                    float dist2 = dot(diff, diff);
+
+                    //dist2 is zero for the particle itself (and coincident particles).
+                    if ((dist2 > 0.0f) && (dist2 < law_parameters.s0))
+                    {
+                        force -= get_force_scale(law_parameters, dist2) * diff;
+                    }
+                }
+            }
+        }
+    }
+
+    //forces, not accelerations, the mass does not enter these laws.
+    forces[gid] = (float4)(force, 0.f);
+}
@@ -1,56 +1,216 @@
+//the force law is chosen at build time, see get_force_law_build_options(). each law
+//gives the pair scale per unit of my mass, force on me = get_force_factor(my mass) *
+//sum of get_pair_scale(other mass, dist2) * diff, so every configuration is branch free.
+//dist2 is zero for the particle itself (and coincident particles), which adds no force.
+//get_pair_potential is the pair energy per unit of get_force_factor, only used with
+//-D COMPUTE_DIAGNOSTICS.
+
+#if defined(FORCE_LAW_PLUMMER)
+
+float get_pair_scale(float other_mass, float dist2)
+{
+    float inv_dist = rsqrt(dist2 + SQR_SOFTENING);
+
+    return other_mass * inv_dist * inv_dist * inv_dist;
+}
+
+float get_force_factor(float my_mass)
+{
+    return my_mass;
+}
+
+float get_pair_potential(float other_mass, float dist2)
+{
+    return (dist2 > 0.0f) ? -other_mass * rsqrt(dist2 + SQR_SOFTENING) : 0.0f;
+}
+
+#elif defined(FORCE_LAW_COULOMB)
+
+//the charges are the masses, equal sign charges repel.
+float get_pair_scale(float other_mass, float dist2)
+{
+    float inv_dist = (dist2 > 0.0f) ? rsqrt(dist2) : 0.0f;
+
+    return -COULOMB_CONSTANT * other_mass * inv_dist * inv_dist * inv_dist;
+}
+
+float get_force_factor(float my_mass)
+{
+    return my_mass;
+}
+
+float get_pair_potential(float other_mass, float dist2)
+{
+    float inv_dist = (dist2 > 0.0f) ? rsqrt(dist2) : 0.0f;
+
+    return COULOMB_CONSTANT * other_mass * inv_dist;
+}
+
+#elif defined(FORCE_LAW_LENNARD_JONES)
+
+//zero mass marks the padding of the last tile, the masses do not enter the law otherwise.
+float get_pair_scale(float other_mass, float dist2)
+{
+    float inv_dist2 = ((dist2 > 0.0f) && (other_mass > 0.0f)) ? 1.0f / dist2 : 0.0f;
+    float sigma6 = SQR_SIGMA * inv_dist2;
+
+    sigma6 = sigma6 * sigma6 * sigma6;
+
+    return -24.0f * EPSILON * sigma6 * (2.0f * sigma6 - 1.0f) * inv_dist2;
+}
+
+float get_force_factor(float my_mass)
+{
+    return 1.0f;
+}
+
+float get_pair_potential(float other_mass, float dist2)
+{
+    float inv_dist2 = ((dist2 > 0.0f) && (other_mass > 0.0f)) ? 1.0f / dist2 : 0.0f;
+    float sigma6 = SQR_SIGMA * inv_dist2;
+
+    sigma6 = sigma6 * sigma6 * sigma6;
+
+    return 4.0f * EPSILON * sigma6 * (sigma6 - 1.0f);
+}
+
+#else
+
+float get_pair_scale(float other_mass, float dist2)
+{
+    float inv_dist = (dist2 > 0.0f) ? rsqrt(dist2) : 0.0f;
+
+    return other_mass * inv_dist * inv_dist * inv_dist;
+}
+
+float get_force_factor(float my_mass)
+{
+    return my_mass;
+}
+
+float get_pair_potential(float other_mass, float dist2)
+{
+    float inv_dist = (dist2 > 0.0f) ? rsqrt(dist2) : 0.0f;
+
+    return -other_mass * inv_dist;
+}
+
+#endif
+
+//with -D COMPUTE_DIAGNOSTICS the force and velocity kernels also write one partial sum
+//per work group at partial_offset + group id, the host adds them up in double.
+#if defined(COMPUTE_DIAGNOSTICS)
+
+#define FORCE_DIAGNOSTICS_ARGS , __global float* potential_partials, uint partial_offset
+#define VELOCITY_DIAGNOSTICS_ARGS , __local float4* scratch, __global float4* kinetic_partials, uint partial_offset
+
+//sums scratch over the work group into scratch[0], for any work-group size.
+void reduce_work_group(__local float4* scratch, uint lid, uint local_size)
+{
+    for (uint stride = 1; stride < local_size; stride *= 2)
+    {
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        if (((lid % (2 * stride)) == 0) && (lid + stride < local_size))
+        {
+            scratch[lid] += scratch[lid + stride];
+        }
+    }
+
+    barrier(CLK_LOCAL_MEM_FENCE);
+}
+
+#else
+
+#define FORCE_DIAGNOSTICS_ARGS
+#define VELOCITY_DIAGNOSTICS_ARGS
+
+#endif
+
 __kernel void compute_forces(__global float4* forces,
-    __global float4* curr_positions,
-    __local float4* positions_cache)
+    __global const float4* curr_positions,
+    __local float4* positions_cache,
+    uint num_particles,
+    uint first_particle,
+    uint num_local_particles
+    FORCE_DIAGNOSTICS_ARGS)
 {
-    //FLOPS : 2 * numWorkItems * num_particles * 12
+    //FLOPS : numWorkItems * num_particles * 20
+
+    //work item gid computes the force on particle first_particle + gid against all
+    //num_particles, so several devices can each take a slice of the particles.
 
     uint gid = get_global_id(0);
-    uint lid = get_local_id(0);
-    uint local_size = get_local_size(0);
-    uint num_particles = get_global_size(0);
+
+    //the global size is padded to a multiple of the work-group size, padding items only
+    //take part in the diagnostics reduction and write nothing.
+    bool active = (gid < num_local_particles);
 
     //read position and mass for this particle where 4th component is the mass.
-    float4 my_pos = curr_positions[gid];
+    float4 my_pos = active ? curr_positions[first_particle + gid] : (float4)0.0f;
     float3 force = (float3)0.0f;
+    float potential = 0.0f;
 
-    for (uint other = gid + 1; other < num_particles; ++other)
+    //every work item reads all particles straight from global memory. the symmetric half
+    //of the pairs is recomputed instead of scattered since there are no float atomics.
+    for (uint other = 0; other < num_particles; ++other)
     {
         float4 other_position = curr_positions[other];
 
-        float3 diff   = other_position.s012 - my_pos.s012;
-        float gravity = my_pos.s3 * other_position.s3 / (fast_length(diff) * dot(diff, diff));
+        float3 diff = other_position.s012 - my_pos.s012;
+        float dist2 = dot(diff, diff);
 
-        force += (gravity * diff);
+        force += get_pair_scale(other_position.s3, dist2) * diff;
+
+#if defined(COMPUTE_DIAGNOSTICS)
+        potential += get_pair_potential(other_position.s3, dist2);
+#endif
     }
 
-    // since atomics for floats is not supported, we need to calculate
-    // the opposite forces as follows
-    for (int other = gid; other >= 0; --other)
+    //write forces so that we can use it later to update positions after syncing.
+    if (active)
     {
-        float4 other_position = curr_positions[other];
+        forces[gid] = (float4)(get_force_factor(my_pos.s3) * force, 0.f);
+    }
 
-        float3 diff   = my_pos.s012 - other_position.s012;
-        float gravity = my_pos.s3 * other_position.s3 / (fast_length(diff) * dot(diff, diff));
+#if defined(COMPUTE_DIAGNOSTICS)
+    uint lid = get_local_id(0);
+    uint local_size = get_local_size(0);
 
-        force = select(force, force - (gravity * diff), (uint3)other < gid);
-    }
+    //every pair is visited from both ends, the local buffer only serves the reduction.
+    positions_cache[lid] = (float4)(active ? 0.5f * get_force_factor(my_pos.s3) * potential : 0.0f, 0.0f, 0.0f, 0.0f);
 
-    //write forces so that we can use it later to update positions after syncing.
-    forces[gid] = (float4)(force, 0.f);
+    reduce_work_group(positions_cache, lid, local_size);
+
+    if (lid == 0)
+    {
+        potential_partials[partial_offset + get_group_id(0)] = positions_cache[0].s0;
+    }
+#endif
 }
 
 __kernel void compute_positions(__global float4* forces,
     __global float4* curr_positions,
     __global float4* new_positions,
     __global float4* current_velocities,
-    float time_step)
+    float time_step,
+    uint num_particles,
+    uint first_particle)
 {
     //FLOPS : numWorkItems * 6
 
+    //updates particles first_particle .. first_particle + num_particles of curr_positions,
+    //new_positions, forces and current_velocities only hold that slice.
+
     uint gid = get_global_id(0);
 
+    if (gid >= num_particles)
+    {
+        return;
+    }
+
     //read position and mass for this particle, 4th component is mass.
-    float4 my_pos = curr_positions[gid];
+    float4 my_pos = curr_positions[first_particle + gid];
 
     //make a copy of the mass so we don't lose it during vector operations.
     float my_mass = my_pos.s3;
@@ -72,31 +232,70 @@ __kernel void compute_positions(__global float4* forces,
 __kernel void compute_velocities(__global float4* oldForces,
     __global float4* new_forces,
     __global float4* current_velocities,
-    float time_step)
+    float time_step,
+    uint num_particles
+    VELOCITY_DIAGNOSTICS_ARGS)
 {
     //FLOPS : numWorkItems * 5
 
-    uint gid        = get_global_id(0);
-    uint lid        = get_local_id(0);
-    uint local_size = get_local_size(0);
+    uint gid = get_global_id(0);
 
-    //read velocity for this particle, 4th component is mass.
-    float4 my_velocity = current_velocities[gid];
+    //kinetic energy and momentum of this particle, padding items add nothing but still
+    //have to reach the barriers of the reduction.
+    float4 my_kinetic = (float4)0.0f;
 
-    //make copy of mass so we don't lose it during vector operations.
-    float my_mass = my_velocity.s3;
+    if (gid < num_particles)
+    {
+        //read velocity for this particle, 4th component is mass.
+        float4 my_velocity = current_velocities[gid];
 
-    //old force for this particle.
-    float4 myOldForce = oldForces[gid];
+        //make copy of mass so we don't lose it during vector operations.
+        float my_mass = my_velocity.s3;
 
-    //current force for this particle.
-    float4 myNewForce = new_forces[gid];
+        //old force for this particle.
+        float4 myOldForce = oldForces[gid];
 
-    //update velocity.
-    float acc = time_step * 0.5f / my_mass;
+        //current force for this particle.
+        float4 myNewForce = new_forces[gid];
+
+        //update velocity.
+        float acc = time_step * 0.5f / my_mass;
+
+        my_velocity = my_velocity + acc * (myOldForce + myNewForce);
+
+        my_velocity.s3 = my_mass;
+        current_velocities[gid] = my_velocity;
+
+        my_kinetic = (float4)(0.5f * my_mass * dot(my_velocity.s012, my_velocity.s012), my_mass * my_velocity.s012);
+    }
+
+#if defined(COMPUTE_DIAGNOSTICS)
+    uint lid = get_local_id(0);
+
+    scratch[lid] = my_kinetic;
+
+    reduce_work_group(scratch, lid, get_local_size(0));
+
+    if (lid == 0)
+    {
+        kinetic_partials[partial_offset + get_group_id(0)] = scratch[0];
+    }
+#endif
+}
 
-    my_velocity = my_velocity + acc * (myOldForce + myNewForce);
+__kernel void permute_particles(__global const float4* source,
+    __global float4* destination,
+    __global const uint* order,
+    uint num_particles)
+{
+    //gathers the particles into a new order, order[new index] = old index.
+
+    uint gid = get_global_id(0);
+
+    if (gid >= num_particles)
+    {
+        return;
+    }
 
-    my_velocity.s3 = my_mass;
-    current_velocities[gid] = my_velocity;
+    destination[gid] = source[order[gid]];
 }